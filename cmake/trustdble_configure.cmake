@@ -2,4 +2,25 @@ IF(WITH_ASAN)
   message(STATUS "[TRUSTDBLE] Enabling address sanitizer")
   set (CMAKE_CXX_FLAGS_DEBUG "${CMAKE_CXX_FLAGS_DEBUG}  -fsanitize=address -fno-omit-frame-pointer")
   set (CMAKE_EXE_LINKER_FLAGS_DEBUG "${CMAKE_LINKER_FLAGS_DEBUG} -fsanitize=address -fno-omit-frame-pointer")
+ENDIF()
+
+IF(WITH_ASAN OR WITH_POOL_BYPASS)
+  message(STATUS "[TRUSTDBLE] Allocating pooled objects on the heap directly")
+  add_compile_definitions(POOL_BYPASS)
+ENDIF()
+
+IF(WITH_FLAT_HASHTABLE)
+  message(STATUS "[TRUSTDBLE] Using open-addressing hash tables")
+  add_compile_definitions(FLAT_HASHTABLE)
+ENDIF()
+
+set(HASH_FUNCTION "modulo" CACHE STRING "Hash function of the lock and transaction tables (modulo, fibonacci or mix64)")
+IF(HASH_FUNCTION STREQUAL "fibonacci")
+  message(STATUS "[TRUSTDBLE] Using multiplicative (Fibonacci) hashing")
+  add_compile_definitions(FIBONACCI_HASH)
+ELSEIF(HASH_FUNCTION STREQUAL "mix64")
+  message(STATUS "[TRUSTDBLE] Using a 64-bit mixer as hash function")
+  add_compile_definitions(MIX64_HASH)
+ELSEIF(NOT HASH_FUNCTION STREQUAL "modulo")
+  message(FATAL_ERROR "[TRUSTDBLE] Unknown HASH_FUNCTION ${HASH_FUNCTION}")
 ENDIF()
\ No newline at end of file
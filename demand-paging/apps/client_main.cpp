@@ -25,14 +25,9 @@ void RunClient() {
   client.requestSharedLock(transactionA, lockBudget, true);
   client.requestSharedLock(transactionB, lockBudget, true);
 
-  // Both release the locks again
-  for (int rowId = 1; rowId < lockBudget; rowId++) {
-    client.requestUnlock(transactionA, rowId, false);
-    client.requestUnlock(transactionB, rowId, false);
-  }
-
-  client.requestUnlock(transactionA, lockBudget, false);
-  client.requestUnlock(transactionB, lockBudget, true);
+  // Both release the locks again, each with a single request
+  client.requestCommit(transactionA);
+  client.requestCommit(transactionB);
 }
 
 auto main() -> int {
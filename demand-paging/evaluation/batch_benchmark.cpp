@@ -0,0 +1,98 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lockmanager.h"
+
+using std::ofstream;
+using std::string;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::high_resolution_clock;
+using std::chrono::nanoseconds;
+
+const int transactionId = 1;
+const int numWorkerThreads = 4;
+const int repetitions = 3;
+const int numLocks = 65536;  // rows a transaction locks in each experiment
+
+// Number of lock requests that are sent to the enclave with one ECALL
+const vector<int> batchSizes = {1, 8, 64, 512};
+
+/**
+ * Writes the data all in one into a CSV file
+ * @param filename the name of the csv file
+ * @param values the outer vector contains the rows and the inner vector
+ * resembles a row with its column values
+ */
+void writeToCSV(string filename, vector<vector<long>> values) {
+  ofstream file;
+  file.open(filename + ".csv", std::ios_base::app);
+
+  for (const auto& row : values) {
+    for (int i = 0; i < row.size() - 1; i++) {
+      file << row[i] << ",";
+    }
+    file << row[row.size() - 1];
+    file << std::endl;
+  }
+  file.close();
+}
+
+/**
+ * Highlevel description of the experiment:
+ * A transaction locks numLocks rows in shared mode with lockBatch(), sending
+ * batchSize requests to the enclave at once and waiting for them before it
+ * sends the next batch. A batch of one request pays a transition into the
+ * enclave for each lock like lock(), larger batches share it.
+ *
+ * @returns the batch size, the duration of the experiment and the mean cost of
+ * a request in nanoseconds
+ */
+auto experiment(int batchSize) -> vector<long> {
+  auto lockManager = LockManager(numWorkerThreads);
+  lockManager.registerTransaction(transactionId, numLocks);
+
+  vector<BatchedLock> batch;
+  batch.reserve(batchSize);
+  long failed = 0;
+
+  //=========== TIME MEASUREMENT ================
+  auto begin = high_resolution_clock::now();
+  for (int rowId = 1; rowId <= numLocks; rowId++) {
+    batch.push_back({transactionId, (unsigned int)rowId, false});
+    if ((int)batch.size() == batchSize || rowId == numLocks) {
+      for (const auto& result : lockManager.lockBatch(batch)) {
+        failed += result.second ? 0 : 1;
+      }
+      batch.clear();
+    }
+  }
+  auto end = high_resolution_clock::now();
+  //=============================================
+
+  lockManager.commit(transactionId);
+  if (failed > 0) {
+    std::cout << failed << " lock requests failed" << std::endl;
+  }
+
+  long duration = duration_cast<nanoseconds>(end - begin).count();
+  std::cout << "Batch size " << batchSize << ": " << duration / numLocks
+            << " ns per request" << std::endl;
+  return {batchSize, duration, duration / numLocks};
+}
+
+auto main() -> int {
+  spdlog::set_level(spdlog::level::err);
+  vector<vector<long>> contentCSVFile;
+
+  for (int batchSize : batchSizes) {
+    for (int i = 0; i < repetitions; i++) {
+      contentCSVFile.push_back(experiment(batchSize));
+    }
+  }
+
+  writeToCSV("batch_out", contentCSVFile);
+  return 0;
+}
@@ -0,0 +1,44 @@
+num_threads=4
+output_file=batch_out.csv
+sealed_keys_file=sealed_data_blob.txt
+
+echo "Starting batch evaluation..."
+
+# Delete old output file
+if [ -f "$output_file" ]; then
+    rm $output_file
+fi
+
+# Compile the project in release mode
+cmake -DSGX_HW=ON -DSGX_MODE=Debug -DCMAKE_BUILD_TYPE=Release -S .. -B ../build >/dev/null
+
+# Comment out logging, because this would cause a costly OCALL regardless of the logging level)
+sed -i -e "s@print_debug@// print_debug@" ../src/enclave/enclave.cpp ../src/lockmanager/lockmanager.cpp
+
+# Set number of threads
+sed -i -e "s/numWorkerThreads = [0-9]*/numWorkerThreads = ${num_threads}/" batch_benchmark.cpp
+thread_num_config=$(($num_threads+2)) # two more for transaction table and main thread
+sed -i -e "s/<TCSNum>[0-9]*/<TCSNum>${thread_num_config}/" ../src/enclave/enclave.config.xml
+
+# Build the project
+cmake --build ../build >/dev/null
+
+# Get most recent enclave.signed.so
+cp ../build/apps/enclave.signed.so .
+
+# Remove old sealed keys, they cannot be opened by the enclave when its config changed, throwing an error
+if [ -f "$sealed_keys_file" ]; then
+  rm $sealed_keys_file
+fi
+
+# Start the benchmarking
+./../build/evaluation/batch_benchmark
+
+echo "Finished batch experiment"
+
+# Reset everything to its original values
+sed -i -e "s/<TCSNum>[0-9]*/<TCSNum>3/" ../src/enclave/enclave.config.xml
+sed -i -e "s@// print_debug@print_debug@" ../src/enclave/enclave.cpp ../src/lockmanager/lockmanager.cpp
+
+rm $sealed_keys_file
+rm enclave.signed.so
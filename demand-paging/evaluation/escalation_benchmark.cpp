@@ -0,0 +1,98 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lockmanager.h"
+
+using std::ofstream;
+using std::string;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::high_resolution_clock;
+using std::chrono::nanoseconds;
+
+const int transactionA = 1;
+const int numWorkerThreads = 1;
+
+// Numbers of rows a transaction locks, up to several tables of 65536 rows
+const vector<int> numLocks = {1000, 10000, 50000, 100000, 200000};
+
+// Row locks within a table that trigger lock escalation, 0 disables it
+const vector<int> thresholds = {0, 1000};
+
+/**
+ * Writes the data all in one into a CSV file
+ * @param filename the name of the csv file
+ * @param values the outer vector contains the rows and the inner vector
+ * resembles a row with its column values
+ */
+void writeToCSV(string filename, vector<vector<long>> values) {
+  ofstream file;
+  file.open(filename + ".csv", std::ios_base::app);
+
+  for (const auto& row : values) {
+    for (int i = 0; i < row.size() - 1; i++) {
+      file << row[i] << ",";
+    }
+    file << row[row.size() - 1];
+    file << std::endl;
+  }
+  file.close();
+}
+
+/**
+ * Highlevel description of the experiment:
+ * A transaction locks a growing number of rows in shared mode, with lock
+ * escalation disabled and enabled. Without escalation each lock stays in the
+ * lock table inside the enclave, so the enclave heap outgrows the EPC and
+ * paging dominates the latency of the requests. With escalation the locks of
+ * each table are replaced by one table lock once the threshold is exceeded.
+ *
+ * The footprint is measured by the entries of the lock table and the slabs
+ * the pools allocated from the enclave heap, while the locks are still held.
+ */
+auto experiment(int locks, int threshold) -> vector<long> {
+  auto lockManager =
+      LockManager(numWorkerThreads, ABORT_ON_CONFLICT, threshold);
+  lockManager.registerTransaction(transactionA, locks);
+
+  //=========== TIME MEASUREMENT ================
+  auto begin = high_resolution_clock::now();
+  for (int rowId = 1; rowId <= locks; rowId++) {
+    lockManager.lock(transactionA, rowId, false);
+  }
+  auto end = high_resolution_clock::now();
+  //=============================================
+
+  long duration = duration_cast<nanoseconds>(end - begin).count();
+  BucketStatistics buckets = lockManager.getLockTableStatistics();
+  PoolStatistics pools = lockManager.getPoolStatistics();
+  EscalationStatistics escalation = lockManager.getEscalationStatistics();
+  std::cout << locks << " locks with threshold " << threshold << ": "
+            << (double)locks * 1e9 / duration << " locks/s, "
+            << buckets.entries << " lock table entries, " << pools.slabs
+            << " slabs, " << escalation.escalations << " escalations"
+            << std::endl;
+
+  return {threshold,
+          locks,
+          duration,
+          (long)buckets.entries,
+          (long)pools.slabs,
+          (long)escalation.escalations};
+}
+
+auto main() -> int {
+  spdlog::set_level(spdlog::level::err);
+  vector<vector<long>> contentCSVFile;
+
+  for (int locks : numLocks) {
+    for (int threshold : thresholds) {
+      contentCSVFile.push_back(experiment(locks, threshold));
+    }
+  }
+
+  writeToCSV("escalation", contentCSVFile);
+  return 0;
+}
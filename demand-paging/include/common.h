@@ -2,41 +2,210 @@
 
 #include <stdbool.h>
 
+#ifdef FLAT_HASHTABLE
 /**
- * This struct is used either as a transaction table, where the keys
- * resemble the TXIDs and the value the transaction structs or a lock table,
- * with RIDs as keys and lock structs as values.
+ * A slot of an open-addressing bucket. The key is stored inline next to its
+ * entry, so probing a bucket does not need to chase any pointers. The entries
+ * themselves stay where they are when the slots move, so pointers to their
+ * values remain valid.
  */
 typedef struct {
-  int size;
-  struct Entry** table;
-} HashTable;
+  int key;
+  struct Entry* entry;
+} FlatSlot;
+
+/**
+ * An open-addressing bucket with linear probing. For each slot it keeps one
+ * control byte, which is either kEmpty or a 7 bit tag taken from the hash of
+ * the key stored in that slot, so that 16 slots can be probed with a single
+ * SIMD comparison. The first 15 control bytes are mirrored behind the last one
+ * so that loading a group of control bytes never has to wrap around. Control
+ * bytes and slots are allocated together with the bucket in one block.
+ */
+typedef struct {
+  int capacity;       // number of slots, always a power of two
+  int count;          // number of occupied slots
+  signed char* ctrl;  // capacity + 15 control bytes
+  FlatSlot* slots;    // capacity slots
+} FlatBucket;
+
+/**
+ * The untyped part of a HashTable<Key, Value> (see hashtable.h), which is used
+ * either as a transaction table, where the keys resemble the TXIDs and the
+ * values the transaction structs or a lock table, with RIDs as keys and lock
+ * structs as values.
+ *
+ * Instead of a linked list, each bucket is a small open-addressing table that
+ * grows on its own. Keys are still assigned to buckets via hash(), so each row
+ * keeps being served by exactly one worker thread.
+ */
+typedef struct {
+  int size;           // number of buckets
+  FlatBucket** table;  // buckets, allocated on the first insert
+} HashTableBase;
+#else
+// Maximum number of times the number of buckets of a bucket group can double
+#define HASHTABLE_MAX_LEVELS 16
+
+/**
+ * All keys with the same hash() belong to one bucket group. A group starts
+ * with a single bucket and grows by linear hashing: whenever it gets too full,
+ * its bucket number split is divided into itself and bucket
+ * split + 2^level. So a group grows one bucket at a time, without ever
+ * rehashing the whole table, and only ever by the worker thread that owns the
+ * group.
+ */
+typedef struct {
+  int level;  // the group has 2^level + split buckets
+  int split;  // number of buckets that are already split on this level
+  int count;  // number of entries within the group
+  struct Entry*** segments;  // segment l - 1 holds the buckets 2^(l-1) to
+                             // 2^l - 1 of the group, allocated as it grows
+} BucketGroup;
+
+/**
+ * The untyped part of a HashTable<Key, Value> (see hashtable.h), which is used
+ * either as a transaction table, where the keys resemble the TXIDs and the
+ * values the transaction structs or a lock table, with RIDs as keys and lock
+ * structs as values.
+ *
+ * The buckets are stored in segments that are allocated once and never move.
+ * The first bucket of every group is stored in a single array, the others in
+ * the segments of their group, so a group that grows does not allocate buckets
+ * for the groups that do not.
+ */
+typedef struct {
+  int size;               // number of bucket groups
+  struct Entry** heads;   // the first bucket of every group
+  BucketGroup* groups;
+} HashTableBase;
+#endif
 
+/**
+ * Header of every entry of a hash table. The value of the entry is stored
+ * right behind it, see Node in hashtable.h.
+ */
 typedef struct Entry Entry;  // Required to use C++ structs as C structs
 struct Entry {
   int key;
-  void* value;
   struct Entry* next;
 };
 
-enum Command { SHARED, EXCLUSIVE, UNLOCK, QUIT, REGISTER };
+/**
+ * Counters of the pools that locks, transactions and hash table entries are
+ * allocated from
+ */
+struct PoolStatistics {
+  unsigned long hits;    // allocations served from the free list of a thread
+  unsigned long misses;  // allocations that had to refill a free list
+  unsigned long slabs;   // number of slabs allocated from the heap
+};
+typedef struct PoolStatistics PoolStatistics;
+
+// Number of bucket lengths that BucketStatistics tells apart. Longer buckets
+// are counted in the last slot of the histogram.
+#define BUCKET_HISTOGRAM_SIZE 16
+
+/**
+ * Distribution of the entries of a hash table over its buckets
+ */
+struct BucketStatistics {
+  unsigned long buckets;     // number of buckets
+  unsigned long entries;     // number of entries
+  unsigned long max_length;  // number of entries of the longest bucket
+  unsigned long histogram[BUCKET_HISTOGRAM_SIZE];  // buckets of each length
+};
+typedef struct BucketStatistics BucketStatistics;
+
+/**
+ * Counters of lock escalation, which replaces the row locks of a transaction
+ * within a table by a single lock on the table
+ */
+struct EscalationStatistics {
+  unsigned long escalations;     // tables locked instead of their rows
+  unsigned long escalated_rows;  // row locks released by escalations
+  unsigned long failed;          // escalations that conflicted with others
+};
+typedef struct EscalationStatistics EscalationStatistics;
+
+/**
+ * Owner and load of a partition of the lock table. The partitions are
+ * reassigned to the worker threads by their load, see BALANCE.
+ */
+struct PartitionStatistics {
+  int owner;                 // worker thread serving the partition
+  unsigned long queued;      // jobs waiting to be served
+  unsigned long served;      // jobs served since the start
+  unsigned long migrations;  // times the partition moved to another worker
+};
+typedef struct PartitionStatistics PartitionStatistics;
+
+/**
+ * Levels of the lock hierarchy. Each row belongs to a page, each page to a
+ * table and each table to the database, see parentOf().
+ */
+enum Granule { ROW, PAGE, TABLE, DATABASE };
+
+/**
+ * Modes of multi-granularity locking. The intention modes IS and IX announce
+ * shared or exclusive locks on finer granules, SIX combines S and IX. U reads
+ * a granule that the transaction may write later: it is compatible with S but
+ * not with another U, so two read-then-write transactions queue up on U
+ * instead of deadlocking on the conversion to X.
+ */
+enum LockMode { IS_LOCK, IX_LOCK, S_LOCK, SIX_LOCK, X_LOCK, U_LOCK };
+
+enum Command {
+  SHARED,
+  EXCLUSIVE,
+  UNLOCK,
+  QUIT,
+  REGISTER,
+  LOCK_GRANULE,
+  LOCK_RANGE,
+  UNLOCK_RANGE,
+  COMMIT,
+  ABORT,
+  BALANCE,
+  MIGRATE,
+  ADOPT
+};
 
 struct Job {
   enum Command command;
   unsigned int transaction_id;
-  unsigned int row_id;
+  unsigned int row_id;       // ID of the row, page or table
+  enum Granule granule;      // level of row_id, for LOCK_GRANULE and UNLOCK
+  enum LockMode mode;        // requested mode, for LOCK_GRANULE and LOCK_RANGE
+  unsigned int last_row_id;  // last row of the range, starting at row_id
+  int partition;  // partition of the lock table the job is sent to
+  int worker;     // worker thread the partition moves to, for MIGRATE
+  unsigned long time;  // milliseconds since the epoch, for BALANCE
+  void* range;    // RangeRequest shared by the parts of a range request
+  void* release;  // ReleaseRequest shared by the parts of COMMIT or ABORT
   unsigned int lock_budget;
   bool wait_for_result;
   volatile char* return_value;
-  volatile bool* finished;
-  volatile bool* error;
+  struct Completion* finished;  // set once the request finished
+  bool* error;  // written before finished is set
 };
 typedef struct Job Job;  // Required to use C++ structs as C structs
 
+/**
+ * What happens to a lock request that conflicts with the owners of its lock
+ */
+enum ConflictPolicy {
+  ABORT_ON_CONFLICT,  // the request fails and its transaction aborts
+  WAIT_ON_CONFLICT    // the request waits in the queue of the lock, if allowed
+};
+
 struct Arg {
   int num_threads;
-  int tx_thread_id;
+  int num_partitions;  // partitions of the lock table, see partition_of()
   int transaction_table_size;
   int lock_table_size;
+  enum ConflictPolicy conflict_policy;
+  int escalation_threshold;  // row locks within a table that make a
+                             // transaction lock the table instead, 0 for none
 };
 typedef struct Arg Arg;  // Required to use C++ structs as C structs
\ No newline at end of file
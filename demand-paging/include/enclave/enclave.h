@@ -5,27 +5,68 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <cstring>
-#include <queue>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "base64-encoding.h"
 #include "common.h"
+#include "completion.h"
 #include "enclave_t.h"
+#include "granule.h"
+#include "job_ring.h"
 #include "lock.h"
+#include "pool.h"
+#include "range_index.h"
 #include "sgx_tcrypto.h"
 #include "sgx_tkey_exchange.h"
 #include "sgx_trts.h"
 #include "sgx_tseal.h"
 #include "transaction.h"
+#include "wait_queue.h"
 
 // Holds the transaction objects of the currently active transactions
-HashTable *transactionTable_;
+TransactionTable *transactionTable_;
 
 // Keeps track of a lock object for each row ID
-HashTable *lockTable_;
+LockTable *lockTable_;
+
+// Keeps track of the locks of pages, tables and the database
+GranuleTable *granuleTable_;
+
+// Lock requests waiting for the lock of a row, with WAIT_ON_CONFLICT
+WaitTable *waitTable_;
+
+// Range locks on the rows of each partition
+RangeIndex *rangeIndex_;
+std::atomic<int> numRanges_;  // lets row requests skip empty range indexes
+
+// Counters of lock escalation, see EscalationStatistics
+std::atomic<unsigned long> escalations_;
+std::atomic<unsigned long> escalatedRows_;
+std::atomic<unsigned long> failedEscalations_;
+
+// Partition map of the lock table. The partitions move between the worker
+// threads by their load, see balance_partitions(). Only the owner of a
+// partition changes its owner, when it hands it over.
+std::atomic<int> *partitionOwner_;    // worker thread owning each partition
+std::atomic<int> *partitionSenders_;  // threads sending a job to each
+                                      // partition right now
+std::atomic<int> *partitionJobs_;     // queued jobs of each partition
+std::atomic<unsigned long> *partitionServed_;      // served jobs of each
+                                                   // partition
+std::atomic<unsigned long> *partitionMigrations_;  // see PartitionStatistics
+std::atomic<bool> *adopting_;  // the partition migrates, but was not handed
+                               // over by its former owner yet
+std::atomic<bool> migrating_;  // a partition migrates, one at a time
+
+// Load of the worker threads measured by the balancer, which runs in one
+// thread at a time
+unsigned long lastBalance_;    // time of the last round in milliseconds
+unsigned long *lastServed_;    // served jobs of each partition back then
+unsigned long *serviceTime_;   // nanoseconds each worker spends on a job
 
 // Public private key pair for signing lock requests
 sgx_ec256_private_t ec256_private_key;
@@ -33,6 +74,53 @@ sgx_ec256_public_t ec256_public_key;
 
 const size_t MAX_SIGNATURE_LENGTH = 255;
 
+// Maximum number of jobs a worker thread takes from its queue at once
+const int kJobBatchSize = 16;
+
+// Minimum number of queued jobs of a worker thread before the balancer moves
+// one of its partitions to another worker
+const int kBalanceThreshold = 8;
+
+/**
+ * Outcome of a lock request
+ */
+enum LockResult {
+  GRANTED,      // the transaction holds the lock in the requested mode now
+  CONFLICTING,  // other transactions hold the lock in a conflicting mode
+  REJECTED,     // the request is invalid, e.g. it violates 2PL
+  WAITING       // the request waits in the queue of the lock
+};
+
+/**
+ * How the lock on its table affects a row lock request, with lock escalation
+ */
+enum TableAccess {
+  NOT_COUNTED,  // lock escalation is disabled
+  COUNTED,      // the row lock is counted within its table
+  COVERED,      // the transaction holds the table in a mode implying the row
+  BLOCKED       // another transaction holds the table in a conflicting mode
+};
+
+/**
+ * A partition of the lock table that a worker thread hands over to another
+ * worker. The worker still serves the jobs that were sent to it before, and
+ * tells the new owner with an ADOPT job once it took the last of them from its
+ * ring.
+ */
+struct Handoff {
+  int partition;
+  int worker;             // worker thread that owns the partition now
+  bool isDrained;         // no more jobs are sent to the former owner
+  unsigned long lastJob;  // position behind the last job of the partition in
+                          // the ring of the former owner, once drained
+};
+typedef struct Handoff Handoff;
+
+// Partitions each worker thread hands over, and the jobs each worker keeps
+// until the partition it takes over is handed over
+std::vector<Handoff> *handoffs_;
+std::vector<Job> *adoptedJobs_;
+
 // Base64 encoded public key
 std::string encoded_public_key;
 
@@ -66,15 +154,132 @@ void enclave_init_values(Arg arg);
 void enclave_send_job(void *data);
 
 /**
- * Function that is run by the worker threads inside the enclave. It pulls a job
- * from its associated job queue in a loop and executes it, e.g. acquiring a
- * shared lock for a specific row. Each row gets assigned a specific thread
- * evenly, so no synchronization is necessary when accessing the underlying lock
- * table. The transaction table is accessed by only one single thread for all
- * requests to register a transaction.
+ * Receives a batch of jobs from the untrusted application and puts each of
+ * them into the job queue of its worker thread like enclave_send_job(), so
+ * that the whole batch costs a single transition into the enclave.
+ *
+ * @param data array of num_jobs Job structs
+ * @param num_jobs the number of jobs in the batch
+ */
+void enclave_send_jobs(void *data, size_t num_jobs);
+
+/**
+ * Function that is run by the worker threads inside the enclave. It pulls the
+ * pending jobs from its associated job queue in a loop and executes them one
+ * after another, e.g. acquiring a shared lock for a specific row. Each row gets
+ * assigned a specific thread evenly, so no synchronization is necessary when
+ * accessing the underlying lock table. The transaction table is accessed by
+ * only one single thread for all requests to register a transaction.
  */
 void enclave_process_request();
 
+/**
+ * Pushes a job into the ring of a worker thread and wakes the worker up, if
+ * it sleeps
+ *
+ * @param thread_id the worker thread
+ * @param job the job to execute
+ */
+void enqueue_job(int thread_id, const Job &job);
+
+/**
+ * Takes up to kJobBatchSize jobs from the ring of a worker thread. Polls the
+ * ring while it is empty, and sleeps once polling does not pay off.
+ *
+ * @param thread_id the worker thread
+ * @param jobs buffer for kJobBatchSize jobs
+ * @returns the number of jobs taken, or 0 if the worker must not sleep as it
+ * hands over a partition, see finish_handoffs()
+ */
+auto dequeue_jobs(int thread_id, Job *jobs) -> int;
+
+/**
+ * Sends a job to the worker thread that owns a partition of the lock table
+ *
+ * @param partition the partition of the rows of the job
+ * @param job the job to execute
+ */
+void send_to_partition(int partition, Job &job);
+
+/**
+ * Measures the load of the worker threads since the last round and moves a
+ * partition from the worker with the longest backlog to the one with the
+ * shortest, if the backlog of the former is more than twice as long. The
+ * backlog of a worker is the number of its queued jobs times the time it
+ * spends on a job, which differs between the workers with the paging of the
+ * enclave. A single partition migrates at a time.
+ *
+ * @param time the current time in milliseconds, sent by the untrusted
+ * application with a BALANCE job
+ */
+void balance_partitions(unsigned long time);
+
+/**
+ * Hands a partition over to another worker thread with a MIGRATE job. Later
+ * jobs of the partition are sent to the new owner, which keeps them until
+ * this worker served the jobs it got before, see finish_handoffs().
+ *
+ * @param threadId the worker thread owning the partition
+ * @param job the MIGRATE job
+ */
+void hand_off_partition(int threadId, Job &job);
+
+/**
+ * Tells the new owners of the partitions a worker thread handed over, once it
+ * took the last job sent to it for them from its ring
+ *
+ * @param threadId the worker thread that handed over the partitions
+ */
+void finish_handoffs(int threadId);
+
+/**
+ * Takes over a partition from the worker thread that handed it over, and
+ * executes the jobs of the partition that were kept meanwhile
+ *
+ * @param threadId the worker thread that owns the partition now
+ * @param job the ADOPT job
+ */
+void adopt_partition(int threadId, Job &job);
+
+/**
+ * Checks if a job is for a partition that migrates to its worker thread, but
+ * that the former owner did not hand over yet
+ *
+ * @param threadId the worker thread
+ * @param job a job taken from the ring of the worker thread
+ */
+auto is_adopting(int threadId, const Job &job) -> bool;
+
+/**
+ * Executes a single job that was taken from the job queue, except QUIT.
+ *
+ * @param job the job to execute
+ * @param threadId the ID of the executing worker thread
+ */
+void process_job(Job &job, int threadId);
+
+/**
+ * Hands the result of a lock request to the client waiting for it, i.e. the
+ * base64 encoded signature of the lock or an error.
+ *
+ * @param job the SHARED or EXCLUSIVE job of the request
+ * @param signature the signature of the granted lock, or nullptr if the
+ * request failed
+ */
+void complete_job(Job &job, sgx_ec256_signature_t *signature);
+
+/**
+ * Looks up the locks of all lock and unlock jobs of a batch at once with
+ * getMany(), so that their buckets are fetched from memory in parallel instead
+ * of one after another. The jobs still look up their locks on their own, as
+ * the jobs before them may add or remove locks, but then find them in the
+ * cache.
+ *
+ * @param jobs the jobs taken from the job queue
+ * @param numJobs the number of jobs
+ */
+void prefetch_locks(Job *jobs, int numJobs);
+
 /**
  * @returns the size of the encrypted DataToSeal struct
  */
@@ -141,39 +346,339 @@ int register_transaction(unsigned int transactionId, unsigned int lockBudget);
 
 /**
  * Acquires a lock for the specified row and writes the signature into the
- * provided buffer.
+ * provided buffer, or parks the request in the wait queue of the lock.
  *
  * @param signature buffer where the enclave will store the signature
- * @param sig_len length of the buffer
- * @param transactionId identifies the transaction making the request
- * @param rowId identifies the row to be locked
- * @param requestedMode either shared for concurrent read access or exclusive
- * for sole write access
+ * @param job the SHARED or EXCLUSIVE job of the request, which is completed by
+ * grant_waiters() if it has to wait
  * @param threadId the context for signing locks is exclusive for each thread,
  * therefore we need to know the calling thread's ID
- * @returns SGX_ERROR_UNEXPCTED, when transaction did not call
- * RegisterTransaction before or the given lock mode is unknown or when the
- * transaction makes a request for a look, that it already owns, makes a
- * request for a lock while in the shrinking phase, or when the lock budget is
- * exhausted
+ * @returns GRANTED or WAITING. CONFLICTING and REJECTED mean that the
+ * transaction did not call RegisterTransaction before or makes a request for a
+ * lock, that it already owns, makes a request for a lock while in the
+ * shrinking phase, conflicts with the owners of the lock or exhausted its lock
+ * budget, and was aborted.
+ */
+auto acquire_lock(void *signature, Job &job, int threadId) -> LockResult;
+
+/**
+ * Acquires a lock for the specified row without signing it.
+ *
+ * @param transaction the transaction making the request
+ * @param rowId identifies the row to be locked
+ * @param mode S for concurrent read access, X for sole write access or U for
+ * read access that converts to X later
+ * @returns GRANTED, CONFLICTING or REJECTED
+ */
+auto acquire_row_lock(Transaction *transaction, unsigned int rowId,
+                      LockMode mode) -> LockResult;
+
+/**
+ * Acquires a lock on a page, a table or the database, or converts the mode the
+ * transaction holds it in, and writes the signature into the provided buffer.
+ *
+ * @param signature buffer where the enclave will store the signature
+ * @param job the LOCK_GRANULE job of the request
+ * @param threadId the ID of the calling thread, whose signing context is used
+ * @returns GRANTED, or CONFLICTING or REJECTED after aborting the transaction.
+ * Requests for granule locks never wait.
+ */
+auto acquire_granule_lock(void *signature, Job &job, int threadId)
+    -> LockResult;
+
+/**
+ * Checks if a LOCK_GRANULE request follows the rules of multi-granularity
+ * locking: the transaction holds the parent granule in a mode that allows the
+ * requested mode, and rows are only locked in S, U or X mode.
+ *
+ * @param transaction the transaction making the request
+ * @param job the LOCK_GRANULE job of the request
+ */
+auto follows_hierarchy(Transaction *transaction, Job &job) -> bool;
+
+/**
+ * Returns the partition of the lock table that a row or granule falls into.
+ * Each worker thread starts with the same number of adjacent partitions, see
+ * partitionOwner_.
+ *
+ * @param key identifies the row, or the granule, see granuleKey()
+ */
+auto partition_of(unsigned int key) -> int;
+
+/**
+ * Returns the partition of the transaction table that a transaction falls
+ * into. The worker thread of the same index registers the transaction, while
+ * any worker may look it up or remove it under the mutex of the partition.
+ *
+ * @param transactionId identifies the transaction
+ */
+auto transaction_partition_of(unsigned int transactionId) -> int;
+
+/**
+ * Adds a transaction to its partition of the transaction table
+ *
+ * @param transactionId identifies the transaction
+ * @param lockBudget maximum number of locks the transaction may acquire
+ * @returns false, if the transaction was already registered
+ */
+auto register_transaction(unsigned int transactionId, int lockBudget) -> bool;
+
+/**
+ * Checks if a transaction is registered in its partition of the transaction
+ * table
+ *
+ * @param transactionId identifies the transaction
+ */
+auto is_registered(unsigned int transactionId) -> bool;
+
+/**
+ * Looks up a transaction in its partition of the transaction table and keeps
+ * it alive until the calling thread passes it to unpin_transaction(), even if
+ * another thread removes it from the table meanwhile
+ *
+ * @param transactionId identifies the transaction
+ * @returns the node of the transaction, or nullptr if it is not registered
+ */
+auto pin_transaction(unsigned int transactionId) -> Node<Transaction> *;
+
+/**
+ * Releases a transaction pinned with pin_transaction(), and frees it if it was
+ * removed from the transaction table and nobody else pins it
+ */
+void unpin_transaction(Node<Transaction> *node);
+
+/**
+ * Frees a transaction that was removed from the transaction table, or leaves
+ * that to the last thread that unpins it
+ */
+void delete_transaction(Node<Transaction> *node);
+
+/**
+ * Removes a transaction from the transaction table and frees its sets of
+ * locks, if it does not hold any locks anymore
+ *
+ * @param transactionId identifies the transaction that released a lock
+ */
+void remove_if_idle(unsigned int transactionId);
+
+/**
+ * Removes a transaction from the transaction table without freeing it. Only
+ * the thread that gets its node may release its locks and has to pass it to
+ * delete_transaction() afterwards.
+ *
+ * @param transactionId identifies the transaction
+ * @param transaction if not nullptr, the transaction is only removed if it is
+ * still the one registered under its ID
+ * @returns the node of the transaction, or nullptr if it is not registered
+ */
+auto extract_transaction(unsigned int transactionId,
+                         Transaction *transaction = nullptr)
+    -> Node<Transaction> *;
+
+/**
+ * Splits a LOCK_RANGE or UNLOCK_RANGE job into one part for each partition
+ * that owns rows of the range and sends the parts to the job queues of their
+ * worker threads
+ *
+ * @param job the job of the request, with its parameters already copied
+ */
+void send_range_parts(Job &job);
+
+/**
+ * Removes the transaction of a COMMIT or ABORT job from the transaction table
+ * and splits the job into one part for each partition that owns rows the
+ * transaction holds locks on, or a single part if it holds none, and sends
+ * the parts to the job queues of their worker threads
+ *
+ * @param job the job of the request, with its parameters already copied
+ */
+void send_release_parts(Job &job);
+
+/**
+ * Releases the locks a committing or aborting transaction holds on the rows
+ * of one partition. The transaction is not updated, as it is freed by the
+ * last part anyway.
+ *
+ * @param job the part of the COMMIT or ABORT job
+ * @param threadId the ID of the calling thread, which signs the locks granted
+ * to waiting requests
+ */
+void release_part(Job &job, int threadId);
+
+/**
+ * Completes a COMMIT or ABORT request once all of its parts finished. The
+ * last part releases the granule and range locks of the transaction and
+ * frees it.
+ *
+ * @param job the part of the COMMIT or ABORT job
+ */
+void finish_release_part(Job &job);
+
+/**
+ * Acquires the part of a range lock that covers the rows of one partition.
+ * The range is added to the index of the partition before checking the locks
+ * of its rows.
+ *
+ * @param job the part of the LOCK_RANGE job
+ * @param threadId the ID of the calling thread
+ * @returns GRANTED, or CONFLICTING or REJECTED after aborting the transaction.
+ * Requests for range locks never wait.
+ */
+auto acquire_range_part(Job &job, int threadId) -> LockResult;
+
+/**
+ * Releases the part of a range lock that covers the rows of one partition
+ *
+ * @param job the part of the UNLOCK_RANGE job
+ */
+void release_range_part(Job &job);
+
+/**
+ * Completes a range request once all of its parts finished. A granted range
+ * is signed once, over the whole range.
+ *
+ * @param job the part of the LOCK_RANGE or UNLOCK_RANGE job
+ * @param ok if the part succeeded
+ * @param threadId the ID of the calling thread, whose signing context is used
+ */
+void finish_range_part(Job &job, bool ok, int threadId);
+
+/**
+ * Checks if another transaction holds a range lock on the row in a mode that
+ * conflicts with the requested mode
+ *
+ * @param transaction the transaction requesting the row
+ * @param rowId identifies the row
+ * @param isExclusive if the request is for sole write access
+ */
+auto conflicts_with_range(Transaction *transaction, unsigned int rowId,
+                          bool isExclusive) -> bool;
+
+/**
+ * Locks the mutex that serializes the granule table and the row locks counted
+ * within the tables with lock escalation, as the worker threads of all rows of
+ * a table count their locks within it then. Otherwise does nothing.
+ */
+void lock_granules();
+
+/**
+ * Unlocks the mutex locked with lock_granules()
+ */
+void unlock_granules();
+
+/**
+ * Checks the lock on the table of a row before the row is locked, and counts
+ * the row lock within it in advance
+ *
+ * @param transaction the transaction requesting the row
+ * @param rowId identifies the row
+ * @param isExclusive if the request is for sole write access
+ * @returns COUNTED, if the request must be settled with settle_row_count()
+ */
+auto enter_table(Transaction *transaction, unsigned int rowId,
+                 bool isExclusive) -> TableAccess;
+
+/**
+ * Removes a row lock of a transaction from the counts of its table
+ *
+ * @param transaction the transaction holding the row lock
+ * @param rowId identifies the row
+ * @param isExclusive if the row lock is exclusive
  */
-auto acquire_lock(void *signature, unsigned int transactionId,
-                  unsigned int rowId, bool isExclusive, int threadId) -> bool;
+void leave_table(Transaction *transaction, unsigned int rowId,
+                 bool isExclusive);
+
+/**
+ * Corrects the row lock counted by enter_table() after the request finished:
+ * removes it if the request did not get the lock, and the shared lock it
+ * replaced after an upgrade
+ *
+ * @param transaction the transaction requesting the row
+ * @param rowId identifies the row
+ * @param isExclusive if the request is for sole write access
+ * @param result the outcome of the request
+ * @param isUpgrade if the transaction held the row in shared mode before
+ */
+void settle_row_count(Transaction *transaction, unsigned int rowId,
+                      bool isExclusive, LockResult result, bool isUpgrade);
+
+/**
+ * Replaces the row locks of a transaction within a table by a single lock on
+ * the table, if no other transaction holds conflicting locks within it. X is
+ * taken if the transaction writes any of the rows, S otherwise. The released
+ * row locks are freed from the enclave heap, like with abort_transaction().
+ *
+ * @param transaction the transaction holding the row locks
+ * @param table identifies the table
+ * @param partition the partition the calling thread serves the request for.
+ * Only the row locks within it are released, the others are merely covered by
+ * the table lock until the transaction ends.
+ * @param threadId the ID of the calling thread, which signs the locks granted
+ * to waiting requests
+ */
+void escalate_table(Transaction *transaction, unsigned int table,
+                    int partition, int threadId);
+
+/**
+ * Signs the lock that a transaction holds on a row.
+ *
+ * @param signature buffer where the enclave will store the signature
+ * @param transactionId identifies the transaction holding the lock
+ * @param rowId identifies the locked row
+ * @param threadId the ID of the calling thread, whose signing context is used
+ */
+void sign_lock(void *signature, unsigned int transactionId, unsigned int rowId,
+               int threadId);
+
+/**
+ * Grants the lock of a row to the requests waiting for it, in the order they
+ * arrived, until the first one conflicts with the owners of the lock, and
+ * hands them their signatures.
+ *
+ * @param rowId identifies the row
+ * @param threadId the ID of the calling thread, whose signing context is used
+ */
+void grant_waiters(unsigned int rowId, int threadId);
 
 /**
  * Releases a lock for the specified row.
  *
  * @param transactionId identifies the transaction making the request
  * @param rowId identifies the row to be released
+ * @param threadId the ID of the calling thread, which signs the locks granted
+ * to waiting requests
+ */
+void release_lock(unsigned int transactionId, unsigned int rowId,
+                  int threadId);
+
+/**
+ * Releases a lock on a page, a table or the database.
+ *
+ * @param transactionId identifies the transaction making the request
+ * @param granule the level of the granule
+ * @param id identifies the page or table, 0 for the database
  */
-void release_lock(unsigned int transactionId, unsigned int rowId);
+void release_granule_lock(unsigned int transactionId, Granule granule,
+                          unsigned int id);
 
 /**
- * Releases all locks the given transaction currently has.
+ * Releases all locks the given transaction currently has. Several parts of a
+ * range may abort the same transaction at once, but only the first one
+ * releases its locks.
  *
- * @param transaction the transaction to be aborted
+ * @param transaction the transaction to be aborted, pinned by the caller
+ * @param threadId the ID of the calling thread, which signs the locks granted
+ * to waiting requests
  */
-void abort_transaction(Transaction *transaction);
+void abort_transaction(Transaction *transaction, int threadId);
+
+/**
+ * Releases the granule and range locks of a transaction, whose row locks were
+ * released already, and removes its row locks from the counts of their tables
+ *
+ * @param transaction the transaction that aborts or commits
+ */
+void release_other_locks(Transaction *transaction);
 
 /**
  * @returns the block timeout, which resembles a future block number of the
@@ -197,16 +702,79 @@ auto get_block_timeout() -> unsigned int;
 auto verify_signature(char *signature, int transactionId, int rowId,
                       int isExclusive) -> int;
 
+/**
+ * Copies the counters of the pools of the enclave heap out of the enclave.
+ *
+ * @param statistics buffer to store the counters in
+ */
+void get_pool_statistics(PoolStatistics *statistics);
+
+/**
+ * Copies the distribution of the locks over the buckets of the lock table out
+ * of the enclave.
+ *
+ * @param statistics buffer to store the distribution in
+ */
+void get_locktable_statistics(BucketStatistics *statistics);
+
+/**
+ * Copies the counters of lock escalation out of the enclave.
+ *
+ * @param statistics buffer to store the counters in
+ */
+void get_escalation_statistics(EscalationStatistics *statistics);
+
+/**
+ * Copies the owner and the load of each partition of the lock table out of
+ * the enclave.
+ *
+ * @param statistics buffer to store num_partitions entries in
+ * @param num_partitions the number of partitions, see Arg
+ */
+void get_partition_statistics(PartitionStatistics *statistics,
+                              size_t num_partitions);
+
 /**
  *  Get string representation of the lock tuple:
- * <TRANSACTION-ID>_<ROW-ID>_<MODE>_<BLOCKTIMEOUT>, where mode means, if the
- * lock is for shared or exclusive access.
+ * <TRANSACTION-ID>_<ROW-ID>_<MODE>_<BLOCKTIMEOUT>, where mode is S, U or X
+ * for shared, update or exclusive access.
  *
  * @param transactionId identifies the transaction
  * @param rowId identifies the row that is locked
+ * @param mode the mode the transaction holds the lock in
+ * @returns a string that represents a lock, that can be signed by the signing
+ * function
+ */
+auto lock_to_string(int transactionId, int rowId, LockMode mode)
+    -> std::string;
+
+/**
+ * Get string representation of the lock tuple of a page, a table or the
+ * database: <TRANSACTION-ID>_<GRANULE><ID>_<MODE>_<BLOCKTIMEOUT>, where granule
+ * is P, T or D and mode is IS, IX, S, SIX, X or U.
+ *
+ * @param transactionId identifies the transaction
+ * @param granule the level of the locked granule
+ * @param id identifies the page or table, 0 for the database
+ * @param mode the mode the transaction holds the lock in
+ * @returns a string that represents a lock, that can be signed by the signing
+ * function
+ */
+auto granule_lock_to_string(int transactionId, Granule granule, int id,
+                            LockMode mode) -> std::string;
+
+/**
+ * Get string representation of the lock tuple of a range of rows:
+ * <TRANSACTION-ID>_<FIRST-ROW-ID>-<LAST-ROW-ID>_<MODE>_<BLOCKTIMEOUT>, where
+ * mode is S or X.
+ *
+ * @param transactionId identifies the transaction
+ * @param firstRowId identifies the first row of the range
+ * @param lastRowId identifies the last row of the range
  * @param isExclusive if the lock is exclusive or shared
  * @returns a string that represents a lock, that can be signed by the signing
  * function
  */
-auto lock_to_string(int transactionId, int rowId, bool isExclusive)
-    -> std::string;
\ No newline at end of file
+auto range_lock_to_string(int transactionId, unsigned int firstRowId,
+                          unsigned int lastRowId, bool isExclusive)
+    -> std::string;
@@ -3,56 +3,255 @@
 #include <stdlib.h>
 
 #include "common.h"
-#include "lock.h"
-#include "transaction.h"
+#include "pool.h"
 
-HashTable* newHashTable(int size);
+#ifdef FLAT_HASHTABLE
+// Number of control bytes that are compared at once when probing a bucket
+const int kFlatGroupWidth = 16;
 
-Entry* newEntry(int key, void* value);
+// Number of slots of a newly allocated open-addressing bucket
+const int kFlatMinCapacity = kFlatGroupWidth;
+
+// Control byte of a free slot
+const signed char kEmpty = -128;
+#endif
+
+// Maximum number of lookups whose memory accesses are overlapped by getMany()
+const int kLookupBatchSize = 16;
+
+#ifndef FLAT_HASHTABLE
+// Average number of entries per bucket above which a bucket group grows
+const int kMaxLoadFactor = 2;
+
+// Maximum number of buckets that are split by a single insert
+const int kSplitsPerOperation = 2;
+#endif
+
+/**
+ * Entry of a HashTable<Key, Value>. The value is stored inline right behind
+ * the key and the link to the next entry of the bucket, so a lookup reaches
+ * the value without following another pointer. As the entry is the first
+ * member, pointers to a node and to its entry can be converted into each
+ * other.
+ */
+template <typename Value>
+struct Node {
+  Entry entry;
+  Value value;
+};
+
+/**
+ * Hash table that maps keys of type Key to values of type Value, which are
+ * stored inline in the entries of the table. All of its state is kept in the
+ * untyped HashTableBase, the type parameters only make sure that the values
+ * are accessed with their correct type.
+ */
+template <typename Key, typename Value>
+struct HashTable : HashTableBase {
+  typedef Key KeyType;
+};
+
+struct Lock;
+struct Transaction;
+typedef HashTable<int, Lock> LockTable;                // RIDs to locks
+typedef HashTable<int, Transaction> TransactionTable;  // TXIDs to transactions
+
+/**
+ * Allocates the buckets of an empty table
+ *
+ * @param hashTable the table to initialize
+ * @param size the number of bucket groups
+ */
+void initHashTable(HashTableBase* hashTable, int size);
+
+/**
+ * Frees all entries and buckets of a table, but not the table itself
+ *
+ * @param hashTable the table to destroy
+ * @param deleteEntry frees an entry together with its value
+ */
+void destroyHashTable(HashTableBase* hashTable, void (*deleteEntry)(Entry*));
 
 /**
- * Maps each key to an index from 0..size-1 within the hashtable
+ * Scrambles the key with the hash function selected at build time
+ * (-DHASH_FUNCTION=modulo|fibonacci|mix64). Keys are assigned to bucket groups
+ * by the remainder and to the buckets within a group by the quotient of the
+ * scrambled key, so that a function that spreads clustered or strided keys
+ * spreads them over both.
  *
- * @param size the number of buckets of either the lock or transaction table
+ * @param key TXID or RID
+ */
+inline auto hashKey(int key) -> unsigned int {
+#if defined(FIBONACCI_HASH)
+  // Multiplicative hashing with 2^32 divided by the golden ratio. The upper
+  // half of the product depends on all bits of the key, so it is rotated into
+  // the lower half, which selects the bucket group.
+  unsigned int h = (unsigned int)key * 0x9e3779b9u;
+  return (h >> 16) | (h << 16);
+#elif defined(MIX64_HASH)
+  // Finalizer of SplitMix64, folded to the upper 32 bits
+  unsigned long long h = (unsigned int)key;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+  h ^= h >> 31;
+  return (unsigned int)(h >> 32);
+#else
+  return (unsigned int)key;
+#endif
+}
+
+/**
+ * Maps each key to an index from 0..size-1 within the hashtable, i.e. to its
+ * bucket group
+ *
+ * @param size the number of bucket groups of either the lock or transaction
+ * table
  * @param key TXID or RID to map into the hashtable
  */
 int hash(int size, int key);
 
+/**
+ * Retrieves the entry for the given key from a hashtable.
+ *
+ * @param hashTable either the lock or transaction table to execute the
+ * operation on
+ * @param key identifies the entry, i.e. TXID or RID
+ * @returns the entry or nullptr, when the corresponding key could not be
+ * found
+ */
+auto findEntry(HashTableBase* hashTable, int key) -> Entry*;
+
+/**
+ * Retrieves the entries for several keys at once. Instead of walking one
+ * bucket after another, it first computes the positions of all buckets and
+ * prefetches them, then advances all walks by one entry per round, so that
+ * the cache misses of the different keys overlap.
+ *
+ * @param hashTable either the lock or transaction table to execute the
+ * operation on
+ * @param keys the keys to look up, at most kLookupBatchSize
+ * @param n the number of keys
+ * @param entries receives the entry of each key, or nullptr when the key could
+ * not be found
+ */
+void findEntries(HashTableBase* hashTable, const int* keys, int n,
+                 Entry** entries);
+
+/**
+ * Adds an entry to the table, unless its key already exists in the table.
+ * Grows the bucket group of the key, when it exceeds kMaxLoadFactor.
+ *
+ * @param hashTable either the lock or transaction table to execute the
+ * operation on
+ * @param entry the entry to add, with its key already set
+ * @returns the entry with the key of the given entry that is in the table
+ * now, i.e. either the given entry or the one that already existed
+ */
+auto insertEntry(HashTableBase* hashTable, Entry* entry) -> Entry*;
+
+/**
+ * Removes the entry for the given key from the table without freeing it
+ *
+ * @param hashTable the table to execute the operation on
+ * @param key TXID or RID
+ * @returns the entry, or nullptr if the key does not exist
+ */
+auto extractEntry(HashTableBase* hashTable, int key) -> Entry*;
+
+/**
+ * Returns the node that starts with the given entry
+ */
+template <typename Value>
+auto nodeOf(Entry* entry) -> Node<Value>* {
+  return reinterpret_cast<Node<Value>*>(entry);
+}
+
+/**
+ * Allocates an empty table
+ *
+ * @param size the number of bucket groups
+ */
+template <typename Key, typename Value>
+auto newHashTable(int size) -> HashTable<Key, Value>* {
+  auto hashTable = new HashTable<Key, Value>();
+  initHashTable(hashTable, size);
+  return hashTable;
+}
+
+/**
+ * Frees a table together with all of its entries and their values
+ */
+template <typename Key, typename Value>
+void deleteHashTable(HashTable<Key, Value>* hashTable) {
+  destroyHashTable(hashTable,
+                   [](Entry* entry) { poolDelete(nodeOf<Value>(entry)); });
+  delete hashTable;
+}
+
 /**
  * Retrieves the value for the given key from a hashtable.
  *
  * @param hashTable either the lock or transaction table to execute the
  * operation on
- * @param key idedentifies the value, i.e. TXID or RID
- * @returns value for the given key. Needs to be casted to the appropriate
- * pointer type, i.e. Transaction or Lock. Or nullptr, when the corresponding
- * key could not be found.
+ * @param key identifies the value, i.e. TXID or RID
+ * @returns the value for the given key, which stays valid until the key is
+ * removed. Or nullptr, when the corresponding key could not be found.
  */
-auto get(HashTable* hashTable, int key) -> void*;
+template <typename Key, typename Value>
+auto get(HashTable<Key, Value>* hashTable,
+         typename HashTable<Key, Value>::KeyType key) -> Value* {
+  Entry* entry = findEntry(hashTable, key);
+  return entry == nullptr ? nullptr : &nodeOf<Value>(entry)->value;
+}
 
 /**
- * Retrieves the value for the given key from a bucket.
+ * Retrieves the values for several keys at once, see findEntries(). Faster
+ * than calling get() for each key, when the buckets are not in the cache.
  *
- * @param entry either the bucket of the lock or transaction table to execute
- * the operation on
- * @param key idedentifies the value, i.e. TXID or RID
- * @returns value for the given key. Needs to be casted to the appropriate
- * pointer type, i.e. Transaction or Lock. Or nullptr, when the corresponding
- * key could not be found.
+ * @param hashTable either the lock or transaction table to execute the
+ * operation on
+ * @param keys identify the values, i.e. TXIDs or RIDs
+ * @param n the number of keys
+ * @param values receives the value of each key, or nullptr when the key could
+ * not be found
  */
-auto get(Entry* entry, int key) -> void*;
+template <typename Key, typename Value>
+void getMany(HashTable<Key, Value>* hashTable,
+             const typename HashTable<Key, Value>::KeyType* keys, int n,
+             Value** values) {
+  Entry* entries[kLookupBatchSize];
+  for (int first = 0; first < n; first += kLookupBatchSize) {
+    int batch = n - first < kLookupBatchSize ? n - first : kLookupBatchSize;
+    findEntries(hashTable, keys + first, batch, entries);
+    for (int i = 0; i < batch; i++) {
+      values[first + i] =
+          entries[i] == nullptr ? nullptr : &nodeOf<Value>(entries[i])->value;
+    }
+  }
+}
 
 /**
- *  Sets the value for a given key. Doesn't do anything when the key already
- * exists in the table.
+ * Adds a value-initialized value for the given key. Doesn't do anything when
+ * the key already exists in the table. Grows the bucket group of the key,
+ * when it exceeds kMaxLoadFactor.
  *
  * @param hashTable either the lock or transaction table to execute the
  * operation on
  * @param key TXID or RID
- * @param value needs to be casted to void pointer from Transaction or Lock
- * pointer
+ * @returns the value for the given key, to be initialized by the caller if it
+ * was just added
  */
-void set(HashTable* hashTable, int key, void* value);
+template <typename Key, typename Value>
+auto insert(HashTable<Key, Value>* hashTable,
+            typename HashTable<Key, Value>::KeyType key) -> Value* {
+  auto node = poolNew<Node<Value>>();
+  node->entry.key = key;
+  Entry* entry = insertEntry(hashTable, &node->entry);
+  if (entry != &node->entry) {
+    poolDelete(node);  // key already exists
+  }
+  return &nodeOf<Value>(entry)->value;
+}
 
 /**
  * Checks if the transaction got already registered or a lock already exists
@@ -64,13 +263,62 @@ void set(HashTable* hashTable, int key, void* value);
  * @return true if the transaction or the lock respectively is in the
  * hashTable
  */
-auto contains(HashTable* hashTable, int key) -> bool;
+template <typename Key, typename Value>
+auto contains(HashTable<Key, Value>* hashTable,
+              typename HashTable<Key, Value>::KeyType key) -> bool {
+  return findEntry(hashTable, key) != nullptr;
+}
+
+/**
+ * Deletes the lock or transaction respectively for the given key. Pointers to
+ * the value become invalid.
+ *
+ * @param hashTable either the lock or transaction table to execute the
+ * operation on
+ * @param key TXID or RID
+ */
+template <typename Key, typename Value>
+void remove(HashTable<Key, Value>* hashTable,
+            typename HashTable<Key, Value>::KeyType key) {
+  Entry* entry = extractEntry(hashTable, key);
+  if (entry != nullptr) {
+    poolDelete(nodeOf<Value>(entry));
+  }
+}
 
 /**
- * Deletes the lock or transaction respectively for the given key
+ * Removes the lock or transaction respectively for the given key from the
+ * table, but keeps it alive until the caller frees its node with poolDelete()
  *
  * @param hashTable either the lock or transaction table to execute the
  * operation on
  * @param key TXID or RID
+ * @returns the node of the key, or nullptr if the key does not exist
+ */
+template <typename Key, typename Value>
+auto extract(HashTable<Key, Value>* hashTable,
+             typename HashTable<Key, Value>::KeyType key) -> Node<Value>* {
+  Entry* entry = extractEntry(hashTable, key);
+  return entry == nullptr ? nullptr : nodeOf<Value>(entry);
+}
+
+/**
+ * Counts the entries of every bucket of the table. Must not run while another
+ * thread modifies the table.
+ *
+ * @param hashTable either the lock or transaction table
+ * @returns the number of buckets and entries and how many buckets hold how
+ * many entries
+ */
+auto bucketStatistics(HashTableBase* hashTable) -> BucketStatistics;
+
+/**
+ * Adds a bucket with the given number of entries to the statistics
+ */
+void countBucket(BucketStatistics* statistics, unsigned long length);
+
+/**
+ * Returns the average number of entries of the non-empty buckets, i.e. the
+ * length of the chain that a lookup of an existing key walks on average
  */
-void remove(HashTable* hashTable, int key);
\ No newline at end of file
+auto meanBucketLength(BucketStatistics* statistics) -> double;
\ No newline at end of file
@@ -9,23 +9,96 @@ using std::memcpy;
 
 const int kTransactionBudget = 200;
 
+// Number of owners that are stored inline in a lock
+const int kInlineOwners = 4;
+
+// Bit of Lock::word that is set while the lock is held exclusively
+const unsigned int kExclusiveBit = 1u << 31;
+
+// Bit of Lock::word that is set while one of the owners holds the lock in U
+// mode
+const unsigned int kUpdateBit = 1u << 30;
+
+// Bits of Lock::word that count the owners of the lock
+const unsigned int kOwnerCountMask = kUpdateBit - 1;
+
 /**
- * The internal representation of a lock for the lock manager.
+ * The internal representation of a lock for the lock manager. It takes 32
+ * bytes, so a lock and its hash table entry share a cache line. The mode and
+ * the number of owners are packed into a single word, which is only changed
+ * with atomic operations. The first kInlineOwners owners are stored inline,
+ * the others of widely shared locks in an overflow array from the pool, whose
+ * first element holds its capacity. At most one of the shared owners holds the
+ * lock in U mode, which is recorded in the padding before the overflow array.
  */
 struct Lock {
-  bool exclusive;
-  int* owners;
-  int owners_size;
+  unsigned int word;          // kExclusiveBit | kUpdateBit | number of owners
+  int owners[kInlineOwners];  // the first owners
+  int updater;                // the owner holding U, if kUpdateBit is set
+  int* overflow;              // the other owners, or nullptr
 };
 typedef struct Lock Lock;
 
 /**
- * Initializes a lock struct
+ * Returns if the lock is held exclusively
+ */
+inline auto isHeldExclusively(Lock* lock) -> bool {
+  return (__atomic_load_n(&lock->word, __ATOMIC_ACQUIRE) & kExclusiveBit) != 0;
+}
+
+/**
+ * Returns if the transaction holds the lock in U mode
+ */
+inline auto isUpdater(Lock* lock, int transactionId) -> bool {
+  return (__atomic_load_n(&lock->word, __ATOMIC_ACQUIRE) & kUpdateBit) != 0 &&
+         lock->updater == transactionId;
+}
+
+/**
+ * Returns the number of transactions that hold the lock
+ */
+inline auto numOwners(Lock* lock) -> int {
+  return (int)(__atomic_load_n(&lock->word, __ATOMIC_ACQUIRE) &
+               kOwnerCountMask);
+}
+
+/**
+ * Returns the owner with the given index, from 0 to numOwners() - 1
+ */
+auto ownerAt(Lock* lock, int index) -> int;
+
+/**
+ * Checks if the transaction holds the lock
+ */
+auto isOwner(Lock* lock, int transactionId) -> bool;
+
+/**
+ * Initializes a lock struct, e.g. one that was just inserted into the lock
+ * table
+ */
+void initLock(Lock* lock);
+
+/**
+ * Allocates and initializes a lock struct that is not part of a lock table
  */
 Lock* newLock();
 
 /**
- * Attempts to acquire shared access for a transaction.
+ * Frees the overflow array of a lock, but not the lock struct itself, e.g.
+ * before the node of the lock is freed
+ */
+void destroyLock(Lock* lock);
+
+/**
+ * Frees a lock struct that was initialized with newLock()
+ */
+void deleteLock(Lock* lock);
+
+/**
+ * Attempts to acquire shared access for a transaction. Like all other
+ * operations on a lock, it has to be serialized by the caller, e.g. by the
+ * partitioning of the lock table. The owner is stored before the count of
+ * owners grows, so threads reading the count see all owners it covers.
  *
  * @param lock the lock the operation is executed on
  * @param transactionId ID of the transaction, that wants to acquire the lock
@@ -42,6 +115,18 @@ auto getSharedAccess(Lock* lock, int transactionId) -> bool;
  */
 auto getExclusiveAccess(Lock* lock, int transactionId) -> bool;
 
+/**
+ * Attempts to acquire update access for a transaction, which is compatible
+ * with the shared owners but with no other updater, or converts its shared
+ * access into update access. The updater converts to exclusive access with
+ * upgrade() once the other owners are gone.
+ *
+ * @param lock the lock the operation is executed on
+ * @param transactionId ID of the transaction, that wants to acquire the lock
+ * @returns false, if the lock is exclusive or has an updater already
+ */
+auto getUpdateAccess(Lock* lock, int transactionId) -> bool;
+
 /**
  * Releases the lock for the calling transaction.
  * @param lock the lock the operation is executed on
@@ -50,8 +135,8 @@ auto getExclusiveAccess(Lock* lock, int transactionId) -> bool;
 void release(Lock* lock, int transactionId);
 
 /**
- * Upgrades the lock for the transaction, that currently holds the shared lock
- * alone, to an exclusive lock.
+ * Upgrades the lock for the transaction, that currently holds the shared or
+ * update lock alone, to an exclusive lock.
  *
  * @param lock the lock the operation is executed on
  * @param transactionId ID of the transaction, that wants to acquire the lock
@@ -1,12 +1,16 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "base64-encoding.h"
 #include "common.h"
+#include "completion.h"
 #include "enclave_u.h"
 #include "errors.h"
 #include "files.h"
@@ -24,6 +28,23 @@
 extern sgx_enclave_id_t global_eid;  // identifies the enclave
 extern sgx_launch_token_t token;
 
+// Number of partitions of the lock table inside the enclave for each worker
+// thread. A worker owns several partitions, so that the balancer can move some
+// of them to other workers.
+const int kPartitionsPerWorker = 16;
+
+// Milliseconds between two rounds of the balancer thread
+const int kBalanceInterval = 10;
+
+/**
+ * A row lock requested as part of a batch, see LockManager::lockBatch()
+ */
+struct BatchedLock {
+  unsigned int transactionId;
+  unsigned int rowId;
+  bool isExclusive;
+};
+
 //=========================== OCALLS ============================
 /**
  * Logs an info message from inside the enclave to the terminal
@@ -71,8 +92,21 @@ class LockManager {
    * Initializes the enclave and seals the public and private key for signing.
    *
    * @param numWorkerThreads the number of threads that work on the lock table
+   * @param policy ABORT_ON_CONFLICT makes a request that conflicts with the
+   * owners of the lock fail and aborts its transaction. WAIT_ON_CONFLICT parks
+   * it in a wait queue of the lock instead, from which it is granted and signed
+   * in order of arrival once the lock is released. Only requests of
+   * transactions that are older than the owners and the requests waiting
+   * before them may wait, see mayWait(), the others still abort.
+   * @param escalationThreshold once a transaction holds more row locks within
+   * a table, they are replaced by a single S or X lock on the table, unless
+   * other transactions hold conflicting locks within it. This keeps the lock
+   * table and the enclave heap small, but costs a global mutex on each row
+   * request. 0 disables lock escalation.
    */
-  LockManager(int numWorkerThreads = 1);
+  LockManager(int numWorkerThreads = 1,
+              ConflictPolicy policy = ABORT_ON_CONFLICT,
+              int escalationThreshold = 0);
 
   /**
    * Destroys the enclave.
@@ -103,12 +137,49 @@ class LockManager {
    * @returns the signature for the acquired lock and true or
    * no signature and false, when transaction was not registered before or when
    * the transaction makes a request for a look that it already owns, makes a
-   * request for a lock while in the shrinking phase, or when the lock budget is
-   * exhausted
+   * request for a lock while in the shrinking phase, when the lock budget is
+   * exhausted or when the row ID is above kMaxGranuleId
    */
   auto lock(unsigned int transactionId, unsigned int rowId, bool isExclusive,
             bool waitForResult = true) -> std::pair<std::string, bool>;
 
+  /**
+   * Acquires a lock on a row, a page, a table or the database in one of the
+   * modes of multi-granularity locking, e.g. a single S lock on a table to
+   * scan all of its rows with one signature. Before locking a granule, the
+   * transaction must lock its parent granule in an intention mode or a mode
+   * that implies it, see allowsChild(). Rows can only be locked in S, U or X
+   * mode. A transaction that reads a row before writing it should lock it in U
+   * mode and convert the lock to X later, as two transactions converting S
+   * locks on the same row always conflict.
+   *
+   * @param transactionId identifies the transaction making the request
+   * @param granule the level of the granule
+   * @param id identifies the row, page or table, 0 for the database
+   * @param mode the requested mode
+   * @param waitForResult parameter forwarded to create_job function
+   * @returns the signature for the acquired lock and true or no signature and
+   * false, see the other lock(). The request also fails, when the parent
+   * granule is not locked in a suitable mode.
+   */
+  auto lock(unsigned int transactionId, Granule granule, unsigned int id,
+            LockMode mode, bool waitForResult = true)
+      -> std::pair<std::string, bool>;
+
+  /**
+   * Acquires the row locks of a batch with a single transition into the
+   * enclave, instead of one for each lock(). The enclave puts the requests
+   * into the job queues of their worker threads at once, so they are
+   * processed in parallel, and the function waits until all of them finished.
+   * The requests may belong to different transactions.
+   *
+   * @param requests the row locks to acquire
+   * @returns a pair of the signature and if the lock was acquired for each
+   * request in the order of the requests, see lock()
+   */
+  auto lockBatch(const std::vector<BatchedLock> &requests)
+      -> std::vector<std::pair<std::string, bool>>;
+
   /**
    * Releases a lock for the specified row
    *
@@ -120,6 +191,77 @@ class LockManager {
   void unlock(unsigned int transactionId, unsigned int rowId,
               bool waitForResult = false);
 
+  /**
+   * Releases a lock on a row, a page, a table or the database
+   *
+   * @param transactionId identifies the transaction making the request
+   * @param granule the level of the granule
+   * @param id identifies the row, page or table, 0 for the database
+   * @param waitForResult if true makes unlock a synchronous operation, else
+   * asynchronous (no waiting for operation to be finished)
+   */
+  void unlock(unsigned int transactionId, Granule granule, unsigned int id,
+              bool waitForResult = false);
+
+  /**
+   * Acquires a key-range lock on the rows firstRowId..lastRowId, which
+   * conflicts with the locks other transactions hold on rows of the range and
+   * with their overlapping ranges, so rows can neither be changed in nor
+   * appear in the range meanwhile. The enclave splits the request into one
+   * part for each partition that owns rows of the range and signs the range
+   * once all parts are granted. Conflicting requests never wait.
+   *
+   * @param transactionId identifies the transaction making the request
+   * @param firstRowId identifies the first row of the range
+   * @param lastRowId identifies the last row of the range
+   * @param isExclusive either shared for concurrent read access or exclusive
+   * for sole write access
+   * @param waitForResult parameter forwarded to create_job function
+   * @returns a pair with the signature of the range lock and if the lock was
+   * acquired, see lock()
+   */
+  auto lockRange(unsigned int transactionId, unsigned int firstRowId,
+                 unsigned int lastRowId, bool isExclusive,
+                 bool waitForResult = true) -> std::pair<std::string, bool>;
+
+  /**
+   * Releases a key-range lock acquired with lockRange()
+   *
+   * @param transactionId identifies the transaction making the request
+   * @param firstRowId identifies the first row of the range
+   * @param lastRowId identifies the last row of the range
+   * @param waitForResult if true makes unlock a synchronous operation, else
+   * asynchronous (no waiting for operation to be finished)
+   */
+  void unlockRange(unsigned int transactionId, unsigned int firstRowId,
+                   unsigned int lastRowId, bool waitForResult = false);
+
+  /**
+   * Commits a transaction by releasing all of its row, granule and range locks
+   * and removing it from the transaction table with a single enclave job,
+   * instead of one unlock() for each lock. The locked rows are split by the
+   * partitions that own them and released by their worker threads in
+   * parallel. Requests of the transaction that did not finish yet fail.
+   *
+   * @param transactionId identifies the transaction
+   * @param waitForResult if the function should wait for all locks to be
+   * released
+   * @returns false, if the transaction is not registered, e.g. because it was
+   * aborted after a conflict
+   */
+  auto commit(unsigned int transactionId, bool waitForResult = true) -> bool;
+
+  /**
+   * Aborts a transaction, which releases all of its locks and removes it from
+   * the transaction table like commit()
+   *
+   * @param transactionId identifies the transaction
+   * @param waitForResult if the function should wait for all locks to be
+   * released
+   * @returns false, if the transaction is not registered
+   */
+  auto abort(unsigned int transactionId, bool waitForResult = true) -> bool;
+
   /**
    * This function is just for testing, to demonstrate that signatures created
    * on lock requests are valid.
@@ -134,6 +276,31 @@ class LockManager {
   auto verify_signature_string(std::string signature, int transactionId,
                                int rowId, int isExclusive) -> bool;
 
+  /**
+   * Returns the hit and miss counters of the pools inside the enclave, that
+   * locks, transactions and hash table entries are allocated from
+   */
+  auto getPoolStatistics() -> PoolStatistics;
+
+  /**
+   * Returns how the locks are distributed over the buckets of the lock table
+   * inside the enclave. Must only be called while no requests are being
+   * processed.
+   */
+  auto getLockTableStatistics() -> BucketStatistics;
+
+  /**
+   * Returns how many row locks the enclave replaced by locks on their tables
+   */
+  auto getEscalationStatistics() -> EscalationStatistics;
+
+  /**
+   * Returns the worker thread that owns each partition of the lock table
+   * inside the enclave, and the jobs that are queued for it and that were
+   * served for it so far
+   */
+  auto getPartitionStatistics() -> std::vector<PartitionStatistics>;
+
  private:
   /**
    * Stores key pair for ECDSA signature inside the sealed key file. This is
@@ -168,33 +335,55 @@ class LockManager {
    */
   static auto create_worker_thread(void *tmp) -> void *;
 
+  /**
+   * Function that the balancer thread executes. Until the lock manager shuts
+   * down, it sends the current time to the enclave every kBalanceInterval
+   * milliseconds, which measures the load of the worker threads and moves
+   * partitions of the lock table from busy workers to idle ones.
+   *
+   * @param tmp the lock manager
+   */
+  static auto create_balancer_thread(void *tmp) -> void *;
+
   /**
    * Initializes the configuration parameters for the enclave
    *
    * @param numWorkerThreads the number of threads that work on the lock table
+   * @param policy what happens to conflicting lock requests
+   * @param escalationThreshold row locks within a table that trigger lock
+   * escalation
    */
-  void configuration_init(int numWorkerThreads);
+  void configuration_init(int numWorkerThreads, ConflictPolicy policy,
+                          int escalationThreshold);
 
   /**
    * Creates a job and sends it to the enclave to get it processed by an enclave
    * worker thread.
    *
-   * @param command SHARED, EXCLUSIVE, REGISTER or QUIT
-   * @param transaction_id additional argument for SHARED, EXCLUSIVE or REGISTER
-   * @param row_id additional argument for SHARED or EXCLUSIVE
+   * @param command SHARED, EXCLUSIVE, LOCK_GRANULE, LOCK_RANGE, UNLOCK,
+   * UNLOCK_RANGE, COMMIT, ABORT, REGISTER or QUIT
+   * @param transaction_id additional argument for all commands except QUIT
+   * @param row_id additional argument for SHARED, EXCLUSIVE, LOCK_GRANULE,
+   * UNLOCK or the first row for LOCK_RANGE and UNLOCK_RANGE
    * @param lock_budget additional argument for REGISTER
    * @param waitForResult if the function should wait for return values to be
    * set or immediately return
+   * @param granule additional argument for LOCK_GRANULE or UNLOCK
+   * @param mode additional argument for LOCK_GRANULE or LOCK_RANGE
+   * @param last_row_id additional argument for LOCK_RANGE or UNLOCK_RANGE
    * @returns a pair containing a boolean, that is true when the job was
    * executed successfully and if true and the command was for a lock request,
    * the pair also contains the signature as the return value
    */
   auto create_enclave_job(Command command, unsigned int transaction_id = 0,
                           unsigned int row_id = 0, unsigned int lock_budget = 0,
-                          bool waitForResult = true)
+                          bool waitForResult = true, Granule granule = ROW,
+                          LockMode mode = S_LOCK, unsigned int last_row_id = 0)
       -> std::pair<std::string, bool>;
 
   Arg arg;  // configuration parameters for the enclave
   pthread_t
       *threads;  // worker threads that execute requests inside the enclave
+  pthread_t balancer;  // moves partitions of the lock table between workers
+  std::atomic<bool> balancer_running;
 };
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <new>
+
+#include "common.h"
+
+/*
+Locks, transactions and hash table entries are small and allocated and freed at
+a high rate. Instead of going to the heap for each of them, they are taken from
+pools of fixed-size blocks. Each thread keeps a free list per size class, so
+most allocations neither take a lock nor touch memory of other threads. Only
+when a free list runs empty or grows too long, blocks are moved in batches
+between it and a shared free list per size class, which in turn carves new
+blocks from slabs allocated on the heap. Slabs are never returned, so freed
+blocks are always reused for objects of the same size class. When a thread
+exits, the blocks of its free lists are handed back to the shared ones.
+
+Built with POOL_BYPASS (-DWITH_POOL_BYPASS=ON, implied by -DWITH_ASAN=ON), every
+object is allocated on the heap directly, so that AddressSanitizer detects uses
+of freed objects and overflows into neighbouring blocks.
+
+The pools are compiled into each binary that uses them, so memory allocated
+inside the enclave comes from the enclave heap and memory allocated in the
+untrusted part from the untrusted heap.
+*/
+
+// Size of the smallest blocks, the size classes double from there on
+const size_t kPoolMinBlockSize = 16;
+
+// Number of size classes, larger objects are allocated on the heap directly
+const int kPoolSizeClasses = 6;
+
+// Number of blocks moved between a thread and the shared free list at once
+const int kPoolBatchSize = 64;
+
+// Size of the memory that is allocated from the heap to carve blocks from
+const size_t kPoolSlabSize = 64 * 1024;
+
+#ifdef POOL_BYPASS
+const bool kPoolBypass = true;
+#else
+const bool kPoolBypass = false;
+#endif
+
+/**
+ * Allocates a block of at least the given size from the pool
+ *
+ * @param size the size of the object in bytes
+ * @returns uninitialized memory for the object
+ */
+auto poolAllocate(size_t size) -> void*;
+
+/**
+ * Returns a block to the free list of the calling thread
+ *
+ * @param block memory allocated with poolAllocate(), or nullptr
+ * @param size the same size the block was allocated with
+ */
+void poolFree(void* block, size_t size);
+
+/**
+ * Returns the statistics of the pools of the calling binary. Each thread
+ * publishes its hits whenever it exchanges blocks with a shared free list, so
+ * the hits of the last few allocations of each thread may be missing.
+ */
+auto poolStatistics() -> PoolStatistics;
+
+/**
+ * Allocates and value-initializes an object from the pool
+ */
+template <typename T>
+auto poolNew() -> T* {
+  return new (poolAllocate(sizeof(T))) T();
+}
+
+/**
+ * Destroys an object allocated with poolNew() and returns its memory to the
+ * pool
+ */
+template <typename T>
+void poolDelete(T* object) {
+  if (object == nullptr) {
+    return;
+  }
+  object->~T();
+  poolFree(object, sizeof(T));
+}
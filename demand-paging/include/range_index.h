@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+
+#include "common.h"
+
+/**
+ * Key-range lock on the rows first..last, that one transaction holds in
+ * shared or exclusive mode
+ */
+struct RangeLock {
+  unsigned int last;   // last row of the range, which starts at its key
+  int transaction_id;  // the transaction holding the range
+  bool exclusive;      // if the range is held for sole write access
+};
+typedef struct RangeLock RangeLock;
+
+/**
+ * Interval index of the range locks of one partition of the rows. The ranges
+ * are sorted by their first row. As no range is longer than max_length, every
+ * range that overlaps first..last starts within first-max_length..last, so an
+ * overlap query only visits the ranges starting there.
+ */
+struct RangeIndex {
+  std::multimap<unsigned int, RangeLock> ranges;  // ranges by first row
+  unsigned int max_length;  // number of rows of the longest range minus 1
+};
+typedef struct RangeIndex RangeIndex;
+
+/**
+ * Shared state of the parts a range request is split into, one for each
+ * partition that owns rows of the range. The last part to finish completes
+ * the original request.
+ */
+struct RangeRequest {
+  Job job;                   // the original request
+  std::atomic<int> pending;  // number of parts that did not finish yet
+  std::atomic<bool> failed;  // if any part failed
+};
+typedef struct RangeRequest RangeRequest;
+
+/**
+ * Initializes an empty range index
+ */
+void initRangeIndex(RangeIndex* index);
+
+/**
+ * Checks if another transaction holds a range that overlaps first..last in a
+ * conflicting mode, i.e. if either of them is exclusive
+ *
+ * @param index the range index of the partition
+ * @param first first row of the requested range, or the requested row
+ * @param last last row of the requested range, or the requested row
+ * @param transactionId the requesting transaction, whose own ranges never
+ * conflict
+ * @param isExclusive if the request is for sole write access
+ */
+auto findConflictingRange(RangeIndex* index, unsigned int first,
+                          unsigned int last, int transactionId,
+                          bool isExclusive) -> bool;
+
+/**
+ * Adds a range lock to the index, without checking for conflicts
+ */
+void insertRange(RangeIndex* index, unsigned int first, unsigned int last,
+                 int transactionId, bool isExclusive);
+
+/**
+ * Removes a range lock of a transaction from the index
+ *
+ * @returns false, if the transaction does not hold the range
+ */
+auto removeRange(RangeIndex* index, unsigned int first, unsigned int last,
+                 int transactionId) -> bool;
+
+/**
+ * Removes all range locks of a transaction from the index, e.g. when it
+ * aborts
+ *
+ * @returns the number of removed ranges
+ */
+auto removeRanges(RangeIndex* index, int transactionId) -> int;
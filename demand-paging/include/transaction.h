@@ -1,15 +1,37 @@
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
+#include "granule.h"
 #include "hashtable.h"
 #include "lock.h"
+#include "row_index.h"
 
 using std::memcpy;
 
+/**
+ * Lock on a page, a table or the database held by a transaction
+ */
+struct HeldGranule {
+  int key;        // key of the granule, see granuleKey()
+  LockMode mode;  // the mode the transaction holds the lock in
+};
+typedef struct HeldGranule HeldGranule;
+
+/**
+ * Row locks a transaction holds within one table, counted for lock escalation
+ */
+struct HeldRows {
+  unsigned int table;  // identifies the table
+  RowCounts rows;      // number of shared and exclusive row locks
+};
+typedef struct HeldRows HeldRows;
+
 /**
  * The internal representation of a transaction for the lock manager.
  * It keeps track of the lock budget, i.e. the maximum number of locks
@@ -29,13 +51,44 @@ struct Transaction {
    */
   bool growing_phase;
   int lock_budget;
+  /**
+   * The locked rows are kept densely in no particular order, so that a
+   * released row is replaced by the last one, and are indexed by row ID.
+   * Looking up, adding and removing a row takes constant time on average.
+   */
   int* locked_rows;
-  int locked_rows_size;
+  int locked_rows_size;      // number of locked rows
+  int locked_rows_capacity;  // number of rows locked_rows has room for
+  RowIndex locked_rows_index;
+  HeldGranule* granule_locks;
+  int granule_locks_size;
+  int locked_ranges;  // number of range locks held, one for each partition
+  HeldRows* table_rows;
+  int table_rows_size;      // number of counted tables
+  int table_rows_capacity;  // number of tables table_rows has room for
+  // number of threads using the transaction, and whether it was removed from
+  // the transaction table meanwhile. Both are guarded by the mutex of its
+  // partition of the transaction table, see pin_transaction().
+  int pins;
+  bool detached;
 };
 typedef struct Transaction Transaction;
 
 /**
- * Initializes the transaction struct.
+ * Initializes the transaction struct, e.g. one that was just inserted into the
+ * transaction table.
+ *
+ * @param transaction the transaction struct to initialize
+ * @param transactionId identifying the transaction
+ * @param lockBudget maximum number of locks the transaction is allowed to
+ * acquire
+ */
+void initTransaction(Transaction* transaction, int transactionId,
+                     int lockBudget);
+
+/**
+ * Allocates and initializes a transaction struct that is not part of a
+ * transaction table.
  *
  * @param transactionId identifying the transaction
  * @param lockBudget maximum number of locks the transaction is allowed to
@@ -44,6 +97,19 @@ typedef struct Transaction Transaction;
  */
 Transaction* newTransaction(int transactionId, int lockBudget);
 
+/**
+ * Frees the sets of locked rows, granules and counted tables of a transaction,
+ * but not the transaction struct itself, e.g. before it is removed from the
+ * transaction table
+ */
+void destroyTransaction(Transaction* transaction);
+
+/**
+ * Frees a transaction struct that was initialized with newTransaction(),
+ * together with its set of locked rows
+ */
+void deleteTransaction(Transaction* transaction);
+
 /**
  * When the transaction acquires a new lock, the row ID that lock refers to is
  * added to the set of locked rows and it decrements the lock budget by 1.
@@ -58,6 +124,16 @@ Transaction* newTransaction(int transactionId, int lockBudget);
 auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock)
     -> bool;
 
+/**
+ * Like addLock(), but acquires the lock in U mode, which the transaction
+ * converts to exclusive once it writes the row
+ *
+ * @param Transaction transaction to execute the operation on
+ * @param rowId row ID of the newly acquired lock
+ * @param lock the lock of the row
+ */
+auto addUpdateLock(Transaction* transaction, int rowId, Lock* lock) -> bool;
+
 /**
  * Checks if the transaction currently holds a lock on the given row ID.
  * If so, it enters the shrinking phase and removes the row ID from the set of
@@ -67,7 +143,19 @@ auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock)
  * @param rowId row ID of the released lock
  * @param lock the lock to release
  */
-void releaseLock(Transaction* transaction, int rowId, HashTable* lockTable);
+void releaseLock(Transaction* transaction, int rowId, LockTable* lockTable);
+
+/**
+ * Releases the lock on a row that a lock of the transaction on its table
+ * covers now, see lock escalation. Unlike releaseLock(), the transaction stays
+ * in its growing phase and gets the lock back to its lock budget.
+ *
+ * @param Transaction transaction to execute the operation on
+ * @param rowId row ID of the released lock
+ * @param lockTable containing all the locks indexed by row ID
+ */
+void releaseCoveredLock(Transaction* transaction, int rowId,
+                        LockTable* lockTable);
 
 /**
  * Checks if the transaction has a lock on the specified row.
@@ -85,4 +173,77 @@ auto hasLock(Transaction* transaction, int rowId) -> bool;
  * @param Transaction transaction to execute the operation on
  * @param lockTable containing all the locks indexed by row ID
  */
-void releaseAllLocks(Transaction* transaction, HashTable* lockTable);
+void releaseAllLocks(Transaction* transaction, LockTable* lockTable);
+
+/**
+ * Acquires a lock on a page, a table or the database for the transaction, or
+ * converts the mode it holds the lock in already. A new lock is added to the
+ * set of locked granules and decrements the lock budget by 1.
+ *
+ * @param transaction transaction to execute the operation on
+ * @param key key of the granule, see granuleKey()
+ * @param mode the requested mode
+ * @param lock the lock of the granule
+ * @returns false, if other transactions hold the lock in a conflicting mode
+ */
+auto addGranuleLock(Transaction* transaction, int key, LockMode mode,
+                    GranuleLock* lock) -> bool;
+
+/**
+ * Looks up the mode the transaction holds a granule lock in
+ *
+ * @param transaction transaction to execute the operation on
+ * @param key key of the granule, see granuleKey()
+ * @param mode receives the mode
+ * @returns false, if the transaction does not hold the lock
+ */
+auto granuleMode(Transaction* transaction, int key, LockMode* mode) -> bool;
+
+/**
+ * Releases a granule lock of the transaction, which enters the shrinking
+ * phase. Removes the lock from the table once it has no holders anymore.
+ *
+ * @param transaction transaction to execute the operation on
+ * @param key key of the granule, see granuleKey()
+ * @param granuleTable containing the locks of pages, tables and the database
+ */
+void releaseGranuleLock(Transaction* transaction, int key,
+                        GranuleTable* granuleTable);
+
+/**
+ * Adds delta to the row locks the transaction holds within the table of a row
+ * in shared or exclusive mode
+ *
+ * @param transaction transaction to execute the operation on
+ * @param rowId identifies the row
+ * @param isExclusive if the row lock is exclusive
+ * @param delta 1 for an acquired and -1 for a released row lock
+ */
+void countRowLock(Transaction* transaction, int rowId, bool isExclusive,
+                  int delta);
+
+/**
+ * Returns the row locks the transaction holds within a table, as counted with
+ * countRowLock()
+ */
+auto rowLocksIn(Transaction* transaction, unsigned int table) -> RowCounts;
+
+/**
+ * Checks if the transaction holds any row, granule or range lock
+ */
+auto holdsLocks(Transaction* transaction) -> bool;
+
+/**
+ * Shared state of the parts a COMMIT or ABORT request is split into, one for
+ * each partition that owns rows the transaction holds locks on. The
+ * transaction is removed from the transaction table before the parts are
+ * sent, and the last part to finish releases its remaining locks, frees it
+ * and completes the original request.
+ */
+struct ReleaseRequest {
+  Job job;                             // the original request
+  Node<Transaction>* node;             // the removed transaction
+  std::vector<std::vector<int>> rows;  // locked rows of each partition
+  std::atomic<int> pending;  // number of parts that did not finish yet
+};
+typedef struct ReleaseRequest ReleaseRequest;
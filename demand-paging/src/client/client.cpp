@@ -92,10 +92,117 @@ auto LockingServiceClient::requestExclusiveLock(unsigned int transactionId,
   return "";
 }
 
+auto LockingServiceClient::requestGranuleLock(unsigned int transactionId,
+                                              GranuleLevel granule,
+                                              unsigned int id, GranuleMode mode,
+                                              bool waitForSignature)
+    -> std::string {
+  // Pages and tables may have the ID 0, as well as the database
+  if (transactionId == 0 || (granule == GRANULE_ROW && id == 0)) {
+    spdlog::error("Cannot acquire lock for TXID 0 or RID 0");
+    return "";
+  }
+
+  spdlog::info(
+      "Requesting granule lock (TXID: " + std::to_string(transactionId) +
+      ", GRANULE: " + GranuleLevel_Name(granule) +
+      ", ID: " + std::to_string(id) + ", MODE: " + GranuleMode_Name(mode) +
+      ")");
+  LockRequest request;
+  request.set_transaction_id(transactionId);
+  request.set_row_id(id);
+  request.set_granule(granule);
+  request.set_mode(mode);
+  request.set_wait_for_signature(waitForSignature);
+
+  LockResponse response;
+  ClientContext context;
+
+  Status status = stub_->LockGranule(&context, request, &response);
+
+  if (status.ok()) {
+    spdlog::info("Received signature: " + response.signature());
+    return response.signature();
+  }
+
+  spdlog::error("Acquiring granule lock failed (TXID: " +
+                std::to_string(transactionId) +
+                ", GRANULE: " + GranuleLevel_Name(granule) +
+                ", ID: " + std::to_string(id) + ")");
+  return "";
+}
+
+auto LockingServiceClient::requestRangeLock(unsigned int transactionId,
+                                            unsigned int firstRowId,
+                                            unsigned int lastRowId,
+                                            GranuleMode mode,
+                                            bool waitForSignature)
+    -> std::string {
+  if (transactionId == 0 || firstRowId == 0) {
+    spdlog::error("Cannot acquire lock for TXID 0 or RID 0");
+    return "";
+  }
+
+  spdlog::info(
+      "Requesting range lock (TXID: " + std::to_string(transactionId) +
+      ", RIDs: " + std::to_string(firstRowId) + ".." +
+      std::to_string(lastRowId) + ", MODE: " + GranuleMode_Name(mode) + ")");
+  LockRequest request;
+  request.set_transaction_id(transactionId);
+  request.set_row_id(firstRowId);
+  request.set_last_row_id(lastRowId);
+  request.set_mode(mode);
+  request.set_wait_for_signature(waitForSignature);
+
+  LockResponse response;
+  ClientContext context;
+
+  Status status = stub_->LockRange(&context, request, &response);
+
+  if (status.ok()) {
+    spdlog::info("Received signature: " + response.signature());
+    return response.signature();
+  }
+
+  spdlog::error("Acquiring range lock failed (TXID: " +
+                std::to_string(transactionId) +
+                ", RIDs: " + std::to_string(firstRowId) + ".." +
+                std::to_string(lastRowId) + ")");
+  return "";
+}
+
+auto LockingServiceClient::requestRangeUnlock(unsigned int transactionId,
+                                              unsigned int firstRowId,
+                                              unsigned int lastRowId,
+                                              bool waitForSignature) -> bool {
+  if (transactionId == 0 || firstRowId == 0) {
+    spdlog::error("Cannot unlock for TXID 0 or RID 0");
+    return false;
+  }
+
+  spdlog::info("Requesting to release a range lock (TXID: " +
+               std::to_string(transactionId) +
+               ", RIDs: " + std::to_string(firstRowId) + ".." +
+               std::to_string(lastRowId) + ")");
+  LockRequest request;
+  request.set_transaction_id(transactionId);
+  request.set_row_id(firstRowId);
+  request.set_last_row_id(lastRowId);
+  request.set_wait_for_signature(waitForSignature);
+
+  LockResponse response;
+  ClientContext context;
+
+  Status status = stub_->UnlockRange(&context, request, &response);
+
+  return status.ok();
+}
+
 auto LockingServiceClient::requestUnlock(unsigned int transactionId,
                                          unsigned int rowId,
-                                         bool waitForSignature) -> bool {
-  if (transactionId == 0 || rowId == 0) {
+                                         bool waitForSignature,
+                                         GranuleLevel granule) -> bool {
+  if (transactionId == 0 || (granule == GRANULE_ROW && rowId == 0)) {
     spdlog::error("Cannot unlock for TXID 0 or RID 0");
     return false;
   }
@@ -106,6 +213,7 @@ auto LockingServiceClient::requestUnlock(unsigned int transactionId,
   LockRequest request;
   request.set_transaction_id(transactionId);
   request.set_row_id(rowId);
+  request.set_granule(granule);
   request.set_wait_for_signature(waitForSignature);
 
   LockResponse response;
@@ -113,5 +221,43 @@ auto LockingServiceClient::requestUnlock(unsigned int transactionId,
 
   Status status = stub_->Unlock(&context, request, &response);
 
+  return status.ok();
+}
+
+auto LockingServiceClient::requestCommit(unsigned int transactionId) -> bool {
+  if (transactionId == 0) {
+    spdlog::error("Cannot commit for TXID 0");
+    return false;
+  }
+
+  spdlog::info("Requesting to commit (TXID: " + std::to_string(transactionId) +
+               ")");
+  TransactionRequest request;
+  request.set_transaction_id(transactionId);
+
+  TransactionResponse response;
+  ClientContext context;
+
+  Status status = stub_->Commit(&context, request, &response);
+
+  return status.ok();
+}
+
+auto LockingServiceClient::requestAbort(unsigned int transactionId) -> bool {
+  if (transactionId == 0) {
+    spdlog::error("Cannot abort for TXID 0");
+    return false;
+  }
+
+  spdlog::info("Requesting to abort (TXID: " + std::to_string(transactionId) +
+               ")");
+  TransactionRequest request;
+  request.set_transaction_id(transactionId);
+
+  TransactionResponse response;
+  ClientContext context;
+
+  Status status = stub_->Abort(&context, request, &response);
+
   return status.ok();
 }
\ No newline at end of file
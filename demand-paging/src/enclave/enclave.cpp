@@ -3,18 +3,100 @@
 Arg arg_enclave;  // configuration parameters for the enclave
 int num = 0;      // global variable used to give every thread a unique ID
 sgx_thread_mutex_t global_num_mutex;    // synchronizes access to num
-sgx_thread_mutex_t *queue_mutex;        // synchronizes access to the job queue
+sgx_thread_mutex_t *queue_mutex;        // lets a worker thread sleep on its
+                                        // job ring
 sgx_thread_mutex_t *transaction_mutex;  // synchronizes access to transactions
+sgx_thread_mutex_t *range_mutex;        // synchronizes access to the range
+                                        // index of each partition
+sgx_thread_mutex_t granule_mutex;       // serializes the granule table with
+                                        // lock escalation
 sgx_thread_cond_t *job_cond;            // wakes up worker threads when a
                                         // new job is available
-std::vector<std::queue<Job>> queue;     // a job queue for each worker thread
+JobRing *job_rings;                     // a job ring for each worker thread
 sgx_ecc_state_handle_t *contexts;       // context for signing for each thread
 
+// Synchronizes access to each partition of the transaction table
+sgx_thread_mutex_t *transaction_table_mutex;
+
+/**
+ * Tells the CPU that the thread is polling, which saves power and frees the
+ * pipeline for a sibling hyperthread
+ */
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+/**
+ * Marks a request as finished and wakes up the client waiting for it outside
+ * of the enclave, if it parked already
+ */
+static void finish_job(const Job &job) {
+  if (finishCompletion(job.finished)) {
+    wake_completion(job.finished);
+  }
+}
+
+/**
+ * Checks if a lock request asks for sole write access to its row
+ */
+static auto is_exclusive(const Job &job) -> bool {
+  return job.command == EXCLUSIVE ||
+         (job.command == LOCK_GRANULE && job.mode == X_LOCK);
+}
+
+/**
+ * Returns the mode a lock request asks for on its row
+ */
+static auto row_mode(const Job &job) -> LockMode {
+  if (job.command == LOCK_GRANULE) {
+    return job.mode;
+  }
+  return job.command == EXCLUSIVE ? X_LOCK : S_LOCK;
+}
+
+// Letters of the lock modes in the signed lock tuples, indexed by LockMode
+static const char *mode_names[] = {"IS", "IX", "S", "SIX", "X", "U"};
+
+/**
+ * Returns the key that decides which worker thread serves a job. Rows keep
+ * their ID, so they are served the same way by SHARED and LOCK_GRANULE jobs.
+ */
+static auto job_key(const Job &job) -> unsigned int {
+  return job.granule == ROW ? job.row_id
+                            : (unsigned int)granuleKey(job.granule, job.row_id);
+}
+
+/**
+ * Checks if the IDs of a request fit into the keys of the lock tables, see
+ * granuleKey()
+ */
+static auto has_valid_ids(const Job &job) -> bool {
+  bool isRange = job.command == LOCK_RANGE || job.command == UNLOCK_RANGE;
+  return job.row_id <= kMaxGranuleId &&
+         (!isRange || job.last_row_id <= kMaxGranuleId);
+}
+
+/**
+ * Signs a string with the signing context of the calling thread
+ */
+static void sign_string(void *signature, const std::string &string_to_sign,
+                        int threadId) {
+  sgx_ecdsa_sign((uint8_t *)string_to_sign.c_str(),
+                 strnlen(string_to_sign.c_str(), MAX_SIGNATURE_LENGTH),
+                 &ec256_private_key, (sgx_ec256_signature_t *)signature,
+                 contexts[threadId]);
+}
+
 void enclave_init_values(Arg arg) {
   // Get configuration parameters
   arg_enclave = arg;
-  transactionTable_ = newHashTable(arg.transaction_table_size);
-  lockTable_ = newHashTable(arg.lock_table_size);
+  transactionTable_ =
+      newHashTable<int, Transaction>(arg.transaction_table_size);
+  lockTable_ = newHashTable<int, Lock>(arg.lock_table_size);
+  granuleTable_ = newHashTable<int, GranuleLock>(arg.lock_table_size);
+  waitTable_ = newHashTable<int, WaitQueue>(arg.lock_table_size);
 
   // Initialize mutex variables
   sgx_thread_mutex_init(&global_num_mutex, NULL);
@@ -30,12 +112,54 @@ void enclave_init_values(Arg arg) {
                           NULL);  // assumes the transaction IDs to be in the
                                   // range 1 - kTransactionBudget
   }
+  transaction_table_mutex = (sgx_thread_mutex_t *)malloc(
+      sizeof(sgx_thread_mutex_t) * arg_enclave.num_threads);
+  for (int i = 0; i < arg_enclave.num_threads; i++) {
+    sgx_thread_mutex_init(&transaction_table_mutex[i], NULL);
+  }
+
+  // Initialize the range indexes of the partitions
+  rangeIndex_ = new RangeIndex[arg_enclave.num_partitions];
+  range_mutex = (sgx_thread_mutex_t *)malloc(sizeof(sgx_thread_mutex_t) *
+                                             arg_enclave.num_partitions);
+  for (int i = 0; i < arg_enclave.num_partitions; i++) {
+    initRangeIndex(&rangeIndex_[i]);
+    sgx_thread_mutex_init(&range_mutex[i], NULL);
+  }
+  numRanges_ = 0;
+
+  // Each worker thread starts with adjacent partitions, so it serves the same
+  // rows as with a fixed partition per worker
+  partitionOwner_ = new std::atomic<int>[arg_enclave.num_partitions];
+  partitionSenders_ = new std::atomic<int>[arg_enclave.num_partitions]();
+  partitionJobs_ = new std::atomic<int>[arg_enclave.num_partitions]();
+  partitionServed_ =
+      new std::atomic<unsigned long>[arg_enclave.num_partitions]();
+  partitionMigrations_ =
+      new std::atomic<unsigned long>[arg_enclave.num_partitions]();
+  adopting_ = new std::atomic<bool>[arg_enclave.num_partitions]();
+  lastServed_ = new unsigned long[arg_enclave.num_partitions]();
+  for (int i = 0; i < arg_enclave.num_partitions; i++) {
+    partitionOwner_[i] =
+        (int)((long)i * arg_enclave.num_threads / arg_enclave.num_partitions);
+  }
+  migrating_ = false;
+  lastBalance_ = 0;
+  serviceTime_ = new unsigned long[arg_enclave.num_threads]();
+  handoffs_ = new std::vector<Handoff>[arg_enclave.num_threads];
+  adoptedJobs_ = new std::vector<Job>[arg_enclave.num_threads];
 
-  // Initialize job queues and signing context
+  sgx_thread_mutex_init(&granule_mutex, NULL);
+  escalations_ = 0;
+  escalatedRows_ = 0;
+  failedEscalations_ = 0;
+
+  // Initialize job rings and signing context
   contexts = (sgx_ecc_state_handle_t *)malloc(arg_enclave.num_threads *
                                               sizeof(sgx_ecc_state_handle_t));
+  job_rings = new JobRing[arg_enclave.num_threads];
   for (int i = 0; i < arg_enclave.num_threads; i++) {
-    queue.push_back(std::queue<Job>());
+    initJobRing(&job_rings[i]);
     sgx_ecc256_open_context(&contexts[i]);
   }
 }
@@ -47,23 +171,32 @@ void enclave_send_job(void *data) {
 
   switch (command) {
     case QUIT:
+      // A migrating partition is handed over first, as the former owner
+      // pushes into the ring of the new one until then
+      while (migrating_) {
+        cpuRelax();
+      }
+
       // Send exit message to all of the worker threads
       for (int i = 0; i < arg_enclave.num_threads; i++) {
         print_debug("Sending QUIT to all threads");
 
-        sgx_thread_mutex_lock(&queue_mutex[i]);
-        queue[i].push(new_job);
-        sgx_thread_cond_signal(&job_cond[i]);
-        sgx_thread_mutex_unlock(&queue_mutex[i]);
+        enqueue_job(i, new_job);
       }
       break;
 
     case SHARED:
     case EXCLUSIVE:
+    case LOCK_GRANULE:
+    case LOCK_RANGE:
+    case UNLOCK_RANGE:
     case UNLOCK: {
       // Copy job parameters
       new_job.transaction_id = ((Job *)data)->transaction_id;
       new_job.row_id = ((Job *)data)->row_id;
+      new_job.granule = ((Job *)data)->granule;
+      new_job.mode = ((Job *)data)->mode;
+      new_job.last_row_id = ((Job *)data)->last_row_id;
       new_job.wait_for_result = ((Job *)data)->wait_for_result;
 
       if (new_job.wait_for_result) {
@@ -72,24 +205,46 @@ void enclave_send_job(void *data) {
         new_job.error = ((Job *)data)->error;
       }
 
+      if (!has_valid_ids(new_job)) {
+        print_error("Row, page or table ID exceeds kMaxGranuleId");
+        if (new_job.wait_for_result) {
+          *new_job.error = true;
+          finish_job(new_job);
+        }
+        return;
+      }
+
       // If transaction is not registered, abort the request
-      if (get(transactionTable_, new_job.transaction_id) == nullptr) {
+      if (!is_registered(new_job.transaction_id)) {
         print_error("Need to register transaction before lock requests");
         if (new_job.wait_for_result) {
           *new_job.error = true;
-          *new_job.finished = true;
+          finish_job(new_job);
         }
         return;
       }
 
-      // Send the requests to specific worker thread
-      int thread_id =
-          (int)((new_job.row_id % lockTable_->size) /
-                ((float)lockTable_->size / (arg_enclave.num_threads - 1)));
-      sgx_thread_mutex_lock(&queue_mutex[thread_id]);
-      queue[thread_id].push(new_job);
-      sgx_thread_cond_signal(&job_cond[thread_id]);
-      sgx_thread_mutex_unlock(&queue_mutex[thread_id]);
+      if (command == LOCK_RANGE || command == UNLOCK_RANGE) {
+        send_range_parts(new_job);
+        break;
+      }
+
+      // Send the requests to the worker thread that owns the partition of
+      // the row or granule
+      send_to_partition(partition_of(job_key(new_job)), new_job);
+      break;
+    }
+    case COMMIT:
+    case ABORT: {
+      // Copy job parameters
+      new_job.transaction_id = ((Job *)data)->transaction_id;
+      new_job.wait_for_result = ((Job *)data)->wait_for_result;
+
+      if (new_job.wait_for_result) {
+        new_job.finished = ((Job *)data)->finished;
+        new_job.error = ((Job *)data)->error;
+      }
+      send_release_parts(new_job);
       break;
     }
     case REGISTER: {
@@ -99,19 +254,119 @@ void enclave_send_job(void *data) {
       new_job.finished = ((Job *)data)->finished;
       new_job.error = ((Job *)data)->error;
 
-      // Send the requests to thread responsible for registering transactions
-      sgx_thread_mutex_lock(&queue_mutex[arg_enclave.tx_thread_id]);
-      queue[arg_enclave.tx_thread_id].push(new_job);
-      sgx_thread_cond_signal(&job_cond[arg_enclave.tx_thread_id]);
-      sgx_thread_mutex_unlock(&queue_mutex[arg_enclave.tx_thread_id]);
+      // Send the requests to the worker thread that owns the partition of the
+      // transaction table
+      int thread_id = transaction_partition_of(new_job.transaction_id);
+      enqueue_job(thread_id, new_job);
       break;
     }
+    case BALANCE:
+      balance_partitions(((Job *)data)->time);
+      break;
     default:
       print_error("Received unknown command");
       break;
   }
 }
 
+void enclave_send_jobs(void *data, size_t num_jobs) {
+  Job *jobs = (Job *)data;
+  for (size_t i = 0; i < num_jobs; i++) {
+    enclave_send_job(&jobs[i]);
+  }
+}
+
+void send_range_parts(Job &job) {
+  if (job.row_id > job.last_row_id) {
+    print_error("Range ends before it starts");
+    if (job.wait_for_result) {
+      *job.error = true;
+      finish_job(job);
+    }
+    return;
+  }
+
+  // Find the partitions that own rows of the range. Once the range is longer
+  // than the lock table, it covers all of them.
+  const int numPartitions = arg_enclave.num_partitions;
+  std::vector<bool> ownsRows(numPartitions, false);
+  int numParts = 0;
+  for (unsigned long rowId = job.row_id;
+       rowId <= job.last_row_id && numParts < numPartitions; rowId++) {
+    int partition = partition_of(rowId);
+    if (!ownsRows[partition]) {
+      ownsRows[partition] = true;
+      numParts++;
+    }
+  }
+
+  // All parts must be counted before the first one may finish
+  RangeRequest *range = new RangeRequest();
+  range->job = job;
+  range->pending = numParts;
+  range->failed = false;
+  for (int partition = 0; partition < numPartitions; partition++) {
+    if (!ownsRows[partition]) {
+      continue;
+    }
+    Job part = job;
+    part.partition = partition;
+    part.range = range;
+
+    send_to_partition(partition, part);
+  }
+}
+
+void send_release_parts(Job &job) {
+  // Later requests of the transaction do not find it anymore
+  Node<Transaction> *node = extract_transaction(job.transaction_id);
+  if (node == nullptr) {
+    print_error("Transaction was not registered");
+    if (job.wait_for_result) {
+      *job.error = true;
+      finish_job(job);
+    }
+    return;
+  }
+  Transaction *transaction = &node->value;
+
+  ReleaseRequest *request = new ReleaseRequest();
+  request->job = job;
+  request->node = node;
+  request->rows.resize(arg_enclave.num_partitions);
+  sgx_thread_mutex_lock(&transaction_mutex[transaction->transaction_id]);
+  if (job.command == ABORT) {
+    transaction->aborted = true;
+  }
+  transaction->growing_phase = false;
+  for (int i = 0; i < transaction->locked_rows_size; i++) {
+    int lockedRow = transaction->locked_rows[i];
+    request->rows[partition_of(lockedRow)].push_back(lockedRow);
+  }
+  sgx_thread_mutex_unlock(&transaction_mutex[transaction->transaction_id]);
+
+  std::vector<int> partitions;
+  for (int partition = 0; partition < arg_enclave.num_partitions;
+       partition++) {
+    if (!request->rows[partition].empty()) {
+      partitions.push_back(partition);
+    }
+  }
+  if (partitions.empty()) {
+    partitions.push_back(transaction_partition_of(job.transaction_id));
+  }
+
+  // All parts must be counted before the first one may finish
+  request->pending = partitions.size();
+  for (auto partition : partitions) {
+    Job part = job;
+    part.partition = partition;
+    part.release = request;
+
+    send_to_partition(partition, part);
+  }
+}
+
 void enclave_process_request() {
   sgx_thread_mutex_lock(&global_num_mutex);
   int thread_id = num;
@@ -121,109 +376,387 @@ void enclave_process_request() {
   sgx_thread_mutex_init(&queue_mutex[thread_id], NULL);
   sgx_thread_cond_init(&job_cond[thread_id], NULL);
 
-  sgx_thread_mutex_lock(&queue_mutex[thread_id]);
+  Job jobs[kJobBatchSize];
 
   while (1) {
     print_debug("Worker waiting for jobs");
-    if (queue[thread_id].size() == 0) {
-      sgx_thread_cond_wait(&job_cond[thread_id], &queue_mutex[thread_id]);
-      continue;
-    }
-
-    print_debug("Worker got a job");
-    Job cur_job = queue[thread_id].front();
-    Command command = cur_job.command;
-
-    sgx_thread_mutex_unlock(&queue_mutex[thread_id]);
+    int numJobs = dequeue_jobs(thread_id, jobs);
 
-    switch (command) {
-      case QUIT:
-        sgx_thread_mutex_lock(&queue_mutex[thread_id]);
-        queue[thread_id].pop();
-        sgx_thread_mutex_unlock(&queue_mutex[thread_id]);
+    print_debug("Worker got jobs");
+    prefetch_locks(jobs, numJobs);
+    for (int i = 0; i < numJobs; i++) {
+      if (jobs[i].command == QUIT) {
         sgx_thread_mutex_destroy(&queue_mutex[thread_id]);
         sgx_thread_cond_destroy(&job_cond[thread_id]);
         sgx_ecc256_close_context(contexts[thread_id]);
+        destroyJobRing(&job_rings[thread_id]);
         print_debug("Enclave worker quitting");
         return;
-      case SHARED:
-      case EXCLUSIVE: {
-        if (command == EXCLUSIVE) {
-          auto log =
-              ("(EXCLUSIVE) TXID: " + std::to_string(cur_job.transaction_id) +
-               ", RID: " + std::to_string(cur_job.row_id))
-                  .c_str();
-          print_debug(log);
-        } else {
-          auto log =
-              ("(SHARED) TXID: " + std::to_string(cur_job.transaction_id) +
-               ", RID: " + std::to_string(cur_job.row_id))
-                  .c_str();
-          print_debug(log);
-        }
-
-        // Acquire lock and receive signature
-        sgx_ec256_signature_t sig;
-        bool ok = acquire_lock((void *)&sig, cur_job.transaction_id,
-                               cur_job.row_id, command == EXCLUSIVE, thread_id);
-        if (cur_job.wait_for_result) {
-          if (!ok) {
-            *cur_job.error = true;
-          } else {
-            // Write base64 encoded signature into the return value of the job
-            // struct
-            std::string encoded_signature =
-                base64_encode((unsigned char *)sig.x, sizeof(sig.x)) + "-" +
-                base64_encode((unsigned char *)sig.y, sizeof(sig.y));
-
-            volatile char *p = cur_job.return_value;
-            size_t signature_size = 89;
-            for (int i = 0; i < signature_size; i++) {
-              *p++ = encoded_signature.c_str()[i];
-            }
-          }
-          *cur_job.finished = true;
-        }
-        break;
       }
-      case UNLOCK: {
-        auto log = ("(UNLOCK) TXID: " + std::to_string(cur_job.transaction_id) +
-                    ", RID: " + std::to_string(cur_job.row_id))
-                       .c_str();
-        print_debug(log);
-        release_lock(cur_job.transaction_id, cur_job.row_id);
-        if (cur_job.wait_for_result) {
-          *cur_job.finished = true;
-        }
-        break;
+      if (jobs[i].command == MIGRATE) {
+        hand_off_partition(thread_id, jobs[i]);
+        continue;
+      }
+      if (jobs[i].command == ADOPT) {
+        adopt_partition(thread_id, jobs[i]);
+        continue;
+      }
+      if (is_adopting(thread_id, jobs[i])) {
+        // The former owner still serves the jobs it got before the handoff
+        adoptedJobs_[thread_id].push_back(jobs[i]);
+        continue;
+      }
+      process_job(jobs[i], thread_id);
+      if (jobs[i].command != REGISTER) {
+        partitionJobs_[jobs[i].partition]--;
+        partitionServed_[jobs[i].partition]++;
       }
-      case REGISTER: {
-        auto transactionId = cur_job.transaction_id;
-        auto lockBudget = cur_job.lock_budget;
+    }
+    finish_handoffs(thread_id);
+  }
 
-        auto log = ("Registering transaction " + std::to_string(transactionId))
-                       .c_str();
+  return;
+}
+
+void enqueue_job(int thread_id, const Job &job) {
+  if (pushJob(&job_rings[thread_id], job)) {
+    sgx_thread_mutex_lock(&queue_mutex[thread_id]);
+    sgx_thread_cond_signal(&job_cond[thread_id]);
+    sgx_thread_mutex_unlock(&queue_mutex[thread_id]);
+  }
+}
+
+auto dequeue_jobs(int thread_id, Job *jobs) -> int {
+  JobRing *ring = &job_rings[thread_id];
+  int numJobs;
+  while ((numJobs = popJobs(ring, jobs, kJobBatchSize)) == 0) {
+    if (spinForJobs(ring)) {
+      continue;
+    }
+    // Jobs sent to the worker just before it handed over a partition may not
+    // be published yet
+    if (!handoffs_[thread_id].empty()) {
+      return 0;
+    }
+    sgx_thread_mutex_lock(&queue_mutex[thread_id]);
+    if (announceSleep(ring)) {
+      sgx_thread_cond_wait(&job_cond[thread_id], &queue_mutex[thread_id]);
+    }
+    cancelSleep(ring);
+    sgx_thread_mutex_unlock(&queue_mutex[thread_id]);
+  }
+  return numJobs;
+}
+
+void send_to_partition(int partition, Job &job) {
+  job.partition = partition;
+  partitionJobs_[partition]++;
+
+  // The owner may hand the partition over meanwhile. It only considers the
+  // partition drained once no thread is sending a job to it anymore, see
+  // finish_handoffs().
+  partitionSenders_[partition]++;
+  enqueue_job(partitionOwner_[partition], job);
+  partitionSenders_[partition]--;
+}
+
+void balance_partitions(unsigned long time) {
+  const int numWorkers = arg_enclave.num_threads;
+  const int numPartitions = arg_enclave.num_partitions;
+  std::vector<unsigned long> queued(numWorkers, 0);
+  std::vector<unsigned long> served(numWorkers, 0);
+  std::vector<int> owned(numWorkers, 0);
+  std::vector<unsigned long> load(numPartitions, 0);
+  for (int partition = 0; partition < numPartitions; partition++) {
+    int owner = partitionOwner_[partition];
+    unsigned long jobs = std::max(partitionJobs_[partition].load(), 0);
+    unsigned long total = partitionServed_[partition];
+    load[partition] = jobs + total - lastServed_[partition];
+    lastServed_[partition] = total;
+    queued[owner] += jobs;
+    served[owner] += load[partition] - jobs;
+    owned[owner]++;
+  }
+  unsigned long elapsed = time > lastBalance_ ? time - lastBalance_ : 0;
+  bool isFirstRound = lastBalance_ == 0;
+  lastBalance_ = time;
+  if (isFirstRound || elapsed == 0 || numWorkers == 1) {
+    return;
+  }
+
+  // A worker that still has queued jobs was busy all the time, so the jobs
+  // it served tell how long it takes for one
+  for (int worker = 0; worker < numWorkers; worker++) {
+    if (served[worker] == 0 || queued[worker] == 0) {
+      continue;
+    }
+    unsigned long serviceTime = elapsed * 1000000 / served[worker];
+    serviceTime_[worker] = serviceTime_[worker] == 0
+                               ? serviceTime
+                               : (serviceTime_[worker] + serviceTime) / 2;
+  }
+
+  int busiest = -1;
+  int idlest = -1;
+  std::vector<unsigned long> backlog(numWorkers);
+  for (int worker = 0; worker < numWorkers; worker++) {
+    backlog[worker] = queued[worker] * std::max(serviceTime_[worker], 1UL);
+    if (owned[worker] > 1 && queued[worker] >= kBalanceThreshold &&
+        (busiest == -1 || backlog[worker] > backlog[busiest])) {
+      busiest = worker;
+    }
+    if (idlest == -1 || backlog[worker] < backlog[idlest]) {
+      idlest = worker;
+    }
+  }
+  if (busiest == -1 || busiest == idlest ||
+      backlog[busiest] <= 2 * backlog[idlest]) {
+    return;
+  }
+
+  // Moving a partition with more than half of the load of the worker would
+  // only move the bottleneck
+  unsigned long workerLoad = queued[busiest] + served[busiest];
+  int partition = -1;
+  for (int i = 0; i < numPartitions; i++) {
+    if (partitionOwner_[i] == busiest && !adopting_[i] && load[i] > 0 &&
+        2 * load[i] <= workerLoad &&
+        (partition == -1 || load[i] > load[partition])) {
+      partition = i;
+    }
+  }
+  bool expected = false;
+  if (partition == -1 || !migrating_.compare_exchange_strong(expected, true)) {
+    return;
+  }
+
+  print_debug(("Migrating partition " + std::to_string(partition) +
+               " from worker " + std::to_string(busiest) + " to worker " +
+               std::to_string(idlest))
+                  .c_str());
+  Job job;
+  job.command = MIGRATE;
+  job.partition = partition;
+  job.worker = idlest;
+  enqueue_job(busiest, job);
+}
+
+void hand_off_partition(int threadId, Job &job) {
+  int partition = job.partition;
+  if (partitionOwner_[partition] != threadId || adopting_[partition]) {
+    migrating_ = false;
+    return;
+  }
+
+  // The new owner keeps the jobs it gets for the partition from now on until
+  // this worker served the ones it got before
+  adopting_[partition] = true;
+  partitionOwner_[partition] = job.worker;
+  partitionMigrations_[partition]++;
+  handoffs_[threadId].push_back({partition, job.worker, false, 0});
+}
+
+void finish_handoffs(int threadId) {
+  JobRing *ring = &job_rings[threadId];
+  std::vector<Handoff> &pending = handoffs_[threadId];
+  for (auto handoff = pending.begin(); handoff != pending.end();) {
+    // Threads that start sending a job to the partition from now on see the
+    // new owner, so the jobs of the partition in the ring end before its tail
+    if (!handoff->isDrained && partitionSenders_[handoff->partition] == 0) {
+      handoff->isDrained = true;
+      handoff->lastJob = ring->tail.load();
+    }
+    if (!handoff->isDrained || ring->head < handoff->lastJob) {
+      handoff++;
+      continue;
+    }
+
+    Job adopt;
+    adopt.command = ADOPT;
+    adopt.partition = handoff->partition;
+    enqueue_job(handoff->worker, adopt);
+    handoff = pending.erase(handoff);
+  }
+}
+
+void adopt_partition(int threadId, Job &job) {
+  // A single partition migrates at a time, so all kept jobs belong to it
+  adopting_[job.partition] = false;
+  for (auto &adopted : adoptedJobs_[threadId]) {
+    process_job(adopted, threadId);
+    partitionJobs_[adopted.partition]--;
+    partitionServed_[adopted.partition]++;
+  }
+  adoptedJobs_[threadId].clear();
+  migrating_ = false;
+}
+
+auto is_adopting(int threadId, const Job &job) -> bool {
+  // The former owner still sees the flag while it serves the last jobs of the
+  // partition, but does not own it anymore
+  return job.command != REGISTER && adopting_[job.partition] &&
+         partitionOwner_[job.partition] == threadId;
+}
+
+void prefetch_locks(Job *jobs, int numJobs) {
+  // The former owner of a migrating partition may still change its buckets
+  int rowIds[kJobBatchSize];
+  int numRows = 0;
+  for (int i = 0; i < numJobs; i++) {
+    if ((jobs[i].command == SHARED || jobs[i].command == EXCLUSIVE ||
+         jobs[i].command == LOCK_GRANULE || jobs[i].command == UNLOCK) &&
+        jobs[i].granule == ROW && !adopting_[jobs[i].partition]) {
+      rowIds[numRows++] = jobs[i].row_id;
+    }
+  }
+  if (numRows > 1) {
+    Lock *locks[kJobBatchSize];
+    getMany(lockTable_, rowIds, numRows, locks);
+  }
+}
+
+void process_job(Job &cur_job, int threadId) {
+  Command command = cur_job.command;
+  switch (command) {
+    case SHARED:
+    case EXCLUSIVE: {
+      if (command == EXCLUSIVE) {
+        auto log =
+            ("(EXCLUSIVE) TXID: " + std::to_string(cur_job.transaction_id) +
+             ", RID: " + std::to_string(cur_job.row_id))
+                .c_str();
         print_debug(log);
+      } else {
+        auto log =
+            ("(SHARED) TXID: " + std::to_string(cur_job.transaction_id) +
+             ", RID: " + std::to_string(cur_job.row_id))
+                .c_str();
+        print_debug(log);
+      }
 
-        if (contains(transactionTable_, transactionId)) {
-          print_error("Transaction is already registered");
-          *cur_job.error = true;
-        } else {
-          set(transactionTable_, transactionId,
-              (void *)newTransaction(transactionId, lockBudget));
-        }
-        *cur_job.finished = true;
-        break;
+      // Acquire lock and receive signature. A waiting request is completed
+      // once it is granted.
+      sgx_ec256_signature_t sig;
+      LockResult result = acquire_lock((void *)&sig, cur_job, threadId);
+      if (result != WAITING) {
+        complete_job(cur_job, result == GRANTED ? &sig : nullptr);
       }
-      default:
-        print_error("Worker received unknown command");
+      break;
     }
+    case LOCK_GRANULE: {
+      auto log = ("(LOCK_GRANULE) TXID: " +
+                  std::to_string(cur_job.transaction_id) +
+                  ", GRANULE: " + std::to_string(cur_job.granule) +
+                  ", ID: " + std::to_string(cur_job.row_id) +
+                  ", MODE: " + std::to_string(cur_job.mode))
+                     .c_str();
+      print_debug(log);
 
-    sgx_thread_mutex_lock(&queue_mutex[thread_id]);
-    queue[thread_id].pop();
+      // Rows are locked and signed the same way as with SHARED and EXCLUSIVE
+      sgx_ec256_signature_t sig;
+      LockResult result =
+          cur_job.granule == ROW
+              ? acquire_lock((void *)&sig, cur_job, threadId)
+              : acquire_granule_lock((void *)&sig, cur_job, threadId);
+      if (result != WAITING) {
+        complete_job(cur_job, result == GRANTED ? &sig : nullptr);
+      }
+      break;
+    }
+    case LOCK_RANGE: {
+      auto log = ("(LOCK_RANGE) TXID: " +
+                  std::to_string(cur_job.transaction_id) +
+                  ", RIDs: " + std::to_string(cur_job.row_id) + ".." +
+                  std::to_string(cur_job.last_row_id) +
+                  ", PARTITION: " + std::to_string(cur_job.partition))
+                     .c_str();
+      print_debug(log);
+      finish_range_part(cur_job,
+                        acquire_range_part(cur_job, threadId) == GRANTED,
+                        threadId);
+      break;
+    }
+    case UNLOCK_RANGE: {
+      auto log = ("(UNLOCK_RANGE) TXID: " +
+                  std::to_string(cur_job.transaction_id) +
+                  ", RIDs: " + std::to_string(cur_job.row_id) + ".." +
+                  std::to_string(cur_job.last_row_id) +
+                  ", PARTITION: " + std::to_string(cur_job.partition))
+                     .c_str();
+      print_debug(log);
+      release_range_part(cur_job);
+      finish_range_part(cur_job, true, threadId);
+      break;
+    }
+    case COMMIT:
+    case ABORT: {
+      auto log =
+          (std::string(command == COMMIT ? "(COMMIT)" : "(ABORT)") +
+           " TXID: " + std::to_string(cur_job.transaction_id) +
+           ", PARTITION: " + std::to_string(cur_job.partition))
+              .c_str();
+      print_debug(log);
+      release_part(cur_job, threadId);
+      finish_release_part(cur_job);
+      break;
+    }
+    case UNLOCK: {
+      auto log = ("(UNLOCK) TXID: " + std::to_string(cur_job.transaction_id) +
+                  ", RID: " + std::to_string(cur_job.row_id))
+                     .c_str();
+      print_debug(log);
+      if (cur_job.granule == ROW) {
+        release_lock(cur_job.transaction_id, cur_job.row_id, threadId);
+      } else {
+        release_granule_lock(cur_job.transaction_id, cur_job.granule,
+                             cur_job.row_id);
+      }
+      if (cur_job.wait_for_result) {
+        finish_job(cur_job);
+      }
+      break;
+    }
+    case REGISTER: {
+      auto transactionId = cur_job.transaction_id;
+      auto lockBudget = cur_job.lock_budget;
+
+      auto log = ("Registering transaction " + std::to_string(transactionId))
+                     .c_str();
+      print_debug(log);
+
+      if (!register_transaction(transactionId, lockBudget)) {
+        print_error("Transaction is already registered");
+        *cur_job.error = true;
+      }
+      finish_job(cur_job);
+      break;
+    }
+    default:
+      print_error("Worker received unknown command");
   }
+}
 
-  return;
+void complete_job(Job &job, sgx_ec256_signature_t *signature) {
+  if (!job.wait_for_result) {
+    return;
+  }
+
+  if (signature == nullptr) {
+    *job.error = true;
+  } else {
+    // Write base64 encoded signature into the return value of the job struct
+    std::string encoded_signature =
+        base64_encode((unsigned char *)signature->x, sizeof(signature->x)) +
+        "-" +
+        base64_encode((unsigned char *)signature->y, sizeof(signature->y));
+
+    volatile char *p = job.return_value;
+    size_t signature_size = 89;
+    for (int i = 0; i < signature_size; i++) {
+      *p++ = encoded_signature.c_str()[i];
+    }
+  }
+  finish_job(job);
 }
 
 auto get_block_timeout() -> unsigned int {
@@ -314,113 +847,780 @@ auto verify(const char *message, void *signature, size_t sig_len) -> int {
   return res;
 }
 
-auto acquire_lock(void *signature, unsigned int transactionId,
-                  unsigned int rowId, bool isExclusive, int threadId) -> bool {
-  bool ok;
-
+auto acquire_lock(void *signature, Job &job, int threadId) -> LockResult {
   // Get the transaction object for the given transaction ID
-  auto transaction = (Transaction *)get(transactionTable_, transactionId);
-  if (transaction == nullptr) {
+  Node<Transaction> *node = pin_transaction(job.transaction_id);
+  if (node == nullptr) {
     print_error("Transaction was not registered");
-    return false;
+    return REJECTED;
+  }
+  Transaction *transaction = &node->value;
+
+  if (job.command == LOCK_GRANULE && !follows_hierarchy(transaction, job)) {
+    abort_transaction(transaction, threadId);
+    unpin_transaction(node);
+    return REJECTED;
+  }
+
+  bool isUpgrade =
+      row_mode(job) != S_LOCK && hasLock(transaction, job.row_id);
+  TableAccess access =
+      enter_table(transaction, job.row_id, is_exclusive(job));
+  bool isCoveredByRange =
+      conflicts_with_range(transaction, job.row_id, is_exclusive(job));
+  LockResult result;
+  if (access == COVERED) {
+    // The lock on the table grants the row, without a lock of its own
+    result = transaction->growing_phase ? GRANTED : REJECTED;
+  } else if (isCoveredByRange || access == BLOCKED) {
+    result = CONFLICTING;
+  } else if (arg_enclave.conflict_policy == WAIT_ON_CONFLICT && !isUpgrade &&
+             firstWaiter(waitTable_, job.row_id) != nullptr) {
+    // Requests must not overtake the ones that wait for the lock already,
+    // except for upgrades, which those wait for anyway
+    result = CONFLICTING;
+  } else {
+    result = acquire_row_lock(transaction, job.row_id, row_mode(job));
+  }
+  if (access == COUNTED) {
+    settle_row_count(transaction, job.row_id, is_exclusive(job), result,
+                     isUpgrade);
+  }
+
+  // Releasing a range or a table does not grant the requests waiting for its
+  // rows, so they must not wait for it
+  if (result == CONFLICTING && !isCoveredByRange && access != BLOCKED &&
+      arg_enclave.conflict_policy == WAIT_ON_CONFLICT &&
+      mayWait(waitTable_, get(lockTable_, job.row_id), job.row_id,
+              job.transaction_id, isUpgrade)) {
+    enqueueWaiter(waitTable_, job, isUpgrade);
+    unpin_transaction(node);
+    return WAITING;
+  }
+
+  if (result != GRANTED) {
+    abort_transaction(transaction, threadId);
+    unpin_transaction(node);
+    return result;
+  }
+
+  if (access == COVERED) {
+    sign_string(signature,
+                lock_to_string(job.transaction_id, job.row_id, row_mode(job)),
+                threadId);
+    unpin_transaction(node);
+    return GRANTED;
+  }
+  sign_lock(signature, job.transaction_id, job.row_id, threadId);
+
+  // The signature is made before escalating, which may release the row lock
+  if (access == COUNTED) {
+    unsigned int table = tableOf(job.row_id);
+    lock_granules();
+    RowCounts rows = rowLocksIn(transaction, table);
+    unlock_granules();
+    if (rows.shared + rows.exclusive >
+        (unsigned int)arg_enclave.escalation_threshold) {
+      escalate_table(transaction, table, job.partition, threadId);
+    }
   }
+  unpin_transaction(node);
+  return GRANTED;
+}
+
+auto acquire_row_lock(Transaction *transaction, unsigned int rowId,
+                      LockMode mode) -> LockResult {
+  bool ok;
 
   // Get the lock object for the given row ID
-  auto lock = (Lock *)get(lockTable_, rowId);
+  Lock *lock = get(lockTable_, rowId);
   if (lock == nullptr) {
-    lock = newLock();
-    set(lockTable_, rowId, (void *)lock);
+    lock = insert(lockTable_, rowId);
+    initLock(lock);
   }
 
   // Check if 2PL is violated
   if (!transaction->growing_phase) {
     print_error("Cannot acquire more locks according to 2PL");
-    goto abort;
+    return REJECTED;
   }
 
   // Check if lock budget is enough
   if (transaction->lock_budget < 1) {
     print_error("Lock budget exhausted");
-    goto abort;
+    return REJECTED;
   }
 
   // Comment out for evaluation ->
-  // Check for upgrade request
-  if (hasLock(transaction, rowId) && isExclusive && !lock->exclusive) {
-    if (upgrade(lock, transactionId)) {
-      goto sign;
-    }
-    goto abort;
+  // Check for upgrade request, from S or U to X or from S to U
+  if (hasLock(transaction, rowId) && mode == X_LOCK &&
+      !isHeldExclusively(lock)) {
+    return upgrade(lock, transaction->transaction_id) ? GRANTED : CONFLICTING;
+  }
+  if (hasLock(transaction, rowId) && mode == U_LOCK &&
+      !isHeldExclusively(lock) &&
+      !isUpdater(lock, transaction->transaction_id)) {
+    return getUpdateAccess(lock, transaction->transaction_id) ? GRANTED
+                                                              : CONFLICTING;
   }
 
-  // Acquire lock in requested mode (shared, exclusive)
+  // Acquire lock in requested mode (shared, update, exclusive)
   if (!hasLock(transaction, rowId)) {
     // <- Comment out for evaluation
     sgx_thread_mutex_lock(&transaction_mutex[transaction->transaction_id]);
-    ok = addLock(transaction, rowId, isExclusive, lock);
+    ok = mode == U_LOCK ? addUpdateLock(transaction, rowId, lock)
+                        : addLock(transaction, rowId, mode == X_LOCK, lock);
     sgx_thread_mutex_unlock(&transaction_mutex[transaction->transaction_id]);
 
-    if (ok) {
-      goto sign;
-    }
-    goto abort;
+    return ok ? GRANTED : CONFLICTING;
     // Comment out for evaluation ->
   }
   // <- Comment out for evaluation
 
   print_error("Request for already acquired lock");
+  return REJECTED;
+}
+
+auto acquire_granule_lock(void *signature, Job &job, int threadId)
+    -> LockResult {
+  // Get the transaction object for the given transaction ID
+  Node<Transaction> *node = pin_transaction(job.transaction_id);
+  if (node == nullptr) {
+    print_error("Transaction was not registered");
+    return REJECTED;
+  }
+  Transaction *transaction = &node->value;
+
+  int key = granuleKey(job.granule, job.row_id);
+  LockMode heldMode;
+  bool isConversion = granuleMode(transaction, key, &heldMode);
+  LockResult result;
+  if (!transaction->growing_phase) {
+    print_error("Cannot acquire more locks according to 2PL");
+    result = REJECTED;
+  } else if (!isConversion && transaction->lock_budget < 1) {
+    print_error("Lock budget exhausted");
+    result = REJECTED;
+  } else if (!follows_hierarchy(transaction, job)) {
+    result = REJECTED;
+  } else {
+    lock_granules();
+    GranuleLock *lock = get(granuleTable_, key);
+    if (lock == nullptr) {
+      lock = insert(granuleTable_, key);
+      initGranuleLock(lock);
+    }
 
-abort:
-  abort_transaction(transaction);
-  return false;
+    // Tables also conflict with the row locks counted within them
+    LockMode mode = isConversion ? strongestOf(heldMode, job.mode) : job.mode;
+    if (job.granule == TABLE &&
+        conflictsWithRows(lock, rowLocksIn(transaction, job.row_id), mode)) {
+      print_error("Table contains rows locked in a conflicting mode");
+      result = CONFLICTING;
+    } else {
+      sgx_thread_mutex_lock(&transaction_mutex[transaction->transaction_id]);
+      result = addGranuleLock(transaction, key, job.mode, lock) ? GRANTED
+                                                                : CONFLICTING;
+      sgx_thread_mutex_unlock(
+          &transaction_mutex[transaction->transaction_id]);
+    }
+    if (isUnused(lock)) {
+      remove(granuleTable_, key);
+    }
+    unlock_granules();
+  }
 
-sign:
-  std::string string_to_sign =
-      lock_to_string(transactionId, rowId, lock->exclusive);
+  if (result != GRANTED) {
+    abort_transaction(transaction, threadId);
+    unpin_transaction(node);
+    return result;
+  }
 
+  // A conversion is signed with the mode the granule is held in now
+  granuleMode(transaction, key, &heldMode);
+  std::string string_to_sign = granule_lock_to_string(
+      job.transaction_id, job.granule, job.row_id, heldMode);
   sgx_ecdsa_sign((uint8_t *)string_to_sign.c_str(),
                  strnlen(string_to_sign.c_str(), MAX_SIGNATURE_LENGTH),
                  &ec256_private_key, (sgx_ec256_signature_t *)signature,
                  contexts[threadId]);
+  unpin_transaction(node);
+  return GRANTED;
+}
+
+void lock_granules() {
+  if (arg_enclave.escalation_threshold > 0) {
+    sgx_thread_mutex_lock(&granule_mutex);
+  }
+}
+
+void unlock_granules() {
+  if (arg_enclave.escalation_threshold > 0) {
+    sgx_thread_mutex_unlock(&granule_mutex);
+  }
+}
+
+auto enter_table(Transaction *transaction, unsigned int rowId,
+                 bool isExclusive) -> TableAccess {
+  if (arg_enclave.escalation_threshold == 0) {
+    return NOT_COUNTED;
+  }
+
+  int key = granuleKey(TABLE, tableOf(rowId));
+  TableAccess access = COUNTED;
+  lock_granules();
+  GranuleLock *lock = get(granuleTable_, key);
+  if (lock == nullptr) {
+    lock = insert(granuleTable_, key);
+    initGranuleLock(lock);
+  }
+  LockMode held;
+  bool holdsTable = granuleMode(transaction, key, &held);
+  if (holdsTable && (held == X_LOCK || (!isExclusive && (held == S_LOCK ||
+                                                         held == SIX_LOCK)))) {
+    access = COVERED;
+  } else if (conflictsWithHolders(lock, holdsTable ? &held : nullptr,
+                                  isExclusive ? IX_LOCK : IS_LOCK)) {
+    print_error("Table of the row is locked in a conflicting mode");
+    access = BLOCKED;
+  } else {
+    countRows(&lock->rows, isExclusive, 1);
+    countRowLock(transaction, rowId, isExclusive, 1);
+  }
+  if (isUnused(lock)) {
+    remove(granuleTable_, key);
+  }
+  unlock_granules();
+  return access;
+}
+
+void leave_table(Transaction *transaction, unsigned int rowId,
+                 bool isExclusive) {
+  if (arg_enclave.escalation_threshold == 0) {
+    return;
+  }
+
+  int key = granuleKey(TABLE, tableOf(rowId));
+  lock_granules();
+  GranuleLock *lock = get(granuleTable_, key);
+  if (lock != nullptr) {
+    countRows(&lock->rows, isExclusive, -1);
+    if (isUnused(lock)) {
+      remove(granuleTable_, key);
+    }
+  }
+  countRowLock(transaction, rowId, isExclusive, -1);
+  unlock_granules();
+}
+
+void settle_row_count(Transaction *transaction, unsigned int rowId,
+                      bool isExclusive, LockResult result, bool isUpgrade) {
+  if (result != GRANTED) {
+    leave_table(transaction, rowId, isExclusive);
+  } else if (isUpgrade) {
+    leave_table(transaction, rowId, false);
+  }
+}
+
+void escalate_table(Transaction *transaction, unsigned int table,
+                    int partition, int threadId) {
+  int key = granuleKey(TABLE, table);
+  lock_granules();
+  RowCounts own = rowLocksIn(transaction, table);
+  LockMode mode = own.exclusive > 0 ? X_LOCK : S_LOCK;
+  GranuleLock *lock = get(granuleTable_, key);
+  bool isEscalated = lock != nullptr && !conflictsWithRows(lock, own, mode);
+  if (isEscalated) {
+    sgx_thread_mutex_lock(&transaction_mutex[transaction->transaction_id]);
+    isEscalated = addGranuleLock(transaction, key, mode, lock);
+    sgx_thread_mutex_unlock(&transaction_mutex[transaction->transaction_id]);
+  }
+  unlock_granules();
+  if (!isEscalated) {
+    failedEscalations_++;
+    return;
+  }
+
+  // The lock on the table covers the row locks within it now. Rows of other
+  // partitions are served by other workers, so they keep their locks until
+  // the transaction ends.
+  std::vector<int> rows;
+  sgx_thread_mutex_lock(&transaction_mutex[transaction->transaction_id]);
+  for (int i = 0; i < transaction->locked_rows_size; i++) {
+    int row = transaction->locked_rows[i];
+    if (tableOf(row) == table && partition_of(row) == partition) {
+      rows.push_back(row);
+    }
+  }
+  sgx_thread_mutex_unlock(&transaction_mutex[transaction->transaction_id]);
+  for (auto row : rows) {
+    bool isExclusive = isHeldExclusively(get(lockTable_, row));
+    sgx_thread_mutex_lock(&transaction_mutex[transaction->transaction_id]);
+    releaseCoveredLock(transaction, row, lockTable_);
+    sgx_thread_mutex_unlock(&transaction_mutex[transaction->transaction_id]);
+    leave_table(transaction, row, isExclusive);
+    grant_waiters(row, threadId);
+  }
+  escalations_++;
+  escalatedRows_ += rows.size();
+}
+
+auto transaction_partition_of(unsigned int transactionId) -> int {
+  return (int)(hash(transactionTable_->size, transactionId) /
+               ((float)transactionTable_->size / arg_enclave.num_threads));
+}
+
+auto register_transaction(unsigned int transactionId, int lockBudget)
+    -> bool {
+  // The bucket groups of a partition only grow under its mutex, so
+  // registrations in different partitions do not contend
+  int partition = transaction_partition_of(transactionId);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  bool isNew = !contains(transactionTable_, transactionId);
+  if (isNew) {
+    initTransaction(insert(transactionTable_, transactionId), transactionId,
+                    lockBudget);
+  }
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  return isNew;
+}
+
+auto is_registered(unsigned int transactionId) -> bool {
+  int partition = transaction_partition_of(transactionId);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  bool registered = contains(transactionTable_, transactionId);
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  return registered;
+}
+
+auto pin_transaction(unsigned int transactionId) -> Node<Transaction> * {
+  int partition = transaction_partition_of(transactionId);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  Entry *entry = findEntry(transactionTable_, transactionId);
+  Node<Transaction> *node =
+      entry == nullptr ? nullptr : nodeOf<Transaction>(entry);
+  if (node != nullptr) {
+    node->value.pins++;
+  }
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  return node;
+}
+
+void unpin_transaction(Node<Transaction> *node) {
+  int partition = transaction_partition_of(node->value.transaction_id);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  bool isLast = --node->value.pins == 0 && node->value.detached;
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  if (isLast) {
+    destroyTransaction(&node->value);
+    poolDelete(node);
+  }
+}
+
+void delete_transaction(Node<Transaction> *node) {
+  int partition = transaction_partition_of(node->value.transaction_id);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  bool isPinned = node->value.pins > 0;
+  node->value.detached = true;
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  if (!isPinned) {
+    destroyTransaction(&node->value);
+    poolDelete(node);
+  }
+}
+
+void remove_if_idle(unsigned int transactionId) {
+  int partition = transaction_partition_of(transactionId);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  Node<Transaction> *node = nullptr;
+  Transaction *transaction = get(transactionTable_, transactionId);
+  if (transaction != nullptr && !holdsLocks(transaction)) {
+    node = extract(transactionTable_, transactionId);
+  }
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  if (node != nullptr) {
+    delete_transaction(node);
+  }
+}
+
+auto extract_transaction(unsigned int transactionId,
+                         Transaction *transaction) -> Node<Transaction> * {
+  int partition = transaction_partition_of(transactionId);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  Node<Transaction> *node = nullptr;
+  if (transaction == nullptr ||
+      get(transactionTable_, transactionId) == transaction) {
+    node = extract(transactionTable_, transactionId);
+  }
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  return node;
+}
+
+auto partition_of(unsigned int key) -> int {
+  return (int)(hash(lockTable_->size, key) /
+               ((float)lockTable_->size / arg_enclave.num_partitions));
+}
+
+auto acquire_range_part(Job &job, int threadId) -> LockResult {
+  // Get the transaction object for the given transaction ID
+  Node<Transaction> *node = pin_transaction(job.transaction_id);
+  if (node == nullptr) {
+    print_error("Transaction was not registered");
+    return REJECTED;
+  }
+  Transaction *transaction = &node->value;
+
+  bool isExclusive = job.mode == X_LOCK;
+  RangeIndex *index = &rangeIndex_[job.partition];
+  LockResult result = GRANTED;
+  sgx_thread_mutex_lock(&range_mutex[job.partition]);
+  sgx_thread_mutex_lock(&transaction_mutex[transaction->transaction_id]);
+  if (!transaction->growing_phase) {
+    print_error("Cannot acquire more locks according to 2PL");
+    result = REJECTED;
+  } else if (transaction->lock_budget < 1) {
+    print_error("Lock budget exhausted");
+    result = REJECTED;
+  } else if (findConflictingRange(index, job.row_id, job.last_row_id,
+                                  job.transaction_id, isExclusive)) {
+    print_error("Range overlaps a conflicting range lock");
+    result = CONFLICTING;
+  } else {
+    insertRange(index, job.row_id, job.last_row_id, job.transaction_id,
+                isExclusive);
+    numRanges_++;
+    transaction->locked_ranges++;
+  }
+  sgx_thread_mutex_unlock(&transaction_mutex[transaction->transaction_id]);
+  sgx_thread_mutex_unlock(&range_mutex[job.partition]);
+
+  // Check the locks on the rows of the partition within the range
+  for (unsigned long rowId = job.row_id;
+       result == GRANTED && rowId <= job.last_row_id; rowId++) {
+    if (partition_of(rowId) != job.partition) {
+      continue;
+    }
+    Lock *lock = get(lockTable_, rowId);
+    if (lock != nullptr) {
+      int others =
+          numOwners(lock) - (isOwner(lock, job.transaction_id) ? 1 : 0);
+      if (others > 0 && (isExclusive || isHeldExclusively(lock))) {
+        print_error("Range contains a row locked in a conflicting mode");
+        result = CONFLICTING;
+      }
+    }
+  }
+  if (result == CONFLICTING) {
+    release_range_part(job);
+  }
 
+  // Parts on other workers may fail at the same time, abort_transaction()
+  // lets only one of them release the locks
+  if (result != GRANTED) {
+    abort_transaction(transaction, threadId);
+  }
+  unpin_transaction(node);
+  return result;
+}
+
+void release_range_part(Job &job) {
+  // Get the transaction object
+  Node<Transaction> *node = pin_transaction(job.transaction_id);
+  if (node == nullptr) {
+    print_error("Transaction was not registered");
+    return;
+  }
+  Transaction *transaction = &node->value;
+
+  sgx_thread_mutex_lock(&range_mutex[job.partition]);
+  if (removeRange(&rangeIndex_[job.partition], job.row_id, job.last_row_id,
+                  job.transaction_id)) {
+    numRanges_--;
+    sgx_thread_mutex_lock(&transaction_mutex[transaction->transaction_id]);
+    transaction->locked_ranges--;
+    transaction->growing_phase = false;
+    sgx_thread_mutex_unlock(&transaction_mutex[transaction->transaction_id]);
+  }
+  sgx_thread_mutex_unlock(&range_mutex[job.partition]);
+  unpin_transaction(node);
+}
+
+void finish_range_part(Job &job, bool ok, int threadId) {
+  RangeRequest *range = (RangeRequest *)job.range;
+  if (!ok) {
+    range->failed = true;
+  }
+  if (--range->pending > 0) {
+    return;
+  }
+
+  Node<Transaction> *node = nullptr;
+  if (job.command == UNLOCK_RANGE) {
+    // If the transaction released its last lock, delete it
+    remove_if_idle(job.transaction_id);
+    if (range->job.wait_for_result) {
+      finish_job(range->job);
+    }
+  } else if (range->failed ||
+             (node = pin_transaction(job.transaction_id)) == nullptr) {
+    complete_job(range->job, nullptr);
+  } else {
+    // The range counts as one lock against the budget, however many
+    // partitions it spans
+    Transaction *transaction = &node->value;
+    sgx_thread_mutex_lock(&transaction_mutex[transaction->transaction_id]);
+    transaction->lock_budget--;
+    sgx_thread_mutex_unlock(&transaction_mutex[transaction->transaction_id]);
+    unpin_transaction(node);
+
+    sgx_ec256_signature_t sig;
+    std::string string_to_sign = range_lock_to_string(
+        job.transaction_id, job.row_id, job.last_row_id, job.mode == X_LOCK);
+    sgx_ecdsa_sign((uint8_t *)string_to_sign.c_str(),
+                   strnlen(string_to_sign.c_str(), MAX_SIGNATURE_LENGTH),
+                   &ec256_private_key, &sig, contexts[threadId]);
+    complete_job(range->job, &sig);
+  }
+  delete range;
+}
+
+void release_part(Job &job, int threadId) {
+  ReleaseRequest *request = (ReleaseRequest *)job.release;
+  for (auto lockedRow : request->rows[job.partition]) {
+    Lock *lock = get(lockTable_, lockedRow);
+    release(lock, job.transaction_id);
+    if (numOwners(lock) == 0) {
+      remove(lockTable_, lockedRow);
+    }
+    grant_waiters(lockedRow, threadId);
+  }
+}
+
+void finish_release_part(Job &job) {
+  ReleaseRequest *request = (ReleaseRequest *)job.release;
+  if (--request->pending > 0) {
+    return;
+  }
+
+  release_other_locks(&request->node->value);
+  delete_transaction(request->node);
+  if (request->job.wait_for_result) {
+    finish_job(request->job);
+  }
+  delete request;
+}
+
+auto conflicts_with_range(Transaction *transaction, unsigned int rowId,
+                          bool isExclusive) -> bool {
+  if (numRanges_ == 0) {
+    return false;
+  }
+
+  int partition = partition_of(rowId);
+  sgx_thread_mutex_lock(&range_mutex[partition]);
+  bool conflict =
+      findConflictingRange(&rangeIndex_[partition], rowId, rowId,
+                           transaction->transaction_id, isExclusive);
+  sgx_thread_mutex_unlock(&range_mutex[partition]);
+  if (conflict) {
+    print_error("Row is covered by a conflicting range lock");
+  }
+  return conflict;
+}
+
+auto follows_hierarchy(Transaction *transaction, Job &job) -> bool {
+  if (job.granule == ROW && job.mode != S_LOCK && job.mode != U_LOCK &&
+      job.mode != X_LOCK) {
+    print_error("Rows can only be locked in S, U or X mode");
+    return false;
+  }
+  if (job.granule == DATABASE) {
+    return true;
+  }
+
+  LockMode parentMode;
+  Granule parent = (Granule)(job.granule + 1);
+  if (!granuleMode(transaction,
+                   granuleKey(parent, parentOf(job.granule, job.row_id)),
+                   &parentMode) ||
+      !allowsChild(parentMode, job.mode)) {
+    print_error("Parent granule is not locked in an intention mode");
+    return false;
+  }
   return true;
 }
 
-void release_lock(unsigned int transactionId, unsigned int rowId) {
+void sign_lock(void *signature, unsigned int transactionId, unsigned int rowId,
+               int threadId) {
+  Lock *lock = get(lockTable_, rowId);
+  LockMode mode = S_LOCK;
+  if (isHeldExclusively(lock)) {
+    mode = X_LOCK;
+  } else if (isUpdater(lock, transactionId)) {
+    mode = U_LOCK;
+  }
+  sign_string(signature, lock_to_string(transactionId, rowId, mode), threadId);
+}
+
+void grant_waiters(unsigned int rowId, int threadId) {
+  if (arg_enclave.conflict_policy != WAIT_ON_CONFLICT) {
+    return;
+  }
+
+  Job *job;
+  while ((job = firstWaiter(waitTable_, rowId)) != nullptr) {
+    // The transaction may have been aborted while its request was waiting
+    Node<Transaction> *node = pin_transaction(job->transaction_id);
+    Transaction *transaction = node == nullptr ? nullptr : &node->value;
+    LockResult result;
+    if (transaction == nullptr ||
+        conflicts_with_range(transaction, rowId, is_exclusive(*job))) {
+      result = REJECTED;
+    } else {
+      bool isUpgrade = row_mode(*job) != S_LOCK && hasLock(transaction, rowId);
+      TableAccess access = enter_table(transaction, rowId, is_exclusive(*job));
+      if (access == BLOCKED) {
+        result = REJECTED;
+      } else {
+        result = acquire_row_lock(transaction, rowId, row_mode(*job));
+      }
+      if (access == COUNTED) {
+        settle_row_count(transaction, rowId, is_exclusive(*job), result,
+                         isUpgrade);
+      }
+    }
+    if (node != nullptr) {
+      unpin_transaction(node);
+    }
+    if (result == CONFLICTING) {
+      break;
+    }
+
+    // A rejected request only fails, as aborting its transaction would grant
+    // the locks it releases from within this loop
+    if (result == GRANTED) {
+      sgx_ec256_signature_t sig;
+      sign_lock((void *)&sig, job->transaction_id, rowId, threadId);
+      complete_job(*job, &sig);
+    } else {
+      complete_job(*job, nullptr);
+    }
+    dequeueWaiter(waitTable_, rowId);
+  }
+}
+
+void release_lock(unsigned int transactionId, unsigned int rowId,
+                  int threadId) {
   // Get the transaction object
-  auto transaction = (Transaction *)get(transactionTable_, transactionId);
-  if (transaction == nullptr) {
+  Node<Transaction> *node = pin_transaction(transactionId);
+  if (node == nullptr) {
     print_error("Transaction was not registered");
     return;
   }
+  Transaction *transaction = &node->value;
 
   // Get the lock object
-  auto lock = (Lock *)get(lockTable_, rowId);
+  Lock *lock = get(lockTable_, rowId);
   if (lock == nullptr) {
     print_error("Lock does not exist");
+    unpin_transaction(node);
     return;
   }
 
+  bool isExclusive = isHeldExclusively(lock);
+  bool isCounted = hasLock(transaction, rowId);
   sgx_thread_mutex_lock(&transaction_mutex[transaction->transaction_id]);
   releaseLock(transaction, rowId, lockTable_);
   sgx_thread_mutex_unlock(&transaction_mutex[transaction->transaction_id]);
+  if (isCounted) {
+    leave_table(transaction, rowId, isExclusive);
+  }
+  unpin_transaction(node);
+  grant_waiters(rowId, threadId);
 
   // If the transaction released its last lock, delete it
-  if (transaction->locked_rows_size == 0) {
-    remove(transactionTable_, transactionId);
-    delete transaction;
+  remove_if_idle(transactionId);
+}
+
+void release_granule_lock(unsigned int transactionId, Granule granule,
+                          unsigned int id) {
+  // Get the transaction object
+  Node<Transaction> *node = pin_transaction(transactionId);
+  if (node == nullptr) {
+    print_error("Transaction was not registered");
+    return;
   }
+  Transaction *transaction = &node->value;
+
+  lock_granules();
+  sgx_thread_mutex_lock(&transaction_mutex[transaction->transaction_id]);
+  releaseGranuleLock(transaction, granuleKey(granule, id), granuleTable_);
+  sgx_thread_mutex_unlock(&transaction_mutex[transaction->transaction_id]);
+  unlock_granules();
+  unpin_transaction(node);
+
+  // If the transaction released its last lock, delete it
+  remove_if_idle(transactionId);
 }
 
-void abort_transaction(Transaction *transaction) {
-  remove(transactionTable_, transaction->transaction_id);
+void abort_transaction(Transaction *transaction, int threadId) {
+  // Only the thread that removes the transaction from the table releases its
+  // locks and frees it
+  Node<Transaction> *node =
+      extract_transaction(transaction->transaction_id, transaction);
+  if (node == nullptr) {
+    return;
+  }
+  std::vector<int> lockedRows;
+  if (arg_enclave.conflict_policy == WAIT_ON_CONFLICT) {
+    lockedRows.assign(transaction->locked_rows,
+                      transaction->locked_rows + transaction->locked_rows_size);
+  }
   releaseAllLocks(transaction, lockTable_);
-  delete transaction;
+  release_other_locks(transaction);
+  delete_transaction(node);
+
+  for (auto lockedRow : lockedRows) {
+    grant_waiters(lockedRow, threadId);
+  }
+}
+
+void release_other_locks(Transaction *transaction) {
+  // Nobody waits for the locks of pages, tables and the database. The released
+  // row locks are not counted within their tables anymore.
+  lock_granules();
+  while (transaction->granule_locks_size > 0) {
+    releaseGranuleLock(transaction, transaction->granule_locks[0].key,
+                       granuleTable_);
+  }
+  for (int i = 0; i < transaction->table_rows_size; i++) {
+    int key = granuleKey(TABLE, transaction->table_rows[i].table);
+    GranuleLock *lock = get(granuleTable_, key);
+    if (lock != nullptr) {
+      lock->rows.shared -= transaction->table_rows[i].rows.shared;
+      lock->rows.exclusive -= transaction->table_rows[i].rows.exclusive;
+      if (isUnused(lock)) {
+        remove(granuleTable_, key);
+      }
+    }
+  }
+  transaction->table_rows_size = 0;
+  unlock_granules();
+
+  // Other parts of a range of the transaction find it unregistered from now on
+  for (int partition = 0; partition < arg_enclave.num_partitions;
+       partition++) {
+    sgx_thread_mutex_lock(&range_mutex[partition]);
+    numRanges_ -=
+        removeRanges(&rangeIndex_[partition], transaction->transaction_id);
+    sgx_thread_mutex_unlock(&range_mutex[partition]);
+  }
 }
 
 auto verify_signature(char *signature, int transactionId, int rowId,
                       int isExclusive) -> int {
-  std::string plain = lock_to_string(transactionId, rowId, isExclusive);
+  std::string plain =
+      lock_to_string(transactionId, rowId, isExclusive ? X_LOCK : S_LOCK);
 
   std::string signature_string(signature);
   std::string x = signature_string.substr(0, signature_string.find("-"));
@@ -440,17 +1640,51 @@ auto verify_signature(char *signature, int transactionId, int rowId,
   return ret;
 }
 
-auto lock_to_string(int transactionId, int rowId, bool isExclusive)
+auto lock_to_string(int transactionId, int rowId, LockMode mode)
     -> std::string {
   unsigned int block_timeout = get_block_timeout();
 
-  std::string mode;
-  if (isExclusive) {
-    mode = "X";
-  } else {
-    mode = "S";
-  }
-
   return std::to_string(transactionId) + "_" + std::to_string(rowId) + "_" +
-         mode + "_" + std::to_string(block_timeout);
-}
\ No newline at end of file
+         mode_names[mode] + "_" + std::to_string(block_timeout);
+}
+auto granule_lock_to_string(int transactionId, Granule granule, int id,
+                            LockMode mode) -> std::string {
+  static const char *granules[] = {"R", "P", "T", "D"};
+  unsigned int block_timeout = get_block_timeout();
+
+  return std::to_string(transactionId) + "_" + granules[granule] +
+         std::to_string(id) + "_" + mode_names[mode] + "_" +
+         std::to_string(block_timeout);
+}
+
+auto range_lock_to_string(int transactionId, unsigned int firstRowId,
+                          unsigned int lastRowId, bool isExclusive)
+    -> std::string {
+  unsigned int block_timeout = get_block_timeout();
+
+  return std::to_string(transactionId) + "_" + std::to_string(firstRowId) +
+         "-" + std::to_string(lastRowId) + "_" + (isExclusive ? "X" : "S") +
+         "_" + std::to_string(block_timeout);
+}
+
+void get_pool_statistics(PoolStatistics *statistics) {
+  *statistics = poolStatistics();
+}
+
+void get_locktable_statistics(BucketStatistics *statistics) {
+  *statistics = bucketStatistics(lockTable_);
+}
+
+void get_escalation_statistics(EscalationStatistics *statistics) {
+  *statistics = {escalations_, escalatedRows_, failedEscalations_};
+}
+
+void get_partition_statistics(PartitionStatistics *statistics,
+                              size_t num_partitions) {
+  size_t size = std::min(num_partitions, (size_t)arg_enclave.num_partitions);
+  for (size_t i = 0; i < size; i++) {
+    statistics[i] = {partitionOwner_[i],
+                     (unsigned long)std::max(partitionJobs_[i].load(), 0),
+                     partitionServed_[i], partitionMigrations_[i]};
+  }
+}
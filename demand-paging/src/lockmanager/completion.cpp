@@ -0,0 +1,54 @@
+#include "completion.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+// Number of polls of the completions of this thread before it parks
+static thread_local int completionSpins = kMinCompletionSpins;
+
+/**
+ * Tells the CPU that the thread is polling, which saves power and frees the
+ * pipeline for a sibling hyperthread
+ */
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+static inline void futex(Completion* completion, int operation, int value) {
+  syscall(SYS_futex, (int*)&completion->state, operation, value, nullptr,
+          nullptr, 0);
+}
+
+void waitForCompletion(Completion* completion) {
+  for (int i = 0; i < completionSpins; i++) {
+    if (completion->state.load(std::memory_order_acquire) == kCompletionDone) {
+      completionSpins = std::min(2 * completionSpins, kMaxCompletionSpins);
+      return;
+    }
+    cpuRelax();
+  }
+  completionSpins = std::max(completionSpins / 2, kMinCompletionSpins);
+
+  int expected = kCompletionPending;
+  if (!completion->state.compare_exchange_strong(expected, kCompletionParked,
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_acquire)) {
+    // Finished after the last poll
+    return;
+  }
+  // The futex only sleeps while the state is still parked and wakes up
+  // spuriously at times
+  while (completion->state.load(std::memory_order_acquire) ==
+         kCompletionParked) {
+    futex(completion, FUTEX_WAIT_PRIVATE, kCompletionParked);
+  }
+}
+
+void wakeCompletion(Completion* completion) {
+  futex(completion, FUTEX_WAKE_PRIVATE, 1);
+}
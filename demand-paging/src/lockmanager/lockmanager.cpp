@@ -34,16 +34,37 @@ auto LockManager::create_worker_thread(void *tmp) -> void * {
   return 0;
 }
 
-void LockManager::configuration_init(int numWorkerThreads) {
-  arg.num_threads =
-      numWorkerThreads + 1;  // one single thread for transaction table
-  arg.tx_thread_id = arg.num_threads - 1;
+auto LockManager::create_balancer_thread(void *tmp) -> void * {
+  LockManager *lockManager = (LockManager *)tmp;
+  while (lockManager->balancer_running) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(kBalanceInterval));
+    Job job;
+    job.command = BALANCE;
+    job.time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+                   .count();
+    job.wait_for_result = false;
+    enclave_send_job(global_eid, &job);
+  }
+  return 0;
+}
+
+void LockManager::configuration_init(int numWorkerThreads,
+                                     ConflictPolicy policy,
+                                     int escalationThreshold) {
+  // The worker threads share the transaction table, see
+  // transaction_partition_of()
+  arg.num_threads = numWorkerThreads;
+  arg.num_partitions = numWorkerThreads * kPartitionsPerWorker;
   arg.lock_table_size = 10000;
   arg.transaction_table_size = 200;
+  arg.conflict_policy = policy;
+  arg.escalation_threshold = escalationThreshold;
 }
 
-LockManager::LockManager(int numWorkerThreads) {
-  configuration_init(numWorkerThreads);
+LockManager::LockManager(int numWorkerThreads, ConflictPolicy policy,
+                         int escalationThreshold) {
+  configuration_init(numWorkerThreads, policy, escalationThreshold);
 
   // Load and initialize the signed enclave
   sgx_status_t ret = load_and_initialize_enclave(&global_eid);
@@ -61,6 +82,8 @@ LockManager::LockManager(int numWorkerThreads) {
   for (int i = 0; i < arg.num_threads; i++) {
     pthread_create(&threads[i], NULL, &LockManager::create_worker_thread, this);
   }
+  balancer_running = true;
+  pthread_create(&balancer, NULL, &LockManager::create_balancer_thread, this);
 
   // Generate new keys if keys from sealed storage cannot be found
   int res = -1;
@@ -85,6 +108,10 @@ LockManager::~LockManager() {
   spdlog::info("Freeing threads");
   free(threads);*/
 
+  // The balancer must not send BALANCE jobs to the enclave anymore
+  balancer_running = false;
+  pthread_join(balancer, NULL);
+
   spdlog::info("Destroying enclave");
   sgx_destroy_enclave(global_eid);
 }
@@ -104,11 +131,87 @@ auto LockManager::lock(unsigned int transactionId, unsigned int rowId,
   return create_enclave_job(SHARED, transactionId, rowId, 0, waitForResult);
 };
 
+auto LockManager::lock(unsigned int transactionId, Granule granule,
+                       unsigned int id, LockMode mode, bool waitForResult)
+    -> std::pair<std::string, bool> {
+  return create_enclave_job(LOCK_GRANULE, transactionId, id, 0, waitForResult,
+                            granule, mode);
+};
+
+auto LockManager::lockBatch(const std::vector<BatchedLock> &requests)
+    -> std::vector<std::pair<std::string, bool>> {
+  size_t numJobs = requests.size();
+
+  // The results of the requests live on the stack and the heap of this thread
+  // in the untrusted part of the application, see create_enclave_job()
+  std::vector<Job> jobs(numJobs);
+  std::vector<Completion> finished(numJobs);
+  std::unique_ptr<bool[]> errors(new bool[numJobs]());
+  std::vector<char> signatures(numJobs * SIGNATURE_SIZE);
+  for (size_t i = 0; i < numJobs; i++) {
+    Job &job = jobs[i];
+    job.command = requests[i].isExclusive ? EXCLUSIVE : SHARED;
+    job.transaction_id = requests[i].transactionId;
+    job.row_id = requests[i].rowId;
+    job.granule = ROW;
+    job.wait_for_result = true;
+    job.return_value = &signatures[i * SIGNATURE_SIZE];
+    initCompletion(&finished[i]);
+    job.finished = &finished[i];
+    job.error = &errors[i];
+  }
+  enclave_send_jobs(global_eid, jobs.data(), numJobs);
+
+  std::vector<std::pair<std::string, bool>> results;
+  results.reserve(numJobs);
+  for (size_t i = 0; i < numJobs; i++) {
+    waitForCompletion(&finished[i]);
+    if (errors[i]) {
+      results.emplace_back(NO_SIGNATURE, false);
+      continue;
+    }
+    results.emplace_back(
+        std::string(&signatures[i * SIGNATURE_SIZE], SIGNATURE_SIZE), true);
+  }
+  return results;
+}
+
 void LockManager::unlock(unsigned int transactionId, unsigned int rowId,
                          bool waitForResult) {
   create_enclave_job(UNLOCK, transactionId, rowId, 0, waitForResult);
 };
 
+void LockManager::unlock(unsigned int transactionId, Granule granule,
+                         unsigned int id, bool waitForResult) {
+  create_enclave_job(UNLOCK, transactionId, id, 0, waitForResult, granule);
+};
+
+auto LockManager::lockRange(unsigned int transactionId,
+                            unsigned int firstRowId, unsigned int lastRowId,
+                            bool isExclusive, bool waitForResult)
+    -> std::pair<std::string, bool> {
+  return create_enclave_job(LOCK_RANGE, transactionId, firstRowId, 0,
+                            waitForResult, ROW, isExclusive ? X_LOCK : S_LOCK,
+                            lastRowId);
+};
+
+void LockManager::unlockRange(unsigned int transactionId,
+                              unsigned int firstRowId, unsigned int lastRowId,
+                              bool waitForResult) {
+  create_enclave_job(UNLOCK_RANGE, transactionId, firstRowId, 0, waitForResult,
+                     ROW, S_LOCK, lastRowId);
+};
+
+auto LockManager::commit(unsigned int transactionId, bool waitForResult)
+    -> bool {
+  return create_enclave_job(COMMIT, transactionId, 0, 0, waitForResult).second;
+};
+
+auto LockManager::abort(unsigned int transactionId, bool waitForResult)
+    -> bool {
+  return create_enclave_job(ABORT, transactionId, 0, 0, waitForResult).second;
+};
+
 auto LockManager::seal_and_save_keys() -> bool {
   uint32_t sealed_data_size = 0;
   sgx_status_t ret = get_sealed_data_size(global_eid, &sealed_data_size);
@@ -194,7 +297,8 @@ auto LockManager::create_enclave_job(Command command,
                                      unsigned int transaction_id,
                                      unsigned int row_id,
                                      unsigned int lock_budget,
-                                     bool waitForResult)
+                                     bool waitForResult, Granule granule,
+                                     LockMode mode, unsigned int last_row_id)
     -> std::pair<std::string, bool> {
   // Set job parameters
   Job job;
@@ -202,19 +306,25 @@ auto LockManager::create_enclave_job(Command command,
 
   job.transaction_id = transaction_id;
   job.row_id = row_id;
+  job.granule = granule;
+  job.mode = mode;
+  job.last_row_id = last_row_id;
   job.lock_budget = lock_budget;
 
-  if (waitForResult) {  // Need to track, when job is finished or error has
-                        // occurred
-    // Allocate dynamic memory in the untrusted part of the application, so the
-    // enclave can modify it via its pointer
-    job.finished = new bool;
-    job.error = new bool;
-    *job.finished = false;
-    *job.error = false;
+  // Need to track, when job is finished or error has occurred. Both live on
+  // the stack of this thread in the untrusted part of the application, so the
+  // enclave can modify them via their pointers while this thread waits.
+  Completion finished;
+  bool error = false;
+  if (waitForResult) {
+    initCompletion(&finished);
+    job.finished = &finished;
+    job.error = &error;
   }
 
-  if (command == SHARED || command == EXCLUSIVE) {
+  bool returnsSignature = command == SHARED || command == EXCLUSIVE ||
+                          command == LOCK_GRANULE || command == LOCK_RANGE;
+  if (returnsSignature) {
     // These requests return a signature
     job.return_value = new char[SIGNATURE_SIZE];
   }
@@ -224,19 +334,15 @@ auto LockManager::create_enclave_job(Command command,
   if (waitForResult) {
     // Need to wait until job is finished because we need to be registered for
     // subsequent requests or because we need to wait for the return value
-    while (!*job.finished) {
-      continue;
-    }
-    delete job.finished;
+    waitForCompletion(&finished);
 
     // Check if an error occured
-    if (*job.error) {
+    if (error) {
       return std::make_pair(NO_SIGNATURE, false);
     }
-    delete job.error;
 
     // Get the signature return value
-    if (command == SHARED || command == EXCLUSIVE) {
+    if (returnsSignature) {
       std::string signature;
       for (int i = 0; i < SIGNATURE_SIZE; i++) {
         signature += job.return_value[i];
@@ -263,4 +369,41 @@ auto LockManager::verify_signature_string(std::string signature,
     print_debug("Signature successfully verified");
     return true;
   }
-}
\ No newline at end of file
+}
+auto LockManager::getPoolStatistics() -> PoolStatistics {
+  PoolStatistics statistics = {};
+  sgx_status_t ret = get_pool_statistics(global_eid, &statistics);
+  if (ret != SGX_SUCCESS) {
+    print_error("Failed to get the pool statistics");
+  }
+  return statistics;
+}
+
+auto LockManager::getLockTableStatistics() -> BucketStatistics {
+  BucketStatistics statistics = {};
+  sgx_status_t ret = get_locktable_statistics(global_eid, &statistics);
+  if (ret != SGX_SUCCESS) {
+    print_error("Failed to get the lock table statistics");
+  }
+  return statistics;
+}
+
+auto LockManager::getEscalationStatistics() -> EscalationStatistics {
+  EscalationStatistics statistics = {};
+  sgx_status_t ret = get_escalation_statistics(global_eid, &statistics);
+  if (ret != SGX_SUCCESS) {
+    print_error("Failed to get the escalation statistics");
+  }
+  return statistics;
+}
+
+auto LockManager::getPartitionStatistics()
+    -> std::vector<PartitionStatistics> {
+  std::vector<PartitionStatistics> statistics(arg.num_partitions);
+  sgx_status_t ret = get_partition_statistics(global_eid, statistics.data(),
+                                              statistics.size());
+  if (ret != SGX_SUCCESS) {
+    print_error("Failed to get the partition statistics");
+  }
+  return statistics;
+}
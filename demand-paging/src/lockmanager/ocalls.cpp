@@ -12,6 +12,10 @@ void print_warn(const char *str) {
   spdlog::warn("Enclave: " + std::string{str});
 }
 
+void wake_completion(void *completion) {
+  wakeCompletion((Completion *)completion);
+}
+
 void print_debug(const char *str) {
   spdlog::debug("Enclave: " + std::string{str});
 }
\ No newline at end of file
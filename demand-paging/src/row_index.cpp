@@ -0,0 +1,115 @@
+#include "row_index.h"
+
+#include <cstring>
+
+// Number of slots an index starts with
+const int kInitialSlots = 16;
+
+/**
+ * Returns the first slot to probe for a row. The multiplication spreads rows
+ * with consecutive IDs over the whole index.
+ */
+static auto home(const RowIndex* index, int rowId) -> int {
+  unsigned int hash = (unsigned int)rowId * 2654435761u;
+  return (int)((hash ^ (hash >> 16)) & (index->num_slots - 1));
+}
+
+/**
+ * Returns the slot that holds the given position, or -1 if no slot does
+ */
+static auto slotOf(RowIndex* index, const int* rows, int position) -> int {
+  int mask = index->num_slots - 1;
+  for (int slot = home(index, rows[position]); index->slots[slot] != 0;
+       slot = (slot + 1) & mask) {
+    if (index->slots[slot] == position + 1) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Stores a position in the first empty slot of its probe sequence
+ */
+static void insertPosition(RowIndex* index, const int* rows, int position) {
+  int mask = index->num_slots - 1;
+  int slot = home(index, rows[position]);
+  while (index->slots[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+  index->slots[slot] = position + 1;
+}
+
+void initRowIndex(RowIndex* index) {
+  index->slots = nullptr;
+  index->num_slots = 0;
+}
+
+void destroyRowIndex(RowIndex* index) {
+  delete[] index->slots;
+  initRowIndex(index);
+}
+
+auto findRow(RowIndex* index, const int* rows, int rowId) -> int {
+  if (index->num_slots == 0) {
+    return -1;
+  }
+
+  int mask = index->num_slots - 1;
+  for (int slot = home(index, rowId); index->slots[slot] != 0;
+       slot = (slot + 1) & mask) {
+    int position = index->slots[slot] - 1;
+    if (rows[position] == rowId) {
+      return position;
+    }
+  }
+  return -1;
+}
+
+void indexRow(RowIndex* index, const int* rows, int numRows) {
+  if (2 * numRows > index->num_slots) {
+    int numSlots = index->num_slots == 0 ? kInitialSlots : 2 * index->num_slots;
+    delete[] index->slots;
+    index->slots = new int[numSlots]();
+    index->num_slots = numSlots;
+    for (int position = 0; position < numRows - 1; position++) {
+      insertPosition(index, rows, position);
+    }
+  }
+  insertPosition(index, rows, numRows - 1);
+}
+
+void unindexRow(RowIndex* index, const int* rows, int position, int last) {
+  int mask = index->num_slots - 1;
+  int hole = slotOf(index, rows, position);
+  if (hole < 0) {
+    return;
+  }
+
+  // Shift back the following rows of the cluster that may not be probed past
+  // the hole anymore
+  index->slots[hole] = 0;
+  for (int slot = (hole + 1) & mask; index->slots[slot] != 0;
+       slot = (slot + 1) & mask) {
+    int wanted = home(index, rows[index->slots[slot] - 1]);
+    if (((slot - wanted) & mask) >= ((slot - hole) & mask)) {
+      index->slots[hole] = index->slots[slot];
+      index->slots[slot] = 0;
+      hole = slot;
+    }
+  }
+
+  // The last row moves into the position of the removed one
+  if (position != last) {
+    index->slots[slotOf(index, rows, last)] = position + 1;
+  }
+}
+
+void copyRowIndex(RowIndex* copy, const RowIndex* index) {
+  copy->num_slots = index->num_slots;
+  copy->slots = nullptr;
+  if (index->num_slots > 0) {
+    copy->slots = new int[index->num_slots];
+    std::memcpy(copy->slots, index->slots, sizeof(int) * index->num_slots);
+  }
+}
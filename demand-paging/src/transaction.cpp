@@ -1,16 +1,82 @@
 #include "transaction.h"
 
-Transaction* newTransaction(int transactionId, int lockBudget) {
-  Transaction* transaction = new Transaction();
+#include <algorithm>
+
+#include "pool.h"
+
+void initTransaction(Transaction* transaction, int transactionId,
+                     int lockBudget) {
   transaction->transaction_id = transactionId;
   transaction->aborted = false;
   transaction->growing_phase = true;
   transaction->lock_budget = lockBudget;
   transaction->locked_rows_size = 0;
   transaction->locked_rows = nullptr;
+  transaction->locked_rows_capacity = 0;
+  initRowIndex(&transaction->locked_rows_index);
+  transaction->granule_locks_size = 0;
+  transaction->granule_locks = nullptr;
+  transaction->locked_ranges = 0;
+  transaction->table_rows_size = 0;
+  transaction->table_rows = nullptr;
+  transaction->table_rows_capacity = 0;
+  transaction->pins = 0;
+  transaction->detached = false;
+}
+
+Transaction* newTransaction(int transactionId, int lockBudget) {
+  Transaction* transaction = poolNew<Transaction>();
+  initTransaction(transaction, transactionId, lockBudget);
   return transaction;
 }
 
+void destroyTransaction(Transaction* transaction) {
+  delete[] transaction->locked_rows;
+  transaction->locked_rows = nullptr;
+  transaction->locked_rows_size = 0;
+  transaction->locked_rows_capacity = 0;
+  destroyRowIndex(&transaction->locked_rows_index);
+  delete[] transaction->granule_locks;
+  transaction->granule_locks = nullptr;
+  transaction->granule_locks_size = 0;
+  delete[] transaction->table_rows;
+  transaction->table_rows = nullptr;
+  transaction->table_rows_size = 0;
+  transaction->table_rows_capacity = 0;
+}
+
+void deleteTransaction(Transaction* transaction) {
+  if (transaction != nullptr) {
+    destroyTransaction(transaction);
+  }
+  poolDelete(transaction);
+}
+
+/**
+ * Adds a row to the set of locked rows of the transaction and decrements its
+ * lock budget by 1. The array of locked rows doubles when it is full, so
+ * appending takes amortized constant time.
+ */
+static void appendLockedRow(Transaction* transaction, int rowId) {
+  if (transaction->locked_rows_size == transaction->locked_rows_capacity) {
+    int capacity = std::max(2 * transaction->locked_rows_capacity, 4);
+    int* temp = new int[capacity];
+    if (transaction->locked_rows_size > 0) {
+      memcpy(temp, transaction->locked_rows,
+             sizeof(int) * transaction->locked_rows_size);
+    }
+    delete[] transaction->locked_rows;
+    transaction->locked_rows = temp;
+    transaction->locked_rows_capacity = capacity;
+  }
+
+  transaction->locked_rows[transaction->locked_rows_size] = rowId;
+  transaction->locked_rows_size++;
+  indexRow(&transaction->locked_rows_index, transaction->locked_rows,
+           transaction->locked_rows_size);
+  transaction->lock_budget--;
+}
+
 auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock)
     -> bool {
   if (transaction->aborted) {
@@ -25,73 +91,201 @@ auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock)
   }
 
   if (ret) {
-    transaction->locked_rows_size++;
-    int* temp = new int[transaction->locked_rows_size];
-    temp[transaction->locked_rows_size - 1] = rowId;
-    for (int i = 0; i < transaction->locked_rows_size - 1; i++) {
-      temp[i] = transaction->locked_rows[i];
-    }
-    delete[] transaction->locked_rows;
-    transaction->locked_rows = temp;
-    transaction->lock_budget--;
+    appendLockedRow(transaction, rowId);
   }
 
   return ret;
 };
 
-void releaseLock(Transaction* transaction, int rowId, HashTable* lockTable) {
-  if (!hasLock(transaction, rowId)) {
-    return;
+auto addUpdateLock(Transaction* transaction, int rowId, Lock* lock) -> bool {
+  if (transaction->aborted ||
+      !getUpdateAccess(lock, transaction->transaction_id)) {
+    return false;
   }
 
-  int* temp = nullptr;
-  if (transaction->locked_rows_size > 1) {
-    temp = new int[transaction->locked_rows_size - 1];
-    int temp_i = 0;
-    int row;
-    for (int i = 0; i < transaction->locked_rows_size; i++) {
-      row = transaction->locked_rows[i];
-      if (!row == rowId) {
-        temp[temp_i] = row;
-        temp_i++;
-      }
-    }
+  appendLockedRow(transaction, rowId);
+  return true;
+};
+
+void releaseLock(Transaction* transaction, int rowId, LockTable* lockTable) {
+  int position = findRow(&transaction->locked_rows_index,
+                         transaction->locked_rows, rowId);
+  if (position < 0) {
+    return;
   }
 
+  // The order of the locked rows does not matter, so the last one fills the
+  // gap
+  int last = transaction->locked_rows_size - 1;
+  unindexRow(&transaction->locked_rows_index, transaction->locked_rows,
+             position, last);
+  transaction->locked_rows[position] = transaction->locked_rows[last];
   transaction->locked_rows_size--;
-  delete[] transaction->locked_rows;
-  transaction->locked_rows = temp;
   transaction->growing_phase = false;
 
-  auto lock = (Lock*)get(lockTable, rowId);
+  Lock* lock = get(lockTable, rowId);
   release(lock, transaction->transaction_id);
 
-  if (lock->owners_size == 0) {
+  if (numOwners(lock) == 0) {
     remove(lockTable, rowId);
-    delete lock;
   }
 };
 
-auto hasLock(Transaction* transaction, int rowId) -> bool {
-  for (int i = 0; i < transaction->locked_rows_size; i++) {
-    if (transaction->locked_rows[i] == rowId) {
-      return true;
-    }
+void releaseCoveredLock(Transaction* transaction, int rowId,
+                        LockTable* lockTable) {
+  if (!hasLock(transaction, rowId)) {
+    return;
   }
-  return false;
+
+  bool growingPhase = transaction->growing_phase;
+  releaseLock(transaction, rowId, lockTable);
+  transaction->growing_phase = growingPhase;
+  transaction->lock_budget++;
 };
 
-void releaseAllLocks(Transaction* transaction, HashTable* lockTable) {
+auto hasLock(Transaction* transaction, int rowId) -> bool {
+  return findRow(&transaction->locked_rows_index, transaction->locked_rows,
+                 rowId) >= 0;
+};
+
+void releaseAllLocks(Transaction* transaction, LockTable* lockTable) {
   for (int i = 0; i < transaction->locked_rows_size; i++) {
     int locked_row = transaction->locked_rows[i];
-    auto lock = (Lock*)get(lockTable, locked_row);
+    Lock* lock = get(lockTable, locked_row);
     release(lock, transaction->transaction_id);
-    if (lock->owners_size == 0) {
+    if (numOwners(lock) == 0) {
       remove(lockTable, locked_row);
     }
   }
   transaction->locked_rows_size = 0;
+  transaction->locked_rows_capacity = 0;
   delete[] transaction->locked_rows;
   transaction->locked_rows = nullptr;
+  destroyRowIndex(&transaction->locked_rows_index);
   transaction->aborted = true;
-};
\ No newline at end of file
+};
+
+/**
+ * Returns the position of a granule in the set of locked granules of the
+ * transaction, or -1 if it does not hold it
+ */
+static auto findGranule(Transaction* transaction, int key) -> int {
+  for (int i = 0; i < transaction->granule_locks_size; i++) {
+    if (transaction->granule_locks[i].key == key) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+auto addGranuleLock(Transaction* transaction, int key, LockMode mode,
+                    GranuleLock* lock) -> bool {
+  if (transaction->aborted) {
+    return false;
+  }
+
+  int i = findGranule(transaction, key);
+  if (i >= 0) {
+    return acquireGranule(lock, &transaction->granule_locks[i].mode, mode);
+  }
+  if (!acquireGranule(lock, nullptr, mode)) {
+    return false;
+  }
+
+  transaction->granule_locks_size++;
+  HeldGranule* temp = new HeldGranule[transaction->granule_locks_size];
+  for (int j = 0; j < transaction->granule_locks_size - 1; j++) {
+    temp[j] = transaction->granule_locks[j];
+  }
+  temp[transaction->granule_locks_size - 1] = {key, mode};
+  delete[] transaction->granule_locks;
+  transaction->granule_locks = temp;
+  transaction->lock_budget--;
+  return true;
+};
+
+auto granuleMode(Transaction* transaction, int key, LockMode* mode) -> bool {
+  int i = findGranule(transaction, key);
+  if (i < 0) {
+    return false;
+  }
+  *mode = transaction->granule_locks[i].mode;
+  return true;
+};
+
+void releaseGranuleLock(Transaction* transaction, int key,
+                        GranuleTable* granuleTable) {
+  int i = findGranule(transaction, key);
+  if (i < 0) {
+    return;
+  }
+
+  // The order of the locked granules does not matter, so the last one fills
+  // the gap
+  LockMode mode = transaction->granule_locks[i].mode;
+  transaction->granule_locks_size--;
+  transaction->granule_locks[i] =
+      transaction->granule_locks[transaction->granule_locks_size];
+  transaction->growing_phase = false;
+
+  GranuleLock* lock = get(granuleTable, key);
+  if (lock != nullptr) {
+    releaseGranule(lock, mode);
+    if (isUnused(lock)) {
+      remove(granuleTable, key);
+    }
+  }
+};
+
+/**
+ * Returns the position of a table in the counted tables of the transaction, or
+ * -1 if it holds no row locks within it
+ */
+static auto findTable(Transaction* transaction, unsigned int table) -> int {
+  for (int i = 0; i < transaction->table_rows_size; i++) {
+    if (transaction->table_rows[i].table == table) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void countRowLock(Transaction* transaction, int rowId, bool isExclusive,
+                  int delta) {
+  unsigned int table = tableOf(rowId);
+  int i = findTable(transaction, table);
+  if (i < 0) {
+    // The array doubles when it is full, like the array of locked rows
+    if (transaction->table_rows_size == transaction->table_rows_capacity) {
+      int capacity = std::max(2 * transaction->table_rows_capacity, 4);
+      HeldRows* temp = new HeldRows[capacity];
+      for (int j = 0; j < transaction->table_rows_size; j++) {
+        temp[j] = transaction->table_rows[j];
+      }
+      delete[] transaction->table_rows;
+      transaction->table_rows = temp;
+      transaction->table_rows_capacity = capacity;
+    }
+    i = transaction->table_rows_size;
+    transaction->table_rows[i] = {table, {0, 0}};
+    transaction->table_rows_size++;
+  }
+
+  RowCounts* rows = &transaction->table_rows[i].rows;
+  countRows(rows, isExclusive, delta);
+  if (rows->shared == 0 && rows->exclusive == 0) {
+    transaction->table_rows_size--;
+    transaction->table_rows[i] =
+        transaction->table_rows[transaction->table_rows_size];
+  }
+};
+
+auto rowLocksIn(Transaction* transaction, unsigned int table) -> RowCounts {
+  int i = findTable(transaction, table);
+  return i >= 0 ? transaction->table_rows[i].rows : RowCounts{0, 0};
+};
+
+auto holdsLocks(Transaction* transaction) -> bool {
+  return transaction->locked_rows_size > 0 ||
+         transaction->granule_locks_size > 0 || transaction->locked_ranges > 0;
+};
@@ -4,117 +4,117 @@
 #include "lock.h"
 
 TEST(HashTableTest, getWhenListEmpty) {
-  HashTable* hashTable = newHashTable(10);
-  void* value = get(hashTable, 102);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
+  Lock* value = get(hashTable, 102);
   EXPECT_EQ(value, nullptr);
 };
 
 TEST(HashTableTest, getListNotEmptyKeyExists) {
-  HashTable* hashTable = newHashTable(10);
-  Lock* lock = newLock();
-  lock->exclusive = true;
-  lock->owners = new int[1];
-  lock->owners_size = 1;
+  LockTable* hashTable = newHashTable<int, Lock>(10);
+  insert(hashTable, 12);
+  insert(hashTable, 22);
+  Lock* lock = insert(hashTable, 32);
   const int val = 4;
-  lock->owners[0] = val;
-
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 32, (void*)lock);
-  set(hashTable, 42, (void*)newLock());
-
-  Lock* value = (Lock*)get(hashTable, 32);
-  EXPECT_EQ(value->exclusive, lock->exclusive);
-  EXPECT_EQ(value->owners_size, lock->owners_size);
-
-  bool wasFoundInValue = false;
-  for (int i = 0; i < value->owners_size; i++) {
-    if (value->owners[i] == val) {
-      wasFoundInValue = true;
-    }
-  }
-  EXPECT_TRUE(wasFoundInValue);
-
-  bool wasFoundInLock = false;
-  for (int i = 0; i < lock->owners_size; i++) {
-    if (lock->owners[i] == val) {
-      wasFoundInLock = true;
-    }
-  }
-  EXPECT_TRUE(wasFoundInLock);
+  getExclusiveAccess(lock, val);
+  insert(hashTable, 42);
+
+  Lock* value = get(hashTable, 32);
+  EXPECT_EQ(value, lock);
+  EXPECT_TRUE(isHeldExclusively(value));
+  EXPECT_EQ(numOwners(value), 1);
+  EXPECT_TRUE(isOwner(value, val));
 };
 
 TEST(HashTableTest, getElementNotFound) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  insert(hashTable, 12);
+  insert(hashTable, 22);
+  insert(hashTable, 42);
 
-  Lock* value = (Lock*)get(hashTable, 32);
+  Lock* value = get(hashTable, 32);
   EXPECT_EQ(value, nullptr);
 };
 
-TEST(HashTableTest, setWhenKeyAlreadyExists) {
-  HashTable* hashTable = newHashTable(10);
-  Lock* lock = newLock();
-  lock->exclusive = true;
-  lock->owners = new int[1];
-  lock->owners_size = 1;
-  const int val = 4;
-  lock->owners[0] = val;
-
-  Lock* anotherLock = new Lock();
-  anotherLock->exclusive = false;
+// Looks up more keys than one batch, hits and misses mixed, in long buckets
+TEST(HashTableTest, getManyFindsHitsAndMisses) {
+  HashTable<int, int>* hashTable = newHashTable<int, int>(10);
+  for (int key = 0; key < 1000; key += 2) {
+    *insert(hashTable, key) = key;
+  }
 
-  set(hashTable, 32, (void*)lock);
-  // Because lock for that key already exists, it should ignore this set
-  // function call!
-  set(hashTable, 32, (void*)anotherLock);
+  const int numKeys = 3 * kLookupBatchSize + 1;
+  int keys[numKeys];
+  for (int i = 0; i < numKeys; i++) {
+    keys[i] = i * 37 % 1200;
+  }
+  int* values[numKeys];
+  getMany(hashTable, keys, numKeys, values);
+
+  for (int i = 0; i < numKeys; i++) {
+    if (keys[i] % 2 == 0 && keys[i] < 1000) {
+      ASSERT_NE(values[i], nullptr);
+      EXPECT_EQ(*values[i], keys[i]);
+    } else {
+      EXPECT_EQ(values[i], nullptr);
+    }
+  }
+  deleteHashTable(hashTable);
+};
 
-  Lock* value = (Lock*)get(hashTable, 32);
-  EXPECT_EQ(value->exclusive, lock->exclusive);
-  EXPECT_EQ(value->owners_size, lock->owners_size);
+TEST(HashTableTest, setWhenKeyAlreadyExists) {
+  LockTable* hashTable = newHashTable<int, Lock>(10);
+  Lock* lock = insert(hashTable, 32);
+  getExclusiveAccess(lock, 4);
+
+  // Because lock for that key already exists, it should return the existing
+  // lock unchanged!
+  Lock* anotherLock = insert(hashTable, 32);
+  EXPECT_EQ(anotherLock, lock);
+
+  Lock* value = get(hashTable, 32);
+  EXPECT_TRUE(isHeldExclusively(value));
+  EXPECT_EQ(numOwners(value), 1);
 };
 
 TEST(HashTableTest, containsListEmpty) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
   EXPECT_FALSE(contains(hashTable, 32));
 };
 
 TEST(HashTableTest, containsTrue) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  insert(hashTable, 12);
+  insert(hashTable, 22);
+  insert(hashTable, 42);
 
   EXPECT_TRUE(contains(hashTable, 22));
 };
 
 TEST(HashTableTest, containsFalse) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  insert(hashTable, 12);
+  insert(hashTable, 22);
+  insert(hashTable, 42);
 
   EXPECT_FALSE(contains(hashTable, 32));
 };
 
 TEST(HashTableTest, removeEmptyList) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
   // Nothing happens
   remove(hashTable, 10);
 };
 
 TEST(HashTableTest, removeEndOfList) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 32, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  insert(hashTable, 12);
+  insert(hashTable, 22);
+  insert(hashTable, 32);
+  insert(hashTable, 42);
 
   EXPECT_TRUE(contains(hashTable, 12));
   EXPECT_TRUE(contains(hashTable, 22));
@@ -130,20 +130,20 @@ TEST(HashTableTest, removeEndOfList) {
 };
 
 TEST(HashTableTest, removeListJustHasOneElement) {
-  HashTable* hashTable = newHashTable(10);
-  set(hashTable, 12, (void*)newLock());
+  LockTable* hashTable = newHashTable<int, Lock>(10);
+  insert(hashTable, 12);
   EXPECT_TRUE(contains(hashTable, 12));
   remove(hashTable, 12);
   EXPECT_FALSE(contains(hashTable, 12));
 }
 
 TEST(HashTableTest, removeBeginningOfList) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 32, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  insert(hashTable, 12);
+  insert(hashTable, 22);
+  insert(hashTable, 32);
+  insert(hashTable, 42);
 
   EXPECT_TRUE(contains(hashTable, 12));
   EXPECT_TRUE(contains(hashTable, 22));
@@ -159,12 +159,12 @@ TEST(HashTableTest, removeBeginningOfList) {
 };
 
 TEST(HashTableTest, removeMiddleOfList) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 32, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  insert(hashTable, 12);
+  insert(hashTable, 22);
+  insert(hashTable, 32);
+  insert(hashTable, 42);
 
   EXPECT_TRUE(contains(hashTable, 12));
   EXPECT_TRUE(contains(hashTable, 22));
@@ -180,11 +180,11 @@ TEST(HashTableTest, removeMiddleOfList) {
 };
 
 TEST(HashTableTest, removeElementNotFound) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  insert(hashTable, 12);
+  insert(hashTable, 22);
+  insert(hashTable, 42);
 
   EXPECT_TRUE(contains(hashTable, 12));
   EXPECT_TRUE(contains(hashTable, 22));
@@ -200,38 +200,155 @@ TEST(HashTableTest, removeElementNotFound) {
 };
 
 TEST(HashTableTest, changeValue) {
-  HashTable* hashTable = newHashTable(10);
-  Lock* lock = newLock();
-  lock->exclusive = true;
-  lock->owners = new int[1];
-  const int val = 1;
-  lock->owners[0] = val;
-
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 32, (void*)lock);
-  set(hashTable, 42, (void*)newLock());
+  LockTable* hashTable = newHashTable<int, Lock>(10);
+  insert(hashTable, 12);
+  insert(hashTable, 22);
+  Lock* lock = insert(hashTable, 32);
+  getExclusiveAccess(lock, 1);
+  insert(hashTable, 42);
 
   // Change value
-  lock->owners = new int[2];
-  lock->owners_size = 2;
-  lock->owners[0] = 1;
-  lock->owners[1] = 2;
-  lock->exclusive = false;
+  release(lock, 1);
+  getSharedAccess(lock, 1);
+  getSharedAccess(lock, 2);
 
   // Check that the values also changed within the table
-  Lock* value = (Lock*)get(hashTable, 32);
-  EXPECT_EQ(value->owners_size, 2);
-  EXPECT_EQ(value->exclusive, false);
+  Lock* value = get(hashTable, 32);
+  EXPECT_EQ(numOwners(value), 2);
+  EXPECT_FALSE(isHeldExclusively(value));
 };
 
 TEST(HashTableTest, keyBiggerThanSize) {
-  HashTable* hashTable = newHashTable(2);
-  set(hashTable, 1, (void*)newLock());
-  set(hashTable, 2, (void*)newLock());
-  set(hashTable, 3, (void*)newLock());
+  LockTable* hashTable = newHashTable<int, Lock>(2);
+  insert(hashTable, 1);
+  insert(hashTable, 2);
+  insert(hashTable, 3);
 
   EXPECT_TRUE(get(hashTable, 1) != nullptr);
   EXPECT_TRUE(get(hashTable, 2) != nullptr);
   EXPECT_TRUE(get(hashTable, 3) != nullptr);
-}
\ No newline at end of file
+}
+
+TEST(HashTableTest, manyKeysPerBucket) {
+  auto hashTable = newHashTable<int, int>(10);
+  const int numKeys = 10000;
+
+  for (int key = 0; key < numKeys; key++) {
+    *insert(hashTable, key) = key * 3;
+  }
+  for (int key = 0; key < numKeys; key++) {
+    EXPECT_EQ(*get(hashTable, key), key * 3);
+  }
+
+  // Removing keys must not make the remaining keys of the bucket unreachable
+  for (int key = 0; key < numKeys; key += 2) {
+    remove(hashTable, key);
+  }
+  for (int key = 0; key < numKeys; key++) {
+    if (key % 2 == 0) {
+      EXPECT_FALSE(contains(hashTable, key));
+    } else {
+      EXPECT_EQ(*get(hashTable, key), key * 3);
+    }
+  }
+
+  deleteHashTable(hashTable);
+};
+
+// Values are stored inline, but must not move while the table grows
+TEST(HashTableTest, valuesStayInPlace) {
+  auto hashTable = newHashTable<int, int>(10);
+  const int numKeys = 1000;
+  int** values = new int*[numKeys];
+
+  for (int key = 0; key < numKeys; key++) {
+    values[key] = insert(hashTable, key);
+    *values[key] = key;
+  }
+  for (int key = 0; key < numKeys; key += 2) {
+    remove(hashTable, key);
+  }
+  for (int key = 1; key < numKeys; key += 2) {
+    EXPECT_EQ(get(hashTable, key), values[key]);
+    EXPECT_EQ(*values[key], key);
+  }
+
+  Node<int>* node = extract(hashTable, 1);
+  EXPECT_EQ(&node->value, values[1]);
+  EXPECT_FALSE(contains(hashTable, 1));
+  poolDelete(node);
+
+  deleteHashTable(hashTable);
+  delete[] values;
+};
+
+// The bucket statistics account for every entry of the table
+TEST(HashTableTest, countsEntriesPerBucket) {
+  auto hashTable = newHashTable<int, int>(10);
+  const int numKeys = 1000;
+  for (int key = 0; key < numKeys; key++) {
+    insert(hashTable, key);
+  }
+
+  BucketStatistics statistics = bucketStatistics(hashTable);
+  EXPECT_EQ(statistics.entries, numKeys);
+  unsigned long buckets = 0;
+  for (int length = 0; length < BUCKET_HISTOGRAM_SIZE; length++) {
+    buckets += statistics.histogram[length];
+  }
+  EXPECT_EQ(buckets, statistics.buckets);
+  EXPECT_GE(statistics.max_length, meanBucketLength(&statistics));
+  EXPECT_GE(meanBucketLength(&statistics), 1);
+
+  for (int key = 0; key < numKeys; key += 2) {
+    remove(hashTable, key);
+  }
+  EXPECT_EQ(bucketStatistics(hashTable).entries, numKeys / 2);
+
+  deleteHashTable(hashTable);
+};
+
+TEST(HashTableTest, hashStaysWithinTable) {
+  const int size = 10;
+  for (int key = 0; key < 100000; key += 7) {
+    EXPECT_GE(hash(size, key), 0);
+    EXPECT_LT(hash(size, key), size);
+  }
+  EXPECT_LT(hash(size, 2147483647), size);
+};
+
+#ifndef FLAT_HASHTABLE
+TEST(HashTableTest, growsOnlyTheFullBucketGroup) {
+  auto hashTable = newHashTable<int, int>(10);
+  const int numKeys = 1000;
+
+  // All keys belong to bucket group 3
+  int* keys = new int[numKeys];
+  for (int i = 0, key = 0; i < numKeys; key++) {
+    if (hash(10, key) == 3) {
+      keys[i++] = key;
+    }
+  }
+  for (int i = 0; i < numKeys; i++) {
+    *insert(hashTable, keys[i]) = i;
+  }
+
+  BucketGroup* group = &hashTable->groups[3];
+  EXPECT_EQ(group->count, numKeys);
+  EXPECT_LE(group->count,
+            kMaxLoadFactor * ((1 << group->level) + group->split));
+  for (int i = 0; i < 10; i++) {
+    if (i != 3) {
+      EXPECT_EQ(hashTable->groups[i].level, 0);
+      EXPECT_EQ(hashTable->groups[i].split, 0);
+      EXPECT_EQ(hashTable->groups[i].segments, nullptr);
+    }
+  }
+  for (int i = 0; i < numKeys; i++) {
+    EXPECT_EQ(*get(hashTable, keys[i]), i);
+  }
+
+  deleteHashTable(hashTable);
+  delete[] keys;
+};
+#endif
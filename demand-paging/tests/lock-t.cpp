@@ -1,11 +1,13 @@
 #include <gtest/gtest.h>
 
+#include <mutex>
 #include <thread>
 
 #include "lock.h"
 
 const unsigned int kTransactionIdA = 0;
 const unsigned int kTransactionIdB = 1;
+const unsigned int kTransactionIdC = 2;
 
 // Shared access works
 TEST(LockTest, sharedAccess) {
@@ -15,25 +17,17 @@ TEST(LockTest, sharedAccess) {
   getSharedAccess(lock, 3);
   getSharedAccess(lock, 4);
 
-  EXPECT_FALSE(lock->exclusive);
-  EXPECT_EQ(lock->owners_size, 4);
+  EXPECT_FALSE(isHeldExclusively(lock));
+  EXPECT_EQ(numOwners(lock), 4);
 };
 
 // Exclusive access works
 TEST(LockTest, exclusiveAccess) {
   Lock* lock = newLock();
   getExclusiveAccess(lock, kTransactionIdA);
-  EXPECT_TRUE(lock->exclusive);
-  EXPECT_EQ(lock->owners_size, 1);
-
-  bool containsId = false;
-  for (int i = 0; i < lock->owners_size; i++) {
-    if (lock->owners[i] == kTransactionIdA) {
-      containsId = true;
-    }
-  }
-
-  EXPECT_TRUE(containsId);
+  EXPECT_TRUE(isHeldExclusively(lock));
+  EXPECT_EQ(numOwners(lock), 1);
+  EXPECT_TRUE(isOwner(lock, kTransactionIdA));
 }
 
 // Cannot acquire shared access on an exclusive lock
@@ -62,17 +56,29 @@ TEST(LockTest, upgrade) {
   Lock* lock = newLock();
   EXPECT_TRUE(getSharedAccess(lock, kTransactionIdA));
   EXPECT_TRUE(upgrade(lock, kTransactionIdA));
-  EXPECT_TRUE(lock->exclusive);
-  EXPECT_EQ(lock->owners_size, 1);
-
-  bool containsId = false;
-  for (int i = 0; i < lock->owners_size; i++) {
-    if (lock->owners[i] == kTransactionIdA) {
-      containsId = true;
-    }
-  }
+  EXPECT_TRUE(isHeldExclusively(lock));
+  EXPECT_EQ(numOwners(lock), 1);
+  EXPECT_TRUE(isOwner(lock, kTransactionIdA));
+}
 
-  EXPECT_TRUE(containsId);
+// U is compatible with shared owners only and converts to X once they left
+TEST(LockTest, updateAccess) {
+  Lock* lock = newLock();
+  EXPECT_TRUE(getSharedAccess(lock, kTransactionIdA));
+  EXPECT_TRUE(getUpdateAccess(lock, kTransactionIdB));
+  EXPECT_FALSE(getUpdateAccess(lock, kTransactionIdC));
+  EXPECT_TRUE(getSharedAccess(lock, kTransactionIdC));
+  EXPECT_TRUE(isUpdater(lock, kTransactionIdB));
+
+  // Releasing a shared owner keeps the updater
+  release(lock, kTransactionIdC);
+  EXPECT_FALSE(upgrade(lock, kTransactionIdB));
+  release(lock, kTransactionIdA);
+  EXPECT_TRUE(isUpdater(lock, kTransactionIdB));
+  EXPECT_TRUE(upgrade(lock, kTransactionIdB));
+  EXPECT_TRUE(isHeldExclusively(lock));
+  EXPECT_FALSE(isUpdater(lock, kTransactionIdB));
+  deleteLock(lock);
 }
 
 TEST(LockTest, releaseUnownedLock) {
@@ -81,15 +87,64 @@ TEST(LockTest, releaseUnownedLock) {
   // B tries to release the lock of A
   release(lock, kTransactionIdB);
   // This has no effect, A still owns the lock
-  EXPECT_TRUE(lock->exclusive);
-  EXPECT_EQ(lock->owners_size, 1);
+  EXPECT_TRUE(isHeldExclusively(lock));
+  EXPECT_EQ(numOwners(lock), 1);
+  EXPECT_TRUE(isOwner(lock, kTransactionIdA));
+}
 
-  bool containsId = false;
-  for (int i = 0; i < lock->owners_size; i++) {
-    if (lock->owners[i] == kTransactionIdA) {
-      containsId = true;
-    }
+// A lock and its hash table entry fit into a cache line
+TEST(LockTest, isCompact) { EXPECT_LE(sizeof(Lock), 32); }
+
+// Widely shared locks keep the owners that don't fit inline in an overflow
+// array, which shrinks again when they release the lock
+TEST(LockTest, manySharedOwners) {
+  Lock* lock = newLock();
+  const int numTransactions = 10 * kInlineOwners;
+  for (int i = 0; i < numTransactions; i++) {
+    EXPECT_TRUE(getSharedAccess(lock, i));
+  }
+  EXPECT_EQ(numOwners(lock), numTransactions);
+  EXPECT_NE(lock->overflow, nullptr);
+  EXPECT_FALSE(getExclusiveAccess(lock, numTransactions));
+
+  for (int i = 0; i < numTransactions; i += 2) {
+    release(lock, i);
+  }
+  EXPECT_EQ(numOwners(lock), numTransactions / 2);
+  for (int i = 0; i < numTransactions; i++) {
+    EXPECT_EQ(isOwner(lock, i), i % 2 == 1);
   }
 
-  EXPECT_TRUE(containsId);
-}
\ No newline at end of file
+  for (int i = 1; i < numTransactions; i += 2) {
+    release(lock, i);
+  }
+  EXPECT_EQ(numOwners(lock), 0);
+  EXPECT_EQ(lock->overflow, nullptr);
+  EXPECT_TRUE(getExclusiveAccess(lock, numTransactions));
+  deleteLock(lock);
+}
+
+// Threads that serialize their shared acquisitions, like the workers of the
+// lock manager, see the owners added by each other
+TEST(LockTest, concurrentSharedAccess) {
+  for (int repetition = 0; repetition < 100; repetition++) {
+    Lock* lock = newLock();
+    std::mutex mutex;
+    std::thread threads[kInlineOwners];
+    for (int i = 0; i < kInlineOwners; i++) {
+      threads[i] = std::thread([lock, &mutex, i] {
+        std::lock_guard<std::mutex> guard(mutex);
+        getSharedAccess(lock, i);
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    EXPECT_EQ(numOwners(lock), kInlineOwners);
+    for (int i = 0; i < kInlineOwners; i++) {
+      EXPECT_TRUE(isOwner(lock, i));
+    }
+    deleteLock(lock);
+  }
+}
@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <thread>
+
+#include "granule.h"
 #include "lock.h"
 #include "lockmanager.h"
 
@@ -20,6 +23,23 @@ TEST_F(LockManagerTest, lockRequestAbortsWhenTransactionNotRegistered) {
   EXPECT_FALSE(lock_manager.lock(kTransactionIdA, kRowId, false).second);
 };
 
+// IDs beyond kMaxGranuleId would alias with the keys of other granules
+TEST_F(LockManagerTest, rejectsIdsBeyondKeyRange) {
+  LockManager lock_manager = LockManager();
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB, kLockBudget));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, true).second);
+  EXPECT_FALSE(
+      lock_manager.lock(kTransactionIdB, kMaxGranuleId + 1 + kRowId, true)
+          .second);
+  EXPECT_FALSE(lock_manager
+                   .lockRange(kTransactionIdB, kMaxGranuleId,
+                              kMaxGranuleId + 1, false)
+                   .second);
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kMaxGranuleId, true).second);
+};
+
 // Registering an already registered transaction
 TEST_F(LockManagerTest, cannotRegisterTwice) {
   LockManager lock_manager = LockManager();
@@ -180,6 +200,101 @@ TEST_F(LockManagerTest, abortedTransactionCanRegisterAgain) {
   EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
 }
 
+// Committing releases the locks of a transaction on all workers at once and
+// ends it
+TEST_F(LockManagerTest, commitReleasesAllLocks) {
+  LockManager lock_manager = LockManager(4);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB, kLockBudget));
+  for (unsigned int rowId = kRowId; rowId < kRowId + 10; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, rowId, true).second);
+  }
+  EXPECT_TRUE(lock_manager.lockRange(kTransactionIdA, 100, 200, true).second);
+
+  EXPECT_TRUE(lock_manager.commit(kTransactionIdA));
+  EXPECT_FALSE(lock_manager.commit(kTransactionIdA));
+  for (unsigned int rowId = kRowId; rowId < kRowId + 10; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdB, rowId, true).second);
+  }
+  EXPECT_TRUE(lock_manager.lockRange(kTransactionIdB, 150, 250, true).second);
+  EXPECT_TRUE(lock_manager.abort(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+}
+
+// The parts of a range fail on several workers at once, but the transaction is
+// only aborted once
+TEST_F(LockManagerTest, rangeConflictsOnSeveralWorkers) {
+  LockManager lock_manager = LockManager(4);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB, kLockBudget));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, 100, true).second);
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, 3000, true).second);
+
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_TRUE(
+        lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+    EXPECT_FALSE(
+        lock_manager.lockRange(kTransactionIdA, 0, 4000, false).second);
+  }
+
+  // The locks of the other transaction are untouched, no range is left over
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC, kLockBudget));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdC, 3000, false).second);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, 50, true).second);
+}
+
+// Escalation only releases the row locks of the worker that escalates, and the
+// rows of the others stay locked until the commit
+TEST_F(LockManagerTest, escalationOnSeveralWorkers) {
+  LockManager lock_manager = LockManager(4, ABORT_ON_CONFLICT, 4);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB, kLockBudget));
+
+  // The rows of the table are spread over the partitions of all workers
+  const unsigned int kRowDistance = 997;
+  for (unsigned int row = 0; row < 5; row++) {
+    EXPECT_TRUE(
+        lock_manager.lock(kTransactionIdA, row * kRowDistance, false).second);
+  }
+  EscalationStatistics stats = lock_manager.getEscalationStatistics();
+  EXPECT_EQ(stats.escalations, 1);
+  EXPECT_GE(stats.escalated_rows, 1);
+  EXPECT_LE(stats.escalated_rows, 5);
+
+  EXPECT_FALSE(
+      lock_manager.lock(kTransactionIdB, 3 * kRowDistance, true).second);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB, kLockBudget));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, 100, true).second);
+  EXPECT_TRUE(lock_manager.commit(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB, kLockBudget));
+  for (unsigned int row = 0; row < 5; row++) {
+    EXPECT_TRUE(
+        lock_manager.lock(kTransactionIdB, row * kRowDistance, true).second);
+  }
+}
+
+// A batch of lock requests is sent to the enclave at once and answered in the
+// order of the requests
+TEST_F(LockManagerTest, lockBatch) {
+  LockManager lock_manager = LockManager(4);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+  std::vector<BatchedLock> batch;
+  for (unsigned int rowId = kRowId; rowId < kRowId + 10; rowId++) {
+    batch.push_back({kTransactionIdA, rowId, true});
+  }
+  // The other transaction is not registered
+  batch.push_back({kTransactionIdB, kRowId + 20, false});
+
+  auto results = lock_manager.lockBatch(batch);
+  ASSERT_EQ(results.size(), batch.size());
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(results[i].second);
+    EXPECT_TRUE(lock_manager.verify_signature_string(
+        results[i].first, kTransactionIdA, kRowId + i, true));
+  }
+  EXPECT_FALSE(results[10].second);
+}
+
 TEST_F(LockManagerTest, notWaitingForSignature) {
   LockManager lock_manager = LockManager();
   int lockBudget = 100;
@@ -191,4 +306,89 @@ TEST_F(LockManagerTest, notWaitingForSignature) {
   EXPECT_TRUE(lock_manager.lock(kTransactionIdA, lockBudget, false,
                                 true)
                   .second);  // waitung for signature return value at the end
-}
\ No newline at end of file
+}
+// An older transaction waits for a conflicting lock and gets its signature
+// once the lock is released
+TEST_F(LockManagerTest, waitingTransactionGetsSignature) {
+  LockManager lock_manager = LockManager(1, WAIT_ON_CONFLICT);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB, kLockBudget));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kRowId, true).second);
+
+  std::pair<std::string, bool> result;
+  std::thread waiter(
+      [&]() { result = lock_manager.lock(kTransactionIdA, kRowId, true); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  lock_manager.unlock(kTransactionIdB, kRowId, true);
+  waiter.join();
+
+  EXPECT_TRUE(result.second);
+  EXPECT_TRUE(lock_manager.verify_signature_string(result.first,
+                                                   kTransactionIdA, kRowId,
+                                                   true));
+}
+
+// Each worker thread owns the same number of partitions of the lock table at
+// first, and the partitions count the jobs served for their rows
+TEST_F(LockManagerTest, partitionStatistics) {
+  LockManager lock_manager = LockManager(4);
+  auto before = lock_manager.getPartitionStatistics();
+  ASSERT_EQ(before.size(), (size_t)(4 * kPartitionsPerWorker));
+  for (int i = 0; i < (int)before.size(); i++) {
+    EXPECT_EQ(before[i].owner, i / kPartitionsPerWorker);
+    EXPECT_EQ(before[i].served, 0UL);
+  }
+
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+  for (unsigned int rowId = kRowId; rowId < kRowId + 10; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, rowId, false).second);
+  }
+  // The workers count a job after serving it, and serve the parts of the
+  // commit after the lock requests
+  EXPECT_TRUE(lock_manager.commit(kTransactionIdA));
+  unsigned long served = 0;
+  for (const auto &partition : lock_manager.getPartitionStatistics()) {
+    EXPECT_GE(partition.owner, 0);
+    EXPECT_LT(partition.owner, 4);
+    served += partition.served;
+  }
+  EXPECT_GE(served, 10UL);
+}
+
+// A worker with a backlog hands partitions over to an idle worker, which still
+// detects conflicts on the rows of the partitions it took over
+TEST_F(LockManagerTest, busyWorkerMigratesPartitions) {
+  LockManager lock_manager = LockManager(4);
+  const unsigned int kHotRows = 2500;       // rows of the first worker
+  const unsigned int kProbeDistance = 100;  // less than a partition
+  const unsigned int kMaxRounds = 100;
+  auto migrations = [&lock_manager]() {
+    unsigned long total = 0;
+    for (const auto &partition : lock_manager.getPartitionStatistics()) {
+      total += partition.migrations;
+    }
+    return total;
+  };
+  for (unsigned int round = 0; round < kMaxRounds && migrations() == 0;
+       round++) {
+    unsigned int transactionId = kTransactionIdC + 1 + round;
+    EXPECT_TRUE(lock_manager.registerTransaction(transactionId, kHotRows));
+    for (unsigned int rowId = 0; rowId < kHotRows; rowId++) {
+      lock_manager.lock(transactionId, rowId, false, false);
+    }
+    EXPECT_TRUE(lock_manager.commit(transactionId));
+  }
+  EXPECT_GT(migrations(), 0UL);
+
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kHotRows));
+  for (unsigned int rowId = 0; rowId < kHotRows; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, rowId, true).second);
+  }
+  // Each partition of the first worker is probed, including the migrated ones
+  for (unsigned int rowId = 0; rowId < kHotRows; rowId += kProbeDistance) {
+    unsigned int transactionId = kTransactionIdC + kMaxRounds + 1 + rowId;
+    EXPECT_TRUE(lock_manager.registerTransaction(transactionId, kLockBudget));
+    EXPECT_FALSE(lock_manager.lock(transactionId, rowId, false).second);
+  }
+  EXPECT_TRUE(lock_manager.commit(kTransactionIdA));
+}
@@ -23,14 +23,9 @@ void RunClient() {
   client.requestSharedLock(transactionA, lockBudget - 1, true);
   client.requestSharedLock(transactionB, lockBudget - 1, true);
 
-  // Both release the locks again
-  for (int rowId = 1; rowId < lockBudget - 1; rowId++) {
-    client.requestUnlock(transactionA, rowId, false);
-    client.requestUnlock(transactionB, rowId, false);
-  }
-
-  client.requestUnlock(transactionA, lockBudget - 1, false);
-  client.requestUnlock(transactionB, lockBudget - 1, true);
+  // Both release the locks again, each with a single request
+  client.requestCommit(transactionA);
+  client.requestCommit(transactionB);
 }
 
 auto main() -> int {
@@ -0,0 +1,125 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lockmanager.h"
+
+using std::ofstream;
+using std::string;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::high_resolution_clock;
+using std::chrono::nanoseconds;
+
+const int repetitions = 3;
+const int numWorkerThreads = 4;
+const int numClients = 16;  // each client runs one transaction at a time
+const int transactionsPerClient = 500;  // committed by each client
+const int locksPerTransaction = 4;      // every second one exclusive
+const vector<int> numHotRows = {16, 64, 256, 1024};
+const vector<ConflictPolicy> policies = {ABORT_ON_CONFLICT, WAIT_ON_CONFLICT};
+
+/**
+ * Writes the data all in one into a CSV file
+ * @param filename the name of the csv file
+ * @param values the outer vector contains the rows and the inner vector
+ * resembles a row with its column values
+ */
+void writeToCSV(string filename, vector<vector<long>> values) {
+  ofstream file;
+  file.open(filename + ".csv", std::ios_base::app);
+
+  for (const auto& row : values) {
+    for (int i = 0; i < row.size() - 1; i++) {
+      file << row[i] << ",";
+    }
+    file << row[row.size() - 1];
+    file << std::endl;
+  }
+  file.close();
+}
+
+/**
+ * All clients concurrently run transactions that lock a few of the hot rows
+ * and release them again. An aborted transaction is retried with the same ID
+ * until it commits, so it keeps its age under wait-die.
+ *
+ * @param aborts receives the number of aborted attempts
+ * @returns the duration in nanoseconds until all transactions committed
+ */
+auto experiment(ConflictPolicy policy, int hotRows, long& aborts) -> long {
+  LockManager lockManager(numWorkerThreads, PARTITIONED, policy);
+  std::atomic<long> numAborts = 0;
+
+  //=========== TIME MEASUREMENT ================
+  auto begin = high_resolution_clock::now();
+  vector<std::thread> clients;
+  for (int client = 0; client < numClients; client++) {
+    clients.emplace_back([&lockManager, &numAborts, client, hotRows]() {
+      std::mt19937 generator(client);
+      std::uniform_int_distribution<int> row(0, hotRows - 1);
+      for (int i = 0; i < transactionsPerClient; i++) {
+        // Older transactions have smaller IDs
+        unsigned int transactionId = i * numClients + client + 1;
+        int firstRow = row(generator);
+        int numLocked = 0;
+        while (numLocked < locksPerTransaction) {
+          if (numLocked == 0) {
+            lockManager.registerTransaction(transactionId);
+          }
+          unsigned int rowId = (firstRow + numLocked) % hotRows;
+          if (lockManager.lock(transactionId, rowId, numLocked % 2 == 1)) {
+            numLocked++;
+          } else {
+            // The lock manager released the locks of the transaction
+            numAborts++;
+            numLocked = 0;
+          }
+        }
+        for (int j = 0; j < locksPerTransaction; j++) {
+          lockManager.unlock(transactionId, (firstRow + j) % hotRows,
+                             j == locksPerTransaction - 1);
+        }
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+  auto end = high_resolution_clock::now();
+  //=============================================
+
+  aborts = numAborts;
+  return duration_cast<nanoseconds>(end - begin).count();
+}
+
+/**
+ * Compares failing conflicting lock requests right away with letting them
+ * wait in the queue of the lock, for a shrinking number of hot rows. Each row
+ * of the CSV file contains the policy (0 = abort, 1 = wait), the number of hot
+ * rows, the number of committed transactions, the number of aborted attempts
+ * and the duration in nanoseconds.
+ */
+auto main() -> int {
+  spdlog::set_level(spdlog::level::off);
+
+  vector<vector<long>> contentCSVFile;
+  for (int hotRows : numHotRows) {
+    for (ConflictPolicy policy : policies) {
+      for (int i = 0; i < repetitions; i++) {
+        long aborts;
+        long duration = experiment(policy, hotRows, aborts);
+        contentCSVFile.push_back({policy, hotRows,
+                                  numClients * transactionsPerClient, aborts,
+                                  duration});
+      }
+    }
+  }
+
+  writeToCSV("contention_out", contentCSVFile);
+  return 0;
+}
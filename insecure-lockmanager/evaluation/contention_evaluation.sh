@@ -0,0 +1,16 @@
+echo "Starting contention evaluation..."
+
+# Delete old output file
+output_file=contention_out.csv
+if [ -f "$output_file" ]; then
+    rm $output_file
+fi
+
+# Compile the project in release mode
+cmake -DCMAKE_BUILD_TYPE=Release -S .. -B ../build >/dev/null
+cmake --build ../build --target contention_benchmark >/dev/null
+
+# Start the benchmarking
+./../build/evaluation/contention_benchmark
+
+echo "Finished contention experiment"
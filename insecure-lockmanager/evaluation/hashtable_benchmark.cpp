@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hashtable.h"
+#include "lock.h"
+
+using std::ofstream;
+using std::string;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::high_resolution_clock;
+using std::chrono::nanoseconds;
+
+const size_t bigger_than_cachesize =
+    20 * 1024 * 1024;  // Checked cache size with command 'lscpu | grep cache'
+long* p = new long[bigger_than_cachesize];
+
+// Same size as the lock table of the lock manager
+const int lockTableSize = 10000;
+const int repetitions = 3;
+const vector<int> numLocks = {10,     100,    500,    1000,   2500,
+                              5000,   10000,  20000,  50000,  100000,
+                              150000, 200000, 300000, 500000, 700000};
+
+#ifdef FLAT_HASHTABLE
+const long implementation = 1;  // open-addressing buckets
+#else
+const long implementation = 0;  // chained buckets
+#endif
+
+#if defined(FIBONACCI_HASH)
+const long hashFunction = 1;
+#elif defined(MIX64_HASH)
+const long hashFunction = 2;
+#else
+const long hashFunction = 0;  // modulo
+#endif
+
+/**
+ * Patterns of RIDs that the keys are drawn from. Each workload maps the i-th
+ * key to a RID, so that the keys i >= numLocks can be looked up as misses.
+ */
+const vector<string> workloadNames = {"sequential", "strided", "clustered"};
+const vector<int (*)(int)> workloads = {
+    // Consecutive rows, e.g. a table scan
+    [](int i) { return i + 1; },
+    // Every 64th row, e.g. one row per page
+    [](int i) { return (i + 1) * 64; },
+    // Runs of 16 consecutive rows, 4096 rows apart
+    [](int i) { return (i / 16) * 4096 + i % 16 + 1; }};
+
+void flushCache() {
+  for (int i = 0; i < bigger_than_cachesize; i++) {
+    p[i] = rand();
+  }
+}
+
+/**
+ * Writes the data all in one into a CSV file
+ * @param filename the name of the csv file
+ * @param values the outer vector contains the rows and the inner vector
+ * resembles a row with its column values
+ */
+void writeToCSV(string filename, vector<vector<long>> values) {
+  ofstream file;
+  file.open(filename + ".csv", std::ios_base::app);
+
+  for (const auto& row : values) {
+    for (int i = 0; i < row.size() - 1; i++) {
+      file << row[i] << ",";
+    }
+    file << row[row.size() - 1];
+    file << std::endl;
+  }
+  file.close();
+}
+
+/**
+ * Measures the time it takes to execute the given operation once for every
+ * key.
+ *
+ * @returns the average duration of a single operation in nanoseconds
+ */
+template <typename Operation>
+auto measure(const vector<int>& keys, Operation operation) -> long {
+  flushCache();
+  auto begin = high_resolution_clock::now();
+  for (int key : keys) {
+    operation(key);
+  }
+  auto end = high_resolution_clock::now();
+  return duration_cast<nanoseconds>(end - begin).count() / keys.size();
+}
+
+/**
+ * Measures the time it takes to look up all keys with getMany(), in batches of
+ * kLookupBatchSize keys.
+ *
+ * @returns the average duration of a single lookup in nanoseconds
+ */
+auto measureGetMany(LockTable* hashTable, const vector<int>& keys) -> long {
+  Lock* locks[kLookupBatchSize];
+  volatile bool exclusive;
+  flushCache();
+  auto begin = high_resolution_clock::now();
+  for (int first = 0; first < keys.size(); first += kLookupBatchSize) {
+    int n = std::min(kLookupBatchSize, (int)keys.size() - first);
+    getMany(hashTable, &keys[first], n, locks);
+    for (int i = 0; i < n; i++) {
+      exclusive = isHeldExclusively(locks[i]);
+    }
+  }
+  auto end = high_resolution_clock::now();
+  return duration_cast<nanoseconds>(end - begin).count() / keys.size();
+}
+
+/**
+ * Microbenchmark of the hash table that backs the lock table, without any of
+ * the lock manager's threading around it. For each workload and number of
+ * locks, the keys are inserted in a random order, then looked up again one by
+ * one and in batches with getMany() (hits, which also read the lock), then
+ * keys that are not in the table are looked up (misses) and finally all keys
+ * are removed. Each row of the CSV file contains the implementation (0 =
+ * chained, 1 = open-addressing), the hash function (0 = modulo, 1 =
+ * fibonacci, 2 = mix64), the workload, the number of locks, the average
+ * duration of set, get (hit), get (miss), remove and getMany (hit) in
+ * nanoseconds and the number of entries of the longest bucket. The maximum and mean bucket
+ * length of each workload are also printed.
+ */
+auto main() -> int {
+  vector<vector<long>> contentCSVFile;
+  std::mt19937 generator(42);
+
+  for (long workload = 0; workload < workloads.size(); workload++) {
+    for (int locks : numLocks) {
+      vector<int> keys(locks);
+      vector<int> missingKeys(locks);
+      for (int i = 0; i < locks; i++) {
+        keys[i] = workloads[workload](i);
+        missingKeys[i] = workloads[workload](locks + i);
+      }
+
+      for (int i = 0; i < repetitions; i++) {
+        std::shuffle(keys.begin(), keys.end(), generator);
+        LockTable* hashTable = newHashTable<int, Lock>(lockTableSize);
+        Lock* volatile sink;
+        volatile bool exclusive;
+
+        long setTime =
+            measure(keys, [&](int key) { initLock(insert(hashTable, key)); });
+        long hitTime = measure(keys, [&](int key) {
+          exclusive = isHeldExclusively(get(hashTable, key));
+        });
+        long hitManyTime = measureGetMany(hashTable, keys);
+        long missTime =
+            measure(missingKeys, [&](int key) { sink = get(hashTable, key); });
+
+        BucketStatistics buckets = bucketStatistics(hashTable);
+        if (i == 0) {
+          std::cout << workloadNames[workload] << ", " << locks
+                    << " locks: max chain length " << buckets.max_length
+                    << ", mean chain length " << meanBucketLength(&buckets)
+                    << std::endl;
+        }
+
+        long removeTime =
+            measure(keys, [&](int key) { remove(hashTable, key); });
+
+        contentCSVFile.push_back({implementation, hashFunction, workload, locks,
+                                  setTime, hitTime, missTime, removeTime,
+                                  hitManyTime, (long)buckets.max_length});
+        deleteHashTable(hashTable);
+      }
+    }
+  }
+
+  writeToCSV("hashtable_out", contentCSVFile);
+  return 0;
+}
@@ -0,0 +1,28 @@
+implementations=(OFF ON)  # chained buckets, open-addressing buckets
+hash_functions=(modulo fibonacci mix64)
+
+echo "Starting hash table evaluation..."
+
+# Delete old output file
+output_file=hashtable_out.csv
+if [ -f "$output_file" ]; then
+    rm $output_file
+fi
+
+for flat in ${implementations[*]}
+do
+  for hash_function in ${hash_functions[*]}
+  do
+    build=../build-hashtable-${flat}-${hash_function}
+
+    # Compile the project in release mode with the selected hash table and
+    # hash function
+    cmake -DCMAKE_BUILD_TYPE=Release -DWITH_FLAT_HASHTABLE=${flat} -DHASH_FUNCTION=${hash_function} -S .. -B ${build} >/dev/null
+    cmake --build ${build} --target hashtable_benchmark >/dev/null
+
+    # Start the benchmarking
+    ./${build}/evaluation/hashtable_benchmark
+
+    echo "Finished experiment with WITH_FLAT_HASHTABLE=${flat} and HASH_FUNCTION=${hash_function}"
+  done
+done
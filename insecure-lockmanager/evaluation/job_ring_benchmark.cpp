@@ -0,0 +1,202 @@
+#include <pthread.h>
+
+#include <chrono>
+#include <fstream>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "job_ring.h"
+
+using std::ofstream;
+using std::string;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::high_resolution_clock;
+using std::chrono::nanoseconds;
+
+const int repetitions = 3;
+const int jobsPerProducer = 100000;
+const vector<int> numProducers = {1, 2, 4, 8, 16};
+
+// Maximum number of jobs the consumer takes at once, like a worker thread
+const int batchSize = 16;
+
+/**
+ * The job queue of a worker thread before the rings: a queue guarded by a
+ * mutex, with a condition variable that is signalled for every job
+ */
+struct MutexQueue {
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+  std::queue<Job> jobs;
+
+  void push(const Job& job) {
+    pthread_mutex_lock(&mutex);
+    jobs.push(job);
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+  }
+
+  auto pop(Job* buffer) -> int {
+    pthread_mutex_lock(&mutex);
+    while (jobs.empty()) {
+      pthread_cond_wait(&cond, &mutex);
+    }
+    int numJobs = 0;
+    while (numJobs < batchSize && !jobs.empty()) {
+      buffer[numJobs++] = jobs.front();
+      jobs.pop();
+    }
+    pthread_mutex_unlock(&mutex);
+    return numJobs;
+  }
+};
+
+/**
+ * A ring with the same spin-then-sleep consumer as the worker threads of the
+ * lock manager
+ */
+struct RingQueue {
+  JobRing ring;
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+  RingQueue() { initJobRing(&ring); }
+  ~RingQueue() { destroyJobRing(&ring); }
+
+  void push(const Job& job) {
+    if (pushJob(&ring, job)) {
+      pthread_mutex_lock(&mutex);
+      pthread_cond_signal(&cond);
+      pthread_mutex_unlock(&mutex);
+    }
+  }
+
+  auto pop(Job* buffer) -> int {
+    int numJobs;
+    while ((numJobs = popJobs(&ring, buffer, batchSize)) == 0) {
+      if (spinForJobs(&ring)) {
+        continue;
+      }
+      pthread_mutex_lock(&mutex);
+      if (announceSleep(&ring)) {
+        pthread_cond_wait(&cond, &mutex);
+      }
+      cancelSleep(&ring);
+      pthread_mutex_unlock(&mutex);
+    }
+    return numJobs;
+  }
+};
+
+auto now() -> long {
+  return duration_cast<nanoseconds>(
+             high_resolution_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * The producers push jobs as fast as they can, while a single consumer takes
+ * them in batches. Each job carries its producer and its index, under which
+ * the producer stored the time it pushed the job.
+ *
+ * @returns the mean duration of a push, the mean time from a push until the
+ * consumer took the job, and the duration until the consumer took all jobs,
+ * in nanoseconds
+ */
+template <typename Queue>
+auto experiment(int producers) -> vector<long> {
+  Queue queue;
+  vector<vector<long>> pushedAt(producers, vector<long>(jobsPerProducer));
+  vector<long> pushDurations(producers);
+
+  //=========== TIME MEASUREMENT ================
+  auto begin = high_resolution_clock::now();
+  vector<std::thread> threads;
+  for (int producer = 0; producer < producers; producer++) {
+    threads.emplace_back([&, producer]() {
+      long pushDuration = 0;
+      for (int i = 0; i < jobsPerProducer; i++) {
+        Job job;
+        job.command = SHARED;
+        job.transaction_id = producer;
+        job.row_id = i;
+        long start = now();
+        pushedAt[producer][i] = start;
+        queue.push(job);
+        pushDuration += now() - start;
+      }
+      pushDurations[producer] = pushDuration;
+    });
+  }
+
+  long latency = 0;
+  Job jobs[batchSize];
+  for (long taken = 0; taken < (long)producers * jobsPerProducer;) {
+    int numJobs = queue.pop(jobs);
+    long takenAt = now();
+    for (int i = 0; i < numJobs; i++) {
+      latency += takenAt - pushedAt[jobs[i].transaction_id][jobs[i].row_id];
+    }
+    taken += numJobs;
+  }
+  auto end = high_resolution_clock::now();
+  //=============================================
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  long pushDuration = 0;
+  for (long duration : pushDurations) {
+    pushDuration += duration;
+  }
+  long numJobs = (long)producers * jobsPerProducer;
+  return {pushDuration / numJobs, latency / numJobs,
+          duration_cast<nanoseconds>(end - begin).count()};
+}
+
+/**
+ * Writes the data all in one into a CSV file
+ * @param filename the name of the csv file
+ * @param values the outer vector contains the rows and the inner vector
+ * resembles a row with its column values
+ */
+void writeToCSV(string filename, vector<vector<long>> values) {
+  ofstream file;
+  file.open(filename + ".csv", std::ios_base::app);
+
+  for (const auto& row : values) {
+    for (int i = 0; i < row.size() - 1; i++) {
+      file << row[i] << ",";
+    }
+    file << row[row.size() - 1];
+    file << std::endl;
+  }
+  file.close();
+}
+
+/**
+ * Compares the lock-free rings of the worker threads with a queue guarded by
+ * a mutex and a condition variable. Each row of the CSV file contains the
+ * implementation (0 for the mutex, 1 for the ring), the number of producers,
+ * the mean enqueue latency, the mean latency until the job was dequeued and
+ * the duration of the experiment, all in nanoseconds.
+ */
+auto main() -> int {
+  vector<vector<long>> contentCSVFile;
+  for (int producers : numProducers) {
+    for (int i = 0; i < repetitions; i++) {
+      auto mutexResult = experiment<MutexQueue>(producers);
+      contentCSVFile.push_back({0, producers, mutexResult[0], mutexResult[1],
+                                mutexResult[2]});
+      auto ringResult = experiment<RingQueue>(producers);
+      contentCSVFile.push_back(
+          {1, producers, ringResult[0], ringResult[1], ringResult[2]});
+    }
+  }
+
+  writeToCSV("job_ring_out", contentCSVFile);
+  return 0;
+}
@@ -0,0 +1,16 @@
+echo "Starting job ring evaluation..."
+
+# Delete old output file
+output_file=job_ring_out.csv
+if [ -f "$output_file" ]; then
+    rm $output_file
+fi
+
+# Compile the project in release mode
+cmake -DCMAKE_BUILD_TYPE=Release -S .. -B ../build >/dev/null
+cmake --build ../build --target job_ring_benchmark >/dev/null
+
+# Start the benchmarking
+./../build/evaluation/job_ring_benchmark
+
+echo "Finished job ring experiment"
@@ -0,0 +1,94 @@
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lockmanager.h"
+
+using std::ofstream;
+using std::string;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::high_resolution_clock;
+using std::chrono::nanoseconds;
+
+const int repetitions = 3;
+const int numClients = 32;               // each client runs its own
+const int transactionsPerClient = 2000;  // transactions, one after another
+const vector<int> numWorkerThreads = {1, 2, 4, 8, 16, 32};
+
+/**
+ * Writes the data all in one into a CSV file
+ * @param filename the name of the csv file
+ * @param values the outer vector contains the rows and the inner vector
+ * resembles a row with its column values
+ */
+void writeToCSV(string filename, vector<vector<long>> values) {
+  ofstream file;
+  file.open(filename + ".csv", std::ios_base::app);
+
+  for (const auto& row : values) {
+    for (int i = 0; i < row.size() - 1; i++) {
+      file << row[i] << ",";
+    }
+    file << row[row.size() - 1];
+    file << std::endl;
+  }
+  file.close();
+}
+
+/**
+ * All clients concurrently run many short transactions, which register, lock
+ * a single row of their own and release it again, so that the transaction
+ * table keeps changing while the lock workers look up the transactions.
+ *
+ * @returns the duration in nanoseconds until all transactions finished
+ */
+auto experiment(int workers) -> long {
+  LockManager lockManager(workers);
+
+  //=========== TIME MEASUREMENT ================
+  auto begin = high_resolution_clock::now();
+  vector<std::thread> clients;
+  for (int client = 0; client < numClients; client++) {
+    clients.emplace_back([&lockManager, client]() {
+      for (int i = 0; i < transactionsPerClient; i++) {
+        unsigned int transactionId = client * transactionsPerClient + i + 1;
+        lockManager.registerTransaction(transactionId);
+        lockManager.lock(transactionId, transactionId, true);
+        lockManager.unlock(transactionId, transactionId);
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+  auto end = high_resolution_clock::now();
+  //=============================================
+
+  return duration_cast<nanoseconds>(end - begin).count();
+}
+
+/**
+ * Measures how the throughput of registering transactions scales with the
+ * number of worker threads, now that each worker owns a partition of the
+ * transaction table instead of a single thread registering all transactions.
+ * Each row of the CSV file contains the number of worker threads, the number
+ * of transactions and the duration in nanoseconds.
+ */
+auto main() -> int {
+  spdlog::set_level(spdlog::level::err);
+
+  vector<vector<long>> contentCSVFile;
+  for (int workers : numWorkerThreads) {
+    for (int i = 0; i < repetitions; i++) {
+      long duration = experiment(workers);
+      contentCSVFile.push_back(
+          {workers, numClients * transactionsPerClient, duration});
+    }
+  }
+
+  writeToCSV("registration_out", contentCSVFile);
+  return 0;
+}
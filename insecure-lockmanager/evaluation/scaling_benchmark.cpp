@@ -0,0 +1,116 @@
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lockmanager.h"
+
+using std::ofstream;
+using std::string;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::high_resolution_clock;
+using std::chrono::nanoseconds;
+
+// Same size as the lock table of the lock manager
+const int lockTableSize = 10000;
+const int repetitions = 3;
+const int numClients = 32;        // each client runs its own transaction
+const int locksPerClient = 2000;  // shared locks acquired by each client
+const vector<int> numWorkerThreads = {1, 2, 4, 8, 16, 32};
+const vector<LockTableEngine> engines = {PARTITIONED, CONCURRENT};
+
+/**
+ * Writes the data all in one into a CSV file
+ * @param filename the name of the csv file
+ * @param values the outer vector contains the rows and the inner vector
+ * resembles a row with its column values
+ */
+void writeToCSV(string filename, vector<vector<long>> values) {
+  ofstream file;
+  file.open(filename + ".csv", std::ios_base::app);
+
+  for (const auto& row : values) {
+    for (int i = 0; i < row.size() - 1; i++) {
+      file << row[i] << ",";
+    }
+    file << row[row.size() - 1];
+    file << std::endl;
+  }
+  file.close();
+}
+
+/**
+ * Returns the i-th row a client locks. The skewed workload only uses rows that
+ * fall into the partition of the first of 32 worker threads, i.e. a hot range
+ * of the lock table.
+ */
+auto rowId(int i, bool skewed) -> unsigned int {
+  if (!skewed) {
+    return i;
+  }
+  const int hotRows = lockTableSize / 32;
+  return (i / hotRows) * lockTableSize + i % hotRows;
+}
+
+/**
+ * All clients concurrently acquire shared locks on the same rows and wait for
+ * each result, like clients waiting for the signature of their locks.
+ *
+ * @returns the duration in nanoseconds until all locks were granted
+ */
+auto experiment(int workers, LockTableEngine engine, bool skewed) -> long {
+  LockManager lockManager(workers, engine);
+  for (int client = 1; client <= numClients; client++) {
+    lockManager.registerTransaction(client);
+  }
+
+  //=========== TIME MEASUREMENT ================
+  auto begin = high_resolution_clock::now();
+  vector<std::thread> clients;
+  for (int client = 1; client <= numClients; client++) {
+    clients.emplace_back([&lockManager, client, skewed]() {
+      for (int i = 0; i < locksPerClient; i++) {
+        lockManager.lock(client, rowId(i, skewed), false);
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+  auto end = high_resolution_clock::now();
+  //=============================================
+
+  return duration_cast<nanoseconds>(end - begin).count();
+}
+
+/**
+ * Compares how the throughput of the lock manager scales with the number of
+ * worker threads when rows are assigned to the worker owning their partition,
+ * which idle workers steal (PARTITIONED), and when any worker serves any row
+ * (CONCURRENT), for uniformly distributed rows
+ * and for a hot range of rows. Each row of the CSV file contains the engine
+ * (0 = partitioned, 1 = concurrent), the workload (0 = uniform, 1 = skewed),
+ * the number of worker threads, the number of lock requests and the duration
+ * in nanoseconds.
+ */
+auto main() -> int {
+  spdlog::set_level(spdlog::level::err);
+
+  vector<vector<long>> contentCSVFile;
+  for (bool skewed : {false, true}) {
+    for (LockTableEngine engine : engines) {
+      for (int workers : numWorkerThreads) {
+        for (int i = 0; i < repetitions; i++) {
+          long duration = experiment(workers, engine, skewed);
+          contentCSVFile.push_back({engine, skewed, workers,
+                                    numClients * locksPerClient, duration});
+        }
+      }
+    }
+  }
+
+  writeToCSV("scaling_out", contentCSVFile);
+  return 0;
+}
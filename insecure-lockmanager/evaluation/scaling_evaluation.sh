@@ -0,0 +1,16 @@
+echo "Starting scaling evaluation..."
+
+# Delete old output file
+output_file=scaling_out.csv
+if [ -f "$output_file" ]; then
+    rm $output_file
+fi
+
+# Compile the project in release mode
+cmake -DCMAKE_BUILD_TYPE=Release -S .. -B ../build >/dev/null
+cmake --build ../build --target scaling_benchmark >/dev/null
+
+# Start the benchmarking
+./../build/evaluation/scaling_benchmark
+
+echo "Finished scaling experiment"
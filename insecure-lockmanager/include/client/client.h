@@ -63,17 +63,86 @@ class LockingServiceClient {
   auto requestExclusiveLock(unsigned int transactionId, unsigned int rowId,
                             bool waitForSignature = true) -> bool;
 
+  /**
+   * Requests a lock on a row, a page, a table or the database. The parent
+   * granule must be locked in an intention mode before, e.g. IS on the
+   * database before S on a table for scanning it.
+   *
+   * @param transactionId identifies the transaction that makes the request
+   * @param granule the level of the granule
+   * @param id identifies the row, page or table, 0 for the database
+   * @param mode the requested mode
+   * @param waitForSignature if the request should wait for the signature return
+   * value or should immediately return
+   * @returns if the operation was successful
+   */
+  auto requestGranuleLock(unsigned int transactionId, GranuleLevel granule,
+                          unsigned int id, GranuleMode mode,
+                          bool waitForSignature = true) -> bool;
+
+  /**
+   * Requests a lock on all rows from firstRowId to lastRowId, including the
+   * ones that do not exist yet, e.g. to protect a range scan from phantoms.
+   *
+   * @param transactionId identifies the transaction that makes the request
+   * @param firstRowId first row of the range
+   * @param lastRowId last row of the range
+   * @param mode MODE_S for reading or MODE_X for writing the range
+   * @param waitForSignature if the request should wait for the signature return
+   * value or should immediately return
+   * @returns if the operation was successful
+   */
+  auto requestRangeLock(unsigned int transactionId, unsigned int firstRowId,
+                        unsigned int lastRowId, GranuleMode mode,
+                        bool waitForSignature = true) -> bool;
+
+  /**
+   * Requests to release a range lock acquired with requestRangeLock()
+   *
+   * @param transactionId identifies the transaction that makes the request
+   * @param firstRowId first row of the range
+   * @param lastRowId last row of the range
+   * @param waitForSignature if true the client waits for the operation to be
+   * finished
+   * @returns if the lock got released successfully
+   */
+  auto requestRangeUnlock(unsigned int transactionId, unsigned int firstRowId,
+                          unsigned int lastRowId, bool waitForSignature = false)
+      -> bool;
+
   /**
    * Requests to release a lock acquired by the transaction.
    *
    * @param transactionId identifies the transaction that makes the request
-   * @param rowId identifies the row, the transaction wants to unlock
+   * @param rowId identifies the row, the transaction wants to unlock, or the
+   * page or table
    * @param waitForSignature if true the client waits for the operation to be
    * finished
+   * @param granule the level of the granule, for locks acquired with
+   * requestGranuleLock()
    * @returns if the lock got released successfully
    */
   auto requestUnlock(unsigned int transactionId, unsigned int rowId,
-                     bool waitForSignature = false) -> bool;
+                     bool waitForSignature = false,
+                     GranuleLevel granule = GRANULE_ROW) -> bool;
+
+  /**
+   * Requests to release all locks of the transaction and to end it, which
+   * takes a single round trip instead of one requestUnlock() for each lock.
+   *
+   * @param transactionId identifies the transaction that commits
+   * @returns if the locks got released successfully, false if the
+   * transaction was aborted before
+   */
+  auto requestCommit(unsigned int transactionId) -> bool;
+
+  /**
+   * Requests to release all locks of the transaction and to abort it.
+   *
+   * @param transactionId identifies the transaction that aborts
+   * @returns if the locks got released successfully
+   */
+  auto requestAbort(unsigned int transactionId) -> bool;
 
  private:
   std::unique_ptr<LockingService::Stub> stub_;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+
+/*
+A thread that sends a request waits for its result on a completion, which the
+worker thread finishing the request sets. The waiting thread polls the
+completion for a while, as most requests finish within microseconds, and then
+parks on a futex, so that waiting threads do not compete with the worker
+threads for the cores. The number of polls adapts per waiting thread: it
+doubles whenever the request finished while polling and halves whenever the
+thread had to park. The worker only issues a wake up if the waiting thread
+announced that it parks.
+*/
+
+// States of a completion
+const int kCompletionPending = 0;  // the request did not finish yet
+const int kCompletionDone = 1;     // the request finished
+const int kCompletionParked = 2;   // the waiting thread sleeps on the futex
+
+// Bounds of the number of times a completion is polled before parking
+const int kMinCompletionSpins = 64;
+const int kMaxCompletionSpins = 1 << 14;
+
+struct Completion {
+  std::atomic<int> state;
+};
+typedef struct Completion Completion;
+
+/**
+ * Initializes a pending completion
+ */
+inline void initCompletion(Completion* completion) {
+  completion->state.store(kCompletionPending, std::memory_order_relaxed);
+}
+
+/**
+ * Marks a completion as done, which publishes all writes before it, e.g. the
+ * error flag of the request, to the waiting thread
+ *
+ * @returns true, if the waiting thread parked, so the caller has to wake it up
+ * with wakeCompletion()
+ */
+inline auto finishCompletion(Completion* completion) -> bool {
+  return completion->state.exchange(kCompletionDone,
+                                    std::memory_order_acq_rel) ==
+         kCompletionParked;
+}
+
+/**
+ * Waits until a completion is done, polling it first and parking the thread
+ * if polling does not pay off
+ */
+void waitForCompletion(Completion* completion);
+
+/**
+ * Wakes up the thread parked on a completion. The completion may already be
+ * freed by the woken thread, as the futex is only identified by its address.
+ */
+void wakeCompletion(Completion* completion);
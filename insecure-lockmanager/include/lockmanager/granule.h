@@ -0,0 +1,156 @@
+#pragma once
+
+#include "common.h"
+#include "hashtable.h"
+
+// Number of lock modes, see LockMode
+const int kNumLockModes = 6;
+
+// Number of rows of a page and pages of a table, which map a row to the page
+// and the table that it belongs to
+const unsigned int kRowsPerPage = 64;
+const unsigned int kPagesPerTable = 1024;
+
+// Number of low bits of a lock table key that hold the ID within its granule.
+// The granule itself is kept in the bits above, so row IDs are their own keys.
+const int kGranuleIdBits = 30;
+
+// Largest ID of a row, page or table. Requests for larger IDs are rejected, as
+// their keys would alias with the keys of other granules.
+const unsigned int kMaxGranuleId = (1u << kGranuleIdBits) - 1;
+
+/**
+ * Numbers of row locks within a table that are held in S and X mode, which
+ * are counted for lock escalation
+ */
+struct RowCounts {
+  unsigned int shared;
+  unsigned int exclusive;
+};
+typedef struct RowCounts RowCounts;
+
+/**
+ * Lock on a page, a table or the database, which transactions may hold in any
+ * of the modes of multi-granularity locking. It only counts the holders of
+ * each mode, as every holder keeps its own mode in its transaction. Rows are
+ * locked with Lock instead, as they are only ever locked in S or X mode.
+ */
+struct GranuleLock {
+  unsigned int holders[kNumLockModes];  // number of holders of each mode
+  RowCounts rows;  // row locks within a table, with lock escalation
+};
+typedef struct GranuleLock GranuleLock;
+
+typedef HashTable<int, GranuleLock> GranuleTable;  // keys to granule locks
+
+/**
+ * Returns the key of a granule in the lock tables, which is the ID for rows
+ *
+ * @param granule the level of the granule
+ * @param id identifies the row, page or table, always 0 for the database
+ */
+inline auto granuleKey(Granule granule, unsigned int id) -> int {
+  return (int)(((unsigned int)granule << kGranuleIdBits) |
+               (id & ((1u << kGranuleIdBits) - 1)));
+}
+
+/**
+ * Returns the ID of the page of a row or the table of a page. Tables belong to
+ * the database, whose ID is 0.
+ *
+ * @param granule the level of the granule, below DATABASE
+ * @param id identifies the row, page or table
+ */
+auto parentOf(Granule granule, unsigned int id) -> unsigned int;
+
+/**
+ * Returns the ID of the table that a row belongs to
+ */
+auto tableOf(unsigned int rowId) -> unsigned int;
+
+/**
+ * Adds delta to the shared or the exclusive row locks of a table
+ */
+void countRows(RowCounts* rows, bool isExclusive, int delta);
+
+/**
+ * Checks if two transactions can hold a granule in the given modes at once,
+ * according to the compatibility matrix of multi-granularity locking
+ */
+auto isCompatible(LockMode held, LockMode requested) -> bool;
+
+/**
+ * Returns the weakest mode that grants the rights of both modes, e.g. SIX for
+ * S and IX or X for U and X. A transaction that requests another mode on a
+ * granule it already holds converts its lock into this mode.
+ */
+auto strongestOf(LockMode a, LockMode b) -> LockMode;
+
+/**
+ * Checks if the mode held on the parent of a granule allows a lock on the
+ * granule: S and IS require IS or IX, X, U, IX and SIX require IX or SIX on
+ * the parent, or any mode that implies them, as U converts to X later.
+ *
+ * @param parentMode the mode held on the parent
+ * @param requested the mode requested on the granule
+ */
+auto allowsChild(LockMode parentMode, LockMode requested) -> bool;
+
+/**
+ * Initializes a granule lock without holders
+ */
+void initGranuleLock(GranuleLock* lock);
+
+/**
+ * Acquires a granule lock in the requested mode, or converts the mode the
+ * transaction holds it in already
+ *
+ * @param lock the granule lock
+ * @param held pointer to the mode the transaction holds the lock in, or
+ * nullptr if it does not hold it. Receives the new mode.
+ * @param requested the requested mode
+ * @returns false, if the lock is held by other transactions in a mode that
+ * is not compatible with the requested mode
+ */
+auto acquireGranule(GranuleLock* lock, LockMode* held, LockMode requested)
+    -> bool;
+
+/**
+ * Checks if other transactions hold a granule lock in a mode that is not
+ * compatible with the requested mode
+ *
+ * @param lock the granule lock
+ * @param held pointer to the mode the requesting transaction holds the lock
+ * in, or nullptr if it does not hold it
+ * @param requested the requested mode
+ */
+auto conflictsWithHolders(GranuleLock* lock, LockMode* held,
+                          LockMode requested) -> bool;
+
+/**
+ * Checks if the row locks that other transactions hold within a table conflict
+ * with a lock on the table in the requested mode. Shared rows imply IS and
+ * exclusive rows IX on their table.
+ *
+ * @param lock the lock of the table
+ * @param own the row locks of the requesting transaction within the table
+ * @param requested the requested mode
+ */
+auto conflictsWithRows(GranuleLock* lock, RowCounts own, LockMode requested)
+    -> bool;
+
+/**
+ * Releases a granule lock held in the given mode
+ */
+void releaseGranule(GranuleLock* lock, LockMode held);
+
+/**
+ * Returns the number of transactions that hold the granule lock
+ */
+auto numHolders(GranuleLock* lock) -> int;
+
+/**
+ * Checks if a granule lock can be removed from its table, as neither a
+ * transaction holds it nor are row locks counted within it
+ */
+auto isUnused(GranuleLock* lock) -> bool;
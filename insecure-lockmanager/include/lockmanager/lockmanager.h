@@ -1,17 +1,76 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <memory>
-#include <queue>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "common.h"
+#include "completion.h"
+#include "granule.h"
 #include "hashtable.h"
+#include "job_ring.h"
 #include "lock.h"
+#include "pool.h"
+#include "range_index.h"
 #include "spdlog/spdlog.h"
 #include "transaction.h"
+#include "wait_queue.h"
+
+// Number of mutexes the lock table is striped with by the CONCURRENT engine
+const int kLockTableStripes = 1024;
+
+// Maximum number of jobs a worker thread takes from its queue at once
+const int kJobBatchSize = 16;
+
+// Number of partitions of the lock table for each worker thread. A worker
+// owns several partitions, so an idle worker can steal some of them.
+const int kPartitionsPerWorker = 4;
+
+// Minimum number of queued jobs of a worker thread before an idle worker
+// steals one of its partitions
+const int kStealThreshold = 4;
+
+// Time in microseconds after which an idle worker thread wakes up to look for
+// a partition to steal
+const int kStealInterval = 1000;
+
+/**
+ * Outcome of a lock request
+ */
+enum LockResult {
+  GRANTED,      // the transaction holds the lock in the requested mode now
+  CONFLICTING,  // other transactions hold the lock in a conflicting mode
+  REJECTED,     // the request is invalid, e.g. it violates 2PL
+  WAITING       // the request waits in the queue of the lock
+};
+
+/**
+ * How the lock on its table affects a row lock request, with lock escalation
+ */
+enum TableAccess {
+  NOT_COUNTED,  // lock escalation is disabled
+  COUNTED,      // the row lock is counted within its table
+  COVERED,      // the transaction holds the table in a mode implying the row
+  BLOCKED       // another transaction holds the table in a conflicting mode
+};
+
+/**
+ * A partition of the lock table that a worker thread handed over to a thief.
+ * The worker still serves the jobs that were sent to it before, and tells the
+ * thief with an ADOPT job once it took the last of them from its ring.
+ */
+struct Handoff {
+  int partition;
+  int thief;              // worker thread that owns the partition now
+  bool isDrained;         // no more jobs are sent to the former owner
+  unsigned long lastJob;  // position behind the last job of the partition in
+                          // the ring of the former owner, once drained
+};
+typedef struct Handoff Handoff;
 
 /**
  * Process lock and unlock requests from the server. It manages a lock table,
@@ -27,8 +86,28 @@ class LockManager {
    * Initializes the job queue, mutexes and the configuration parameters.
    *
    * @param numWorkerThreads the number of threads that work on the lock table
+   * @param engine PARTITIONED assigns each row to the one worker thread that
+   * owns its partition of the lock table. An idle worker steals partitions
+   * from busy ones, so a range of hot rows is spread over several threads,
+   * but a single hot partition still keeps one thread busy. CONCURRENT sends
+   * each request to the least loaded worker thread instead and protects the
+   * lock table with striped mutexes. Requests that are not waited for may then
+   * complete out of order.
+   * @param policy ABORT_ON_CONFLICT makes a request that conflicts with the
+   * owners of the lock fail and aborts its transaction. WAIT_ON_CONFLICT parks
+   * it in a wait queue of the lock instead, from which it is granted in order
+   * of arrival once the lock is released. Only requests of transactions that
+   * are older than the owners and the requests waiting before them may wait,
+   * see mayWait(), the others still abort.
+   * @param escalationThreshold once a transaction holds more row locks within
+   * a table, they are replaced by a single S or X lock on the table, unless
+   * other transactions hold conflicting locks within it. This bounds the size
+   * of the lock table, but costs a global mutex on each row request. 0
+   * disables lock escalation.
    */
-  LockManager(int numWorkerThreads = 1);
+  LockManager(int numWorkerThreads = 1, LockTableEngine engine = PARTITIONED,
+              ConflictPolicy policy = ABORT_ON_CONFLICT,
+              int escalationThreshold = 0);
 
   /**
    * Shuts down the worker threads.
@@ -56,10 +135,33 @@ class LockManager {
    * RegisterTransaction before or the given lock mode is unknown or when the
    * transaction makes a request for a look, that it already owns or makes a
    * request for a lock while in the shrinking phase, the request will fail.
+   * Row IDs above kMaxGranuleId are rejected as well.
    */
   auto lock(unsigned int transactionId, unsigned int rowId, bool isExclusive,
             bool waitForResult = true) -> bool;
 
+  /**
+   * Acquires a lock on a row, a page, a table or the database in one of the
+   * modes of multi-granularity locking, e.g. a single S lock on a table to
+   * scan all of its rows. Before locking a granule, the transaction must lock
+   * its parent granule in an intention mode or a mode that implies it, see
+   * allowsChild(). Rows can only be locked in S, U or X mode. A transaction
+   * that reads a row before writing it should lock it in U mode and convert
+   * the lock to X later, as two transactions converting S locks on the same
+   * row always conflict. Row locks acquired with the other lock() stay outside
+   * of the hierarchy.
+   *
+   * @param transactionId identifies the transaction making the request
+   * @param granule the level of the granule
+   * @param id identifies the row, page or table, 0 for the database
+   * @param mode the requested mode
+   * @param waitForResult parameter forwarded to create_job function
+   * @returns if successful or not, see the other lock(). The request also
+   * fails, when the parent granule is not locked in a suitable mode.
+   */
+  auto lock(unsigned int transactionId, Granule granule, unsigned int id,
+            LockMode mode, bool waitForResult = true) -> bool;
+
   /**
    * Releases a lock for the specified row
    *
@@ -71,6 +173,100 @@ class LockManager {
   void unlock(unsigned int transactionId, unsigned int rowId,
               bool waitForResult = false);
 
+  /**
+   * Releases a lock on a row, a page, a table or the database
+   *
+   * @param transactionId identifies the transaction making the request
+   * @param granule the level of the granule
+   * @param id identifies the row, page or table, 0 for the database
+   * @param waitForResult if true makes unlock a synchronous operation, else
+   * asynchronous (no waiting for operation to be finished)
+   */
+  void unlock(unsigned int transactionId, Granule granule, unsigned int id,
+              bool waitForResult = false);
+
+  /**
+   * Acquires a key-range lock on the rows firstRowId..lastRowId, which
+   * conflicts with the locks other transactions hold on rows of the range and
+   * with their overlapping ranges, so rows can neither be changed in nor
+   * appear in the range meanwhile. The request is split into one part for each
+   * partition that owns rows of the range, and each part is served by a
+   * worker thread of its partition. Conflicting requests never wait.
+   *
+   * @param transactionId identifies the transaction making the request
+   * @param firstRowId identifies the first row of the range
+   * @param lastRowId identifies the last row of the range
+   * @param isExclusive either shared for concurrent read access or exclusive
+   * for sole write access
+   * @param waitForResult if the function should wait for all parts to finish
+   * @returns if successful or not, see lock()
+   */
+  auto lockRange(unsigned int transactionId, unsigned int firstRowId,
+                 unsigned int lastRowId, bool isExclusive,
+                 bool waitForResult = true) -> bool;
+
+  /**
+   * Releases a key-range lock acquired with lockRange()
+   *
+   * @param transactionId identifies the transaction making the request
+   * @param firstRowId identifies the first row of the range
+   * @param lastRowId identifies the last row of the range
+   * @param waitForResult if true makes unlock a synchronous operation, else
+   * asynchronous (no waiting for operation to be finished)
+   */
+  void unlockRange(unsigned int transactionId, unsigned int firstRowId,
+                   unsigned int lastRowId, bool waitForResult = false);
+
+  /**
+   * Commits a transaction by releasing all of its row, granule and range locks
+   * and removing it from the transaction table in a single request, instead of
+   * one unlock() for each lock. The locked rows are split by the partitions
+   * that own them and released by their worker threads in parallel.
+   * Requests of the transaction that did not finish yet fail.
+   *
+   * @param transactionId identifies the transaction
+   * @param waitForResult if the function should wait for all locks to be
+   * released
+   * @returns false, if the transaction is not registered, e.g. because it was
+   * aborted after a conflict
+   */
+  auto commit(unsigned int transactionId, bool waitForResult = true) -> bool;
+
+  /**
+   * Aborts a transaction, which releases all of its locks and removes it from
+   * the transaction table like commit(). Requests of the transaction that
+   * already hold it, e.g. the other parts of a range, are rejected.
+   *
+   * @param transactionId identifies the transaction
+   * @param waitForResult if the function should wait for all locks to be
+   * released
+   * @returns false, if the transaction is not registered
+   */
+  auto abort(unsigned int transactionId, bool waitForResult = true) -> bool;
+
+  /**
+   * Returns the hit and miss counters of the pools that locks, transactions
+   * and hash table entries are allocated from
+   */
+  auto getPoolStatistics() -> PoolStatistics;
+
+  /**
+   * Returns how the locks are distributed over the buckets of the lock table.
+   * Must only be called while no requests are being processed.
+   */
+  auto getLockTableStatistics() -> BucketStatistics;
+
+  /**
+   * Returns how many row locks were replaced by locks on their tables
+   */
+  auto getEscalationStatistics() -> EscalationStatistics;
+
+  /**
+   * Returns how many partitions of the lock table idle worker threads took
+   * over from busy ones
+   */
+  auto getStealStatistics() -> StealStatistics;
+
  private:
   /**
    * Function that each worker thread executes. It calls inside the enclave and
@@ -85,33 +281,299 @@ class LockManager {
    * Initializes configuration parameters.
    *
    * @param numWorkerThreads the number of threads that work on the lock table
+   * @param engine how the worker threads share the lock table
+   * @param policy what happens to conflicting lock requests
+   * @param escalationThreshold row locks within a table that trigger lock
+   * escalation
    */
-  void configuration_init(int numWorkerThreads);
+  void configuration_init(int numWorkerThreads, LockTableEngine engine,
+                          ConflictPolicy policy, int escalationThreshold);
 
   /**
    * Sends a job to the job queue.
    *
-   * @param command command for the job (SHARED, EXCLUSIVE, UNLOCK, REGISTER,
-   * QUIT)
-   * @param transaction_id optional parameter for SHARED, EXCLUSIVE, UNLOCK or
-   * REGISTER
-   * @param row_id optional parameter for SHARED, EXCLUSIVE or UNLOCK
+   * @param command command for the job (SHARED, EXCLUSIVE, LOCK_GRANULE,
+   * UNLOCK, COMMIT, ABORT, REGISTER, QUIT)
+   * @param transaction_id optional parameter for SHARED, EXCLUSIVE,
+   * LOCK_GRANULE, UNLOCK, COMMIT, ABORT or REGISTER
+   * @param row_id optional parameter for SHARED, EXCLUSIVE, LOCK_GRANULE or
+   * UNLOCK
    * @param waitForResult if the function should wait for return values to be
    * set or immediately return
+   * @param granule optional parameter for LOCK_GRANULE or UNLOCK
+   * @param mode optional parameter for LOCK_GRANULE or LOCK_RANGE
+   * @param last_row_id optional parameter for LOCK_RANGE or UNLOCK_RANGE
    */
   auto create_job(Command command, unsigned int transaction_id = 0,
-                  unsigned int row_id = 0, bool waitForResult = true) -> bool;
+                  unsigned int row_id = 0, bool waitForResult = true,
+                  Granule granule = ROW, LockMode mode = S_LOCK,
+                  unsigned int last_row_id = 0) -> bool;
 
   /**
-   * Function that is run by the worker threads inside the enclave. It pulls a
-   * job from its associated job queue in a loop and executes it, e.g. acquiring
-   * a shared lock for a specific row. Each row gets assigned a specific thread
-   * evenly, so no synchronization is necessary when accessing the underlying
-   * lock table. The transaction table is accessed by only one single thread for
-   * all requests to register a transaction.
+   * Function that is run by the worker threads inside the enclave. It pulls
+   * the pending jobs from its associated job queue in a loop and executes them
+   * one after another, e.g. acquiring a shared lock for a specific row. With
+   * the PARTITIONED engine each row gets assigned a specific thread evenly, so
+   * no synchronization is necessary when accessing the underlying lock table.
+   * Each worker thread also registers the transactions of its partition of the
+   * transaction table, see transaction_partition_of().
    */
   void process_request();
 
+  /**
+   * Pushes a job into the ring of a worker thread and wakes the worker up, if
+   * it sleeps
+   *
+   * @param threadId the worker thread
+   * @param job the job to execute
+   */
+  void enqueue_job(int threadId, const Job &job);
+
+  /**
+   * Takes up to kJobBatchSize jobs from the ring of a worker thread. Polls the
+   * ring while it is empty, and sleeps once polling does not pay off. Before
+   * sleeping, the worker tries to steal a partition from a busy worker, and
+   * wakes up every kStealInterval microseconds to try again.
+   *
+   * @param threadId the worker thread
+   * @param jobs buffer for kJobBatchSize jobs
+   * @returns the number of jobs taken, or 0 if the worker must not sleep as it
+   * hands over a partition, see finish_handoffs()
+   */
+  auto dequeue_jobs(int threadId, Job *jobs) -> int;
+
+  /**
+   * Sends a job to the worker thread that owns a partition of the lock table
+   * with the PARTITIONED engine
+   *
+   * @param partition the partition of the rows of the job
+   * @param job the job to execute
+   */
+  void send_to_partition(int partition, Job &job);
+
+  /**
+   * Asks the busiest worker thread for one of its partitions, if it has
+   * enough queued jobs that taking one of its partitions does not make the
+   * idle worker the busiest one. The busy worker answers with an ADOPT job.
+   *
+   * @param threadId the idle worker thread
+   */
+  void steal_partition(int threadId);
+
+  /**
+   * Hands a partition over to the worker thread that sent a STEAL job, unless
+   * the partition is not owned by this worker or was just stolen itself.
+   * Later jobs of the partition are sent to the thief, which keeps them until
+   * this worker served the jobs it got before, see finish_handoffs().
+   *
+   * @param threadId the worker thread owning the partition
+   * @param job the STEAL job
+   */
+  void hand_off_partition(int threadId, Job &job);
+
+  /**
+   * Tells the thieves of the partitions a worker thread handed over, once it
+   * took the last job sent to it for them from its ring
+   *
+   * @param threadId the worker thread that handed over the partitions
+   */
+  void finish_handoffs(int threadId);
+
+  /**
+   * Takes over a partition from the worker thread that handed it over, and
+   * executes the jobs of the partition that were kept meanwhile
+   *
+   * @param threadId the worker thread that stole the partition
+   * @param job the ADOPT job, whose partition is -1 if the steal was declined
+   */
+  void adopt_partition(int threadId, Job &job);
+
+  /**
+   * Checks if a job is for a partition that its worker thread stole, but that
+   * the former owner did not hand over yet
+   *
+   * @param threadId the worker thread
+   * @param job a job taken from the ring of the worker thread
+   */
+  auto is_adopting(int threadId, const Job &job) -> bool;
+
+  /**
+   * Executes a single job that was taken from the job queue, except QUIT.
+   *
+   * @param job the job to execute
+   */
+  void process_job(Job &job);
+
+  /**
+   * Looks up the locks of all lock and unlock jobs of a batch at once with
+   * getMany(), so that their buckets are fetched from memory in parallel
+   * instead of one after another. The jobs still look up their locks on their
+   * own, as the jobs before them may add or remove locks, but then find them
+   * in the cache.
+   *
+   * @param jobs the jobs taken from the job queue
+   * @param numJobs the number of jobs
+   */
+  void prefetch_locks(Job *jobs, int numJobs);
+
+  /**
+   * Returns the worker thread with the fewest pending lock requests. Ties are
+   * broken by the row ID, so idle workers share the requests evenly.
+   *
+   * @param rowId identifies the requested row
+   */
+  auto least_loaded_worker(unsigned int rowId) -> int;
+
+  /**
+   * Returns the partition of the lock table that a row or granule falls into.
+   * Each worker thread starts with kPartitionsPerWorker adjacent partitions
+   * with the PARTITIONED engine, see partition_owner. Range locks are indexed
+   * by the same partitions with both engines.
+   *
+   * @param key identifies the row, or the granule, see granuleKey()
+   */
+  auto partition_of(unsigned int key) -> int;
+
+  /**
+   * Returns the partition of the transaction table that a transaction falls
+   * into. The worker thread of the same index registers the transaction,
+   * while any worker may look it up or remove it under the mutex of the
+   * partition.
+   *
+   * @param transactionId identifies the transaction
+   */
+  auto transaction_partition_of(unsigned int transactionId) -> int;
+
+  /**
+   * Adds a transaction to its partition of the transaction table
+   *
+   * @param transactionId identifies the transaction
+   * @returns false, if the transaction was already registered
+   */
+  auto register_transaction(unsigned int transactionId) -> bool;
+
+  /**
+   * Checks if a transaction is registered in its partition of the transaction
+   * table
+   *
+   * @param transactionId identifies the transaction
+   */
+  auto is_registered(unsigned int transactionId) -> bool;
+
+  /**
+   * Looks up a transaction in its partition of the transaction table and keeps
+   * it alive until the calling worker thread passes it to unpin_transaction(),
+   * even if another worker removes it from the table meanwhile
+   *
+   * @param transactionId identifies the transaction
+   * @returns the node of the transaction, or nullptr if it is not registered
+   */
+  auto pin_transaction(unsigned int transactionId) -> Node<Transaction> *;
+
+  /**
+   * Releases a transaction pinned with pin_transaction(), and frees it if it
+   * was removed from the transaction table and nobody else pins it
+   */
+  void unpin_transaction(Node<Transaction> *node);
+
+  /**
+   * Frees a transaction that was removed from the transaction table, or leaves
+   * that to the last worker thread that unpins it
+   */
+  void delete_transaction(Node<Transaction> *node);
+
+  /**
+   * Removes a transaction from the transaction table, if it does not hold any
+   * locks anymore
+   *
+   * @param transactionId identifies the transaction that released a lock
+   */
+  void remove_if_idle(unsigned int transactionId);
+
+  /**
+   * Removes a transaction from the transaction table without freeing it. Only
+   * the worker thread that gets its node may release its locks and has to pass
+   * it to delete_transaction() afterwards.
+   *
+   * @param transactionId identifies the transaction
+   * @param transaction if not nullptr, the transaction is only removed if it is
+   * still the one registered under its ID
+   * @returns the node of the transaction, or nullptr if it is not registered
+   */
+  auto extract_transaction(unsigned int transactionId,
+                           Transaction *transaction = nullptr)
+      -> Node<Transaction> *;
+
+  /**
+   * Splits a LOCK_RANGE or UNLOCK_RANGE job into one part for each partition
+   * that owns rows of the range and sends the parts to the job queues
+   *
+   * @param job the job of the request, with its parameters already copied
+   */
+  void send_range_parts(Job &job);
+
+  /**
+   * Removes the transaction of a COMMIT or ABORT job from the transaction
+   * table and releases its locks, see release_in_parts()
+   *
+   * @param job the job of the request, with its parameters already copied
+   */
+  void send_release_parts(Job &job);
+
+  /**
+   * Splits the release of a transaction, which was removed from the
+   * transaction table already, into one part for each partition that owns
+   * rows or granules the transaction holds locks on, or a single part if it
+   * holds none. The parts of partitions served by the calling worker are
+   * released right away, the others are sent to the job queues.
+   *
+   * @param job the COMMIT or ABORT job completed once all parts finished
+   * @param node the removed transaction
+   * @param partition the partition served by the calling worker, or -1 if it
+   * is not a worker
+   */
+  void release_in_parts(Job &job, Node<Transaction> *node, int partition);
+
+  /**
+   * Checks if the worker serving a partition surely serves another one, too.
+   * With the CONCURRENT engine, any worker serves any partition.
+   *
+   * @param partition the partition served by the calling worker
+   * @param other the other partition
+   */
+  auto serves_both(int partition, int other) -> bool;
+
+  /**
+   * Releases the locks a committing or aborting transaction holds on the rows
+   * and granules of one partition
+   *
+   * @param job the part of the COMMIT or ABORT job
+   */
+  void release_part(Job &job);
+
+  /**
+   * Completes a COMMIT or ABORT request once all of its parts finished. The
+   * last part releases the range locks of the transaction and frees it.
+   *
+   * @param job the part of the COMMIT or ABORT job
+   */
+  void finish_release_part(Job &job);
+
+  /**
+   * Locks the stripe of the lock table that contains the row, when worker
+   * threads share the lock table. Otherwise does nothing.
+   *
+   * @param rowId identifies the row
+   */
+  void lock_row(unsigned int rowId);
+
+  /**
+   * Unlocks the stripe locked by lock_row()
+   *
+   * @param rowId identifies the row
+   */
+  void unlock_row(unsigned int rowId);
+
   /**
    * Function that receives a job, which can be a lock request or a request to
    * register a transaction. The job is then put into a job queue for the
@@ -123,20 +585,159 @@ class LockManager {
   void send_job(void *data);
 
   /**
-   * Acquires a lock for the specified row.
+   * Acquires a lock for the specified row, or parks the request in the wait
+   * queue of the lock.
    *
-   * @param sig_len length of the buffer
-   * @param transactionId identifies the transaction making the request
+   * @param job the SHARED or EXCLUSIVE job of the request, which is completed
+   * by grant_waiters() if it has to wait
+   * @returns GRANTED or WAITING. CONFLICTING and REJECTED mean that the
+   * transaction did not call RegisterTransaction before or makes a request for
+   * a lock, that it already owns, makes a request for a lock while in the
+   * shrinking phase or conflicts with the owners of the lock, and was aborted.
+   */
+  auto acquire_lock(Job &job) -> LockResult;
+
+  /**
+   * Acquires a lock for the specified row while holding its stripe.
+   *
+   * @param transaction the transaction making the request
    * @param rowId identifies the row to be locked
-   * @param isExclusive either shared for concurrent read access or exclusive
-   * for sole write access
-   * @returns false, when transaction did not call
-   * RegisterTransaction before or the given lock mode is unknown or when the
-   * transaction makes a request for a look, that it already owns, makes a
-   * request for a lock while in the shrinking phase, else true
+   * @param mode S for concurrent read access, X for sole write access or U
+   * for read access that converts to X later
+   * @returns GRANTED, CONFLICTING or REJECTED
+   */
+  auto acquire_row_lock(Transaction *transaction, unsigned int rowId,
+                        LockMode mode) -> LockResult;
+
+  /**
+   * Acquires the part of a range lock that covers the rows of one partition.
+   * The range is added to the index of the partition before checking the
+   * locks of its rows, so rows locked by other workers meanwhile see it.
+   *
+   * @param job the part of the LOCK_RANGE job
+   * @returns GRANTED, or CONFLICTING or REJECTED after aborting the
+   * transaction
+   */
+  auto acquire_range_part(Job &job) -> LockResult;
+
+  /**
+   * Releases the part of a range lock that covers the rows of one partition
+   *
+   * @param job the part of the UNLOCK_RANGE job
+   */
+  void release_range_part(Job &job);
+
+  /**
+   * Completes a range request once all of its parts finished
+   *
+   * @param job the part of the LOCK_RANGE or UNLOCK_RANGE job
+   * @param ok if the part succeeded
+   */
+  void finish_range_part(Job &job, bool ok);
+
+  /**
+   * Checks if another transaction holds a range lock on the row in a mode
+   * that conflicts with the requested mode
+   *
+   * @param transaction the transaction requesting the row
+   * @param rowId identifies the row
+   * @param isExclusive if the request is for sole write access
+   */
+  auto conflicts_with_range(Transaction *transaction, unsigned int rowId,
+                            bool isExclusive) -> bool;
+
+  /**
+   * Acquires a lock on a page, a table or the database, or converts the mode
+   * the transaction holds it in.
+   *
+   * @param job the LOCK_GRANULE job of the request
+   * @returns GRANTED, or CONFLICTING or REJECTED after aborting the
+   * transaction. Requests for granule locks never wait.
+   */
+  auto acquire_granule_lock(Job &job) -> LockResult;
+
+  /**
+   * Checks if a LOCK_GRANULE request follows the rules of multi-granularity
+   * locking: the transaction holds the parent granule in a mode that allows
+   * the requested mode, and rows are only locked in S, U or X mode.
+   *
+   * @param transaction the transaction making the request
+   * @param job the LOCK_GRANULE job of the request
+   */
+  auto follows_hierarchy(Transaction *transaction, Job &job) -> bool;
+
+  /**
+   * Locks the mutex that serializes the granule table with lock escalation,
+   * as all row requests count their locks within the locks of the tables
+   * then. Otherwise does nothing. Must not be held while locking a stripe.
+   */
+  void lock_granules();
+
+  /**
+   * Unlocks the mutex locked with lock_granules()
+   */
+  void unlock_granules();
+
+  /**
+   * Checks the lock on the table of a row before the row is locked, and counts
+   * the row lock within it in advance, so a concurrent escalation of the table
+   * sees it
+   *
+   * @param transaction the transaction requesting the row
+   * @param rowId identifies the row
+   * @param isExclusive if the request is for sole write access
+   * @returns COUNTED, if the request must be settled with settle_row_count()
    */
-  auto acquire_lock(unsigned int transactionId, unsigned int rowId,
-                    bool isExclusive) -> bool;
+  auto enter_table(Transaction *transaction, unsigned int rowId,
+                   bool isExclusive) -> TableAccess;
+
+  /**
+   * Removes a row lock of a transaction from the counts of its table
+   *
+   * @param transaction the transaction holding the row lock
+   * @param rowId identifies the row
+   * @param isExclusive if the row lock is exclusive
+   */
+  void leave_table(Transaction *transaction, unsigned int rowId,
+                   bool isExclusive);
+
+  /**
+   * Corrects the row lock counted by enter_table() after the request finished:
+   * removes it if the request did not get the lock, and the shared lock it
+   * replaced after an upgrade
+   *
+   * @param transaction the transaction requesting the row
+   * @param rowId identifies the row
+   * @param isExclusive if the request is for sole write access
+   * @param result the outcome of the request
+   * @param isUpgrade if the transaction held the row in shared mode before
+   */
+  void settle_row_count(Transaction *transaction, unsigned int rowId,
+                        bool isExclusive, LockResult result, bool isUpgrade);
+
+  /**
+   * Replaces the row locks of a transaction within a table by a single lock
+   * on the table, if no other transaction holds conflicting locks within it.
+   * X is taken if the transaction writes any of the rows, S otherwise.
+   *
+   * @param transaction the transaction holding the row locks
+   * @param table identifies the table
+   * @param partition the partition the calling worker thread serves the
+   * request for. With PARTITIONED, only the row locks within it are released,
+   * the others are merely covered by the table lock until the transaction
+   * ends.
+   */
+  void escalate_table(Transaction *transaction, unsigned int table,
+                      int partition);
+
+  /**
+   * Grants the lock of a row to the requests waiting for it, in the order they
+   * arrived, until the first one conflicts with the owners of the lock. Must
+   * be called while holding the stripe of the row after it was released.
+   *
+   * @param rowId identifies the row
+   */
+  void grant_waiters(unsigned int rowId);
 
   /**
    * Releases a lock for the specified row.
@@ -147,26 +748,86 @@ class LockManager {
   void release_lock(unsigned int transactionId, unsigned int rowId);
 
   /**
-   * Releases all locks the given transaction currently has.
+   * Releases a lock on a page, a table or the database.
    *
-   * @param transaction the transaction to be aborted
+   * @param transactionId identifies the transaction making the request
+   * @param granule the level of the granule
+   * @param id identifies the page or table, 0 for the database
+   */
+  void release_granule_lock(unsigned int transactionId, Granule granule,
+                            unsigned int id);
+
+  /**
+   * Releases all locks the given transaction currently has. Several parts of
+   * a request may abort the same transaction at once, but only the first one
+   * releases its locks, split into parts like an ABORT request, see
+   * release_in_parts().
+   *
+   * @param transaction the transaction to be aborted, pinned by the caller
+   * @param partition the partition of the failed request
    */
-  void abort_transaction(Transaction *transaction);
+  void abort_transaction(Transaction *transaction, int partition);
+
+  /**
+   * Releases the range locks of a transaction, whose row and granule locks
+   * were released already, and removes its row locks from the counts of their
+   * tables
+   *
+   * @param transaction the transaction that aborts or commits
+   */
+  void release_other_locks(Transaction *transaction);
 
   Arg arg;  // configuration parameters for the enclave
   pthread_t
       *threads;  // worker threads that execute requests inside the enclave
 
   pthread_mutex_t global_num_mutex;  // synchronizes access to num
-  pthread_mutex_t *queue_mutex;      // synchronizes access to the job queue
+  JobRing *job_rings;                // a job queue for each worker thread
+  pthread_mutex_t *queue_mutex;      // lets a worker thread sleep on its ring
   pthread_cond_t
       *job_cond;  // wakes up worker threads when a new job is available
-  std::vector<std::queue<Job>> queue;  // a job queue for each worker thread
+  std::atomic<int> *pending_jobs;  // lock requests queued at each worker
+  pthread_mutex_t *stripe_mutex;   // synchronizes access to the lock table
+
+  // Work stealing between the worker threads of the PARTITIONED engine. Only
+  // the owner of a partition changes its owner, when it hands it over.
+  std::atomic<int> *partition_owner;    // worker thread owning each partition
+  std::atomic<int> *partition_senders;  // threads sending a job to each
+                                        // partition right now
+  std::atomic<int> *partition_jobs;     // queued jobs of each partition
+  std::atomic<bool> *adopting;          // the partition was stolen, but not
+                                        // handed over by its owner yet
+  bool *stealing;                   // each worker waits for an ADOPT job
+  std::vector<Job> *adopted_jobs;   // jobs each worker keeps until the
+                                    // partition it stole is handed over
+  std::vector<Handoff> *handoffs;   // partitions each worker hands over
+  std::atomic<unsigned long> steals_;          // see StealStatistics
+  std::atomic<unsigned long> declinedSteals_;  // see StealStatistics
 
   // Holds the transaction objects of the currently active transactions
-  HashTable *transactionTable_;
+  TransactionTable *transactionTable_;
+  pthread_mutex_t *transaction_mutex;  // synchronizes access to each
+                                       // partition of the transaction table
 
   // Keeps track of a lock object for each row ID
-  HashTable *lockTable_;
+  LockTable *lockTable_;
+
+  // Keeps track of the locks of pages, tables and the database
+  GranuleTable *granuleTable_;
+
+  // Lock requests waiting for the lock of a row, with WAIT_ON_CONFLICT
+  WaitTable *waitTable_;
+
+  // Range locks on the rows of each partition
+  RangeIndex *rangeIndex_;
+  pthread_mutex_t *range_mutex;  // synchronizes access to each range index
+  std::atomic<int> numRanges_;   // lets row requests skip empty range indexes
+
+  // Serializes the granule table with lock escalation, see lock_granules()
+  pthread_mutex_t granule_mutex;
+  std::atomic<unsigned long> escalations_;    // see EscalationStatistics
+  std::atomic<unsigned long> escalatedRows_;  // see EscalationStatistics
+  std::atomic<unsigned long> failedEscalations_;
+
   int num = 0;  // global variable used to give every thread a unique ID
 };
\ No newline at end of file
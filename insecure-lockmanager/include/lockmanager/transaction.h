@@ -1,11 +1,14 @@
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
+#include "granule.h"
 #include "hashtable.h"
 #include "lock.h"
 
@@ -19,7 +22,7 @@ using std::memcpy;
  */
 struct Transaction {
   int transaction_id;
-  bool aborted;
+  std::atomic<bool> aborted;  // read by the parts of a request on any worker
   /**
    * According to 2PL, a transaction has two subsequent phases:
    * It starts with the growing phase, where it acquires all
@@ -31,12 +34,36 @@ struct Transaction {
   bool growing_phase;
   int lock_budget;
   std::set<int> locked_rows;
-  std::mutex mut;  // access on locked_rows and lock_budget
+  std::unordered_map<int, LockMode> granule_locks;  // keys of held granules
+  int locked_ranges;  // number of range locks held, one for each partition
+  // row locks held within each table, counted for lock escalation
+  std::unordered_map<int, RowCounts> table_rows;
+  // access on locked_rows, granule_locks, locked_ranges, table_rows and
+  // lock_budget
+  std::mutex mut;
+  // number of worker threads using the transaction, and whether it was removed
+  // from the transaction table meanwhile. Both are guarded by the mutex of its
+  // partition of the transaction table, see LockManager::pin_transaction().
+  int pins;
+  bool detached;
 };
 typedef struct Transaction Transaction;
 
 /**
- * Initializes the transaction struct.
+ * Initializes the transaction struct, e.g. one that was just inserted into the
+ * transaction table.
+ *
+ * @param transaction the transaction struct to initialize
+ * @param transactionId identifying the transaction
+ * @param lockBudget maximum number of locks the transaction is allowed to
+ * acquire
+ */
+void initTransaction(Transaction* transaction, int transactionId,
+                     int lockBudget = 500000);
+
+/**
+ * Allocates and initializes a transaction struct that is not part of a
+ * transaction table.
  *
  * @param transactionId identifying the transaction
  * @param lockBudget maximum number of locks the transaction is allowed to
@@ -45,6 +72,11 @@ typedef struct Transaction Transaction;
  */
 Transaction* newTransaction(int transactionId, int lockBudget = 500000);
 
+/**
+ * Frees a transaction struct that was initialized with newTransaction()
+ */
+void deleteTransaction(Transaction* transaction);
+
 /**
  * When the transaction acquires a new lock, the row ID that lock refers to is
  * added to the set of locked rows and it decrements the lock budget by 1.
@@ -59,6 +91,16 @@ Transaction* newTransaction(int transactionId, int lockBudget = 500000);
 auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock)
     -> bool;
 
+/**
+ * Like addLock(), but acquires the lock in U mode, which the transaction
+ * converts to exclusive once it writes the row
+ *
+ * @param Transaction transaction to execute the operation on
+ * @param rowId row ID of the newly acquired lock
+ * @param lock the lock of the row
+ */
+auto addUpdateLock(Transaction* transaction, int rowId, Lock* lock) -> bool;
+
 /**
  * Checks if the transaction currently holds a lock on the given row ID.
  * If so, it enters the shrinking phase and removes the row ID from the set of
@@ -68,7 +110,19 @@ auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock)
  * @param rowId row ID of the released lock
  * @param lock the lock to release
  */
-void releaseLock(Transaction* transaction, int rowId, HashTable* lockTable);
+void releaseLock(Transaction* transaction, int rowId, LockTable* lockTable);
+
+/**
+ * Releases the lock on a row that a lock of the transaction on its table
+ * covers now, see lock escalation. Unlike releaseLock(), the transaction stays
+ * in its growing phase and gets the lock back to its lock budget.
+ *
+ * @param Transaction transaction to execute the operation on
+ * @param rowId row ID of the released lock
+ * @param lockTable containing all the locks indexed by row ID
+ */
+void releaseCoveredLock(Transaction* transaction, int rowId,
+                        LockTable* lockTable);
 
 /**
  * Checks if the transaction has a lock on the specified row.
@@ -86,4 +140,79 @@ auto hasLock(Transaction* transaction, int rowId) -> bool;
  * @param Transaction transaction to execute the operation on
  * @param lockTable containing all the locks indexed by row ID
  */
-void releaseAllLocks(Transaction* transaction, HashTable* lockTable);
\ No newline at end of file
+void releaseAllLocks(Transaction* transaction, LockTable* lockTable);
+
+/**
+ * Acquires a lock on a page, a table or the database for the transaction, or
+ * converts the mode it holds the lock in already. A new lock is added to the
+ * granule locks of the transaction and decrements its lock budget by 1.
+ *
+ * @param transaction transaction to execute the operation on
+ * @param key key of the granule, see granuleKey()
+ * @param mode the requested mode
+ * @param lock the lock of the granule
+ * @returns false, if other transactions hold the lock in a conflicting mode
+ */
+auto addGranuleLock(Transaction* transaction, int key, LockMode mode,
+                    GranuleLock* lock) -> bool;
+
+/**
+ * Looks up the mode the transaction holds a granule lock in
+ *
+ * @param transaction transaction to execute the operation on
+ * @param key key of the granule, see granuleKey()
+ * @param mode receives the mode
+ * @returns false, if the transaction does not hold the lock
+ */
+auto granuleMode(Transaction* transaction, int key, LockMode* mode) -> bool;
+
+/**
+ * Releases a granule lock of the transaction, which enters the shrinking
+ * phase. Removes the lock from the table once it has no holders anymore.
+ *
+ * @param transaction transaction to execute the operation on
+ * @param key key of the granule, see granuleKey()
+ * @param granuleTable containing the locks of pages, tables and the database
+ */
+void releaseGranuleLock(Transaction* transaction, int key,
+                        GranuleTable* granuleTable);
+
+/**
+ * Adds delta to the row locks the transaction holds within the table of a row
+ * in shared or exclusive mode
+ *
+ * @param transaction transaction to execute the operation on
+ * @param rowId identifies the row
+ * @param isExclusive if the row lock is exclusive
+ * @param delta 1 for an acquired and -1 for a released row lock
+ */
+void countRowLock(Transaction* transaction, int rowId, bool isExclusive,
+                  int delta);
+
+/**
+ * Returns the row locks the transaction holds within a table, as counted with
+ * countRowLock()
+ */
+auto rowLocksIn(Transaction* transaction, unsigned int table) -> RowCounts;
+
+/**
+ * Checks if the transaction holds any row, granule or range lock
+ */
+auto holdsLocks(Transaction* transaction) -> bool;
+
+/**
+ * Shared state of the parts a COMMIT or ABORT request, or the abort of a
+ * transaction after a failed request, is split into, one for each partition
+ * that owns rows or granules the transaction holds locks on. The transaction
+ * is removed from the transaction table before the parts are sent, and the
+ * last part to finish releases its remaining locks, frees it and completes
+ * the original request.
+ */
+struct ReleaseRequest {
+  Job job;                                 // the original request
+  Node<Transaction>* node;                 // the removed transaction
+  std::vector<std::vector<int>> rows;      // locked rows of each partition
+  std::vector<std::vector<int>> granules;  // granule keys of each partition
+  std::atomic<int> pending;  // number of parts that did not finish yet
+};
+typedef struct ReleaseRequest ReleaseRequest;
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "common.h"
+#include "hashtable.h"
+#include "lock.h"
+
+/**
+ * A lock request that conflicts with the owners of its lock and waits until
+ * it can be granted
+ */
+struct Waiter {
+  Job job;
+  struct Waiter* next;
+};
+typedef struct Waiter Waiter;
+
+/**
+ * The lock requests that wait for the lock of a row, in the order they
+ * arrived. It only exists while at least one request waits, so the lock
+ * itself stays compact.
+ */
+struct WaitQueue {
+  Waiter* head;  // next request to be granted
+  Waiter* tail;  // request that arrived last
+};
+typedef struct WaitQueue WaitQueue;
+
+typedef HashTable<int, WaitQueue> WaitTable;  // RIDs to waiting requests
+
+/**
+ * Checks if a lock request may wait for the lock instead of failing. Requests
+ * follow the wait-die rule: a transaction only waits for transactions that are
+ * younger, i.e. that have a greater ID, than itself. This covers the owners of
+ * the lock as well as the requests that wait before it, so no two transactions
+ * ever wait for each other. An upgrade only waits for the other owners, as it
+ * is queued ahead of the waiting requests, which wait for it anyway.
+ *
+ * @param waitTable the requests waiting for the locks
+ * @param lock the requested lock, or nullptr if the row is not locked
+ * @param rowId identifies the requested row
+ * @param transactionId the transaction making the request
+ * @param isUpgrade if the transaction owns the lock already and requests
+ * exclusive access
+ */
+auto mayWait(WaitTable* waitTable, Lock* lock, int rowId, int transactionId,
+             bool isUpgrade) -> bool;
+
+/**
+ * Adds a lock request to the wait queue of its row. Requests are appended,
+ * upgrades are put in front of them, so that shared requests arriving after
+ * an upgrade cannot starve it.
+ *
+ * @param waitTable the requests waiting for the locks
+ * @param job the lock request, whose completion is signaled once it is granted
+ * @param isUpgrade if the transaction owns the lock already and requests
+ * exclusive access
+ */
+void enqueueWaiter(WaitTable* waitTable, Job& job, bool isUpgrade);
+
+/**
+ * Returns the request that waits longest for the lock of a row
+ *
+ * @param waitTable the requests waiting for the locks
+ * @param rowId identifies the row
+ * @returns the request, or nullptr if no request waits for the row
+ */
+auto firstWaiter(WaitTable* waitTable, int rowId) -> Job*;
+
+/**
+ * Removes the request returned by firstWaiter() from the wait queue of a row
+ *
+ * @param waitTable the requests waiting for the locks
+ * @param rowId identifies the row
+ */
+void dequeueWaiter(WaitTable* waitTable, int rowId);
+
+/**
+ * Frees the wait queue stored in an entry of a wait table, after calling
+ * the given function for each request that still waits
+ *
+ * @param entry the entry of the wait table
+ * @param cancel receives each waiting request, e.g. to signal its failure
+ */
+void destroyWaitQueue(Entry* entry, void (*cancel)(Job&));
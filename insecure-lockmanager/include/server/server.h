@@ -64,6 +64,45 @@ class LockingServiceImpl final : public LockingService::Service {
   auto LockShared(ServerContext* context, const LockRequest* request,
                   LockResponse* response) -> Status override;
 
+  /**
+   * Unpacks the LockRequest by a client to acquire a lock on a row, a page, a
+   * table or the database in the requested mode.
+   *
+   * @param context contains metadata about the request
+   * @param request containing transaction ID, granule, ID and mode of the
+   *                client request
+   * @param response contains if the lock was acquired successfully
+   * @return the status code of the RPC call (OK or a specific error code)
+   */
+  auto LockGranule(ServerContext* context, const LockRequest* request,
+                   LockResponse* response) -> Status override;
+
+  /**
+   * Unpacks the LockRequest by a client to acquire a shared or exclusive lock
+   * on a range of rows.
+   *
+   * @param context contains metadata about the request
+   * @param request containing transaction ID, first and last row and mode of
+   *                the client request
+   * @param response contains if the lock was acquired successfully
+   * @return the status code of the RPC call (OK or a specific error code)
+   */
+  auto LockRange(ServerContext* context, const LockRequest* request,
+                 LockResponse* response) -> Status override;
+
+  /**
+   * Unpacks the LockRequest by a client to release a range lock he acquired
+   * previously.
+   *
+   * @param context contains metadata about the request
+   * @param request containing transaction ID and first and last row of the
+   *                range
+   * @param response contains if the lock was released successfully
+   * @return the status code of the RPC call (OK or a specific error code)
+   */
+  auto UnlockRange(ServerContext* context, const LockRequest* request,
+                   LockResponse* response) -> Status override;
+
   /**
    * Unpacks the LockRequest by a client to release a lock he acquired
    * previously.
@@ -78,6 +117,30 @@ class LockingServiceImpl final : public LockingService::Service {
   auto Unlock(ServerContext* context, const LockRequest* request,
               LockResponse* response) -> Status override;
 
+  /**
+   * Unpacks the TransactionRequest by a client to release all locks of its
+   * transaction at once and to end it.
+   *
+   * @param context contains metadata about the request
+   * @param request containing transaction ID
+   * @param response only used for the status of the RPC call
+   * @return the status code of the RPC call (OK or a specific error code)
+   */
+  auto Commit(ServerContext* context, const TransactionRequest* request,
+              TransactionResponse* response) -> Status override;
+
+  /**
+   * Unpacks the TransactionRequest by a client to release all locks of its
+   * transaction at once and to abort it.
+   *
+   * @param context contains metadata about the request
+   * @param request containing transaction ID
+   * @param response only used for the status of the RPC call
+   * @return the status code of the RPC call (OK or a specific error code)
+   */
+  auto Abort(ServerContext* context, const TransactionRequest* request,
+             TransactionResponse* response) -> Status override;
+
  private:
   LockManager lockManager_;
 };
\ No newline at end of file
@@ -75,15 +75,101 @@ auto LockingServiceClient::requestExclusiveLock(unsigned int transactionId,
   return status.ok();
 }
 
+auto LockingServiceClient::requestGranuleLock(unsigned int transactionId,
+                                              GranuleLevel granule,
+                                              unsigned int id, GranuleMode mode,
+                                              bool waitForSignature) -> bool {
+  spdlog::info(
+      "Requesting granule lock (TXID: " + std::to_string(transactionId) +
+      ", GRANULE: " + GranuleLevel_Name(granule) +
+      ", ID: " + std::to_string(id) + ", MODE: " + GranuleMode_Name(mode) +
+      ")");
+  LockRequest request;
+  request.set_transaction_id(transactionId);
+  request.set_row_id(id);
+  request.set_granule(granule);
+  request.set_mode(mode);
+  request.set_wait_for_signature(waitForSignature);
+
+  LockResponse response;
+  ClientContext context;
+
+  Status status = stub_->LockGranule(&context, request, &response);
+
+  if (status.ok()) {
+    spdlog::info(
+        "Acquired granule lock (TXID: " + std::to_string(transactionId) +
+        ", GRANULE: " + GranuleLevel_Name(granule) +
+        ", ID: " + std::to_string(id) + ")");
+  }
+
+  return status.ok();
+}
+
+auto LockingServiceClient::requestRangeLock(unsigned int transactionId,
+                                            unsigned int firstRowId,
+                                            unsigned int lastRowId,
+                                            GranuleMode mode,
+                                            bool waitForSignature) -> bool {
+  spdlog::info(
+      "Requesting range lock (TXID: " + std::to_string(transactionId) +
+      ", RIDs: " + std::to_string(firstRowId) + ".." +
+      std::to_string(lastRowId) + ", MODE: " + GranuleMode_Name(mode) + ")");
+  LockRequest request;
+  request.set_transaction_id(transactionId);
+  request.set_row_id(firstRowId);
+  request.set_last_row_id(lastRowId);
+  request.set_mode(mode);
+  request.set_wait_for_signature(waitForSignature);
+
+  LockResponse response;
+  ClientContext context;
+
+  Status status = stub_->LockRange(&context, request, &response);
+
+  if (status.ok()) {
+    spdlog::info(
+        "Acquired range lock (TXID: " + std::to_string(transactionId) +
+        ", RIDs: " + std::to_string(firstRowId) + ".." +
+        std::to_string(lastRowId) + ")");
+  }
+
+  return status.ok();
+}
+
+auto LockingServiceClient::requestRangeUnlock(unsigned int transactionId,
+                                              unsigned int firstRowId,
+                                              unsigned int lastRowId,
+                                              bool waitForSignature) -> bool {
+  spdlog::info("Requesting to release a range lock (TXID: " +
+               std::to_string(transactionId) +
+               ", RIDs: " + std::to_string(firstRowId) + ".." +
+               std::to_string(lastRowId) + ")");
+  LockRequest request;
+  request.set_transaction_id(transactionId);
+  request.set_row_id(firstRowId);
+  request.set_last_row_id(lastRowId);
+  request.set_wait_for_signature(waitForSignature);
+
+  LockResponse response;
+  ClientContext context;
+
+  Status status = stub_->UnlockRange(&context, request, &response);
+
+  return status.ok();
+}
+
 auto LockingServiceClient::requestUnlock(unsigned int transactionId,
                                          unsigned int rowId,
-                                         bool waitForSignature) -> bool {
+                                         bool waitForSignature,
+                                         GranuleLevel granule) -> bool {
   spdlog::info(
       "Requesting to release a lock (TXID: " + std::to_string(transactionId) +
       ", RID: " + std::to_string(rowId) + ")");
   LockRequest request;
   request.set_transaction_id(transactionId);
   request.set_row_id(rowId);
+  request.set_granule(granule);
   request.set_wait_for_signature(waitForSignature);
 
   LockResponse response;
@@ -91,5 +177,33 @@ auto LockingServiceClient::requestUnlock(unsigned int transactionId,
 
   Status status = stub_->Unlock(&context, request, &response);
 
+  return status.ok();
+}
+
+auto LockingServiceClient::requestCommit(unsigned int transactionId) -> bool {
+  spdlog::info("Requesting to commit (TXID: " + std::to_string(transactionId) +
+               ")");
+  TransactionRequest request;
+  request.set_transaction_id(transactionId);
+
+  TransactionResponse response;
+  ClientContext context;
+
+  Status status = stub_->Commit(&context, request, &response);
+
+  return status.ok();
+}
+
+auto LockingServiceClient::requestAbort(unsigned int transactionId) -> bool {
+  spdlog::info("Requesting to abort (TXID: " + std::to_string(transactionId) +
+               ")");
+  TransactionRequest request;
+  request.set_transaction_id(transactionId);
+
+  TransactionResponse response;
+  ClientContext context;
+
+  Status status = stub_->Abort(&context, request, &response);
+
   return status.ok();
 }
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include "hashtable.h"
+
+#include <string.h>
+
+#ifdef FLAT_HASHTABLE
+
+#ifdef __SSE2__
+// Written with compiler vector extensions instead of intrinsics, because the
+// enclave is compiled without the compiler's system headers (-nostdinc)
+typedef char ControlGroup __attribute__((vector_size(kFlatGroupWidth)));
+#endif
+
+/**
+ * Scrambles the bits of the key (finalizer of MurmurHash3). All keys of a
+ * bucket share the same remainder of hash(), so the position inside the
+ * bucket must not be derived from the lower bits of the key alone.
+ */
+static auto mix(int key) -> unsigned int {
+  auto h = (unsigned int)key;
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+// The 7 most significant bits of the mixed key are used as its tag
+static auto tag(unsigned int h) -> signed char {
+  return (signed char)(h >> 25);
+}
+
+static auto newFlatBucket(int capacity) -> FlatBucket* {
+  // Round the control bytes up to 8 bytes so that the slots stay aligned
+  size_t ctrlSize = (capacity + kFlatGroupWidth - 1 + 7) & ~(size_t)7;
+  char* memory = (char*)malloc(sizeof(FlatBucket) + ctrlSize +
+                               capacity * sizeof(FlatSlot));
+
+  auto bucket = (FlatBucket*)memory;
+  bucket->capacity = capacity;
+  bucket->count = 0;
+  bucket->ctrl = (signed char*)(memory + sizeof(FlatBucket));
+  bucket->slots = (FlatSlot*)(memory + sizeof(FlatBucket) + ctrlSize);
+  memset(bucket->ctrl, kEmpty, capacity + kFlatGroupWidth - 1);
+  return bucket;
+}
+
+static void setCtrl(FlatBucket* bucket, int index, signed char value) {
+  bucket->ctrl[index] = value;
+  if (index < kFlatGroupWidth - 1) {
+    bucket->ctrl[bucket->capacity + index] = value;  // mirrored byte
+  }
+}
+
+/**
+ * Compares kFlatGroupWidth control bytes starting at group with the given
+ * value.
+ *
+ * @returns a bit mask, where bit i is set if group[i] equals value
+ */
+static auto match(const signed char* group, signed char value)
+    -> unsigned int {
+#ifdef __SSE2__
+  ControlGroup ctrl;
+  memcpy(&ctrl, group, sizeof(ControlGroup));
+  return __builtin_ia32_pmovmskb128((ControlGroup)(ctrl == (char)value));
+#else
+  unsigned int mask = 0;
+  for (int i = 0; i < kFlatGroupWidth; i++) {
+    if (group[i] == value) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+/**
+ * Finds the slot of the given key within the bucket.
+ *
+ * @returns the index of the slot or -1, when the key is not in the bucket
+ */
+static auto find(FlatBucket* bucket, int key) -> int {
+  int mask = bucket->capacity - 1;
+  unsigned int h = mix(key);
+  int position = h & mask;
+
+  while (true) {
+    const signed char* group = bucket->ctrl + position;
+    unsigned int candidates = match(group, tag(h));
+    unsigned int empty = match(group, kEmpty);
+    if (empty != 0) {
+      // Linear probing never leaves a gap between a key and its home slot, so
+      // the key cannot be stored behind the first free slot
+      candidates &= (empty & (0u - empty)) - 1;
+    }
+
+    while (candidates != 0) {
+      int index = (position + __builtin_ctz(candidates)) & mask;
+      if (bucket->slots[index].key == key) {
+        return index;
+      }
+      candidates &= candidates - 1;
+    }
+
+    if (empty != 0) {
+      return -1;
+    }
+    position = (position + kFlatGroupWidth) & mask;
+  }
+}
+
+/**
+ * Stores the entry in the first free slot at or behind its home slot. The
+ * caller has to make sure that the key is not yet in the bucket and that the
+ * bucket has a free slot.
+ */
+static void insert(FlatBucket* bucket, Entry* entry) {
+  int mask = bucket->capacity - 1;
+  unsigned int h = mix(entry->key);
+  int position = h & mask;
+
+  unsigned int empty;
+  while ((empty = match(bucket->ctrl + position, kEmpty)) == 0) {
+    position = (position + kFlatGroupWidth) & mask;
+  }
+
+  int index = (position + __builtin_ctz(empty)) & mask;
+  setCtrl(bucket, index, tag(h));
+  bucket->slots[index].key = entry->key;
+  bucket->slots[index].entry = entry;
+  bucket->count++;
+}
+
+/**
+ * Moves all entries of the bucket into a new bucket with twice the capacity.
+ * Only the entries of this bucket are rehashed, so growing never blocks
+ * requests for other buckets.
+ */
+static auto grow(FlatBucket* bucket) -> FlatBucket* {
+  FlatBucket* grown = newFlatBucket(bucket->capacity * 2);
+  for (int i = 0; i < bucket->capacity; i++) {
+    if (bucket->ctrl[i] != kEmpty) {
+      insert(grown, bucket->slots[i].entry);
+    }
+  }
+  free(bucket);
+  return grown;
+}
+
+void initHashTable(HashTableBase* hashTable, int size) {
+  hashTable->size = size;
+  hashTable->table = new FlatBucket*[size];
+  for (int i = 0; i < size; i++) {
+    hashTable->table[i] = nullptr;
+  }
+}
+
+void destroyHashTable(HashTableBase* hashTable, void (*deleteEntry)(Entry*)) {
+  for (int i = 0; i < hashTable->size; i++) {
+    FlatBucket* bucket = hashTable->table[i];
+    if (bucket == nullptr) {
+      continue;
+    }
+    for (int j = 0; j < bucket->capacity; j++) {
+      if (bucket->ctrl[j] != kEmpty) {
+        deleteEntry(bucket->slots[j].entry);
+      }
+    }
+    free(bucket);
+  }
+  delete[] hashTable->table;
+}
+
+int hash(int size, int key) {
+  return (int)(hashKey(key) % (unsigned int)size);
+}
+
+auto findEntry(HashTableBase* hashTable, int key) -> Entry* {
+  FlatBucket* bucket = hashTable->table[hash(hashTable->size, key)];
+  if (bucket == nullptr) {
+    return nullptr;
+  }
+
+  int index = find(bucket, key);
+  if (index < 0) {
+    return nullptr;
+  }
+  return bucket->slots[index].entry;
+}
+
+void findEntries(HashTableBase* hashTable, const int* keys, int n,
+                 Entry** entries) {
+  int positions[kLookupBatchSize];
+  for (int i = 0; i < n; i++) {
+    positions[i] = hash(hashTable->size, keys[i]);
+    __builtin_prefetch(&hashTable->table[positions[i]]);
+  }
+
+  FlatBucket* buckets[kLookupBatchSize];
+  for (int i = 0; i < n; i++) {
+    buckets[i] = hashTable->table[positions[i]];
+    __builtin_prefetch(buckets[i]);
+  }
+
+  // Prefetch the first group of control bytes and the home slot of each key
+  for (int i = 0; i < n; i++) {
+    if (buckets[i] != nullptr) {
+      int home = mix(keys[i]) & (buckets[i]->capacity - 1);
+      __builtin_prefetch(buckets[i]->ctrl + home);
+      __builtin_prefetch(&buckets[i]->slots[home]);
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    int index = buckets[i] == nullptr ? -1 : find(buckets[i], keys[i]);
+    entries[i] = index < 0 ? nullptr : buckets[i]->slots[index].entry;
+    __builtin_prefetch(entries[i]);
+  }
+}
+
+auto insertEntry(HashTableBase* hashTable, Entry* entry) -> Entry* {
+  int position = hash(hashTable->size, entry->key);
+  FlatBucket* bucket = hashTable->table[position];
+
+  if (bucket == nullptr) {
+    bucket = newFlatBucket(kFlatMinCapacity);
+    hashTable->table[position] = bucket;
+  } else {
+    int index = find(bucket, entry->key);
+    if (index >= 0) {
+      return bucket->slots[index].entry;  // key already exists
+    }
+  }
+
+  // Keep the load factor below 7/8, so that probing stays short and every
+  // probe sequence ends at a free slot
+  if ((bucket->count + 1) * 8 > bucket->capacity * 7) {
+    bucket = grow(bucket);
+    hashTable->table[position] = bucket;
+  }
+
+  entry->next = nullptr;
+  insert(bucket, entry);
+  return entry;
+}
+
+auto extractEntry(HashTableBase* hashTable, int key) -> Entry* {
+  int position = hash(hashTable->size, key);
+  FlatBucket* bucket = hashTable->table[position];
+
+  if (bucket == nullptr) {
+    return nullptr;
+  }
+
+  int hole = find(bucket, key);
+  if (hole < 0) {
+    return nullptr;
+  }
+  Entry* entry = bucket->slots[hole].entry;
+
+  if (bucket->count == 1) {
+    // Release the memory of buckets that become empty
+    free(bucket);
+    hashTable->table[position] = nullptr;
+    return entry;
+  }
+
+  // Instead of leaving a tombstone, shift back the following entries of the
+  // probe sequence, as long as this does not move them before their home slot
+  int mask = bucket->capacity - 1;
+  int next = (hole + 1) & mask;
+  while (bucket->ctrl[next] != kEmpty) {
+    int home = mix(bucket->slots[next].key) & mask;
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      bucket->slots[hole] = bucket->slots[next];
+      setCtrl(bucket, hole, bucket->ctrl[next]);
+      hole = next;
+    }
+    next = (next + 1) & mask;
+  }
+
+  setCtrl(bucket, hole, kEmpty);
+  bucket->count--;
+  return entry;
+}
+
+auto bucketStatistics(HashTableBase* hashTable) -> BucketStatistics {
+  BucketStatistics statistics = {};
+  for (int i = 0; i < hashTable->size; i++) {
+    FlatBucket* bucket = hashTable->table[i];
+    countBucket(&statistics, bucket == nullptr ? 0 : bucket->count);
+  }
+  return statistics;
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "granule.h"
+
+// Modes that can be held together, indexed by the held and the requested mode
+static constexpr bool kCompatible[kNumLockModes][kNumLockModes] = {
+    //  IS     IX     S      SIX    X      U
+    {true, true, true, true, false, true},       // IS
+    {true, true, false, false, false, false},    // IX
+    {true, false, true, false, false, true},     // S
+    {true, false, false, false, false, false},   // SIX
+    {false, false, false, false, false, false},  // X
+    {true, false, true, false, false, false},    // U
+};
+
+// Modes a lock is converted into, indexed by the held and the requested mode
+// in the same order as above
+static constexpr LockMode kConversion[kNumLockModes][kNumLockModes] = {
+    {IS_LOCK, IX_LOCK, S_LOCK, SIX_LOCK, X_LOCK, U_LOCK},        // IS
+    {IX_LOCK, IX_LOCK, SIX_LOCK, SIX_LOCK, X_LOCK, SIX_LOCK},    // IX
+    {S_LOCK, SIX_LOCK, S_LOCK, SIX_LOCK, X_LOCK, U_LOCK},        // S
+    {SIX_LOCK, SIX_LOCK, SIX_LOCK, SIX_LOCK, X_LOCK, SIX_LOCK},  // SIX
+    {X_LOCK, X_LOCK, X_LOCK, X_LOCK, X_LOCK, X_LOCK},            // X
+    {U_LOCK, SIX_LOCK, U_LOCK, SIX_LOCK, X_LOCK, U_LOCK},        // U
+};
+
+/**
+ * Checks at compile time that both tables are symmetric, so a new mode cannot
+ * be added to only one of its rows and columns
+ */
+static constexpr auto isSymmetric() -> bool {
+  for (int held = 0; held < kNumLockModes; held++) {
+    for (int requested = 0; requested < kNumLockModes; requested++) {
+      if (kCompatible[held][requested] != kCompatible[requested][held] ||
+          kConversion[held][requested] != kConversion[requested][held]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+static_assert(isSymmetric(), "lock modes must be added to rows and columns");
+
+auto parentOf(Granule granule, unsigned int id) -> unsigned int {
+  switch (granule) {
+    case ROW:
+      return id / kRowsPerPage;
+    case PAGE:
+      return id / kPagesPerTable;
+    default:
+      return 0;
+  }
+}
+
+auto tableOf(unsigned int rowId) -> unsigned int {
+  return parentOf(PAGE, parentOf(ROW, rowId));
+}
+
+void countRows(RowCounts* rows, bool isExclusive, int delta) {
+  if (isExclusive) {
+    rows->exclusive += delta;
+  } else {
+    rows->shared += delta;
+  }
+}
+
+auto isCompatible(LockMode held, LockMode requested) -> bool {
+  return kCompatible[held][requested];
+}
+
+auto strongestOf(LockMode a, LockMode b) -> LockMode {
+  return kConversion[a][b];
+}
+
+auto allowsChild(LockMode parentMode, LockMode requested) -> bool {
+  if (requested == IS_LOCK || requested == S_LOCK) {
+    return true;  // every mode implies IS
+  }
+  return parentMode == IX_LOCK || parentMode == SIX_LOCK ||
+         parentMode == X_LOCK;
+}
+
+void initGranuleLock(GranuleLock* lock) {
+  for (int mode = 0; mode < kNumLockModes; mode++) {
+    lock->holders[mode] = 0;
+  }
+  lock->rows = {0, 0};
+}
+
+auto conflictsWithHolders(GranuleLock* lock, LockMode* held,
+                          LockMode requested) -> bool {
+  // The own lock of a converting transaction does not conflict with it
+  for (int other = 0; other < kNumLockModes; other++) {
+    unsigned int holders = lock->holders[other];
+    if (held != nullptr && *held == other) {
+      holders--;
+    }
+    if (holders > 0 && !isCompatible((LockMode)other, requested)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+auto conflictsWithRows(GranuleLock* lock, RowCounts own, LockMode requested)
+    -> bool {
+  return (lock->rows.shared > own.shared &&
+          !isCompatible(IS_LOCK, requested)) ||
+         (lock->rows.exclusive > own.exclusive &&
+          !isCompatible(IX_LOCK, requested));
+}
+
+auto acquireGranule(GranuleLock* lock, LockMode* held, LockMode requested)
+    -> bool {
+  LockMode mode = held == nullptr ? requested : strongestOf(*held, requested);
+  if (conflictsWithHolders(lock, held, mode)) {
+    return false;
+  }
+
+  if (held != nullptr) {
+    lock->holders[*held]--;
+    *held = mode;
+  }
+  lock->holders[mode]++;
+  return true;
+}
+
+void releaseGranule(GranuleLock* lock, LockMode held) {
+  if (lock->holders[held] > 0) {
+    lock->holders[held]--;
+  }
+}
+
+auto numHolders(GranuleLock* lock) -> int {
+  int holders = 0;
+  for (int mode = 0; mode < kNumLockModes; mode++) {
+    holders += lock->holders[mode];
+  }
+  return holders;
+}
+
+auto isUnused(GranuleLock* lock) -> bool {
+  return numHolders(lock) == 0 && lock->rows.shared == 0 &&
+         lock->rows.exclusive == 0;
+}
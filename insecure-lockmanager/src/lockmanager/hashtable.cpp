@@ -1,98 +1,255 @@
 #include "hashtable.h"
 
-HashTable* newHashTable(int size) {
-  HashTable* hashTable = new HashTable();
-  hashTable->size = size;
-  hashTable->table = new Entry*[size];
-  for (int i = 0; i < size; i++) {
-    hashTable->table[i] = nullptr;
+#ifndef FLAT_HASHTABLE
+
+/**
+ * Returns the position of the head of a bucket, so that it can be read or
+ * replaced.
+ *
+ * @param hashTable the table containing the bucket
+ * @param group the bucket group, i.e. hash() of the key
+ * @param bucket the index of the bucket within its group
+ */
+static auto bucketHead(HashTableBase* hashTable, int group, int bucket)
+    -> Entry** {
+  if (bucket == 0) {
+    return &hashTable->heads[group];
   }
-  return hashTable;
-};
+  int segment = 32 - __builtin_clz(bucket);
+  return &hashTable->groups[group]
+              .segments[segment - 1][bucket - (1 << (segment - 1))];
+}
 
-Entry* newEntry(int key, void* value) {
-  Entry* entry = new Entry();
-  entry->key = key;
-  entry->value = value;
-  return entry;
+/**
+ * Returns the index of the bucket within its group that the key belongs to.
+ * As all keys of a group share the same remainder of hash(), the buckets are
+ * chosen by the quotient of the scrambled key instead.
+ */
+static auto bucketOf(HashTableBase* hashTable, int group, int key) -> int {
+  BucketGroup* state = &hashTable->groups[group];
+  unsigned int quotient = hashKey(key) / hashTable->size;
+  unsigned int bucket = quotient & ((1u << state->level) - 1);
+  if (bucket < (unsigned int)state->split) {
+    bucket = quotient & ((2u << state->level) - 1);
+  }
+  return bucket;
 }
 
-int hash(int size, int key) { return key % size; }
+static auto bucketHead(HashTableBase* hashTable, int key) -> Entry** {
+  int group = hash(hashTable->size, key);
+  return bucketHead(hashTable, group, bucketOf(hashTable, group, key));
+}
 
-auto get(HashTable* hashTable, int key) -> void* {
-  Entry* entry = hashTable->table[hash(hashTable->size, key)];
-  return get(entry, key);
+/**
+ * Allocates the segment of a group that holds the buckets 2^(segment-1) to
+ * 2^segment - 1, unless it already exists. Only the thread owning the group
+ * grows it, so no other thread allocates the same segment.
+ */
+static void allocateSegment(BucketGroup* state, int segment) {
+  if (state->segments == nullptr) {
+    state->segments = new Entry**[HASHTABLE_MAX_LEVELS - 1]();
+  }
+  if (state->segments[segment - 1] == nullptr) {
+    state->segments[segment - 1] = new Entry*[1 << (segment - 1)]();
+  }
 }
 
-auto get(Entry* entry, int key) -> void* {
+/**
+ * Splits the next bucket of the group into itself and a new bucket. Only the
+ * entries of that single bucket are moved, in their original order.
+ */
+static void split(HashTableBase* hashTable, int group) {
+  BucketGroup* state = &hashTable->groups[group];
+  if (state->level + 1 >= HASHTABLE_MAX_LEVELS) {
+    return;
+  }
+  allocateSegment(state, state->level + 1);
+
+  Entry** stay = bucketHead(hashTable, group, state->split);
+  Entry** move =
+      bucketHead(hashTable, group, state->split + (1 << state->level));
+  Entry* entry = *stay;
   while (entry != nullptr) {
-    if (entry->key == key) {
-      return entry->value;
+    unsigned int quotient = hashKey(entry->key) / hashTable->size;
+    if ((quotient >> state->level) & 1) {
+      *move = entry;
+      move = &entry->next;
+    } else {
+      *stay = entry;
+      stay = &entry->next;
     }
     entry = entry->next;
   }
-  return nullptr;
-}
+  *stay = nullptr;
+  *move = nullptr;
 
-void set(HashTable* hashTable, int key, void* value) {
-  Entry* entry = hashTable->table[hash(hashTable->size, key)];
+  state->split++;
+  if (state->split == 1 << state->level) {
+    state->level++;
+    state->split = 0;
+  }
+}
 
-  Entry* entryToInsert = new Entry();
-  entryToInsert->key = key;
-  entryToInsert->value = value;
-  entryToInsert->next = nullptr;
+void initHashTable(HashTableBase* hashTable, int size) {
+  hashTable->size = size;
+  hashTable->heads = new Entry*[size]();
+  hashTable->groups = new BucketGroup[size]();
+}
 
-  if (entry == nullptr) {
-    hashTable->table[hash(hashTable->size, key)] = entryToInsert;
-    return;
+/**
+ * Frees the entries of an array of buckets
+ */
+static void destroyBuckets(Entry** buckets, long numBuckets,
+                           void (*deleteEntry)(Entry*)) {
+  for (long i = 0; i < numBuckets; i++) {
+    Entry* entry = buckets[i];
+    while (entry != nullptr) {
+      Entry* next = entry->next;
+      deleteEntry(entry);
+      entry = next;
+    }
   }
+}
 
-  while (entry->next != nullptr) {
-    if (entry->key == key) {
-      delete entryToInsert;
-      return;  // key already exists
+void destroyHashTable(HashTableBase* hashTable, void (*deleteEntry)(Entry*)) {
+  destroyBuckets(hashTable->heads, hashTable->size, deleteEntry);
+  delete[] hashTable->heads;
+  for (int group = 0; group < hashTable->size; group++) {
+    Entry*** segments = hashTable->groups[group].segments;
+    if (segments == nullptr) {
+      continue;
     }
-    entry = entry->next;
+    for (int segment = 1; segment < HASHTABLE_MAX_LEVELS; segment++) {
+      if (segments[segment - 1] != nullptr) {
+        destroyBuckets(segments[segment - 1], 1L << (segment - 1),
+                       deleteEntry);
+        delete[] segments[segment - 1];
+      }
+    }
+    delete[] segments;
   }
-
-  entry->next = entryToInsert;  // Add new entry at the end of the list
+  delete[] hashTable->groups;
 }
 
-auto contains(HashTable* hashTable, int key) -> bool {
-  Entry* entry = hashTable->table[hash(hashTable->size, key)];
+int hash(int size, int key) {
+  return (int)(hashKey(key) % (unsigned int)size);
+}
 
-  while (entry != nullptr) {
-    if (entry->key == key) {
-      return true;
-    }
+auto findEntry(HashTableBase* hashTable, int key) -> Entry* {
+  Entry* entry = *bucketHead(hashTable, key);
+  while (entry != nullptr && entry->key != key) {
     entry = entry->next;
   }
+  return entry;
+}
+
+void findEntries(HashTableBase* hashTable, const int* keys, int n,
+                 Entry** entries) {
+  int groups[kLookupBatchSize];
+  for (int i = 0; i < n; i++) {
+    groups[i] = hash(hashTable->size, keys[i]);
+    __builtin_prefetch(&hashTable->groups[groups[i]]);
+  }
+
+  Entry** heads[kLookupBatchSize];
+  for (int i = 0; i < n; i++) {
+    heads[i] = bucketHead(hashTable, groups[i],
+                          bucketOf(hashTable, groups[i], keys[i]));
+    __builtin_prefetch(heads[i]);
+  }
+
+  for (int i = 0; i < n; i++) {
+    entries[i] = *heads[i];
+    __builtin_prefetch(entries[i]);
+  }
 
-  return false;
+  // Advance every walk that has not reached its key or the end of its bucket
+  // by one entry per round, so that a long bucket does not stall the others
+  bool walking = true;
+  while (walking) {
+    walking = false;
+    for (int i = 0; i < n; i++) {
+      if (entries[i] != nullptr && entries[i]->key != keys[i]) {
+        entries[i] = entries[i]->next;
+        __builtin_prefetch(entries[i]);
+        walking = true;
+      }
+    }
+  }
 }
 
-void remove(HashTable* hashTable, int key) {
-  Entry* entry = hashTable->table[hash(hashTable->size, key)];
+auto insertEntry(HashTableBase* hashTable, Entry* entry) -> Entry* {
+  Entry** position = bucketHead(hashTable, entry->key);
 
-  if (entry == nullptr) {
-    return;
+  while (*position != nullptr) {
+    if ((*position)->key == entry->key) {
+      return *position;  // key already exists
+    }
+    position = &(*position)->next;
+  }
+  entry->next = nullptr;
+  *position = entry;  // Add new entry at the end of the list
+
+  // Grow the group step by step, so that no single request has to pay for
+  // rehashing more than a few buckets
+  int group = hash(hashTable->size, entry->key);
+  BucketGroup* state = &hashTable->groups[group];
+  state->count++;
+  for (int i = 0; i < kSplitsPerOperation &&
+                  state->count > kMaxLoadFactor *
+                                     ((1 << state->level) + state->split);
+       i++) {
+    split(hashTable, group);
   }
+  return entry;
+}
 
-  if (entry->key == key) {
-    hashTable->table[hash(hashTable->size, key)] = entry->next;
-    delete entry;
-    return;
+auto extractEntry(HashTableBase* hashTable, int key) -> Entry* {
+  Entry** position = bucketHead(hashTable, key);
+
+  while (*position != nullptr) {
+    Entry* entry = *position;
+    if (entry->key == key) {
+      *position = entry->next;
+      hashTable->groups[hash(hashTable->size, key)].count--;
+      return entry;
+    }
+    position = &entry->next;
   }
+  return nullptr;
+}
 
-  Entry* next = entry->next;
-  while (next != nullptr) {
-    if (next->key == key) {
-      // delete it and return
-      entry->next = next->next;
-      delete next;
-      return;
+auto bucketStatistics(HashTableBase* hashTable) -> BucketStatistics {
+  BucketStatistics statistics = {};
+  for (int group = 0; group < hashTable->size; group++) {
+    BucketGroup* state = &hashTable->groups[group];
+    for (int bucket = 0; bucket < (1 << state->level) + state->split;
+         bucket++) {
+      unsigned long length = 0;
+      for (Entry* entry = *bucketHead(hashTable, group, bucket);
+           entry != nullptr; entry = entry->next) {
+        length++;
+      }
+      countBucket(&statistics, length);
     }
-    entry = next;
-    next = entry->next;
   }
-}
\ No newline at end of file
+  return statistics;
+}
+
+#endif
+
+void countBucket(BucketStatistics* statistics, unsigned long length) {
+  statistics->buckets++;
+  statistics->entries += length;
+  if (length > statistics->max_length) {
+    statistics->max_length = length;
+  }
+  statistics->histogram[length < BUCKET_HISTOGRAM_SIZE
+                            ? length
+                            : BUCKET_HISTOGRAM_SIZE - 1]++;
+}
+
+auto meanBucketLength(BucketStatistics* statistics) -> double {
+  unsigned long used = statistics->buckets - statistics->histogram[0];
+  return used == 0 ? 0 : (double)statistics->entries / used;
+}
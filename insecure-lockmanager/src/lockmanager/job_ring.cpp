@@ -0,0 +1,105 @@
+#include "job_ring.h"
+
+#include <algorithm>
+#include <thread>
+
+/**
+ * Tells the CPU that the thread is polling, which saves power and frees the
+ * pipeline for a sibling hyperthread
+ */
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+/**
+ * Returns true, if the job at the head of the ring was published
+ */
+static inline auto hasJob(JobRing* ring) -> bool {
+  JobSlot* slot = &ring->slots[ring->head & (kJobRingSize - 1)];
+  return slot->sequence.load(std::memory_order_acquire) == ring->head + 1;
+}
+
+void initJobRing(JobRing* ring) {
+  ring->slots = new JobSlot[kJobRingSize];
+  for (int i = 0; i < kJobRingSize; i++) {
+    ring->slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  ring->tail.store(0, std::memory_order_relaxed);
+  ring->head = 0;
+  ring->spins = kMinJobRingSpins;
+  ring->sleeping.store(false, std::memory_order_relaxed);
+}
+
+void destroyJobRing(JobRing* ring) {
+  delete[] ring->slots;
+  ring->slots = nullptr;
+}
+
+auto pushJob(JobRing* ring, const Job& job) -> bool {
+  unsigned long position = ring->tail.load(std::memory_order_relaxed);
+  JobSlot* slot;
+  while (true) {
+    slot = &ring->slots[position & (kJobRingSize - 1)];
+    long difference =
+        (long)slot->sequence.load(std::memory_order_acquire) - (long)position;
+    if (difference == 0) {
+      if (ring->tail.compare_exchange_weak(position, position + 1,
+                                           std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // The ring is full until the consumer took the job of the last round,
+      // which may need the core of this thread
+      std::this_thread::yield();
+      position = ring->tail.load(std::memory_order_relaxed);
+    } else {
+      position = ring->tail.load(std::memory_order_relaxed);
+    }
+  }
+  slot->job = job;
+  slot->sequence.store(position + 1, std::memory_order_release);
+
+  // Either the consumer sees the job before it sleeps, or the producer sees
+  // that it sleeps, see announceSleep()
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return ring->sleeping.load(std::memory_order_relaxed);
+}
+
+auto popJobs(JobRing* ring, Job* jobs, int maxJobs) -> int {
+  int numJobs = 0;
+  while (numJobs < maxJobs && hasJob(ring)) {
+    JobSlot* slot = &ring->slots[ring->head & (kJobRingSize - 1)];
+    jobs[numJobs++] = slot->job;
+    slot->sequence.store(ring->head + kJobRingSize, std::memory_order_release);
+    ring->head++;
+  }
+  return numJobs;
+}
+
+auto spinForJobs(JobRing* ring) -> bool {
+  for (int i = 0; i < ring->spins; i++) {
+    if (hasJob(ring)) {
+      ring->spins = std::min(2 * ring->spins, kMaxJobRingSpins);
+      return true;
+    }
+    cpuRelax();
+  }
+  ring->spins = std::max(ring->spins / 2, kMinJobRingSpins);
+  return false;
+}
+
+auto announceSleep(JobRing* ring) -> bool {
+  ring->sleeping.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (hasJob(ring)) {
+    ring->sleeping.store(false, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void cancelSleep(JobRing* ring) {
+  ring->sleeping.store(false, std::memory_order_relaxed);
+}
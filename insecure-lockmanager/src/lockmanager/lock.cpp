@@ -1,40 +1,152 @@
 #include "lock.h"
 
+#include "pool.h"
+
+/**
+ * Returns the position of the owner with the given index
+ */
+static auto ownerSlot(Lock* lock, int index) -> int* {
+  if (index < kInlineOwners) {
+    return &lock->owners[index];
+  }
+  return &lock->overflow[1 + index - kInlineOwners];
+}
+
+/**
+ * Replaces the overflow array of a lock with one of the given capacity, which
+ * must be large enough for all of its owners. Frees the overflow array, if the
+ * capacity is 0.
+ */
+static void resizeOverflow(Lock* lock, int capacity) {
+  int* overflow = nullptr;
+  if (capacity > 0) {
+    overflow = (int*)poolAllocate(sizeof(int) * (capacity + 1));
+    overflow[0] = capacity;
+    for (int i = kInlineOwners; i < numOwners(lock); i++) {
+      overflow[1 + i - kInlineOwners] = *ownerSlot(lock, i);
+    }
+  }
+  if (lock->overflow != nullptr) {
+    poolFree(lock->overflow, sizeof(int) * (lock->overflow[0] + 1));
+  }
+  lock->overflow = overflow;
+}
+
+auto ownerAt(Lock* lock, int index) -> int { return *ownerSlot(lock, index); }
+
+auto isOwner(Lock* lock, int transactionId) -> bool {
+  int count = numOwners(lock);
+  for (int i = 0; i < count; i++) {
+    if (*ownerSlot(lock, i) == transactionId) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void initLock(Lock* lock) {
+  lock->word = 0;
+  for (int i = 0; i < kInlineOwners; i++) {
+    lock->owners[i] = 0;
+  }
+  lock->updater = 0;
+  lock->overflow = nullptr;
+}
+
 Lock* newLock() {
-  Lock* lock = new Lock();
-  lock->exclusive = false;
+  Lock* lock = poolNew<Lock>();
+  initLock(lock);
   return lock;
 }
 
+void destroyLock(Lock* lock) { resizeOverflow(lock, 0); }
+
+void deleteLock(Lock* lock) {
+  if (lock != nullptr) {
+    destroyLock(lock);
+  }
+  poolDelete(lock);
+}
+
 auto getSharedAccess(Lock* lock, int transactionId) -> bool {
-  if (!lock->exclusive) {
-    lock->owners.insert(transactionId);
+  unsigned int word = __atomic_load_n(&lock->word, __ATOMIC_ACQUIRE);
+  if ((word & kExclusiveBit) != 0) {
+    return false;
+  }
+  if (isOwner(lock, transactionId)) {
     return true;
   }
-  return false;
+
+  // Append the owner, doubling the overflow array when it is full. The count
+  // only covers the slot once it holds the owner.
+  int count = word & kOwnerCountMask;
+  int capacity = lock->overflow == nullptr ? 0 : lock->overflow[0];
+  if (count >= kInlineOwners && count - kInlineOwners == capacity) {
+    resizeOverflow(lock, capacity == 0 ? kInlineOwners : 2 * capacity);
+  }
+  *ownerSlot(lock, count) = transactionId;
+  __atomic_store_n(&lock->word, word + 1, __ATOMIC_RELEASE);
+  return true;
 };
 
 auto getExclusiveAccess(Lock* lock, int transactionId) -> bool {
-  if (lock->owners.size() == 0) {
-    lock->exclusive = true;
-    lock->owners.insert(transactionId);
+  unsigned int word = 0;
+  if (__atomic_compare_exchange_n(&lock->word, &word, kExclusiveBit | 1, false,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    lock->owners[0] = transactionId;
     return true;
   }
   return false;
 };
 
+auto getUpdateAccess(Lock* lock, int transactionId) -> bool {
+  unsigned int word = __atomic_load_n(&lock->word, __ATOMIC_ACQUIRE);
+  if ((word & (kExclusiveBit | kUpdateBit)) != 0) {
+    return false;
+  }
+
+  // The caller serializes all operations on the lock with this one
+  if (!getSharedAccess(lock, transactionId)) {
+    return false;
+  }
+  lock->updater = transactionId;
+  __atomic_fetch_or(&lock->word, kUpdateBit, __ATOMIC_ACQ_REL);
+  return true;
+};
+
 auto upgrade(Lock* lock, int transactionId) -> bool {
-  if (lock->owners.size() == 1 &&
-      lock->owners.find(transactionId) != lock->owners.end()) {
-    lock->exclusive = true;
+  if (numOwners(lock) == 1 && lock->owners[0] == transactionId) {
+    __atomic_store_n(&lock->word, kExclusiveBit | 1, __ATOMIC_RELEASE);
     return true;
   }
   return false;
 };
 
 void release(Lock* lock, int transactionId) {
-  if (lock->owners.find(transactionId) != lock->owners.end()) {
-    lock->owners.erase(transactionId);
-    lock->exclusive = false;
+  int count = numOwners(lock);
+  unsigned int update = __atomic_load_n(&lock->word, __ATOMIC_ACQUIRE) &
+                        kUpdateBit;
+  if (isUpdater(lock, transactionId)) {
+    update = 0;
+  }
+  for (int i = 0; i < count; i++) {
+    if (*ownerSlot(lock, i) == transactionId) {
+      for (int j = i; j < count - 1; j++) {
+        *ownerSlot(lock, j) = *ownerSlot(lock, j + 1);
+      }
+      count--;
+      __atomic_store_n(&lock->word, (unsigned int)count | update,
+                       __ATOMIC_RELEASE);
+
+      // Shrink the overflow array once it is only a quarter full
+      int capacity = lock->overflow == nullptr ? 0 : lock->overflow[0];
+      if (count <= kInlineOwners) {
+        resizeOverflow(lock, 0);
+      } else if (capacity > kInlineOwners &&
+                 4 * (count - kInlineOwners) <= capacity) {
+        resizeOverflow(lock, capacity / 2);
+      }
+      return;
+    }
   }
-}
\ No newline at end of file
+}
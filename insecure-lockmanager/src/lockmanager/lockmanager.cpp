@@ -2,29 +2,136 @@
 
 size_t transactionTableSize_;
 size_t lockTableSize_;
+
+/**
+ * Frees an entry of the lock table together with the overflow array of its
+ * lock
+ */
+static void delete_locktable_entry(Entry *entry) {
+  Node<Lock> *node = nodeOf<Lock>(entry);
+  destroyLock(&node->value);
+  poolDelete(node);
+}
+
+/**
+ * Marks a request as finished and wakes up the client waiting for it, if it
+ * parked already
+ */
+static void finish_job(const Job &job) {
+  if (finishCompletion(job.finished)) {
+    wakeCompletion(job.finished);
+  }
+}
+
+/**
+ * Hands the result of a lock request to the client waiting for it
+ */
+static void complete_job(Job &job, bool ok) {
+  if (job.wait_for_result) {
+    if (!ok) {
+      *job.error = true;
+    }
+    finish_job(job);
+  }
+}
+
+/**
+ * Checks if a lock request asks for sole write access to its row
+ */
+static auto is_exclusive(const Job &job) -> bool {
+  return job.command == EXCLUSIVE ||
+         (job.command == LOCK_GRANULE && job.mode == X_LOCK);
+}
+
+/**
+ * Returns the mode a lock request asks for on its row
+ */
+static auto row_mode(const Job &job) -> LockMode {
+  if (job.command == LOCK_GRANULE) {
+    return job.mode;
+  }
+  return job.command == EXCLUSIVE ? X_LOCK : S_LOCK;
+}
+
+/**
+ * Returns the key that decides which worker thread and stripe serve a job.
+ * Rows keep their ID, so they are served the same way with either lock().
+ */
+static auto job_key(const Job &job) -> unsigned int {
+  return job.granule == ROW ? job.row_id
+                            : (unsigned int)granuleKey(job.granule, job.row_id);
+}
+
+/**
+ * Checks if the IDs of a request fit into the keys of the lock tables, see
+ * granuleKey()
+ */
+static auto has_valid_ids(const Job &job) -> bool {
+  bool isRange = job.command == LOCK_RANGE || job.command == UNLOCK_RANGE;
+  return job.row_id <= kMaxGranuleId &&
+         (!isRange || job.last_row_id <= kMaxGranuleId);
+}
+
+/**
+ * Frees an entry of the wait table and fails the requests still waiting in it
+ */
+static void delete_waittable_entry(Entry *entry) {
+  destroyWaitQueue(entry, [](Job &job) { complete_job(job, false); });
+}
+
 auto LockManager::create_worker_thread(void *object) -> void * {
   reinterpret_cast<LockManager *>(object)->process_request();
   return 0;
 }
 
-void LockManager::configuration_init(int numWorkerThreads) {
-  const int numLocktableWorkerThreads = numWorkerThreads;
-  arg.num_threads =
-      numLocktableWorkerThreads + 1;  // + 1 thread for transaction table;
-  arg.tx_thread_id = arg.num_threads - 1;
+void LockManager::configuration_init(int numWorkerThreads,
+                                     LockTableEngine engine,
+                                     ConflictPolicy policy,
+                                     int escalationThreshold) {
+  // The worker threads share the transaction table, see
+  // transaction_partition_of()
+  arg.num_threads = numWorkerThreads;
+  arg.num_partitions = numWorkerThreads * kPartitionsPerWorker;
   arg.transaction_table_size = 200;
   arg.lock_table_size = 10000;
+  arg.engine = engine;
+  arg.conflict_policy = policy;
+  arg.escalation_threshold = escalationThreshold;
 }
 
-LockManager::LockManager(int numWorkerThreads) {
-  configuration_init(numWorkerThreads);
+LockManager::LockManager(int numWorkerThreads, LockTableEngine engine,
+                         ConflictPolicy policy, int escalationThreshold) {
+  configuration_init(numWorkerThreads, engine, policy, escalationThreshold);
 
   // Get configuration parameters
   transactionTableSize_ = arg.transaction_table_size;
   lockTableSize_ = arg.lock_table_size;
 
-  transactionTable_ = newHashTable(transactionTableSize_);
-  lockTable_ = newHashTable(lockTableSize_);
+  transactionTable_ =
+      newHashTable<int, Transaction>(transactionTableSize_);
+  transaction_mutex =
+      (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t) * arg.num_threads);
+  for (int i = 0; i < arg.num_threads; i++) {
+    pthread_mutex_init(&transaction_mutex[i], NULL);
+  }
+  lockTable_ = newHashTable<int, Lock>(lockTableSize_);
+  granuleTable_ = newHashTable<int, GranuleLock>(lockTableSize_);
+  waitTable_ = newHashTable<int, WaitQueue>(lockTableSize_);
+
+  // Initialize the range indexes of the partitions
+  rangeIndex_ = new RangeIndex[arg.num_partitions];
+  range_mutex =
+      (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t) * arg.num_partitions);
+  for (int i = 0; i < arg.num_partitions; i++) {
+    initRangeIndex(&rangeIndex_[i]);
+    pthread_mutex_init(&range_mutex[i], NULL);
+  }
+  numRanges_ = 0;
+
+  pthread_mutex_init(&granule_mutex, NULL);
+  escalations_ = 0;
+  escalatedRows_ = 0;
+  failedEscalations_ = 0;
 
   // Initialize mutex variables
   pthread_mutex_init(&global_num_mutex, NULL);
@@ -33,8 +140,34 @@ LockManager::LockManager(int numWorkerThreads) {
   job_cond = (pthread_cond_t *)malloc(sizeof(pthread_cond_t) * arg.num_threads);
 
   // Initialize job queues
+  job_rings = new JobRing[arg.num_threads];
   for (int i = 0; i < arg.num_threads; i++) {
-    queue.push_back(std::queue<Job>());
+    initJobRing(&job_rings[i]);
+  }
+  pending_jobs = new std::atomic<int>[arg.num_threads]();
+
+  // Each worker thread starts with adjacent partitions, so it serves the same
+  // rows as without work stealing
+  partition_owner = new std::atomic<int>[arg.num_partitions];
+  partition_senders = new std::atomic<int>[arg.num_partitions]();
+  partition_jobs = new std::atomic<int>[arg.num_partitions]();
+  adopting = new std::atomic<bool>[arg.num_partitions]();
+  for (int i = 0; i < arg.num_partitions; i++) {
+    partition_owner[i] = i / kPartitionsPerWorker;
+  }
+  stealing = new bool[arg.num_threads]();
+  adopted_jobs = new std::vector<Job>[arg.num_threads];
+  handoffs = new std::vector<Handoff>[arg.num_threads];
+  steals_ = 0;
+  declinedSteals_ = 0;
+
+  // Initialize the stripes of the lock table
+  if (arg.engine == CONCURRENT) {
+    stripe_mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t) *
+                                             kLockTableStripes);
+    for (int i = 0; i < kLockTableStripes; i++) {
+      pthread_mutex_init(&stripe_mutex[i], NULL);
+    }
   }
 
   // Create worker threads to serve lock requests and registrations of
@@ -56,12 +189,67 @@ LockManager::~LockManager() {
   spdlog::info("Waiting for thread to stop");
   for (int i = 0; i < arg.num_threads; i++) {
     pthread_join(threads[i], NULL);
+  }
+  // Workers push jobs into the rings of others when they hand over partitions,
+  // so the rings are only freed once all workers stopped
+  for (int i = 0; i < arg.num_threads; i++) {
     pthread_mutex_destroy(&queue_mutex[i]);
     pthread_cond_destroy(&job_cond[i]);
+    destroyJobRing(&job_rings[i]);
   }
+  delete[] job_rings;
 
   spdlog::info("Freeing threads");
   free(threads);
+
+  delete[] pending_jobs;
+  delete[] partition_owner;
+  delete[] partition_senders;
+  delete[] partition_jobs;
+  delete[] adopting;
+  delete[] stealing;
+  delete[] adopted_jobs;
+  delete[] handoffs;
+  if (arg.engine == CONCURRENT) {
+    for (int i = 0; i < kLockTableStripes; i++) {
+      pthread_mutex_destroy(&stripe_mutex[i]);
+    }
+    free(stripe_mutex);
+  }
+
+  deleteHashTable(transactionTable_);
+  for (int i = 0; i < arg.num_threads; i++) {
+    pthread_mutex_destroy(&transaction_mutex[i]);
+  }
+  free(transaction_mutex);
+  destroyHashTable(lockTable_, &delete_locktable_entry);
+  delete lockTable_;
+  deleteHashTable(granuleTable_);
+  destroyHashTable(waitTable_, &delete_waittable_entry);
+  delete waitTable_;
+
+  for (int i = 0; i < arg.num_partitions; i++) {
+    pthread_mutex_destroy(&range_mutex[i]);
+  }
+  free(range_mutex);
+  delete[] rangeIndex_;
+  pthread_mutex_destroy(&granule_mutex);
+}
+
+auto LockManager::getPoolStatistics() -> PoolStatistics {
+  return poolStatistics();
+}
+
+auto LockManager::getLockTableStatistics() -> BucketStatistics {
+  return bucketStatistics(lockTable_);
+}
+
+auto LockManager::getEscalationStatistics() -> EscalationStatistics {
+  return {escalations_, escalatedRows_, failedEscalations_};
+}
+
+auto LockManager::getStealStatistics() -> StealStatistics {
+  return {steals_, declinedSteals_};
 }
 
 auto LockManager::registerTransaction(unsigned int transactionId) -> bool {
@@ -76,47 +264,83 @@ auto LockManager::lock(unsigned int transactionId, unsigned int rowId,
   return create_job(SHARED, transactionId, rowId, waitForResult);
 };
 
+auto LockManager::lock(unsigned int transactionId, Granule granule,
+                       unsigned int id, LockMode mode, bool waitForResult)
+    -> bool {
+  return create_job(LOCK_GRANULE, transactionId, id, waitForResult, granule,
+                    mode);
+};
+
 void LockManager::unlock(unsigned int transactionId, unsigned int rowId,
                          bool waitForResult) {
   create_job(UNLOCK, transactionId, rowId, waitForResult);
 };
 
+void LockManager::unlock(unsigned int transactionId, Granule granule,
+                         unsigned int id, bool waitForResult) {
+  create_job(UNLOCK, transactionId, id, waitForResult, granule);
+};
+
+auto LockManager::lockRange(unsigned int transactionId,
+                            unsigned int firstRowId, unsigned int lastRowId,
+                            bool isExclusive, bool waitForResult) -> bool {
+  return create_job(LOCK_RANGE, transactionId, firstRowId, waitForResult, ROW,
+                    isExclusive ? X_LOCK : S_LOCK, lastRowId);
+};
+
+void LockManager::unlockRange(unsigned int transactionId,
+                              unsigned int firstRowId, unsigned int lastRowId,
+                              bool waitForResult) {
+  create_job(UNLOCK_RANGE, transactionId, firstRowId, waitForResult, ROW,
+             S_LOCK, lastRowId);
+};
+
+auto LockManager::commit(unsigned int transactionId, bool waitForResult)
+    -> bool {
+  return create_job(COMMIT, transactionId, 0, waitForResult);
+};
+
+auto LockManager::abort(unsigned int transactionId, bool waitForResult)
+    -> bool {
+  return create_job(ABORT, transactionId, 0, waitForResult);
+};
+
 auto LockManager::create_job(Command command, unsigned int transaction_id,
-                             unsigned int row_id, bool waitForResult) -> bool {
+                             unsigned int row_id, bool waitForResult,
+                             Granule granule, LockMode mode,
+                             unsigned int last_row_id) -> bool {
   // Set job parameters
   Job job;
   job.command = command;
 
   job.transaction_id = transaction_id;
   job.row_id = row_id;
+  job.granule = granule;
+  job.mode = mode;
+  job.last_row_id = last_row_id;
 
-  // Need to track, when job is finished or error has occurred
-  if (waitForResult && (command == SHARED || command == EXCLUSIVE ||
-                        command == REGISTER || command == UNLOCK)) {
-    // Allocate dynamic memory in the untrusted part of the application, so the
-    // enclave can modify it via its pointer
-    job.finished = new bool;
-    job.error = new bool;
-    *job.finished = false;
-    *job.error = false;
+  // Need to track, when job is finished or error has occurred. Both live on
+  // the stack, as this thread waits until the worker thread set them.
+  bool returnsResult = command != QUIT;
+  Completion finished;
+  bool error = false;
+  if (waitForResult && returnsResult) {
+    initCompletion(&finished);
+    job.finished = &finished;
+    job.error = &error;
   }
 
   job.wait_for_result = waitForResult;
   send_job(&job);
-  if (waitForResult && (command == SHARED || command == EXCLUSIVE ||
-                        command == REGISTER || command == UNLOCK)) {
+  if (waitForResult && returnsResult) {
     // Need to wait until job is finished because we need to be registered for
     // subsequent requests or because we need to wait for the return value
-    while (!*job.finished) {
-      continue;
-    }
-    delete job.finished;
+    waitForCompletion(&finished);
 
     // Check if an error occured
-    if (*job.error) {
+    if (error) {
       return false;
     }
-    delete job.error;
   }
 
   return true;
@@ -133,43 +357,77 @@ void LockManager::send_job(void *data) {
       for (int i = 0; i < arg.num_threads; i++) {
         spdlog::info("Sending QUIT to all threads");
 
-        pthread_mutex_lock(&queue_mutex[i]);
-        queue[i].push(new_job);
-        pthread_cond_signal(&job_cond[i]);
-        pthread_mutex_unlock(&queue_mutex[i]);
+        enqueue_job(i, new_job);
       }
       return;
 
     case SHARED:
     case EXCLUSIVE:
+    case LOCK_GRANULE:
+    case LOCK_RANGE:
+    case UNLOCK_RANGE:
     case UNLOCK: {
       // Copy job parameters
 
       new_job.transaction_id = ((Job *)data)->transaction_id;
       new_job.row_id = ((Job *)data)->row_id;
+      new_job.granule = ((Job *)data)->granule;
+      new_job.mode = ((Job *)data)->mode;
+      new_job.last_row_id = ((Job *)data)->last_row_id;
       new_job.wait_for_result = ((Job *)data)->wait_for_result;
 
       if (new_job.wait_for_result) {
         new_job.finished = ((Job *)data)->finished;
         new_job.error = ((Job *)data)->error;
       }
+      if (!has_valid_ids(new_job)) {
+        spdlog::error("Row, page or table ID exceeds kMaxGranuleId");
+        if (new_job.wait_for_result) {
+          *new_job.error = true;
+          finish_job(new_job);
+        }
+        return;
+      }
+
       // If transaction is not registered, abort the request
-      if (get(transactionTable_, new_job.transaction_id) == nullptr) {
+      if (!is_registered(new_job.transaction_id)) {
         spdlog::error("Need to register transaction before lock requests");
         if (new_job.wait_for_result) {
           *new_job.error = true;
-          *new_job.finished = true;
+          finish_job(new_job);
         }
         return;
       }
 
-      // Send the requests to specific worker thread
-      int thread_id = (int)((new_job.row_id % lockTableSize_) /
-                            ((float)lockTableSize_ / (arg.num_threads - 1)));
-      pthread_mutex_lock(&queue_mutex[thread_id]);
-      queue[thread_id].push(new_job);
-      pthread_cond_signal(&job_cond[thread_id]);
-      pthread_mutex_unlock(&queue_mutex[thread_id]);
+      if (command == LOCK_RANGE || command == UNLOCK_RANGE) {
+        send_range_parts(new_job);
+        break;
+      }
+
+      // Send the requests to the worker thread that owns the bucket group of
+      // the row or granule
+      if (arg.engine == CONCURRENT) {
+        // The partition still tells where an abort starts to release locks
+        new_job.partition = partition_of(job_key(new_job));
+        int thread_id = least_loaded_worker(job_key(new_job));
+        pending_jobs[thread_id]++;
+        enqueue_job(thread_id, new_job);
+      } else {
+        send_to_partition(partition_of(job_key(new_job)), new_job);
+      }
+      break;
+    }
+    case COMMIT:
+    case ABORT: {
+      // Copy job parameters
+      new_job.transaction_id = ((Job *)data)->transaction_id;
+      new_job.wait_for_result = ((Job *)data)->wait_for_result;
+
+      if (new_job.wait_for_result) {
+        new_job.finished = ((Job *)data)->finished;
+        new_job.error = ((Job *)data)->error;
+      }
+      send_release_parts(new_job);
       break;
     }
     case REGISTER: {
@@ -178,12 +436,10 @@ void LockManager::send_job(void *data) {
       new_job.finished = ((Job *)data)->finished;
       new_job.error = ((Job *)data)->error;
 
-      // Send the requests to thread responsible for registering
-      // transactions
-      pthread_mutex_lock(&queue_mutex[arg.tx_thread_id]);
-      queue[arg.tx_thread_id].push(new_job);
-      pthread_cond_signal(&job_cond[arg.tx_thread_id]);
-      pthread_mutex_unlock(&queue_mutex[arg.tx_thread_id]);
+      // Send the requests to the worker thread that owns the partition of the
+      // transaction table
+      int thread_id = transaction_partition_of(new_job.transaction_id);
+      enqueue_job(thread_id, new_job);
       break;
     }
     default:
@@ -192,6 +448,135 @@ void LockManager::send_job(void *data) {
   }
 }
 
+void LockManager::send_range_parts(Job &job) {
+  if (job.row_id > job.last_row_id) {
+    spdlog::error("Range ends before it starts");
+    complete_job(job, false);
+    return;
+  }
+
+  // Find the partitions that own rows of the range. Once the range is longer
+  // than the lock table, it covers all of them.
+  const int numPartitions = arg.num_partitions;
+  std::vector<bool> ownsRows(numPartitions, false);
+  int numParts = 0;
+  for (unsigned long rowId = job.row_id;
+       rowId <= job.last_row_id && numParts < numPartitions; rowId++) {
+    int partition = partition_of(rowId);
+    if (!ownsRows[partition]) {
+      ownsRows[partition] = true;
+      numParts++;
+    }
+  }
+
+  // All parts must be counted before the first one may finish
+  RangeRequest *range = new RangeRequest();
+  range->job = job;
+  range->pending = numParts;
+  range->failed = false;
+  for (int partition = 0; partition < numPartitions; partition++) {
+    if (!ownsRows[partition]) {
+      continue;
+    }
+    Job part = job;
+    part.partition = partition;
+    part.range = range;
+
+    if (arg.engine == CONCURRENT) {
+      int thread_id = least_loaded_worker(partition);
+      pending_jobs[thread_id]++;
+      enqueue_job(thread_id, part);
+    } else {
+      send_to_partition(partition, part);
+    }
+  }
+}
+
+void LockManager::send_release_parts(Job &job) {
+  // Later requests of the transaction do not find it anymore
+  Node<Transaction> *node = extract_transaction(job.transaction_id);
+  if (node == nullptr) {
+    spdlog::error("Transaction was not registered");
+    complete_job(job, false);
+    return;
+  }
+  Transaction *transaction = &node->value;
+  transaction->mut.lock();
+  if (job.command == ABORT) {
+    transaction->aborted = true;
+  }
+  transaction->growing_phase = false;
+  transaction->mut.unlock();
+
+  release_in_parts(job, node, -1);
+}
+
+void LockManager::release_in_parts(Job &job, Node<Transaction> *node,
+                                   int partition) {
+  Transaction *transaction = &node->value;
+  ReleaseRequest *request = new ReleaseRequest();
+  request->job = job;
+  request->node = node;
+  request->rows.resize(arg.num_partitions);
+  request->granules.resize(arg.num_partitions);
+  transaction->mut.lock();
+  for (auto lockedRow : transaction->locked_rows) {
+    request->rows[partition_of(lockedRow)].push_back(lockedRow);
+  }
+  for (auto &granuleLock : transaction->granule_locks) {
+    request->granules[partition_of(granuleLock.first)].push_back(
+        granuleLock.first);
+  }
+  transaction->mut.unlock();
+
+  std::vector<int> partitions;
+  for (int owner = 0; owner < arg.num_partitions; owner++) {
+    if (!request->rows[owner].empty() || !request->granules[owner].empty()) {
+      partitions.push_back(owner);
+    }
+  }
+  if (partitions.empty()) {
+    partitions.push_back(partition != -1
+                             ? partition
+                             : transaction_partition_of(job.transaction_id));
+  }
+
+  // All parts must be counted before the first one may finish
+  request->pending = partitions.size();
+  std::vector<Job> servedParts;
+  for (auto owner : partitions) {
+    Job part = job;
+    part.partition = owner;
+    part.release = request;
+
+    if (partition != -1 && serves_both(partition, owner)) {
+      // A worker must not wait for room in its own job queue
+      servedParts.push_back(part);
+    } else if (arg.engine == CONCURRENT) {
+      int thread_id = least_loaded_worker(owner);
+      pending_jobs[thread_id]++;
+      enqueue_job(thread_id, part);
+    } else {
+      send_to_partition(owner, part);
+    }
+  }
+
+  // The last part frees the request, so it is not touched after that
+  for (auto &part : servedParts) {
+    release_part(part);
+    finish_release_part(part);
+  }
+}
+
+auto LockManager::serves_both(int partition, int other) -> bool {
+  if (other == partition || arg.engine == CONCURRENT) {
+    return true;
+  }
+  // While a partition is handed over, its former owner is not known anymore
+  return !adopting[partition] && !adopting[other] &&
+         partition_owner[other] == partition_owner[partition];
+}
+
 void LockManager::process_request() {
   pthread_mutex_lock(&global_num_mutex);
 
@@ -200,172 +585,1082 @@ void LockManager::process_request() {
 
   pthread_mutex_unlock(&global_num_mutex);
 
-  pthread_mutex_lock(&queue_mutex[thread_id]);
+  Job jobs[kJobBatchSize];
   while (1) {
     spdlog::info("Worker " + std::to_string(thread_id) + " waiting for jobs");
-    if (queue[thread_id].size() == 0) {
-      pthread_cond_wait(&job_cond[thread_id], &queue_mutex[thread_id]);
-      continue;
-    }
-
-    spdlog::info("Worker " + std::to_string(thread_id) + " got a job");
-    Job cur_job = queue[thread_id].front();
-    Command command = cur_job.command;
 
-    pthread_mutex_unlock(&queue_mutex[thread_id]);
+    // Drain the pending jobs, up to kJobBatchSize at once
+    int numJobs = dequeue_jobs(thread_id, jobs);
 
-    switch (command) {
-      case QUIT:
-        pthread_mutex_lock(&queue_mutex[thread_id]);
-        queue[thread_id].pop();
-        pthread_mutex_unlock(&queue_mutex[thread_id]);
+    spdlog::info("Worker " + std::to_string(thread_id) + " got " +
+                 std::to_string(numJobs) + " jobs");
+    prefetch_locks(jobs, numJobs);
+    for (int i = 0; i < numJobs; i++) {
+      if (jobs[i].command == QUIT) {
         spdlog::info("Enclave worker quitting");
         return;
-      case SHARED:
-      case EXCLUSIVE: {
-        if (command == EXCLUSIVE) {
-          spdlog::info(
-              ("(EXCLUSIVE) TXID: " + std::to_string(cur_job.transaction_id) +
-               ", RID: " + std::to_string(cur_job.row_id))
-                  .c_str());
-        } else {
-          spdlog::info(
-              ("(SHARED) TXID: " + std::to_string(cur_job.transaction_id) +
-               ", RID: " + std::to_string(cur_job.row_id))
-                  .c_str());
-        }
+      }
+      if (jobs[i].command == STEAL) {
+        hand_off_partition(thread_id, jobs[i]);
+        continue;
+      }
+      if (jobs[i].command == ADOPT) {
+        adopt_partition(thread_id, jobs[i]);
+        continue;
+      }
+      if (is_adopting(thread_id, jobs[i])) {
+        // The former owner still serves the jobs it got before the handoff
+        adopted_jobs[thread_id].push_back(jobs[i]);
+        continue;
+      }
+      process_job(jobs[i]);
+      if (jobs[i].command == REGISTER) {
+        continue;
+      }
+      if (arg.engine == CONCURRENT) {
+        pending_jobs[thread_id]--;
+      } else {
+        partition_jobs[jobs[i].partition]--;
+      }
+    }
+    finish_handoffs(thread_id);
+  }
 
-        bool ok = acquire_lock(cur_job.transaction_id, cur_job.row_id,
-                               command == EXCLUSIVE);
+  return;
+}
 
-        if (cur_job.wait_for_result) {
-          if (!ok) {
-            *cur_job.error = true;
-          }
+void LockManager::enqueue_job(int threadId, const Job &job) {
+  if (pushJob(&job_rings[threadId], job)) {
+    pthread_mutex_lock(&queue_mutex[threadId]);
+    pthread_cond_signal(&job_cond[threadId]);
+    pthread_mutex_unlock(&queue_mutex[threadId]);
+  }
+}
 
-          *cur_job.finished = true;
+auto LockManager::dequeue_jobs(int threadId, Job *jobs) -> int {
+  JobRing *ring = &job_rings[threadId];
+  bool maySteal = arg.engine == PARTITIONED && arg.num_threads > 1;
+  int numJobs;
+  while ((numJobs = popJobs(ring, jobs, kJobBatchSize)) == 0) {
+    if (spinForJobs(ring)) {
+      continue;
+    }
+    // Jobs sent to the worker just before it handed over a partition may not
+    // be published yet
+    if (!handoffs[threadId].empty()) {
+      std::this_thread::yield();
+      return 0;
+    }
+    if (maySteal && !stealing[threadId]) {
+      steal_partition(threadId);
+    }
+
+    pthread_mutex_lock(&queue_mutex[threadId]);
+    if (announceSleep(ring)) {
+      if (maySteal && !stealing[threadId]) {
+        // Wake up in time to look for busy workers again
+        struct timespec timeout;
+        clock_gettime(CLOCK_REALTIME, &timeout);
+        timeout.tv_nsec += kStealInterval * 1000L;
+        if (timeout.tv_nsec >= 1000000000L) {
+          timeout.tv_sec++;
+          timeout.tv_nsec -= 1000000000L;
         }
-        break;
+        pthread_cond_timedwait(&job_cond[threadId], &queue_mutex[threadId],
+                               &timeout);
+      } else {
+        pthread_cond_wait(&job_cond[threadId], &queue_mutex[threadId]);
       }
-      case UNLOCK: {
+    }
+    cancelSleep(ring);
+    pthread_mutex_unlock(&queue_mutex[threadId]);
+  }
+  return numJobs;
+}
+
+void LockManager::send_to_partition(int partition, Job &job) {
+  job.partition = partition;
+  partition_jobs[partition]++;
+
+  // The owner may hand the partition over meanwhile. It only considers the
+  // partition drained once no thread is sending a job to it anymore, see
+  // finish_handoffs().
+  partition_senders[partition]++;
+  enqueue_job(partition_owner[partition], job);
+  partition_senders[partition]--;
+}
+
+void LockManager::steal_partition(int threadId) {
+  std::vector<int> load(arg.num_threads, 0);
+  std::vector<int> owned(arg.num_threads, 0);
+  for (int partition = 0; partition < arg.num_partitions; partition++) {
+    int owner = partition_owner[partition];
+    load[owner] += partition_jobs[partition];
+    owned[owner]++;
+  }
+  int victim = -1;
+  for (int worker = 0; worker < arg.num_threads; worker++) {
+    if (worker != threadId && owned[worker] > 1 &&
+        load[worker] >= kStealThreshold &&
+        (victim == -1 || load[worker] > load[victim])) {
+      victim = worker;
+    }
+  }
+  if (victim == -1) {
+    return;
+  }
+
+  // Taking over a partition with more than half of the queued jobs of the
+  // victim would only move the bottleneck
+  int busiest = -1;
+  int busiestJobs = 0;
+  for (int partition = 0; partition < arg.num_partitions; partition++) {
+    int jobs = partition_jobs[partition];
+    if (partition_owner[partition] == victim && !adopting[partition] &&
+        jobs > busiestJobs && 2 * jobs <= load[victim]) {
+      busiest = partition;
+      busiestJobs = jobs;
+    }
+  }
+  if (busiest == -1) {
+    return;
+  }
+
+  spdlog::info("Worker " + std::to_string(threadId) + " steals partition " +
+               std::to_string(busiest) + " from worker " +
+               std::to_string(victim));
+  Job job;
+  job.command = STEAL;
+  job.partition = busiest;
+  job.worker = threadId;
+  stealing[threadId] = true;
+  enqueue_job(victim, job);
+}
+
+void LockManager::hand_off_partition(int threadId, Job &job) {
+  int partition = job.partition;
+  if (partition_owner[partition] != threadId || adopting[partition]) {
+    Job declined;
+    declined.command = ADOPT;
+    declined.partition = -1;
+    enqueue_job(job.worker, declined);
+    declinedSteals_++;
+    return;
+  }
+
+  // The thief keeps the jobs it gets for the partition from now on until
+  // this worker served the ones it got before
+  adopting[partition] = true;
+  partition_owner[partition] = job.worker;
+  handoffs[threadId].push_back({partition, job.worker, false, 0});
+}
+
+void LockManager::finish_handoffs(int threadId) {
+  JobRing *ring = &job_rings[threadId];
+  std::vector<Handoff> &pending = handoffs[threadId];
+  for (auto handoff = pending.begin(); handoff != pending.end();) {
+    // Threads that start sending a job to the partition from now on see the
+    // new owner, so the jobs of the partition in the ring end before its tail
+    if (!handoff->isDrained && partition_senders[handoff->partition] == 0) {
+      handoff->isDrained = true;
+      handoff->lastJob = ring->tail.load();
+    }
+    if (!handoff->isDrained || ring->head < handoff->lastJob) {
+      handoff++;
+      continue;
+    }
+
+    Job adopt;
+    adopt.command = ADOPT;
+    adopt.partition = handoff->partition;
+    enqueue_job(handoff->thief, adopt);
+    handoff = pending.erase(handoff);
+  }
+}
+
+void LockManager::adopt_partition(int threadId, Job &job) {
+  stealing[threadId] = false;
+  if (job.partition == -1) {
+    return;
+  }
+
+  // A worker steals one partition at a time, so all kept jobs belong to it
+  adopting[job.partition] = false;
+  steals_++;
+  for (auto &adopted : adopted_jobs[threadId]) {
+    process_job(adopted);
+    partition_jobs[adopted.partition]--;
+  }
+  adopted_jobs[threadId].clear();
+}
+
+auto LockManager::is_adopting(int threadId, const Job &job) -> bool {
+  // The former owner still sees the flag while it serves the last jobs of the
+  // partition, but does not own it anymore
+  return arg.engine == PARTITIONED && job.command != REGISTER &&
+         adopting[job.partition] && partition_owner[job.partition] == threadId;
+}
+
+void LockManager::prefetch_locks(Job *jobs, int numJobs) {
+  // Without partitions, other workers may change the buckets of these rows
+  // until their stripes are locked
+  if (arg.engine == CONCURRENT) {
+    return;
+  }
+
+  // The former owner of a stolen partition may still change its buckets
+  int rowIds[kJobBatchSize];
+  int numRows = 0;
+  for (int i = 0; i < numJobs; i++) {
+    if ((jobs[i].command == SHARED || jobs[i].command == EXCLUSIVE ||
+         jobs[i].command == LOCK_GRANULE || jobs[i].command == UNLOCK) &&
+        jobs[i].granule == ROW && !adopting[jobs[i].partition]) {
+      rowIds[numRows++] = jobs[i].row_id;
+    }
+  }
+  if (numRows > 1) {
+    Lock *locks[kJobBatchSize];
+    getMany(lockTable_, rowIds, numRows, locks);
+  }
+}
+
+void LockManager::process_job(Job &cur_job) {
+  Command command = cur_job.command;
+  switch (command) {
+    case SHARED:
+    case EXCLUSIVE: {
+      if (command == EXCLUSIVE) {
+        spdlog::info(
+            ("(EXCLUSIVE) TXID: " + std::to_string(cur_job.transaction_id) +
+             ", RID: " + std::to_string(cur_job.row_id))
+                .c_str());
+      } else {
         spdlog::info(
-            ("(UNLOCK) TXID: " + std::to_string(cur_job.transaction_id) +
+            ("(SHARED) TXID: " + std::to_string(cur_job.transaction_id) +
              ", RID: " + std::to_string(cur_job.row_id))
                 .c_str());
+      }
+
+      // A waiting request is completed once it is granted
+      LockResult result = acquire_lock(cur_job);
+      if (result != WAITING) {
+        complete_job(cur_job, result == GRANTED);
+      }
+      break;
+    }
+    case LOCK_GRANULE: {
+      spdlog::info(("(LOCK_GRANULE) TXID: " +
+                    std::to_string(cur_job.transaction_id) +
+                    ", GRANULE: " + std::to_string(cur_job.granule) +
+                    ", ID: " + std::to_string(cur_job.row_id) +
+                    ", MODE: " + std::to_string(cur_job.mode))
+                       .c_str());
+
+      // Rows are locked the same way as with SHARED and EXCLUSIVE
+      LockResult result = cur_job.granule == ROW
+                              ? acquire_lock(cur_job)
+                              : acquire_granule_lock(cur_job);
+      if (result != WAITING) {
+        complete_job(cur_job, result == GRANTED);
+      }
+      break;
+    }
+    case LOCK_RANGE: {
+      spdlog::info(("(LOCK_RANGE) TXID: " +
+                    std::to_string(cur_job.transaction_id) +
+                    ", RIDs: " + std::to_string(cur_job.row_id) + ".." +
+                    std::to_string(cur_job.last_row_id) +
+                    ", PARTITION: " + std::to_string(cur_job.partition))
+                       .c_str());
+      finish_range_part(cur_job, acquire_range_part(cur_job) == GRANTED);
+      break;
+    }
+    case UNLOCK_RANGE: {
+      spdlog::info(("(UNLOCK_RANGE) TXID: " +
+                    std::to_string(cur_job.transaction_id) +
+                    ", RIDs: " + std::to_string(cur_job.row_id) + ".." +
+                    std::to_string(cur_job.last_row_id) +
+                    ", PARTITION: " + std::to_string(cur_job.partition))
+                       .c_str());
+      release_range_part(cur_job);
+      finish_range_part(cur_job, true);
+      break;
+    }
+    case COMMIT:
+    case ABORT: {
+      spdlog::info((std::string(command == COMMIT ? "(COMMIT)" : "(ABORT)") +
+                    " TXID: " + std::to_string(cur_job.transaction_id) +
+                    ", PARTITION: " + std::to_string(cur_job.partition))
+                       .c_str());
+      release_part(cur_job);
+      finish_release_part(cur_job);
+      break;
+    }
+    case UNLOCK: {
+      spdlog::info(("(UNLOCK) TXID: " + std::to_string(cur_job.transaction_id) +
+                    ", RID: " + std::to_string(cur_job.row_id))
+                       .c_str());
+      if (cur_job.granule == ROW) {
         release_lock(cur_job.transaction_id, cur_job.row_id);
-        if (cur_job.wait_for_result) {
-          *cur_job.finished = true;
-        }
-        break;
+      } else {
+        release_granule_lock(cur_job.transaction_id, cur_job.granule,
+                             cur_job.row_id);
       }
-      case REGISTER: {
-        auto transactionId = cur_job.transaction_id;
+      if (cur_job.wait_for_result) {
+        finish_job(cur_job);
+      }
+      break;
+    }
+    case REGISTER: {
+      auto transactionId = cur_job.transaction_id;
 
-        spdlog::info(
-            ("Registering transaction " + std::to_string(transactionId))
-                .c_str());
+      spdlog::info(
+          ("Registering transaction " + std::to_string(transactionId)).c_str());
 
-        if (contains(transactionTable_, transactionId)) {
-          spdlog::error("Transaction is already registered");
-          *cur_job.error = true;
-        } else {
-          set(transactionTable_, transactionId, newTransaction(transactionId));
-        }
-        *cur_job.finished = true;
-        break;
+      if (!register_transaction(transactionId)) {
+        spdlog::error("Transaction is already registered");
+        *cur_job.error = true;
       }
-      default:
-        spdlog::error("Worker received unknown command");
+      finish_job(cur_job);
+      break;
     }
+    default:
+      spdlog::error("Worker received unknown command");
+  }
+}
 
-    pthread_mutex_lock(&queue_mutex[thread_id]);
-    queue[thread_id].pop();
+auto LockManager::least_loaded_worker(unsigned int rowId) -> int {
+  const int numLocktableWorkerThreads = arg.num_threads;
+  int start = rowId % numLocktableWorkerThreads;
+  int leastLoaded = start;
+  int fewestJobs = pending_jobs[start];
+  for (int i = 1; i < numLocktableWorkerThreads && fewestJobs > 0; i++) {
+    int worker = (start + i) % numLocktableWorkerThreads;
+    int jobs = pending_jobs[worker];
+    if (jobs < fewestJobs) {
+      leastLoaded = worker;
+      fewestJobs = jobs;
+    }
   }
+  return leastLoaded;
+}
 
-  return;
+auto LockManager::transaction_partition_of(unsigned int transactionId)
+    -> int {
+  return (int)(hash(transactionTableSize_, transactionId) /
+               ((float)transactionTableSize_ / arg.num_threads));
+}
+
+auto LockManager::register_transaction(unsigned int transactionId) -> bool {
+  // The bucket groups of a partition only grow under its mutex, so
+  // registrations in different partitions do not contend
+  int partition = transaction_partition_of(transactionId);
+  pthread_mutex_lock(&transaction_mutex[partition]);
+  bool isNew = !contains(transactionTable_, transactionId);
+  if (isNew) {
+    initTransaction(insert(transactionTable_, transactionId), transactionId);
+  }
+  pthread_mutex_unlock(&transaction_mutex[partition]);
+  return isNew;
+}
+
+auto LockManager::is_registered(unsigned int transactionId) -> bool {
+  int partition = transaction_partition_of(transactionId);
+  pthread_mutex_lock(&transaction_mutex[partition]);
+  bool registered = contains(transactionTable_, transactionId);
+  pthread_mutex_unlock(&transaction_mutex[partition]);
+  return registered;
+}
+
+auto LockManager::pin_transaction(unsigned int transactionId)
+    -> Node<Transaction> * {
+  int partition = transaction_partition_of(transactionId);
+  pthread_mutex_lock(&transaction_mutex[partition]);
+  Entry *entry = findEntry(transactionTable_, transactionId);
+  Node<Transaction> *node =
+      entry == nullptr ? nullptr : nodeOf<Transaction>(entry);
+  if (node != nullptr) {
+    node->value.pins++;
+  }
+  pthread_mutex_unlock(&transaction_mutex[partition]);
+  return node;
+}
+
+void LockManager::unpin_transaction(Node<Transaction> *node) {
+  int partition = transaction_partition_of(node->value.transaction_id);
+  pthread_mutex_lock(&transaction_mutex[partition]);
+  bool isLast = --node->value.pins == 0 && node->value.detached;
+  pthread_mutex_unlock(&transaction_mutex[partition]);
+  if (isLast) {
+    poolDelete(node);
+  }
+}
+
+void LockManager::delete_transaction(Node<Transaction> *node) {
+  int partition = transaction_partition_of(node->value.transaction_id);
+  pthread_mutex_lock(&transaction_mutex[partition]);
+  bool isPinned = node->value.pins > 0;
+  node->value.detached = true;
+  pthread_mutex_unlock(&transaction_mutex[partition]);
+  if (!isPinned) {
+    poolDelete(node);
+  }
+}
+
+void LockManager::remove_if_idle(unsigned int transactionId) {
+  int partition = transaction_partition_of(transactionId);
+  pthread_mutex_lock(&transaction_mutex[partition]);
+  Node<Transaction> *node = nullptr;
+  Transaction *transaction = get(transactionTable_, transactionId);
+  if (transaction != nullptr && !holdsLocks(transaction)) {
+    node = extract(transactionTable_, transactionId);
+  }
+  pthread_mutex_unlock(&transaction_mutex[partition]);
+  if (node != nullptr) {
+    delete_transaction(node);
+  }
 }
 
-auto LockManager::acquire_lock(unsigned int transactionId, unsigned int rowId,
-                               bool isExclusive) -> bool {
-  int ret;
+auto LockManager::extract_transaction(unsigned int transactionId,
+                                      Transaction *transaction)
+    -> Node<Transaction> * {
+  int partition = transaction_partition_of(transactionId);
+  pthread_mutex_lock(&transaction_mutex[partition]);
+  Node<Transaction> *node = nullptr;
+  if (transaction == nullptr ||
+      get(transactionTable_, transactionId) == transaction) {
+    node = extract(transactionTable_, transactionId);
+  }
+  pthread_mutex_unlock(&transaction_mutex[partition]);
+  return node;
+}
 
+auto LockManager::partition_of(unsigned int key) -> int {
+  return (int)(hash(lockTableSize_, key) /
+               ((float)lockTableSize_ / arg.num_partitions));
+}
+
+void LockManager::lock_row(unsigned int rowId) {
+  if (arg.engine == CONCURRENT) {
+    // Rows of the same bucket group share a stripe, as they share buckets
+    pthread_mutex_lock(
+        &stripe_mutex[hash(lockTableSize_, rowId) % kLockTableStripes]);
+  }
+}
+
+void LockManager::unlock_row(unsigned int rowId) {
+  if (arg.engine == CONCURRENT) {
+    pthread_mutex_unlock(
+        &stripe_mutex[hash(lockTableSize_, rowId) % kLockTableStripes]);
+  }
+}
+
+auto LockManager::acquire_lock(Job &job) -> LockResult {
   // Get the transaction object for the given transaction ID
-  auto transaction = (Transaction *)get(transactionTable_, transactionId);
-  if (transaction == nullptr) {
+  Node<Transaction> *node = pin_transaction(job.transaction_id);
+  if (node == nullptr) {
     spdlog::error("Transaction was not registered");
-    return false;
+    return REJECTED;
+  }
+  Transaction *transaction = &node->value;
+
+  if (job.command == LOCK_GRANULE && !follows_hierarchy(transaction, job)) {
+    abort_transaction(transaction, job.partition);
+    unpin_transaction(node);
+    return REJECTED;
   }
 
+  lock_row(job.row_id);
+  bool isUpgrade =
+      row_mode(job) != S_LOCK && hasLock(transaction, job.row_id);
+  TableAccess access =
+      enter_table(transaction, job.row_id, is_exclusive(job));
+  bool isCoveredByRange =
+      conflicts_with_range(transaction, job.row_id, is_exclusive(job));
+  LockResult result;
+  if (access == COVERED) {
+    // The lock on the table grants the row, without a lock of its own
+    result = transaction->growing_phase && !transaction->aborted ? GRANTED
+                                                                 : REJECTED;
+  } else if (isCoveredByRange || access == BLOCKED) {
+    result = CONFLICTING;
+  } else if (arg.conflict_policy == WAIT_ON_CONFLICT && !isUpgrade &&
+             firstWaiter(waitTable_, job.row_id) != nullptr) {
+    // Requests must not overtake the ones that wait for the lock already,
+    // except for upgrades, which those wait for anyway
+    result = CONFLICTING;
+  } else {
+    result = acquire_row_lock(transaction, job.row_id, row_mode(job));
+  }
+  // Releasing a range or a table does not grant the requests waiting for its
+  // rows, so they must not wait for it
+  if (result == CONFLICTING && !isCoveredByRange && access != BLOCKED &&
+      arg.conflict_policy == WAIT_ON_CONFLICT &&
+      mayWait(waitTable_, get(lockTable_, job.row_id), job.row_id,
+              job.transaction_id, isUpgrade)) {
+    enqueueWaiter(waitTable_, job, isUpgrade);
+    result = WAITING;
+  }
+  if (access == COUNTED) {
+    settle_row_count(transaction, job.row_id, is_exclusive(job), result,
+                     isUpgrade);
+  }
+  unlock_row(job.row_id);
+
+  // Escalating releases the locks on other rows, so it must not happen while
+  // holding the stripe of this row either
+  if (result == GRANTED && access == COUNTED) {
+    unsigned int table = tableOf(job.row_id);
+    RowCounts rows = rowLocksIn(transaction, table);
+    if (rows.shared + rows.exclusive >
+        (unsigned int)arg.escalation_threshold) {
+      escalate_table(transaction, table, job.partition);
+    }
+  }
+
+  // Aborting releases the locks on other rows, so it must not happen while
+  // holding the stripe of this row
+  if (result == CONFLICTING || result == REJECTED) {
+    abort_transaction(transaction, job.partition);
+  }
+  unpin_transaction(node);
+  return result;
+}
+
+auto LockManager::acquire_row_lock(Transaction *transaction,
+                                   unsigned int rowId, LockMode mode)
+    -> LockResult {
   // Get the lock object for the given row ID
-  auto lock = (Lock *)get(lockTable_, rowId);
+  Lock *lock = get(lockTable_, rowId);
   if (lock == nullptr) {
-    lock = newLock();
-    set(lockTable_, rowId, (void *)lock);
+    lock = insert(lockTable_, rowId);
+    initLock(lock);
   }
 
   // Check if 2PL is violated
-  if (!transaction->growing_phase) {
+  if (!transaction->growing_phase || transaction->aborted) {
     spdlog::error("Cannot acquire more locks according to 2PL");
-    abort_transaction(transaction);
-    return false;
+    return REJECTED;
   }
 
   // Comment out for evaluation ->
-  // Check for upgrade request
-  if (hasLock(transaction, rowId) && isExclusive && !lock->exclusive) {
-    ret = upgrade(lock, transactionId);
-
-    if (!ret) {
-      abort_transaction(transaction);
-      return false;
-    }
-    return ret;
+  // Check for upgrade request, from S or U to X or from S to U
+  if (hasLock(transaction, rowId) && mode == X_LOCK &&
+      !isHeldExclusively(lock)) {
+    return upgrade(lock, transaction->transaction_id) ? GRANTED : CONFLICTING;
+  }
+  if (hasLock(transaction, rowId) && mode == U_LOCK &&
+      !isHeldExclusively(lock) &&
+      !isUpdater(lock, transaction->transaction_id)) {
+    return getUpdateAccess(lock, transaction->transaction_id) ? GRANTED
+                                                              : CONFLICTING;
   }
 
-  // Acquire lock in requested mode (shared, exclusive)
+  // Acquire lock in requested mode (shared, update, exclusive)
   if (!hasLock(transaction, rowId)) {
     // <- Comment out for evaluation
-    ret = addLock(transaction, rowId, isExclusive, lock);
-    if (!ret) {
-      abort_transaction(transaction);
-      return false;
+    if (mode == U_LOCK) {
+      return addUpdateLock(transaction, rowId, lock) ? GRANTED : CONFLICTING;
     }
-    return ret;
+    return addLock(transaction, rowId, mode == X_LOCK, lock) ? GRANTED
+                                                             : CONFLICTING;
     // Comment out for evaluation ->
   }
   // <- Comment out for evaluation
 
   spdlog::error("Request for already acquired lock");
-  abort_transaction(transaction);
-  return false;
+  return REJECTED;
+}
+
+void LockManager::lock_granules() {
+  if (arg.escalation_threshold > 0) {
+    pthread_mutex_lock(&granule_mutex);
+  }
+}
+
+void LockManager::unlock_granules() {
+  if (arg.escalation_threshold > 0) {
+    pthread_mutex_unlock(&granule_mutex);
+  }
+}
+
+auto LockManager::enter_table(Transaction *transaction, unsigned int rowId,
+                              bool isExclusive) -> TableAccess {
+  if (arg.escalation_threshold == 0) {
+    return NOT_COUNTED;
+  }
+
+  int key = granuleKey(TABLE, tableOf(rowId));
+  TableAccess access = COUNTED;
+  lock_granules();
+  GranuleLock *lock = get(granuleTable_, key);
+  if (lock == nullptr) {
+    lock = insert(granuleTable_, key);
+    initGranuleLock(lock);
+  }
+  LockMode held;
+  bool holdsTable = granuleMode(transaction, key, &held);
+  if (holdsTable && (held == X_LOCK || (!isExclusive && (held == S_LOCK ||
+                                                         held == SIX_LOCK)))) {
+    access = COVERED;
+  } else if (conflictsWithHolders(lock, holdsTable ? &held : nullptr,
+                                  isExclusive ? IX_LOCK : IS_LOCK)) {
+    spdlog::error("Table of the row is locked in a conflicting mode");
+    access = BLOCKED;
+  } else {
+    countRows(&lock->rows, isExclusive, 1);
+    countRowLock(transaction, rowId, isExclusive, 1);
+  }
+  if (isUnused(lock)) {
+    remove(granuleTable_, key);
+  }
+  unlock_granules();
+  return access;
+}
+
+void LockManager::leave_table(Transaction *transaction, unsigned int rowId,
+                              bool isExclusive) {
+  if (arg.escalation_threshold == 0) {
+    return;
+  }
+
+  int key = granuleKey(TABLE, tableOf(rowId));
+  lock_granules();
+  GranuleLock *lock = get(granuleTable_, key);
+  if (lock != nullptr) {
+    countRows(&lock->rows, isExclusive, -1);
+    if (isUnused(lock)) {
+      remove(granuleTable_, key);
+    }
+  }
+  countRowLock(transaction, rowId, isExclusive, -1);
+  unlock_granules();
+}
+
+void LockManager::settle_row_count(Transaction *transaction,
+                                   unsigned int rowId, bool isExclusive,
+                                   LockResult result, bool isUpgrade) {
+  if (result != GRANTED) {
+    leave_table(transaction, rowId, isExclusive);
+  } else if (isUpgrade) {
+    leave_table(transaction, rowId, false);
+  }
+}
+
+void LockManager::escalate_table(Transaction *transaction,
+                                 unsigned int table, int partition) {
+  int key = granuleKey(TABLE, table);
+  lock_granules();
+  RowCounts own = rowLocksIn(transaction, table);
+  LockMode mode = own.exclusive > 0 ? X_LOCK : S_LOCK;
+  GranuleLock *lock = get(granuleTable_, key);
+  bool isEscalated = lock != nullptr && !transaction->aborted &&
+                     !conflictsWithRows(lock, own, mode) &&
+                     addGranuleLock(transaction, key, mode, lock);
+  unlock_granules();
+  if (!isEscalated) {
+    failedEscalations_++;
+    return;
+  }
+
+  // The lock on the table covers the row locks within it now. Rows of other
+  // partitions are served by other workers, so they keep their locks until
+  // the transaction ends.
+  unsigned int firstRow = table * kPagesPerTable * kRowsPerPage;
+  std::vector<int> rows;
+  transaction->mut.lock();
+  for (auto row = transaction->locked_rows.lower_bound(firstRow);
+       row != transaction->locked_rows.end() && tableOf(*row) == table;
+       row++) {
+    if (arg.engine == CONCURRENT || partition_of(*row) == partition) {
+      rows.push_back(*row);
+    }
+  }
+  transaction->mut.unlock();
+  for (auto row : rows) {
+    lock_row(row);
+    bool isExclusive = isHeldExclusively(get(lockTable_, row));
+    releaseCoveredLock(transaction, row, lockTable_);
+    leave_table(transaction, row, isExclusive);
+    grant_waiters(row);
+    unlock_row(row);
+  }
+  escalations_++;
+  escalatedRows_ += rows.size();
+}
+
+auto LockManager::acquire_range_part(Job &job) -> LockResult {
+  // Get the transaction object for the given transaction ID. Another part of
+  // the range may have aborted and removed it already.
+  Node<Transaction> *node = pin_transaction(job.transaction_id);
+  if (node == nullptr) {
+    spdlog::error("Transaction was not registered");
+    return REJECTED;
+  }
+  Transaction *transaction = &node->value;
+  if (transaction->aborted) {
+    unpin_transaction(node);
+    return REJECTED;
+  }
+
+  bool isExclusive = job.mode == X_LOCK;
+  RangeIndex *index = &rangeIndex_[job.partition];
+  LockResult result = GRANTED;
+  pthread_mutex_lock(&range_mutex[job.partition]);
+  if (!transaction->growing_phase || transaction->aborted) {
+    spdlog::error("Cannot acquire more locks according to 2PL");
+    result = REJECTED;
+  } else if (findConflictingRange(index, job.row_id, job.last_row_id,
+                                  job.transaction_id, isExclusive)) {
+    spdlog::error("Range overlaps a conflicting range lock");
+    result = CONFLICTING;
+  } else {
+    insertRange(index, job.row_id, job.last_row_id, job.transaction_id,
+                isExclusive);
+    numRanges_++;
+    transaction->mut.lock();
+    transaction->locked_ranges++;
+    transaction->mut.unlock();
+  }
+  pthread_mutex_unlock(&range_mutex[job.partition]);
+
+  // Check the locks on the rows of the partition within the range
+  for (unsigned long rowId = job.row_id;
+       result == GRANTED && rowId <= job.last_row_id; rowId++) {
+    if (partition_of(rowId) != job.partition) {
+      continue;
+    }
+    lock_row(rowId);
+    Lock *lock = get(lockTable_, rowId);
+    if (lock != nullptr) {
+      int others =
+          numOwners(lock) - (isOwner(lock, job.transaction_id) ? 1 : 0);
+      if (others > 0 && (isExclusive || isHeldExclusively(lock))) {
+        spdlog::error("Range contains a row locked in a conflicting mode");
+        result = CONFLICTING;
+      }
+    }
+    unlock_row(rowId);
+  }
+  if (result == CONFLICTING) {
+    release_range_part(job);
+  }
+
+  // Parts on other workers may fail at the same time, abort_transaction()
+  // lets only one of them release the locks
+  if (result != GRANTED) {
+    abort_transaction(transaction, job.partition);
+  }
+  unpin_transaction(node);
+  return result;
+}
+
+void LockManager::release_range_part(Job &job) {
+  // Get the transaction object
+  Node<Transaction> *node = pin_transaction(job.transaction_id);
+  if (node == nullptr) {
+    spdlog::error("Transaction was not registered");
+    return;
+  }
+  Transaction *transaction = &node->value;
+
+  pthread_mutex_lock(&range_mutex[job.partition]);
+  if (removeRange(&rangeIndex_[job.partition], job.row_id, job.last_row_id,
+                  job.transaction_id)) {
+    numRanges_--;
+    transaction->mut.lock();
+    transaction->locked_ranges--;
+    transaction->growing_phase = false;
+    transaction->mut.unlock();
+  }
+  pthread_mutex_unlock(&range_mutex[job.partition]);
+  unpin_transaction(node);
+}
+
+void LockManager::finish_range_part(Job &job, bool ok) {
+  RangeRequest *range = (RangeRequest *)job.range;
+  if (!ok) {
+    range->failed = true;
+  }
+  if (--range->pending > 0) {
+    return;
+  }
+
+  // If the transaction released its last lock, delete it
+  if (job.command == UNLOCK_RANGE) {
+    remove_if_idle(job.transaction_id);
+  }
+  complete_job(range->job, !range->failed);
+  delete range;
+}
+
+void LockManager::release_part(Job &job) {
+  ReleaseRequest *request = (ReleaseRequest *)job.release;
+  Transaction *transaction = &request->node->value;
+  for (auto lockedRow : request->rows[job.partition]) {
+    lock_row(lockedRow);
+    releaseLock(transaction, lockedRow, lockTable_);
+    grant_waiters(lockedRow);
+    unlock_row(lockedRow);
+  }
+
+  // Nobody waits for the locks of pages, tables and the database
+  for (auto key : request->granules[job.partition]) {
+    lock_row(key);
+    lock_granules();
+    releaseGranuleLock(transaction, key, granuleTable_);
+    unlock_granules();
+    unlock_row(key);
+  }
+}
+
+void LockManager::finish_release_part(Job &job) {
+  ReleaseRequest *request = (ReleaseRequest *)job.release;
+  if (--request->pending > 0) {
+    return;
+  }
+
+  release_other_locks(&request->node->value);
+  delete_transaction(request->node);
+  complete_job(request->job, true);
+  delete request;
+}
+
+auto LockManager::conflicts_with_range(Transaction *transaction,
+                                       unsigned int rowId, bool isExclusive)
+    -> bool {
+  if (numRanges_ == 0) {
+    return false;
+  }
+
+  int partition = partition_of(rowId);
+  pthread_mutex_lock(&range_mutex[partition]);
+  bool conflict =
+      findConflictingRange(&rangeIndex_[partition], rowId, rowId,
+                           transaction->transaction_id, isExclusive);
+  pthread_mutex_unlock(&range_mutex[partition]);
+  if (conflict) {
+    spdlog::error("Row is covered by a conflicting range lock");
+  }
+  return conflict;
+}
+
+auto LockManager::acquire_granule_lock(Job &job) -> LockResult {
+  // Get the transaction object for the given transaction ID
+  Node<Transaction> *node = pin_transaction(job.transaction_id);
+  if (node == nullptr) {
+    spdlog::error("Transaction was not registered");
+    return REJECTED;
+  }
+  Transaction *transaction = &node->value;
+
+  LockResult result;
+  if (!transaction->growing_phase || transaction->aborted) {
+    spdlog::error("Cannot acquire more locks according to 2PL");
+    result = REJECTED;
+  } else if (!follows_hierarchy(transaction, job)) {
+    result = REJECTED;
+  } else {
+    int key = granuleKey(job.granule, job.row_id);
+    lock_row(key);
+    lock_granules();
+    GranuleLock *lock = get(granuleTable_, key);
+    if (lock == nullptr) {
+      lock = insert(granuleTable_, key);
+      initGranuleLock(lock);
+    }
+
+    // Tables also conflict with the row locks counted within them
+    LockMode mode = job.mode;
+    LockMode held;
+    if (granuleMode(transaction, key, &held)) {
+      mode = strongestOf(held, job.mode);
+    }
+    if (job.granule == TABLE &&
+        conflictsWithRows(lock, rowLocksIn(transaction, job.row_id), mode)) {
+      spdlog::error("Table contains rows locked in a conflicting mode");
+      result = CONFLICTING;
+    } else {
+      result = addGranuleLock(transaction, key, job.mode, lock) ? GRANTED
+                                                                 : CONFLICTING;
+    }
+    if (isUnused(lock)) {
+      remove(granuleTable_, key);
+    }
+    unlock_granules();
+    unlock_row(key);
+  }
+
+  if (result != GRANTED) {
+    abort_transaction(transaction, job.partition);
+  }
+  unpin_transaction(node);
+  return result;
+}
+
+auto LockManager::follows_hierarchy(Transaction *transaction, Job &job)
+    -> bool {
+  if (job.granule == ROW && job.mode != S_LOCK && job.mode != U_LOCK &&
+      job.mode != X_LOCK) {
+    spdlog::error("Rows can only be locked in S, U or X mode");
+    return false;
+  }
+  if (job.granule == DATABASE) {
+    return true;
+  }
+
+  LockMode parentMode;
+  Granule parent = (Granule)(job.granule + 1);
+  if (!granuleMode(transaction,
+                   granuleKey(parent, parentOf(job.granule, job.row_id)),
+                   &parentMode) ||
+      !allowsChild(parentMode, job.mode)) {
+    spdlog::error("Parent granule is not locked in an intention mode");
+    return false;
+  }
+  return true;
+}
+
+void LockManager::grant_waiters(unsigned int rowId) {
+  if (arg.conflict_policy != WAIT_ON_CONFLICT) {
+    return;
+  }
+
+  Job *job;
+  while ((job = firstWaiter(waitTable_, rowId)) != nullptr) {
+    // The transaction may have been aborted while its request was waiting
+    Node<Transaction> *node = pin_transaction(job->transaction_id);
+    Transaction *transaction = node == nullptr ? nullptr : &node->value;
+    LockResult result;
+    TableAccess access = NOT_COUNTED;
+    if (transaction == nullptr ||
+        conflicts_with_range(transaction, rowId, is_exclusive(*job))) {
+      result = REJECTED;
+    } else {
+      bool isUpgrade = row_mode(*job) != S_LOCK && hasLock(transaction, rowId);
+      access = enter_table(transaction, rowId, is_exclusive(*job));
+      if (access == COVERED) {
+        result = GRANTED;
+      } else if (access == BLOCKED) {
+        result = REJECTED;
+      } else {
+        result = acquire_row_lock(transaction, rowId, row_mode(*job));
+      }
+      if (access == COUNTED) {
+        settle_row_count(transaction, rowId, is_exclusive(*job), result,
+                         isUpgrade);
+      }
+    }
+    if (node != nullptr) {
+      unpin_transaction(node);
+    }
+    if (result == CONFLICTING) {
+      break;
+    }
+
+    // A rejected request only fails, as aborting its transaction would release
+    // the locks on other rows while holding the stripe of this row
+    complete_job(*job, result == GRANTED);
+    dequeueWaiter(waitTable_, rowId);
+  }
 }
 
 void LockManager::release_lock(unsigned int transactionId, unsigned int rowId) {
   // Get the transaction object
-  auto transaction = (Transaction *)get(transactionTable_, transactionId);
-  if (transaction == nullptr) {
+  Node<Transaction> *node = pin_transaction(transactionId);
+  if (node == nullptr) {
     spdlog::error("Transaction was not registered");
     return;
   }
+  Transaction *transaction = &node->value;
 
   // Get the lock object
-  auto lock = (Lock *)get(lockTable_, rowId);
+  lock_row(rowId);
+  Lock *lock = get(lockTable_, rowId);
   if (lock == nullptr) {
+    unlock_row(rowId);
+    unpin_transaction(node);
     spdlog::error("Lock does not exist");
     return;
   }
 
+  bool isExclusive = isHeldExclusively(lock);
+  bool isCounted = hasLock(transaction, rowId);
   releaseLock(transaction, rowId, lockTable_);
+  if (isCounted) {
+    leave_table(transaction, rowId, isExclusive);
+  }
+  grant_waiters(rowId);
+  unlock_row(rowId);
 
   // If the transaction released its last lock, delete it
-  if (transaction->locked_rows.size() == 0) {
-    remove(transactionTable_, transactionId);
-    delete transaction;
+  remove_if_idle(transactionId);
+  unpin_transaction(node);
+}
+
+void LockManager::release_granule_lock(unsigned int transactionId,
+                                       Granule granule, unsigned int id) {
+  // Get the transaction object
+  Node<Transaction> *node = pin_transaction(transactionId);
+  if (node == nullptr) {
+    spdlog::error("Transaction was not registered");
+    return;
   }
+  Transaction *transaction = &node->value;
+
+  int key = granuleKey(granule, id);
+  lock_row(key);
+  lock_granules();
+  releaseGranuleLock(transaction, key, granuleTable_);
+  unlock_granules();
+  unlock_row(key);
+
+  // If the transaction released its last lock, delete it
+  remove_if_idle(transactionId);
+  unpin_transaction(node);
+}
+
+void LockManager::abort_transaction(Transaction *transaction, int partition) {
+  // Only the worker that removes the transaction from the table releases its
+  // locks, the caller's pin keeps it alive for the others
+  Node<Transaction> *node =
+      extract_transaction(transaction->transaction_id, transaction);
+  if (node == nullptr) {
+    return;
+  }
+  transaction->aborted = true;
+
+  // The same parts release the locks as for an ABORT request
+  Job job;
+  job.command = ABORT;
+  job.transaction_id = transaction->transaction_id;
+  job.wait_for_result = false;
+  release_in_parts(job, node, partition);
 }
 
-void LockManager::abort_transaction(Transaction *transaction) {
-  remove(transactionTable_, transaction->transaction_id);
-  releaseAllLocks(transaction, lockTable_);
-  delete transaction;
+void LockManager::release_other_locks(Transaction *transaction) {
+  // The released row locks are not counted within their tables anymore
+  lock_granules();
+  for (auto &counted : transaction->table_rows) {
+    int key = granuleKey(TABLE, counted.first);
+    GranuleLock *lock = get(granuleTable_, key);
+    if (lock != nullptr) {
+      lock->rows.shared -= counted.second.shared;
+      lock->rows.exclusive -= counted.second.exclusive;
+      if (isUnused(lock)) {
+        remove(granuleTable_, key);
+      }
+    }
+  }
+  transaction->table_rows.clear();
+  unlock_granules();
+
+  // Parts of a range that are acquired from now on see that the transaction
+  // aborted
+  for (int partition = 0; partition < arg.num_partitions; partition++) {
+    pthread_mutex_lock(&range_mutex[partition]);
+    numRanges_ -=
+        removeRanges(&rangeIndex_[partition], transaction->transaction_id);
+    pthread_mutex_unlock(&range_mutex[partition]);
+  }
 }
\ No newline at end of file
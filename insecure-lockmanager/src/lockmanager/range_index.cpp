@@ -0,0 +1,57 @@
+#include "range_index.h"
+
+void initRangeIndex(RangeIndex* index) {
+  index->ranges.clear();
+  index->max_length = 0;
+}
+
+auto findConflictingRange(RangeIndex* index, unsigned int first,
+                          unsigned int last, int transactionId,
+                          bool isExclusive) -> bool {
+  unsigned int from = first > index->max_length ? first - index->max_length : 0;
+  auto end = index->ranges.upper_bound(last);
+  for (auto it = index->ranges.lower_bound(from); it != end; it++) {
+    const RangeLock& range = it->second;
+    if (range.last >= first && range.transaction_id != transactionId &&
+        (isExclusive || range.exclusive)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void insertRange(RangeIndex* index, unsigned int first, unsigned int last,
+                 int transactionId, bool isExclusive) {
+  index->ranges.insert({first, {last, transactionId, isExclusive}});
+
+  // The bound only ever grows, as shrinking it would need another pass over
+  // all ranges
+  if (last - first > index->max_length) {
+    index->max_length = last - first;
+  }
+}
+
+auto removeRange(RangeIndex* index, unsigned int first, unsigned int last,
+                 int transactionId) -> bool {
+  auto candidates = index->ranges.equal_range(first);
+  for (auto it = candidates.first; it != candidates.second; it++) {
+    if (it->second.last == last && it->second.transaction_id == transactionId) {
+      index->ranges.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+auto removeRanges(RangeIndex* index, int transactionId) -> int {
+  int removed = 0;
+  for (auto it = index->ranges.begin(); it != index->ranges.end();) {
+    if (it->second.transaction_id == transactionId) {
+      it = index->ranges.erase(it);
+      removed++;
+    } else {
+      it++;
+    }
+  }
+  return removed;
+}
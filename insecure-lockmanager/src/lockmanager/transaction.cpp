@@ -1,14 +1,29 @@
 #include "transaction.h"
 
-Transaction* newTransaction(int transactionId, int lockBudget) {
-  Transaction* transaction = new Transaction();
+#include "pool.h"
+
+void initTransaction(Transaction* transaction, int transactionId,
+                     int lockBudget) {
   transaction->transaction_id = transactionId;
   transaction->aborted = false;
   transaction->growing_phase = true;
   transaction->lock_budget = lockBudget;
+  transaction->locked_rows.clear();
+  transaction->granule_locks.clear();
+  transaction->locked_ranges = 0;
+  transaction->table_rows.clear();
+  transaction->pins = 0;
+  transaction->detached = false;
+}
+
+Transaction* newTransaction(int transactionId, int lockBudget) {
+  Transaction* transaction = poolNew<Transaction>();
+  initTransaction(transaction, transactionId, lockBudget);
   return transaction;
 }
 
+void deleteTransaction(Transaction* transaction) { poolDelete(transaction); }
+
 auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock)
     -> bool {
   if (transaction->aborted) {
@@ -32,35 +47,156 @@ auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock)
   return ret;
 };
 
-void releaseLock(Transaction* transaction, int rowId, HashTable* lockTable) {
+auto addUpdateLock(Transaction* transaction, int rowId, Lock* lock) -> bool {
+  if (transaction->aborted ||
+      !getUpdateAccess(lock, transaction->transaction_id)) {
+    return false;
+  }
+
+  transaction->mut.lock();
+  transaction->locked_rows.insert(rowId);
+  transaction->lock_budget--;
+  transaction->mut.unlock();
+  return true;
+};
+
+void releaseLock(Transaction* transaction, int rowId, LockTable* lockTable) {
   if (hasLock(transaction, rowId)) {
     transaction->mut.lock();
     transaction->locked_rows.erase(rowId);
     transaction->growing_phase = false;
     transaction->mut.unlock();
 
-    auto lock = (Lock*)get(lockTable, rowId);
+    Lock* lock = get(lockTable, rowId);
     release(lock, transaction->transaction_id);
 
-    if (lock->owners.size() == 0) {
+    if (numOwners(lock) == 0) {
       remove(lockTable, rowId);
-      delete lock;
     }
   }
 };
 
+void releaseCoveredLock(Transaction* transaction, int rowId,
+                        LockTable* lockTable) {
+  if (!hasLock(transaction, rowId)) {
+    return;
+  }
+
+  transaction->mut.lock();
+  bool growingPhase = transaction->growing_phase;
+  transaction->mut.unlock();
+  releaseLock(transaction, rowId, lockTable);
+
+  transaction->mut.lock();
+  transaction->growing_phase = growingPhase;
+  transaction->lock_budget++;
+  transaction->mut.unlock();
+};
+
 auto hasLock(Transaction* transaction, int rowId) -> bool {
-  return transaction->locked_rows.find(rowId) != transaction->locked_rows.end();
+  // Workers serving other partitions may change the rows meanwhile
+  transaction->mut.lock();
+  bool ret =
+      transaction->locked_rows.find(rowId) != transaction->locked_rows.end();
+  transaction->mut.unlock();
+  return ret;
 };
 
-void releaseAllLocks(Transaction* transaction, HashTable* lockTable) {
+void releaseAllLocks(Transaction* transaction, LockTable* lockTable) {
   for (auto locked_row : transaction->locked_rows) {
-    auto lock = (Lock*)get(lockTable, locked_row);
+    Lock* lock = get(lockTable, locked_row);
     release(lock, transaction->transaction_id);
-    if (lock->owners.size() == 0) {
+    if (numOwners(lock) == 0) {
       remove(lockTable, locked_row);
     }
   }
   transaction->locked_rows.clear();
   transaction->aborted = true;
-};
\ No newline at end of file
+};
+
+auto addGranuleLock(Transaction* transaction, int key, LockMode mode,
+                    GranuleLock* lock) -> bool {
+  if (transaction->aborted) {
+    return false;
+  }
+
+  bool ret;
+  transaction->mut.lock();
+  auto held = transaction->granule_locks.find(key);
+  if (held != transaction->granule_locks.end()) {
+    ret = acquireGranule(lock, &held->second, mode);
+  } else {
+    ret = acquireGranule(lock, nullptr, mode);
+    if (ret) {
+      transaction->granule_locks[key] = mode;
+      transaction->lock_budget--;
+    }
+  }
+  transaction->mut.unlock();
+
+  return ret;
+};
+
+auto granuleMode(Transaction* transaction, int key, LockMode* mode) -> bool {
+  transaction->mut.lock();
+  auto held = transaction->granule_locks.find(key);
+  bool ret = held != transaction->granule_locks.end();
+  if (ret) {
+    *mode = held->second;
+  }
+  transaction->mut.unlock();
+  return ret;
+};
+
+void releaseGranuleLock(Transaction* transaction, int key,
+                        GranuleTable* granuleTable) {
+  transaction->mut.lock();
+  auto held = transaction->granule_locks.find(key);
+  if (held == transaction->granule_locks.end()) {
+    transaction->mut.unlock();
+    return;
+  }
+  LockMode mode = held->second;
+  transaction->granule_locks.erase(held);
+  transaction->growing_phase = false;
+  transaction->mut.unlock();
+
+  GranuleLock* lock = get(granuleTable, key);
+  if (lock != nullptr) {
+    releaseGranule(lock, mode);
+    if (isUnused(lock)) {
+      remove(granuleTable, key);
+    }
+  }
+};
+
+void countRowLock(Transaction* transaction, int rowId, bool isExclusive,
+                  int delta) {
+  transaction->mut.lock();
+  unsigned int table = tableOf(rowId);
+  RowCounts& rows = transaction->table_rows[table];
+  countRows(&rows, isExclusive, delta);
+  if (rows.shared == 0 && rows.exclusive == 0) {
+    transaction->table_rows.erase(table);
+  }
+  transaction->mut.unlock();
+};
+
+auto rowLocksIn(Transaction* transaction, unsigned int table) -> RowCounts {
+  transaction->mut.lock();
+  auto counted = transaction->table_rows.find(table);
+  RowCounts rows = counted != transaction->table_rows.end()
+                       ? counted->second
+                       : RowCounts{0, 0};
+  transaction->mut.unlock();
+  return rows;
+};
+
+auto holdsLocks(Transaction* transaction) -> bool {
+  transaction->mut.lock();
+  bool ret = !transaction->locked_rows.empty() ||
+             !transaction->granule_locks.empty() ||
+             transaction->locked_ranges > 0;
+  transaction->mut.unlock();
+  return ret;
+};
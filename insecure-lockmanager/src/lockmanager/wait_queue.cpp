@@ -0,0 +1,74 @@
+#include "wait_queue.h"
+
+#include "pool.h"
+
+auto mayWait(WaitTable* waitTable, Lock* lock, int rowId, int transactionId,
+             bool isUpgrade) -> bool {
+  if (lock != nullptr) {
+    int count = numOwners(lock);
+    for (int i = 0; i < count; i++) {
+      if (ownerAt(lock, i) < transactionId) {
+        return false;
+      }
+    }
+  }
+  WaitQueue* queue = get(waitTable, rowId);
+  if (queue != nullptr && !isUpgrade) {
+    for (Waiter* waiter = queue->head; waiter != nullptr;
+         waiter = waiter->next) {
+      if ((int)waiter->job.transaction_id <= transactionId) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void enqueueWaiter(WaitTable* waitTable, Job& job, bool isUpgrade) {
+  Waiter* waiter = poolNew<Waiter>();
+  waiter->job = job;
+  waiter->next = nullptr;
+
+  WaitQueue* queue = get(waitTable, job.row_id);
+  if (queue == nullptr) {
+    queue = insert(waitTable, job.row_id);
+    queue->head = waiter;
+    queue->tail = waiter;
+  } else if (isUpgrade) {
+    waiter->next = queue->head;
+    queue->head = waiter;
+  } else {
+    queue->tail->next = waiter;
+    queue->tail = waiter;
+  }
+}
+
+auto firstWaiter(WaitTable* waitTable, int rowId) -> Job* {
+  WaitQueue* queue = get(waitTable, rowId);
+  return queue == nullptr ? nullptr : &queue->head->job;
+}
+
+void dequeueWaiter(WaitTable* waitTable, int rowId) {
+  WaitQueue* queue = get(waitTable, rowId);
+  if (queue == nullptr) {
+    return;
+  }
+  Waiter* waiter = queue->head;
+  queue->head = waiter->next;
+  poolDelete(waiter);
+  if (queue->head == nullptr) {
+    remove(waitTable, rowId);
+  }
+}
+
+void destroyWaitQueue(Entry* entry, void (*cancel)(Job&)) {
+  Node<WaitQueue>* node = nodeOf<WaitQueue>(entry);
+  Waiter* waiter = node->value.head;
+  while (waiter != nullptr) {
+    Waiter* next = waiter->next;
+    cancel(waiter->job);
+    poolDelete(waiter);
+    waiter = next;
+  }
+  poolDelete(node);
+}
@@ -39,13 +39,84 @@ auto LockingServiceImpl::LockShared(ServerContext* context,
   return Status::CANCELLED;
 }
 
+auto LockingServiceImpl::LockGranule(ServerContext* context,
+                                     const LockRequest* request,
+                                     LockResponse* response) -> Status {
+  unsigned int transaction_id = request->transaction_id();
+  unsigned int row_id = request->row_id();
+  bool wait_for_signature = request->wait_for_signature();
+  if (!GranuleLevel_IsValid(request->granule()) ||
+      !GranuleMode_IsValid(request->mode())) {
+    return Status::CANCELLED;
+  }
+
+  // The values of the proto enums match the ones of Granule and LockMode
+  if (lockManager_.lock(transaction_id,
+                        static_cast<Granule>(request->granule()), row_id,
+                        static_cast<LockMode>(request->mode()),
+                        wait_for_signature)) {
+    return Status::OK;
+  }
+  return Status::CANCELLED;
+}
+
+auto LockingServiceImpl::LockRange(ServerContext* context,
+                                   const LockRequest* request,
+                                   LockResponse* response) -> Status {
+  unsigned int transaction_id = request->transaction_id();
+  bool wait_for_signature = request->wait_for_signature();
+  if (request->mode() != MODE_S && request->mode() != MODE_X) {
+    return Status::CANCELLED;
+  }
+
+  if (lockManager_.lockRange(transaction_id, request->row_id(),
+                             request->last_row_id(),
+                             request->mode() == MODE_X, wait_for_signature)) {
+    return Status::OK;
+  }
+  return Status::CANCELLED;
+}
+
+auto LockingServiceImpl::UnlockRange(ServerContext* context,
+                                     const LockRequest* request,
+                                     LockResponse* response) -> Status {
+  unsigned int transaction_id = request->transaction_id();
+  bool wait_for_signature = request->wait_for_signature();
+
+  lockManager_.unlockRange(transaction_id, request->row_id(),
+                           request->last_row_id(), wait_for_signature);
+  return Status::OK;
+}
+
 auto LockingServiceImpl::Unlock(ServerContext* context,
                                 const LockRequest* request,
                                 LockResponse* response) -> Status {
   unsigned int transaction_id = request->transaction_id();
   unsigned int row_id = request->row_id();
   bool wait_for_signature = request->wait_for_signature();
+  if (!GranuleLevel_IsValid(request->granule())) {
+    return Status::CANCELLED;
+  }
 
-  lockManager_.unlock(transaction_id, row_id, wait_for_signature);
+  lockManager_.unlock(transaction_id, static_cast<Granule>(request->granule()),
+                      row_id, wait_for_signature);
   return Status::OK;
+}
+
+auto LockingServiceImpl::Commit(ServerContext* context,
+                                const TransactionRequest* request,
+                                TransactionResponse* response) -> Status {
+  if (lockManager_.commit(request->transaction_id())) {
+    return Status::OK;
+  }
+  return Status::CANCELLED;
+}
+
+auto LockingServiceImpl::Abort(ServerContext* context,
+                               const TransactionRequest* request,
+                               TransactionResponse* response) -> Status {
+  if (lockManager_.abort(request->transaction_id())) {
+    return Status::OK;
+  }
+  return Status::CANCELLED;
 }
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "completion.h"
+
+class CompletionTest : public ::testing::Test {
+ protected:
+  void SetUp() override { initCompletion(&completion_); };
+
+  Completion completion_;
+};
+
+// A completion that is done before the thread waits for it needs no wake up
+TEST_F(CompletionTest, finishesBeforeWaiting) {
+  EXPECT_FALSE(finishCompletion(&completion_));
+  waitForCompletion(&completion_);
+  EXPECT_EQ(completion_.state.load(), kCompletionDone);
+};
+
+// A thread that parked on a completion has to be woken up by the thread that
+// finishes it
+TEST_F(CompletionTest, wakesParkedWaiter) {
+  std::thread waiter([this] { waitForCompletion(&completion_); });
+  while (completion_.state.load() != kCompletionParked) {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+
+  EXPECT_TRUE(finishCompletion(&completion_));
+  wakeCompletion(&completion_);
+  waiter.join();
+  EXPECT_EQ(completion_.state.load(), kCompletionDone);
+};
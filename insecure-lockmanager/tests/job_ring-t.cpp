@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "job_ring.h"
+
+class JobRingTest : public ::testing::Test {
+ protected:
+  void SetUp() override { initJobRing(&ring_); };
+
+  void TearDown() override { destroyJobRing(&ring_); }
+
+  auto makeJob(unsigned int transactionId, unsigned int rowId) -> Job {
+    Job job;
+    job.command = SHARED;
+    job.transaction_id = transactionId;
+    job.row_id = rowId;
+    return job;
+  }
+
+  JobRing ring_;
+};
+
+// Jobs of a single producer are taken in the order they were pushed
+TEST_F(JobRingTest, keepsOrder) {
+  for (unsigned int i = 0; i < 10; i++) {
+    EXPECT_FALSE(pushJob(&ring_, makeJob(1, i)));
+  }
+
+  Job jobs[4];
+  unsigned int next = 0;
+  int numJobs;
+  while ((numJobs = popJobs(&ring_, jobs, 4)) > 0) {
+    for (int i = 0; i < numJobs; i++) {
+      EXPECT_EQ(jobs[i].row_id, next++);
+    }
+  }
+  EXPECT_EQ(next, 10);
+};
+
+// A consumer cannot sleep while a job is pushed, and a producer that pushes a
+// job to a sleeping consumer has to wake it up
+TEST_F(JobRingTest, wakesSleepingConsumer) {
+  EXPECT_TRUE(announceSleep(&ring_));
+  EXPECT_TRUE(pushJob(&ring_, makeJob(1, 1)));
+  cancelSleep(&ring_);
+
+  EXPECT_FALSE(announceSleep(&ring_));
+  EXPECT_TRUE(spinForJobs(&ring_));
+  Job job;
+  EXPECT_EQ(popJobs(&ring_, &job, 1), 1);
+  EXPECT_FALSE(spinForJobs(&ring_));
+};
+
+// Concurrent producers wrap around the ring several times without losing or
+// reordering their jobs
+TEST_F(JobRingTest, concurrentProducers) {
+  const int kNumProducers = 8;
+  const unsigned int kJobsPerProducer = 2 * kJobRingSize;
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < kNumProducers; producer++) {
+    producers.emplace_back([this, producer, kJobsPerProducer] {
+      for (unsigned int i = 0; i < kJobsPerProducer; i++) {
+        pushJob(&ring_, makeJob(producer, i));
+      }
+    });
+  }
+
+  std::vector<unsigned int> next(kNumProducers, 0);
+  Job jobs[16];
+  for (unsigned int taken = 0; taken < kNumProducers * kJobsPerProducer;) {
+    int numJobs = popJobs(&ring_, jobs, 16);
+    for (int i = 0; i < numJobs; i++) {
+      EXPECT_EQ(jobs[i].row_id, next[jobs[i].transaction_id]++);
+    }
+    taken += numJobs;
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  EXPECT_EQ(popJobs(&ring_, jobs, 16), 0);
+};
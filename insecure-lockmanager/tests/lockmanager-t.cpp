@@ -22,6 +22,20 @@ TEST_F(LockManagerTest, lockRequestAbortsWhenTransactionNotRegistered) {
   EXPECT_FALSE(lock_manager.lock(kTransactionIdA, kRowId, false));
 };
 
+// IDs beyond kMaxGranuleId would alias with the keys of other granules
+TEST_F(LockManagerTest, rejectsIdsBeyondKeyRange) {
+  LockManager lock_manager;
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, true));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, kMaxGranuleId + 1 + kRowId,
+                                 true));
+  EXPECT_FALSE(lock_manager.lockRange(kTransactionIdB, kMaxGranuleId,
+                                      kMaxGranuleId + 1, false));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kMaxGranuleId, true));
+};
+
 // Registering an already registered transaction
 TEST_F(LockManagerTest, cannotRegisterTwice) {
   LockManager lock_manager;
@@ -156,6 +170,75 @@ TEST_F(LockManagerTest, transactionGetsDeletedAfterReleasingLastLock) {
   EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
 }
 
+// Transactions registered concurrently with all workers are found by the
+// workers of their rows and removed once they released their last lock
+TEST_F(LockManagerTest, registersTransactionsAcrossWorkers) {
+  const int kNumClients = 4;
+  const int kTransactionsPerClient = 50;
+  LockManager lock_manager(4);
+  std::vector<std::thread> clients;
+  for (int client = 0; client < kNumClients; client++) {
+    clients.emplace_back([&lock_manager, client]() {
+      for (int i = 1; i <= kTransactionsPerClient; i++) {
+        unsigned int transactionId = client * kTransactionsPerClient + i;
+        EXPECT_TRUE(lock_manager.registerTransaction(transactionId));
+        EXPECT_FALSE(lock_manager.registerTransaction(transactionId));
+        EXPECT_TRUE(lock_manager.lock(transactionId, transactionId, true));
+        lock_manager.unlock(transactionId, transactionId, true);
+        EXPECT_TRUE(lock_manager.registerTransaction(transactionId));
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+}
+
+// Committing releases the row, range and granule locks of a transaction on
+// all workers at once and ends it
+TEST_F(LockManagerTest, commitReleasesAllLocks) {
+  LockManager lock_manager(4);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, DATABASE, 0, IX_LOCK));
+  for (unsigned int rowId = kRowId; rowId < kRowId + kLockBudget; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, rowId, true));
+  }
+  EXPECT_TRUE(lock_manager.lockRange(kTransactionIdA, 100, 200, true));
+
+  EXPECT_TRUE(lock_manager.commit(kTransactionIdA));
+  EXPECT_FALSE(lock_manager.commit(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, DATABASE, 0, IX_LOCK));
+  for (unsigned int rowId = kRowId; rowId < kRowId + kLockBudget; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdB, rowId, true));
+  }
+  EXPECT_TRUE(lock_manager.lockRange(kTransactionIdB, 150, 250, true));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+}
+
+// Aborting releases all locks of a transaction, and a transaction that was
+// aborted after a conflict cannot commit anymore
+TEST_F(LockManagerTest, abortReleasesAllLocks) {
+  LockManager lock_manager(4, CONCURRENT);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.abort(kTransactionIdA));
+  EXPECT_FALSE(lock_manager.abort(kTransactionIdA));
+
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  for (unsigned int rowId = kRowId; rowId < kRowId + kLockBudget; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, rowId, false));
+  }
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, kRowId, true));
+  EXPECT_FALSE(lock_manager.commit(kTransactionIdB));
+
+  EXPECT_TRUE(lock_manager.abort(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  for (unsigned int rowId = kRowId; rowId < kRowId + kLockBudget; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdB, rowId, true));
+  }
+}
+
 TEST_F(LockManagerTest, notWaitingForSignature) {
   LockManager lock_manager = LockManager();
   EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
@@ -166,4 +249,500 @@ TEST_F(LockManagerTest, notWaitingForSignature) {
   EXPECT_TRUE(lock_manager.lock(
       kTransactionIdA, 10000, false,
       true));  // waitung for signature return value at the end
-}
\ No newline at end of file
+}
+
+// Any worker can serve any row with the concurrent lock table
+TEST_F(LockManagerTest, concurrentEngineDetectsConflicts) {
+  LockManager lock_manager(4, CONCURRENT);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, false));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kRowId, false));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdC, kRowId, true));
+
+  lock_manager.unlock(kTransactionIdA, kRowId, true);
+  lock_manager.unlock(kTransactionIdB, kRowId, true);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, kRowId, true));
+}
+
+// Aborting a transaction releases its locks on rows served by other workers
+TEST_F(LockManagerTest, concurrentEngineReleasesLocksOnAbort) {
+  LockManager lock_manager(4, CONCURRENT);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  for (unsigned int rowId = kRowId; rowId < kRowId + kLockBudget; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, rowId, true));
+  }
+
+  // Make transaction A abort by acquiring the same lock again
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdA, kRowId, true));
+
+  for (unsigned int rowId = kRowId; rowId < kRowId + kLockBudget; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdB, rowId, true));
+  }
+}
+
+// A transaction that aborts after a conflict releases its row and granule
+// locks on the partitions of all workers
+TEST_F(LockManagerTest, abortReleasesLocksOnAllWorkers) {
+  LockManager lock_manager(4);
+  const unsigned int kRowDistance = 997;
+  const unsigned int kRows = 40;
+  for (int round = 0; round < 100; round++) {
+    EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+    EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kRows * kRowDistance, true));
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, DATABASE, 0, IX_LOCK));
+    for (unsigned int row = 0; row < kRows; row++) {
+      EXPECT_TRUE(lock_manager.lock(kTransactionIdA, row * kRowDistance, true));
+    }
+
+    // The conflict aborts transaction A
+    EXPECT_FALSE(
+        lock_manager.lock(kTransactionIdA, kRows * kRowDistance, true));
+
+    for (unsigned int row = 0; row < kRows; row++) {
+      EXPECT_TRUE(lock_manager.lock(kTransactionIdB, row * kRowDistance, true));
+    }
+    EXPECT_TRUE(lock_manager.commit(kTransactionIdB));
+    EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdC, DATABASE, 0, X_LOCK));
+    EXPECT_TRUE(lock_manager.commit(kTransactionIdC));
+  }
+}
+
+// The concurrent engine releases the granule locks of a transaction that
+// aborts after a conflict the same way
+TEST_F(LockManagerTest, concurrentEngineReleasesGranulesOnAbort) {
+  LockManager lock_manager(4, CONCURRENT);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, DATABASE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, true));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, DATABASE, 0, X_LOCK));
+
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdA, kRowId, true));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, DATABASE, 0, X_LOCK));
+}
+
+// Many clients requesting the same few rows at once
+TEST_F(LockManagerTest, concurrentEngineWithConcurrentClients) {
+  LockManager lock_manager(4, CONCURRENT);
+  const unsigned int numClients = 8;
+  std::vector<std::thread> clients;
+  std::atomic<int> failures = 0;
+
+  for (unsigned int client = 1; client <= numClients; client++) {
+    EXPECT_TRUE(lock_manager.registerTransaction(client));
+  }
+  for (unsigned int client = 1; client <= numClients; client++) {
+    clients.emplace_back([&, client]() {
+      for (unsigned int rowId = 0; rowId < 100; rowId++) {
+        // Shared locks on the hot rows, exclusive locks on distinct rows
+        if (!lock_manager.lock(client, rowId, false) ||
+            !lock_manager.lock(client, client * 1000 + rowId, true)) {
+          failures++;
+        }
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+  EXPECT_EQ(failures, 0);
+}
+
+// An older transaction waits for a conflicting lock until it is released
+TEST_F(LockManagerTest, olderTransactionWaitsForLock) {
+  LockManager lock_manager(1, PARTITIONED, WAIT_ON_CONFLICT);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kRowId, true));
+
+  std::atomic<bool> granted = false;
+  std::thread waiter([&]() {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, false));
+    granted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(granted);
+
+  lock_manager.unlock(kTransactionIdB, kRowId, true);
+  waiter.join();
+  EXPECT_TRUE(granted);
+}
+
+// A younger transaction aborts instead of waiting for an older one
+TEST_F(LockManagerTest, youngerTransactionDies) {
+  LockManager lock_manager(1, PARTITIONED, WAIT_ON_CONFLICT);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, false));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, kRowId, true));
+}
+
+// Waiting requests are granted in the order they arrived
+TEST_F(LockManagerTest, waitersAreGrantedInOrder) {
+  LockManager lock_manager(4, CONCURRENT, WAIT_ON_CONFLICT);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, kRowId, true));
+
+  std::atomic<int> grants = 0;
+  std::thread waiterB([&]() {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kRowId, true));
+    EXPECT_EQ(grants++, 0);
+    lock_manager.unlock(kTransactionIdB, kRowId, true);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  std::thread waiterA([&]() {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, true));
+    EXPECT_EQ(grants++, 1);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(grants, 0);
+
+  lock_manager.unlock(kTransactionIdC, kRowId, true);
+  waiterB.join();
+  waiterA.join();
+  EXPECT_EQ(grants, 2);
+}
+
+// An upgrade waits ahead of the requests that were queued before it
+TEST_F(LockManagerTest, upgradeIsGrantedBeforeWaitingRequests) {
+  LockManager lock_manager(1, PARTITIONED, WAIT_ON_CONFLICT);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kRowId, false));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, kRowId, false));
+
+  std::atomic<int> grants = 0;
+  std::thread waiterA([&]() {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, true));
+    EXPECT_EQ(grants++, 1);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  std::thread upgraderB([&]() {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kRowId, true));
+    EXPECT_EQ(grants++, 0);
+    lock_manager.unlock(kTransactionIdB, kRowId, true);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(grants, 0);
+
+  lock_manager.unlock(kTransactionIdC, kRowId, true);
+  upgraderB.join();
+  waiterA.join();
+  EXPECT_EQ(grants, 2);
+}
+
+// A table-level S lock conflicts with intention locks of writers
+TEST_F(LockManagerTest, tableScanConflictsWithWriter) {
+  LockManager lock_manager;
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, DATABASE, 0, IS_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, TABLE, 0, S_LOCK));
+
+  // Readers of single rows may lock the table in IS mode
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, DATABASE, 0, IS_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, TABLE, 0, IS_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, PAGE, 0, IS_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, ROW, kRowId, S_LOCK));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, DATABASE, 0, IX_LOCK));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, TABLE, 0, IX_LOCK));
+}
+
+// Granules can only be locked below a parent held in an intention mode
+TEST_F(LockManagerTest, parentMustBeLockedInIntentionMode) {
+  LockManager lock_manager;
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdA, TABLE, 0, IS_LOCK));
+
+  // X on a page requires IX on its table, IS is not enough
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, DATABASE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, TABLE, 0, IS_LOCK));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, PAGE, 0, X_LOCK));
+}
+
+// Rows are only locked in S or X mode and conflict with the other lock()
+TEST_F(LockManagerTest, rowsAreLockedInSharedOrExclusiveMode) {
+  LockManager lock_manager;
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, DATABASE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, TABLE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, PAGE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, ROW, kRowId, X_LOCK));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, kRowId, false));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, DATABASE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, TABLE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, PAGE, 0, IX_LOCK));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdC, ROW, kRowId + 1, IX_LOCK));
+}
+
+// A row read before it is written is locked in U mode, which shares the row
+// with readers but not with other updaters, and converts to X once the
+// readers are gone
+TEST_F(LockManagerTest, updateLockConvertsToExclusive) {
+  LockManager lock_manager;
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, DATABASE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, TABLE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, PAGE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, ROW, kRowId, U_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kRowId, false));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, DATABASE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, TABLE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, PAGE, 0, IX_LOCK));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdC, ROW, kRowId, U_LOCK));
+
+  lock_manager.unlock(kTransactionIdB, kRowId, true);
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, ROW, kRowId, X_LOCK));
+}
+
+// Reading a whole table while writing some of its rows converts S and IX into
+// SIX, which excludes other readers of the table
+TEST_F(LockManagerTest, convertsToSharedIntentionExclusive) {
+  LockManager lock_manager;
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, DATABASE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, TABLE, 0, S_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, TABLE, 0, IX_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, PAGE, 0, X_LOCK));
+
+  // SIX is compatible with IS only
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, DATABASE, 0, IS_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, TABLE, 0, IS_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdC, DATABASE, 0, IS_LOCK));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdC, TABLE, 0, S_LOCK));
+}
+
+// Releasing the last granule lock deletes the transaction, aborting releases
+// its granule locks
+TEST_F(LockManagerTest, releasesGranuleLocks) {
+  LockManager lock_manager;
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, DATABASE, 0, X_LOCK));
+  lock_manager.unlock(kTransactionIdA, DATABASE, 0, true);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, DATABASE, 0, IS_LOCK));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, TABLE, 0, S_LOCK));
+
+  // Make transaction A abort by requesting a row lock twice
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, false));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdA, kRowId, false));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, DATABASE, 0, X_LOCK));
+}
+
+// A range lock conflicts with the row locks of other transactions within it
+TEST_F(LockManagerTest, rangeConflictsWithLockedRow) {
+  LockManager lock_manager;
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId + 5, false));
+  EXPECT_TRUE(lock_manager.lockRange(kTransactionIdB, kRowId, kRowId + 9,
+                                     false));
+  EXPECT_FALSE(lock_manager.lockRange(kTransactionIdC, kRowId, kRowId + 9,
+                                      true));
+}
+
+// Row locks of other transactions within an exclusive range conflict with it
+TEST_F(LockManagerTest, rowWithinRangeConflicts) {
+  LockManager lock_manager;
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+
+  EXPECT_TRUE(lock_manager.lockRange(kTransactionIdA, kRowId, kRowId + 9,
+                                     true));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId + 5, true));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kRowId + 10, true));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdC, kRowId + 9, false));
+}
+
+// Shared ranges may overlap, exclusive ones must not
+TEST_F(LockManagerTest, overlappingRanges) {
+  LockManager lock_manager;
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+
+  EXPECT_TRUE(lock_manager.lockRange(kTransactionIdA, 10, 20, false));
+  EXPECT_TRUE(lock_manager.lockRange(kTransactionIdB, 15, 100, false));
+  EXPECT_TRUE(lock_manager.lockRange(kTransactionIdC, 101, 110, true));
+  EXPECT_FALSE(lock_manager.lockRange(kTransactionIdC, 1, 10, true));
+}
+
+// Ranges are split across the workers owning their rows and conflicts are
+// detected by any of them
+TEST_F(LockManagerTest, rangeSpansPartitions) {
+  LockManager lock_manager(4, CONCURRENT);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+
+  EXPECT_TRUE(lock_manager.lockRange(kTransactionIdA, 0, 9999, false));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, 42, false));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, 9000, true));
+}
+
+// Parts of a range that conflict on several workers at once abort the
+// transaction only once
+TEST_F(LockManagerTest, rangeConflictsOnSeveralWorkers) {
+  LockManager lock_manager(4);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, 100, true));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, 3000, true));
+
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+    EXPECT_FALSE(lock_manager.lockRange(kTransactionIdA, 0, 4000, false));
+  }
+
+  // The locks of the other transaction are untouched, no range is left over
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdC, 3000, false));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, 50, true));
+}
+
+// Releasing a range lets other transactions lock its rows and deletes the
+// transaction once it holds no more locks
+TEST_F(LockManagerTest, unlockRange) {
+  LockManager lock_manager;
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+
+  EXPECT_TRUE(lock_manager.lockRange(kTransactionIdA, kRowId, kRowId + 9,
+                                     true));
+  lock_manager.unlockRange(kTransactionIdA, kRowId, kRowId + 9, true);
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kRowId, true));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_FALSE(lock_manager.lockRange(kTransactionIdA, kRowId + 1, kRowId,
+                                      false));
+}
+
+// Locking more rows of a table than the threshold replaces the row locks by a
+// lock on the table, which conflicts with writers of any of its rows
+TEST_F(LockManagerTest, escalatesRowLocksToTable) {
+  LockManager lock_manager(1, PARTITIONED, ABORT_ON_CONFLICT, 4);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+
+  for (unsigned int row = 0; row < 5; row++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, row, false));
+  }
+  EscalationStatistics stats = lock_manager.getEscalationStatistics();
+  EXPECT_EQ(stats.escalations, 1);
+  EXPECT_EQ(stats.escalated_rows, 5);
+
+  // The table lock covers rows that were not locked before
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, 100, false));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, 200, false));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdC, 300, true));
+}
+
+// Escalation fails while another transaction writes a row of the table, and
+// the transaction keeps its row locks
+TEST_F(LockManagerTest, escalationConflictsWithWriters) {
+  LockManager lock_manager(1, PARTITIONED, ABORT_ON_CONFLICT, 4);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdC));
+
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, 1000, true));
+  for (unsigned int row = 0; row < 5; row++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, row, false));
+  }
+  EscalationStatistics stats = lock_manager.getEscalationStatistics();
+  EXPECT_EQ(stats.escalations, 0);
+  EXPECT_EQ(stats.failed, 1);
+
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdC, 4, true));
+}
+
+// With several workers, escalation only releases the row locks of the worker
+// that escalates, and the rows of the others stay locked until the commit
+TEST_F(LockManagerTest, escalationOnSeveralWorkers) {
+  LockManager lock_manager(4, PARTITIONED, ABORT_ON_CONFLICT, 4);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+
+  // The rows of the table are spread over the partitions of all workers
+  const unsigned int kRowDistance = 997;
+  for (unsigned int row = 0; row < 5; row++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, row * kRowDistance, false));
+  }
+  EscalationStatistics stats = lock_manager.getEscalationStatistics();
+  EXPECT_EQ(stats.escalations, 1);
+  EXPECT_GE(stats.escalated_rows, 1);
+  EXPECT_LE(stats.escalated_rows, 5);
+
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, 3 * kRowDistance, true));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, 100, true));
+  EXPECT_TRUE(lock_manager.commit(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  for (unsigned int row = 0; row < 5; row++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdB, row * kRowDistance, true));
+  }
+}
+
+// Idle workers take over partitions of the worker that serves a hot range of
+// rows, which still detects conflicts on the rows it handed over
+TEST_F(LockManagerTest, idleWorkersStealPartitions) {
+  LockManager lock_manager(4);
+  const unsigned int kHotRows = 2500;      // rows of the first worker
+  const unsigned int kPartitionRows = 625;  // rows of each of its partitions
+  const unsigned int kMaxRounds = 100;
+  for (unsigned int round = 0;
+       round < kMaxRounds && lock_manager.getStealStatistics().steals == 0;
+       round++) {
+    unsigned int transactionId = kTransactionIdC + 1 + round;
+    EXPECT_TRUE(lock_manager.registerTransaction(transactionId));
+    for (unsigned int rowId = 0; rowId < kHotRows; rowId++) {
+      // The jobs of a partition are served in order, even if it is stolen
+      // meanwhile, so waiting for its last row waits for all of them
+      bool isLast = rowId % kPartitionRows == kPartitionRows - 1;
+      EXPECT_TRUE(lock_manager.lock(transactionId, rowId, false, isLast));
+    }
+    EXPECT_TRUE(lock_manager.commit(transactionId));
+  }
+  EXPECT_GT(lock_manager.getStealStatistics().steals, 0);
+
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB));
+  for (unsigned int rowId = 0; rowId < kHotRows; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, rowId, true));
+  }
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, kHotRows - 1, false));
+  EXPECT_TRUE(lock_manager.commit(kTransactionIdA));
+}
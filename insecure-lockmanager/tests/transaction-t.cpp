@@ -14,12 +14,13 @@ class TransactionTest : public ::testing::Test {
     lock_ = newLock();
     transactionA_ = newTransaction(kTransactionIdA_, kLockBudget_);
     transactionB_ = newTransaction(kTransactionIdB_, kLockBudget_);
-    lockTable_ = newHashTable(100);
+    lockTable_ = newHashTable<int, Lock>(100);
   };
 
   void TearDown() override {
-    delete transactionA_;
-    delete transactionB_;
+    deleteTransaction(transactionA_);
+    deleteTransaction(transactionB_);
+    deleteHashTable(lockTable_);
   }
 
   const unsigned int kTransactionIdA_ = 1;
@@ -29,13 +30,12 @@ class TransactionTest : public ::testing::Test {
   Lock* lock_;
   Transaction* transactionA_;
   Transaction* transactionB_;
-  HashTable* lockTable_;
+  LockTable* lockTable_;
 
  public:
   void acquireLock(Transaction* transaction, unsigned int rowId) {
-    auto lock = newLock();
-    getSharedAccess(lock, transaction->transaction_id);
-    set(lockTable_, rowId, (void*)lock);
+    Lock* lock = insert(lockTable_, rowId);
+    initLock(lock);
     addLock(transaction, rowId, false, lock);
   };
 };
@@ -65,8 +65,8 @@ TEST_F(TransactionTest, noSharedOnExclusive) {
 
 // Enters shrinking phase after releasing a lock
 TEST_F(TransactionTest, entersShrinkingPhase) {
-  EXPECT_TRUE(addLock(transactionA_, rowId_, false, lock_));
-  set(lockTable_, rowId_, (void*)lock_);
+  Lock* lock = insert(lockTable_, rowId_);
+  EXPECT_TRUE(addLock(transactionA_, rowId_, false, lock));
 
   auto locked_rows = transactionA_->locked_rows;
   EXPECT_EQ(transactionA_->locked_rows.size(), 1);
@@ -81,11 +81,8 @@ TEST_F(TransactionTest, entersShrinkingPhase) {
 
 // Lock budget decreases when acquiring locks
 TEST_F(TransactionTest, lockBudgetDecreases) {
-  auto another_lock = newLock();
-  addLock(transactionA_, rowId_, false, lock_);
-  set(lockTable_, rowId_, (void*)lock_);
-  addLock(transactionA_, rowId_ + 1, true, another_lock);
-  set(lockTable_, rowId_ + 1, (void*)another_lock);
+  addLock(transactionA_, rowId_, false, insert(lockTable_, rowId_));
+  addLock(transactionA_, rowId_ + 1, true, insert(lockTable_, rowId_ + 1));
   EXPECT_EQ(transactionA_->lock_budget, kLockBudget_ - 2);
 
   releaseLock(transactionA_, rowId_, lockTable_);
@@ -121,4 +118,46 @@ TEST_F(TransactionTest, releasesAllLocks) {
 
   // Assert that the transaction holds no locks
   EXPECT_EQ(transactionA_->locked_rows.size(), 0);
-};
\ No newline at end of file
+};// Requesting another mode on a granule converts the lock, other transactions
+// then conflict with the combined mode
+TEST_F(TransactionTest, convertsGranuleLock) {
+  GranuleTable* granuleTable = newHashTable<int, GranuleLock>(100);
+  int key = granuleKey(TABLE, 0);
+  GranuleLock* lock = insert(granuleTable, key);
+  initGranuleLock(lock);
+
+  EXPECT_TRUE(addGranuleLock(transactionA_, key, S_LOCK, lock));
+  EXPECT_TRUE(addGranuleLock(transactionB_, key, S_LOCK, lock));
+  EXPECT_FALSE(addGranuleLock(transactionA_, key, IX_LOCK, lock));
+  releaseGranuleLock(transactionB_, key, granuleTable);
+  EXPECT_TRUE(addGranuleLock(transactionA_, key, IX_LOCK, lock));
+
+  LockMode mode;
+  EXPECT_TRUE(granuleMode(transactionA_, key, &mode));
+  EXPECT_EQ(mode, SIX_LOCK);
+  EXPECT_EQ(transactionA_->lock_budget, kLockBudget_ - 1);
+
+  // The lock is removed together with its last holder
+  releaseGranuleLock(transactionA_, key, granuleTable);
+  EXPECT_FALSE(holdsLocks(transactionA_));
+  EXPECT_FALSE(contains(granuleTable, key));
+  deleteHashTable(granuleTable);
+};
+
+// Releasing a row lock that the table lock covers keeps the transaction in
+// its growing phase and returns the lock to the budget
+TEST_F(TransactionTest, releasesCoveredLock) {
+  acquireLock(transactionA_, rowId_);
+  countRowLock(transactionA_, rowId_, false, 1);
+  countRowLock(transactionA_, kRowsPerPage * kPagesPerTable, true, 1);
+  EXPECT_EQ(rowLocksIn(transactionA_, 0).shared, 1);
+  EXPECT_EQ(rowLocksIn(transactionA_, 1).exclusive, 1);
+
+  releaseCoveredLock(transactionA_, rowId_, lockTable_);
+  countRowLock(transactionA_, rowId_, false, -1);
+  EXPECT_FALSE(hasLock(transactionA_, rowId_));
+  EXPECT_TRUE(transactionA_->growing_phase);
+  EXPECT_EQ(transactionA_->lock_budget, kLockBudget_);
+  EXPECT_EQ(rowLocksIn(transactionA_, 0).shared, 0);
+  EXPECT_EQ(transactionA_->table_rows.size(), 1);
+};
@@ -21,11 +21,9 @@ void RunClient() {
     client.requestSharedLock(transactionB, rowId, true);
   }
 
-  // Both release the locks again
-  for (int rowId = 1; rowId <= lockBudget; rowId++) {
-    client.requestUnlock(transactionA, rowId, false);
-    client.requestUnlock(transactionB, rowId, false);
-  }
+  // Both release the locks again, each with a single request
+  client.requestCommit(transactionA);
+  client.requestCommit(transactionB);
 }
 
 auto main() -> int {
@@ -73,20 +73,24 @@ void experiment(LockManager& lockManager, int numLocks, int numThreads) {
    to a thread ID via
    *
    * ===========================================================================
-   * int thread_id = (int)((new_job.row_id % lockTableSize_) /
-                            ((float)lockTableSize_ / (arg.num_threads - 1)));
+   * int thread_id = (int)(hash(lockTableSize_, new_job.row_id) /
+                            ((float)lockTableSize_ / arg.num_threads));
    * ===========================================================================
    *
-   * which is explained in more detail below. We want to find the latest request
-   * (i.e. request with the largest RID) for
-   * each thread, which needs to be synchronous, so that each thread completes
-   * all requests before we stop the time measurement.
+   * with the default modulo hash function, where hash() is the RID modulo the
+   * lockTableSize_. This is explained in more detail below. We want to find
+   * the latest request (i.e. request with the largest RID) for each thread,
+   * which needs to be synchronous, so that each thread completes all requests
+   * before we stop the time measurement.
    *
    * As you see from the formula above, a
    * set of RIDs less than the lockTableSize_ = 10000 doesn't distribute over
    * all threads. I.e., when the range is only between 1-5000 and we have 4
    * threads, the fourth thread, who has the range of 7500 - 9999, never
    * receives a request. This can be a disadvantage when RIDs are skewed.
+   * The enclave moves partitions from busy threads to idle ones to make up for
+   * it, see kPartitionsPerWorker. Only the requests of each partition are
+   * served in order then, so we wait on the last request of each partition.
    */
   std::set<int> waitOn;
 
@@ -120,10 +124,10 @@ void experiment(LockManager& lockManager, int numLocks, int numThreads) {
    * */
   int partitionSize = lockTableSize / numThreads;
 
-  for (int i = 1; i < numThreads;
-       i++) {  // Note that when numThreads = 1, only
-               // wait on numLocks (see on previous insert)
-    waitOn.insert(base + partitionSize * i - 1);
+  // Each thread starts with kPartitionsPerWorker partitions of the lock table
+  int numPartitions = numThreads * kPartitionsPerWorker;
+  for (int i = 1; i < numPartitions; i++) {
+    waitOn.insert(base + lockTableSize / numPartitions * i - 1);
   }
 
   /**
@@ -211,6 +215,14 @@ auto main() -> int {
     contentCSVFile.push_back(rowInCSVFile);
 
     sleep_for(seconds(1));  // because unlock is asynchronous
+
+    // The locks are still held, so the lock table is as full as it gets
+    BucketStatistics buckets = lockManager.getLockTableStatistics();
+    std::cout << "Lock table with " << lockBudget
+              << " locks: max chain length " << buckets.max_length
+              << ", mean chain length " << meanBucketLength(&buckets)
+              << std::endl;
+
     flushCache();
   }
 
@@ -0,0 +1,82 @@
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "lockmanager.h"
+
+using std::ifstream;
+using std::ofstream;
+using std::string;
+using std::vector;
+
+const int numWorkerThreads = 1;
+const long numCycles = 5000000;      // lock/unlock cycles in total
+const long sampleInterval = 100000;  // cycles between two measurements
+const int numRows = 1000000;         // distinct rows that are locked in turn
+const int transactionId = 1;
+
+/**
+ * Writes the data all in one into a CSV file
+ * @param filename the name of the csv file
+ * @param values the outer vector contains the rows and the inner vector
+ * resembles a row with its column values
+ */
+void writeToCSV(string filename, vector<vector<long>> values) {
+  ofstream file;
+  file.open(filename + ".csv", std::ios_base::app);
+
+  for (const auto& row : values) {
+    for (int i = 0; i < row.size() - 1; i++) {
+      file << row[i] << ",";
+    }
+    file << row[row.size() - 1];
+    file << std::endl;
+  }
+  file.close();
+}
+
+/**
+ * @returns the resident set size of the process in kilobytes
+ */
+auto residentSetSize() -> long {
+  long pages = 0;
+  long residentPages = 0;
+  ifstream statm("/proc/self/statm");
+  statm >> pages >> residentPages;
+  return residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * Soak test of the reclamation of the lock table: a single transaction locks
+ * and unlocks millions of rows one after another, so that every cycle creates
+ * a lock and its entry in untrusted memory and the enclave removes them again.
+ * As the janitor thread frees the removed entries, the memory of the process
+ * has to stay flat instead of growing with every lock ever granted. Each row
+ * of the CSV file contains the number of cycles so far, the resident set size
+ * in kilobytes and the number of slabs of the untrusted pools.
+ */
+auto main() -> int {
+  spdlog::set_level(spdlog::level::err);
+
+  vector<vector<long>> contentCSVFile;
+  LockManager lockManager(numWorkerThreads);
+
+  for (long cycle = 0; cycle < numCycles; cycle++) {
+    // The transaction is deleted after releasing its last lock, so it
+    // registers again for every cycle
+    int rowId = cycle % numRows + 1;
+    lockManager.registerTransaction(transactionId, 1);
+    lockManager.lock(transactionId, rowId, true);
+    lockManager.unlock(transactionId, rowId, true);
+
+    if ((cycle + 1) % sampleInterval == 0) {
+      contentCSVFile.push_back({cycle + 1, residentSetSize(),
+                                (long)lockManager.getPoolStatistics().slabs});
+    }
+  }
+
+  writeToCSV("soak_out", contentCSVFile);
+  return 0;
+}
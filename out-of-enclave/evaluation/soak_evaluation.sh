@@ -0,0 +1,37 @@
+output_file=soak_out.csv
+sealed_keys_file=sealed_data_blob.txt
+
+echo "Starting soak evaluation..."
+
+# Delete old output file
+if [ -f "$output_file" ]; then
+    rm $output_file
+fi
+
+# Compile the project in release mode
+cmake -DSGX_HW=ON -DSGX_MODE=Debug -DCMAKE_BUILD_TYPE=Release -S .. -B ../build >/dev/null
+
+# Comment out logging, because this would cause a costly OCALL regardless of the logging level)
+sed -i -e "s@print_info@// print_info@" ../src/enclave/enclave.cpp ../src/enclave/lock_signatures.cpp ../src/lockmanager/lockmanager.cpp
+
+# Build the project
+cmake --build ../build >/dev/null
+
+# Get most recent enclave.signed.so
+cp ../build/apps/enclave.signed.so .
+
+# Remove old sealed keys, they cannot be opened by the enclave when its config changed, throwing an error
+if [ -f "$sealed_keys_file" ]; then
+  rm $sealed_keys_file
+fi
+
+# Start the benchmarking
+./../build/evaluation/soak_benchmark
+
+echo "Finished soak experiment"
+
+# Reset everything to its original values
+sed -i -e "s@// print_info@print_info@" ../src/enclave/enclave.cpp ../src/enclave/lock_signatures.cpp ../src/lockmanager/lockmanager.cpp
+
+rm $sealed_keys_file
+rm enclave.signed.so
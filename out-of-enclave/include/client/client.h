@@ -74,6 +74,23 @@ class LockingServiceClient {
   auto requestUnlock(unsigned int transactionId, unsigned int rowId,
                      bool waitForResult = false) -> bool;
 
+  /**
+   * Requests to release all locks of the transaction and to end it, which
+   * takes a single round trip instead of one requestUnlock() for each lock.
+   *
+   * @param transactionId identifies the transaction that commits
+   * @returns if the locks got released successfully
+   */
+  auto requestCommit(unsigned int transactionId) -> bool;
+
+  /**
+   * Requests to release all locks of the transaction and to abort it.
+   *
+   * @param transactionId identifies the transaction that aborts
+   * @returns if the locks got released successfully
+   */
+  auto requestAbort(unsigned int transactionId) -> bool;
+
  private:
   std::unique_ptr<LockingService::Stub> stub_;
 };
\ No newline at end of file
@@ -2,45 +2,160 @@
 
 #include <stdbool.h>
 
+// Maximum number of times the number of buckets of a bucket group can double
+#define HASHTABLE_MAX_LEVELS 16
+
+typedef struct {
+  struct Entry* head;  // linked list of entries
+  unsigned int size;   // number of entries in the linked list
+} Bucket;
+
+/**
+ * All keys with the same hash() belong to one bucket group. A group starts
+ * with a single bucket and grows by linear hashing: whenever it gets too full,
+ * its bucket number split is divided into itself and bucket
+ * split + 2^level. So a group grows one bucket at a time, without ever
+ * rehashing the whole table, and only ever by the worker thread that owns the
+ * group.
+ */
+typedef struct {
+  int level;  // the group has 2^level + split buckets
+  int split;  // number of buckets that are already split on this level
+  int count;  // number of entries within the group
+  Bucket** segments;  // segment l - 1 holds the buckets 2^(l-1) to 2^l - 1 of
+                      // the group, allocated as it grows
+} BucketGroup;
+
 /**
- * This struct is used either as a transaction table, where the keys
- * resemble the TXIDs and the value the transaction structs or a lock table,
- * with RIDs as keys and lock structs as values.
+ * The untyped part of a HashTable<Key, Value> (see hashtable.h), which is used
+ * either as a transaction table, where the keys resemble the TXIDs and the
+ * values the transaction structs or a lock table, with RIDs as keys and lock
+ * structs as values. It is the type of the lock table that crosses the
+ * boundary between the untrusted part and the enclave.
  *
  * It implements Chained Hashing, where for each entry in the table a linked
- * list, called bucket, is maintained that can store collisions.
+ * list, called bucket, is maintained that can store collisions. The buckets
+ * are stored in segments that are allocated once and never move. The first
+ * bucket of every group is stored in a single array, the others in the
+ * segments of their group, so a group that grows does not allocate buckets for
+ * the groups that do not.
  */
 typedef struct {
-  int size;                   // number of buckets
-  struct Entry** table;       // list of linked list of entires, i.e. buckets
-  unsigned int* bucketSizes;  // list of number of entries for each bucket
-} HashTable;
+  int size;       // number of bucket groups
+  Bucket* heads;  // the first bucket of every group
+  BucketGroup* groups;
+  // The table lives in untrusted memory: insertEntry() does not grow it,
+  // because the enclave has to split the buckets to keep their integrity hashes
+  bool untrusted;
+} HashTableBase;
 
+/**
+ * Header of every entry of a hash table. The value of the entry is stored
+ * right behind it, see Node in hashtable.h, so the enclave reaches a lock in
+ * untrusted memory without following another pointer.
+ */
 typedef struct Entry Entry;  // Required to use C++ structs as C structs
 struct Entry {
   int key;
-  void* value;
   struct Entry* next;
 };
 
-enum Command { SHARED, EXCLUSIVE, UNLOCK, QUIT, REGISTER };
+// Number of lock table entries a worker thread can retire at once
+#define RECLAMATION_RING_SIZE 65536
+
+/**
+ * The enclave cannot free untrusted memory, so each worker thread hands the
+ * entries it removes from the lock table, together with their locks, over to
+ * the untrusted part through a ring in untrusted memory. The worker thread is
+ * the only one advancing tail and the janitor thread of the untrusted part the
+ * only one advancing head.
+ */
+typedef struct {
+  unsigned int head;      // next entry to be freed by the janitor
+  unsigned int tail;      // next free slot for the worker thread
+  unsigned long dropped;  // entries that leaked because the ring was full
+  struct Entry* entries[RECLAMATION_RING_SIZE];
+} ReclamationRing;
+
+/**
+ * Counters of the pools that locks, transactions and hash table entries are
+ * allocated from
+ */
+struct PoolStatistics {
+  unsigned long hits;    // allocations served from the free list of a thread
+  unsigned long misses;  // allocations that had to refill a free list
+  unsigned long slabs;   // number of slabs allocated from the heap
+};
+typedef struct PoolStatistics PoolStatistics;
+
+// Number of bucket lengths that BucketStatistics tells apart. Longer buckets
+// are counted in the last slot of the histogram.
+#define BUCKET_HISTOGRAM_SIZE 16
+
+/**
+ * Distribution of the entries of a hash table over its buckets
+ */
+struct BucketStatistics {
+  unsigned long buckets;     // number of buckets
+  unsigned long entries;     // number of entries
+  unsigned long max_length;  // number of entries of the longest bucket
+  unsigned long histogram[BUCKET_HISTOGRAM_SIZE];  // buckets of each length
+};
+typedef struct BucketStatistics BucketStatistics;
+
+/**
+ * Owner and load of a partition of the lock table. The partitions are
+ * reassigned to the worker threads by their load, see BALANCE.
+ */
+struct PartitionStatistics {
+  int owner;                 // worker thread serving the partition
+  unsigned long queued;      // jobs waiting to be served
+  unsigned long served;      // jobs served since the start
+  unsigned long migrations;  // times the partition moved to another worker
+};
+typedef struct PartitionStatistics PartitionStatistics;
+
+enum Command {
+  SHARED,
+  EXCLUSIVE,
+  UNLOCK,
+  QUIT,
+  REGISTER,
+  COMMIT,
+  ABORT,
+  TICK,
+  BALANCE,
+  MIGRATE,
+  ADOPT
+};
+
+// Size of the return value of a lock request: the base64-encoded signature,
+// "_", up to 20 digits of the lease expiry and a terminating zero
+#define RETURN_VALUE_SIZE 111
 
 struct Job {
   enum Command command;
   unsigned int transaction_id;
   unsigned int row_id;
   unsigned int lock_budget;
+  int partition;  // partition of the lock table the job is sent to
+  int worker;     // worker thread the partition moves to, for MIGRATE
+  void* release;  // ReleaseRequest shared by the parts of COMMIT or ABORT
+  unsigned long time;  // milliseconds since the epoch, for TICK and BALANCE
   bool wait_for_result;
   volatile char* return_value;
-  volatile bool* finished;
-  volatile bool* error;
+  struct Completion* finished;  // set once the request finished
+  bool* error;  // written before finished is set
 };
 typedef struct Job Job;  // Required to use C++ structs as C structs
 
 struct Arg {
   int num_threads;
-  int tx_thread_id;
+  int num_partitions;  // partitions of the lock table, see partition_of()
   int transaction_table_size;
   int lock_table_size;
+  int lease_duration;        // milliseconds a lock is granted for, or 0 if
+                             // locks never expire
+  unsigned long start_time;  // milliseconds since the epoch at startup
 };
 typedef struct Arg Arg;  // Required to use C++ structs as C structs
\ No newline at end of file
@@ -5,32 +5,111 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
-#include <queue>
 #include <string>
 #include <vector>
 
 #include "common.h"
+#include "completion.h"
 #include "enclave_t.h"
 #include "hashtable.h"
 #include "integrity_verification.h"
+#include "job_ring.h"
 #include "lock.h"
 #include "lock_signatures.h"
+#include "pool.h"
 #include "sgx_tcrypto.h"
 #include "sgx_tkey_exchange.h"
 #include "sgx_trts.h"
+#include "timing_wheel.h"
 #include "transaction.h"
 
 // Holds the transaction objects of the currently active transactions
-HashTable *transactionTable_;
+TransactionTable *transactionTable_;
 
 // Keeps track of a lock object for each row ID
-HashTable *lockTable_;
+LockTable *lockTable_;
 
 /* Contains a list of hashes over the buckets of the lock table, which is used
  * to verify the integrity of the lock table: If the hash is recomputed and has
- * changed, it means the contents of the bucket changed.*/
+ * changed, it means the contents of the bucket changed. There is one hash for
+ * the first bucket of every group, the hashes of the other buckets are kept
+ * per group in lockTableSplitHashes and only grow with their group.*/
 std::vector<sgx_sha256_hash_t *> lockTableIntegrityHashes;
+std::vector<std::vector<sgx_sha256_hash_t *>> lockTableSplitHashes;
+
+/* Rings in untrusted memory, one per worker thread, through which entries
+ * removed from the lock table are handed over to the untrusted part to be
+ * freed */
+ReclamationRing *reclamationRings_;
+
+/* Arenas that provide the overflow arrays of the locks in untrusted memory,
+ * one per partition of the lock table, so they move with the partition */
+OwnerArena *ownerArenas_;
+
+/* Trusted copy of the state of each bucket group of the lock table, which
+ * decides in which bucket a row is looked up. The segments of the group are
+ * only referenced by the table in untrusted memory. */
+std::vector<BucketGroup> lockTableGroups;
+
+/* Timing wheels, one per partition of the lock table, in which the leases of
+ * the locks on the rows of the partition expire */
+TimingWheel *timingWheels_;
+
+/* Time in milliseconds since the epoch that leases are granted and expire by.
+ * It comes from the TICK jobs of the untrusted part, but never goes back and
+ * advances by at most kMaxTickAdvance per TICK, so a time far ahead cannot
+ * release locks whose signatures are still valid at once. */
+std::atomic<unsigned long> leaseClock_;
+
+/* Partition map of the lock table. The partitions move between the worker
+ * threads by their load, see balance_partitions(). Only the owner of a
+ * partition changes its owner, when it hands it over. */
+std::atomic<int> *partitionOwner_;    // worker thread owning each partition
+std::atomic<int> *partitionSenders_;  // threads sending a job to each
+                                      // partition right now
+std::atomic<int> *partitionJobs_;     // queued jobs of each partition
+std::atomic<unsigned long> *partitionServed_;      // served jobs of each
+                                                   // partition
+std::atomic<unsigned long> *partitionMigrations_;  // see PartitionStatistics
+std::atomic<bool> *adopting_;  // the partition migrates, but was not handed
+                               // over by its former owner yet
+std::atomic<bool> migrating_;  // a partition migrates, one at a time
+
+/* Load of the worker threads measured by the balancer, which runs in one
+ * thread at a time */
+unsigned long lastBalance_;   // time of the last round in milliseconds
+unsigned long *lastServed_;   // served jobs of each partition back then
+unsigned long *serviceTime_;  // nanoseconds each worker spends on a job
+
+/**
+ * A partition of the lock table that a worker thread hands over to another
+ * worker. The worker still serves the jobs that were sent to it before, and
+ * tells the new owner with an ADOPT job once it took the last of them from its
+ * ring.
+ */
+struct Handoff {
+  int partition;
+  int worker;             // worker thread that owns the partition now
+  bool isDrained;         // no more jobs are sent to the former owner
+  unsigned long lastJob;  // position behind the last job of the partition in
+                          // the ring of the former owner, once drained
+};
+typedef struct Handoff Handoff;
+
+/* Partitions each worker thread hands over, and the jobs each worker keeps
+ * until the partition it takes over is handed over */
+std::vector<Handoff> *handoffs_;
+std::vector<Job> *adoptedJobs_;
+
+// Maximum number of jobs a worker thread takes from its queue at once
+const int kJobBatchSize = 16;
+
+// Minimum number of queued jobs of a worker thread before the balancer moves
+// one of its partitions to another worker
+const int kBalanceThreshold = 8;
 
 // Contains configuration parameters
 extern Arg arg_enclave;
@@ -46,8 +125,11 @@ extern int transactionCount;
  * @param lock_table pointer to lock table whose memory was allocated in the
  * untrusted part
  * allocated in the untrusted part
+ * @param reclamation_rings one ring per thread in untrusted memory, see
+ * ReclamationRing
  */
-void enclave_init_values(Arg arg, HashTable *lock_table);
+void enclave_init_values(Arg arg, HashTableBase *lock_table,
+                         ReclamationRing *reclamation_rings);
 
 /**
  * Function that receives a job from the untrusted application.
@@ -61,15 +143,120 @@ void enclave_init_values(Arg arg, HashTable *lock_table);
 void enclave_send_job(void *data);
 
 /**
- * Function that is run by the worker threads inside the enclave. It pulls a job
- * from its associated job queue in a loop and executes it, e.g. acquiring a
- * shared lock for a specific row. Each row gets assigned a specific thread
- * evenly, so no synchronization is necessary when accessing the underlying lock
- * table. The transaction table is accessed by only one single thread for all
- * requests to register a transaction.
+ * Receives a batch of jobs from the untrusted application and puts each of
+ * them into the job queue of its worker thread like enclave_send_job(), so
+ * that the whole batch costs a single transition into the enclave.
+ *
+ * @param data array of num_jobs Job structs
+ * @param num_jobs the number of jobs in the batch
+ */
+void enclave_send_jobs(void *data, size_t num_jobs);
+
+/**
+ * Function that is run by the worker threads inside the enclave. It pulls the
+ * pending jobs from its associated job queue in a loop and executes them one
+ * after another, e.g. acquiring a shared lock for a specific row. Each row gets
+ * assigned a specific thread evenly, so no synchronization is necessary when
+ * accessing the underlying lock table. The transaction table is accessed by
+ * only one single thread for all requests to register a transaction.
  */
 void enclave_process_request();
 
+/**
+ * Pushes a job into the ring of a worker thread and wakes the worker up, if
+ * it sleeps
+ *
+ * @param thread_id the worker thread
+ * @param job the job to execute
+ */
+void enqueue_job(int thread_id, const Job &job);
+
+/**
+ * Takes up to kJobBatchSize jobs from the ring of a worker thread. Polls the
+ * ring while it is empty, and sleeps once polling does not pay off.
+ *
+ * @param thread_id the worker thread
+ * @param jobs buffer for kJobBatchSize jobs
+ * @returns the number of jobs taken, or 0 if the worker must not sleep as it
+ * hands over a partition, see finish_handoffs()
+ */
+auto dequeue_jobs(int thread_id, Job *jobs) -> int;
+
+/**
+ * Sends a job to the worker thread that owns a partition of the lock table
+ *
+ * @param partition the partition of the rows of the job
+ * @param job the job to execute
+ */
+void send_to_partition(int partition, Job &job);
+
+/**
+ * Measures the load of the worker threads since the last round and moves a
+ * partition from the worker with the longest backlog to the one with the
+ * shortest, if the backlog of the former is more than twice as long. The
+ * backlog of a worker is the number of its queued jobs times the time it
+ * spends on a job. A single partition migrates at a time.
+ *
+ * @param time the current time in milliseconds, sent by the janitor thread
+ * of the untrusted part with a BALANCE job
+ */
+void balance_partitions(unsigned long time);
+
+/**
+ * Hands a partition over to another worker thread with a MIGRATE job. Later
+ * jobs of the partition are sent to the new owner, which keeps them until
+ * this worker served the jobs it got before, see finish_handoffs().
+ *
+ * @param threadId the worker thread owning the partition
+ * @param job the MIGRATE job
+ */
+void hand_off_partition(int threadId, Job &job);
+
+/**
+ * Tells the new owners of the partitions a worker thread handed over, once it
+ * took the last job sent to it for them from its ring
+ *
+ * @param threadId the worker thread that handed over the partitions
+ */
+void finish_handoffs(int threadId);
+
+/**
+ * Takes over a partition from the worker thread that handed it over, and
+ * executes the jobs of the partition that were kept meanwhile
+ *
+ * @param threadId the worker thread that owns the partition now
+ * @param job the ADOPT job
+ */
+void adopt_partition(int threadId, Job &job);
+
+/**
+ * Checks if a job is for a partition that migrates to its worker thread, but
+ * that the former owner did not hand over yet
+ *
+ * @param threadId the worker thread
+ * @param job a job taken from the ring of the worker thread
+ */
+auto is_adopting(int threadId, const Job &job) -> bool;
+
+/**
+ * Executes a single job that was taken from the job queue, except QUIT.
+ *
+ * @param job the job to execute
+ * @param threadId the ID of the executing worker thread
+ */
+void process_job(Job &job, int threadId);
+
+/**
+ * Looks up the locks of all lock and unlock jobs of a batch at once with
+ * getMany(), so that the buckets in untrusted memory are fetched in parallel
+ * instead of one after another. The jobs still look up and verify their
+ * buckets on their own, but then find them in the cache.
+ *
+ * @param jobs the jobs taken from the job queue
+ * @param numJobs the number of jobs
+ */
+void prefetch_locks(Job *jobs, int numJobs);
+
 /**
  * Registers the transaction at the enclave prior to being able to
  * acquire any locks, so that the enclave can now the transaction's lock
@@ -90,22 +277,204 @@ int register_transaction(unsigned int transactionId, unsigned int lockBudget);
  * @param transactionId identifies the transaction making the request
  * @param rowId identifies the row to be locked
  * @param requestedMode either shared for concurrent read access or exclusive
- * for sole write access
+ * for sole write access. Exclusive access to a row that the transaction holds
+ * a shared lock on upgrades that lock.
  * @param threadId the context for signing locks is exclusive for each thread,
  * therefore we need to know the calling thread's ID
+ * @param expiry the block timeout the lock is granted until and signed with,
+ * see get_block_timeout()
  * @returns SGX_ERROR_UNEXPCTED, when transaction did not call
  * RegisterTransaction before or the given lock mode is unknown or when the
  * transaction makes a request for a look, that it already owns, makes a
- * request for a lock while in the shrinking phase, or when the lock budget is
- * exhausted
+ * request for a lock while in the shrinking phase, when the lock is held in a
+ * conflicting mode, e.g. by other shared owners for an upgrade, or when the
+ * lock budget is exhausted
  */
 auto acquire_lock(void *signature, int transactionId, int rowId,
-                  bool isExclusive, int threadId) -> bool;
+                  bool isExclusive, int threadId, unsigned long expiry) -> bool;
+
+/**
+ * Returns the partition of the lock table that a row falls into. Each worker
+ * thread starts with the same number of adjacent partitions, see
+ * partitionOwner_.
+ *
+ * @param rowId identifies the row
+ */
+auto partition_of(unsigned int rowId) -> int;
+
+/**
+ * Returns the partition of the transaction table that a transaction falls
+ * into. The worker thread of the same index registers the transaction, while
+ * any worker may look it up or remove it under the mutex of the partition.
+ *
+ * @param transactionId identifies the transaction
+ */
+auto transaction_partition_of(unsigned int transactionId) -> int;
+
+/**
+ * Adds a transaction to its partition of the transaction table
+ *
+ * @param transactionId identifies the transaction
+ * @param lockBudget maximum number of locks the transaction may acquire
+ * @returns false, if the transaction was already registered
+ */
+auto register_transaction(unsigned int transactionId, int lockBudget) -> bool;
+
+/**
+ * Checks if a transaction is registered in its partition of the transaction
+ * table
+ *
+ * @param transactionId identifies the transaction
+ */
+auto is_registered(unsigned int transactionId) -> bool;
+
+/**
+ * Looks up a transaction in its partition of the transaction table and keeps
+ * it alive until the calling thread passes it to unpin_transaction(), even if
+ * another thread removes it from the table meanwhile
+ *
+ * @param transactionId identifies the transaction
+ * @returns the node of the transaction, or nullptr if it is not registered
+ */
+auto pin_transaction(unsigned int transactionId) -> Node<Transaction> *;
+
+/**
+ * Releases a transaction pinned with pin_transaction(), and frees it if it was
+ * removed from the transaction table and nobody else pins it
+ */
+void unpin_transaction(Node<Transaction> *node);
+
+/**
+ * Frees a transaction that was removed from the transaction table, or leaves
+ * that to the last thread that unpins it
+ */
+void delete_transaction(Node<Transaction> *node);
+
+/**
+ * Removes a transaction from the transaction table and frees it, if it does
+ * not hold any locks anymore
+ *
+ * @param transactionId identifies the transaction that released a lock
+ */
+void remove_if_idle(unsigned int transactionId);
+
+/**
+ * Removes a transaction from the transaction table without freeing it. The
+ * caller has to pass it to delete_transaction() afterwards.
+ *
+ * @param transactionId identifies the transaction
+ * @returns the node of the transaction, or nullptr if it is not registered
+ */
+auto extract_transaction(unsigned int transactionId) -> Node<Transaction> *;
+
+/**
+ * Removes the transaction of a COMMIT or ABORT job from the transaction table
+ * and splits the job into one part for each partition that owns rows the
+ * transaction holds locks on, or a single part if it holds none, and sends
+ * the parts to the job queues of their worker threads
+ *
+ * @param job the job of the request, with its parameters already copied
+ */
+void send_release_parts(Job &job);
+
+/**
+ * Releases the locks a committing or aborting transaction holds on the rows
+ * of one partition. The transaction is not updated, as it is freed by the
+ * last part anyway.
+ *
+ * @param job the part of the COMMIT or ABORT job
+ * @param threadId the worker thread serving the rows, whose reclamation ring
+ * receives the locks without owners
+ */
+void release_part(Job &job, int threadId);
+
+/**
+ * Completes a COMMIT or ABORT request once all of its parts finished. The
+ * last part frees the transaction.
+ *
+ * @param job the part of the COMMIT or ABORT job
+ */
+void finish_release_part(Job &job);
+
+/**
+ * Splits buckets of a group of the lock table, while the group exceeds
+ * kMaxLoadFactor. Verifies each bucket before it is split and hashes both
+ * resulting buckets afterwards.
+ *
+ * @param group the bucket group, i.e. hash() of the row ID
+ * @returns false, if the integrity verification of a bucket failed or a new
+ * segment could not be allocated
+ */
+auto split_locktable_buckets(int group) -> bool;
 
 /**
  * Releases a lock for the specified row.
  *
  * @param transactionId identifies the transaction making the request
  * @param rowId identifies the row to be released
+ * @param threadId the worker thread serving the row, whose reclamation ring
+ * receives the lock, if it has no owners anymore
+ */
+void release_lock(int transactionId, int rowId, int threadId);
+
+/**
+ * Verifies the bucket of a row against its stored hash, releases the lock of
+ * the transaction within the serialized bucket and updates the hash. The
+ * caller repeats the release in untrusted memory.
+ *
+ * @param transaction the transaction holding the lock
+ * @param rowId identifies the row to be released
+ * @returns false, if the integrity verification of the bucket failed
+ */
+auto release_verified(Transaction *transaction, int rowId) -> bool;
+
+/**
+ * Grants the lock of a transaction on a row a lease in the timing wheel of the
+ * partition of the row, replacing the lease of a shared lock that was
+ * upgraded. Does nothing if locks never expire.
+ *
+ * @param transaction the transaction that acquired the lock
+ * @param rowId identifies the locked row
+ * @param expiry the block timeout the lock was signed with
+ */
+void grant_lease(Transaction *transaction, int rowId, unsigned long expiry);
+
+/**
+ * Cancels the lease of the lock of a transaction on a row, before the lock is
+ * released
+ *
+ * @param transaction the transaction holding the lock
+ * @param rowId identifies the locked row
+ */
+void cancel_lease(Transaction *transaction, int rowId);
+
+/**
+ * Advances the timing wheels of the partitions a worker thread owns to the
+ * time of a TICK job and releases the locks whose lease expired, as if their
+ * transaction unlocked them, so locks of crashed clients do not stay in the
+ * lock table forever. A lease whose transaction is being committed or aborted
+ * is left to the part of the COMMIT or ABORT job that releases its row. The
+ * wheel of a migrating partition catches up with a later TICK.
+ *
+ * @param time milliseconds since the epoch
+ * @param threadId the worker thread whose partitions are advanced
+ */
+void expire_leases(unsigned long time, int threadId);
+
+/**
+ * Copies the counters of the pools of the enclave heap out of the enclave.
+ * Transactions and the entries of the transaction table are allocated there.
+ *
+ * @param statistics buffer to store the counters in
+ */
+void get_pool_statistics(PoolStatistics *statistics);
+
+/**
+ * Copies the owner and the load of each partition of the lock table out of
+ * the enclave.
+ *
+ * @param statistics buffer to store num_partitions entries in
+ * @param num_partitions the number of partitions, see Arg
  */
-void release_lock(int transactionId, int rowId);
\ No newline at end of file
+void get_partition_statistics(PartitionStatistics *statistics,
+                              size_t num_partitions);
\ No newline at end of file
@@ -9,20 +9,26 @@
 #include "sgx_trts.h"
 #include "transaction.h"
 
-extern int sizeOfSerializedLockEntry;
-
 /**
  * Computes the hash over the given bucket from the lock table and updates the
- * integrity hashes stored inside the enclave.
+ * integrity hash stored inside the enclave.
+ *
+ * @param bucket the serialized bucket
+ * @param numEntries how many entries of the bucket to hash
+ * @param storedHash the integrity hash of the bucket stored inside the enclave
+ */
+void update_integrity_hash_locktable(uint32_t *bucket, int numEntries,
+                                     sgx_sha256_hash_t *&storedHash);
+
+/**
+ * Returns the number of entries of a serialized bucket that are covered by its
+ * integrity hash. A lock that the untrusted part appended for a new row, but
+ * that was not yet acquired within the enclave, is not part of the hash.
  *
- * @param bucket
- * @param key
- * @param numEntries
- * @param lockTableIntegrityHashes
+ * @param serialized the serialized bucket
+ * @param numEntries how many entries the serialized bucket has
  */
-void update_integrity_hash_locktable(
-    uint32_t *bucket, int key, int numEntries,
-    std::vector<sgx_sha256_hash_t *> &lockTableIntegrityHashes);
+auto entries_to_hash(uint32_t *serialized, int numEntries) -> int;
 
 /**
  * Hashes a bucket of the lock table. The hash is saved by the enclave
@@ -69,33 +75,39 @@ auto hash_locktable_bucket(uint32_t *bucket, int numEntries)
  * changed later, e.g., when registering or aborting it.
  */
 auto integrity_verified_get_transactiontable(
-    HashTable *&transactionTable_,
+    TransactionTable *&transactionTable_,
     std::vector<sgx_sha256_hash_t *> transactionTableIntegrityHashes, int key)
     -> std::pair<Transaction *, Entry *>;
 
 /**
  * Serializes an entire bucket of the lock table into an uint32_t array that is
  * memory efficient and can be directly passed as a parameter to Intel SGX's
- * hash function for integrity verification.
+ * hash function for integrity verification. Each lock is serialized as its
+ * row ID, mode and number of owners, followed by that many owners, so the
+ * entries have different lengths. The array belongs to the calling thread and
+ * is overwritten by its next call.
  *
  * @param bucket a pointer to the first entry of the bucket
  * @param numEntries how many entries are in the given bucket
- * @returns the serialized bucket
+ * @returns the serialized bucket, or nullptr if a lock has more owners than
+ * possible or points to an overflow array that is not in untrusted memory
  */
 auto locktable_bucket_to_uint32_t(Entry *&bucket, int numEntries) -> uint32_t *;
 
 /**
- * Adds a lock in the serialized bucket
+ * Adds a lock in the serialized bucket, or upgrades it to an exclusive lock if
+ * the transaction is its only owner
  * @param transaction the (trusted) transaction that wants to acquire the lock
  * @param rowId the rowId of the lock to acquire
  * @param isExclusive if the lock should be exclusive or shared
  * @param serializedLockBucket
+ * @param numEntries how many entries the serialized bucket has
  * @returns true if the lock was acquired successfully, or false if the lock
  * couldn't get acquired, e.g. because it is already exclusive or integrity
  * verification failed.
  */
 auto add_lock_trusted(Transaction *transaction, int rowId, bool isExclusive,
-                      uint32_t *serializedLockBucket) -> bool;
+                      uint32_t *serializedLockBucket, int numEntries) -> bool;
 
 /**
  * Removes a lock in the serialized bucket
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 
 #include "base64-encoding.h"
@@ -7,6 +8,7 @@
 #include "sgx_tcrypto.h"
 #include "sgx_trts.h"
 #include "sgx_tseal.h"
+#include "timing_wheel.h"
 
 // Context and public private key pair for signing lock requests
 extern sgx_ecc_state_handle_t context;
@@ -21,6 +23,20 @@ struct DataToSeal {
 
 const size_t MAX_SIGNATURE_LENGTH = 255;
 
+// Milliseconds per tick of the timing wheels, which is the precision that
+// leases expire with
+const int kLeaseResolution = 10;
+
+// Milliseconds a single TICK job may advance the clock of the enclave by, see
+// leaseClock_
+const unsigned long kMaxTickAdvance = 100;
+
+// Configuration parameters, timing wheels and clock of the worker threads, see
+// enclave.h
+extern Arg arg_enclave;
+extern TimingWheel *timingWheels_;
+extern std::atomic<unsigned long> leaseClock_;
+
 // Base64 encoded public key
 extern std::string encoded_public_key;
 
@@ -58,7 +74,9 @@ auto verify(const char *message, void *signature, size_t sig_len) -> int;
  * @param transactionId identifying the transaction that requested the lock
  * @param rowId identifying the row the lock is refering to
  * @param isExclusive if the lock is a shared or exclusive lock (boolean)
- * @returns SGX_SUCCESS, when the signature is valid
+ * @returns SGX_SUCCESS, when the signature is valid. The signature may be
+ * followed by "_" and the block timeout it was signed with, else the block
+ * timeout is 0.
  */
 auto verify_signature(char *signature, int transactionId, int rowId,
                       int isExclusive) -> int;
@@ -71,19 +89,23 @@ auto verify_signature(char *signature, int transactionId, int rowId,
  * @param transactionId identifies the transaction
  * @param rowId identifies the row that is locked
  * @param isExclusive if the lock is exclusive or shared
+ * @param blockTimeout the time the lock is granted until, see
+ * get_block_timeout()
  * @returns a string that represents a lock, that can be signed by the signing
  * function
  */
-auto lock_to_string(int transactionId, int rowId, bool isExclusive)
-    -> std::string;
+auto lock_to_string(int transactionId, int rowId, bool isExclusive,
+                    unsigned long blockTimeout) -> std::string;
 
 /**
- * @returns the block timeout, which resembles a future block number of the
- *          blockchain in the storage layer. The storage layer will decline
- *          any requests with a signature that has a block timeout number
- *          smaller than the current block number
+ * @returns the block timeout, i.e. the time in milliseconds since the epoch
+ *          at which the lease of a lock granted now expires, or 0 if locks
+ *          never expire. The storage layer will decline any requests with a
+ *          signature whose block timeout has passed, and the enclave releases
+ *          the lock at that time. The time is taken from leaseClock_, as the
+ *          enclave has no trusted clock.
  */
-auto get_block_timeout() -> int;
+auto get_block_timeout() -> unsigned long;
 
 /**
  * @returns the size of the encrypted DataToSeal struct
@@ -2,9 +2,11 @@
 
 #include <stdlib.h>
 
+#include <type_traits>
+#include <utility>
+
 #include "common.h"
-#include "lock.h"
-#include "transaction.h"
+#include "pool.h"
 
 /*
 C++ classes currently don't work when we need to transfer them from the
@@ -14,18 +16,127 @@ the memory via the pointer. That is the reason we are using C-style structs and
 methods here.
 */
 
-HashTable* newHashTable(int size);
+// Maximum number of lookups whose memory accesses are overlapped by getMany()
+const int kLookupBatchSize = 16;
+
+// Average number of entries per bucket above which a bucket group grows
+const int kMaxLoadFactor = 2;
+
+// Maximum number of buckets that are split by a single insert
+const int kSplitsPerOperation = 2;
+
+/**
+ * Entry of a HashTable<Key, Value>. The value is stored inline right behind
+ * the key and the link to the next entry of the bucket, so a lookup reaches
+ * the value without following another pointer. As the entry is the first
+ * member, pointers to a node and to its entry can be converted into each
+ * other.
+ */
+template <typename Value>
+struct Node {
+  Entry entry;
+  Value value;
+};
+
+/**
+ * Hash table that maps keys of type Key to values of type Value, which are
+ * stored inline in the entries of the table. All of its state is kept in the
+ * untyped HashTableBase, the type parameters only make sure that the values
+ * are accessed with their correct type. The lock table is shared between the
+ * untrusted part and the enclave as a HashTableBase, so the layout of its
+ * nodes must be the same on both sides, see nodeOf().
+ */
+template <typename Key, typename Value>
+struct HashTable : HashTableBase {
+  typedef Key KeyType;
+};
 
-Entry* newEntry(int key, void* value);
+struct Lock;
+struct Transaction;
+typedef HashTable<int, Lock> LockTable;                // RIDs to locks
+typedef HashTable<int, Transaction> TransactionTable;  // TXIDs to transactions
 
 /**
- * Maps each key to an index from 0..size-1 within the hashtable
+ * Allocates the first bucket of every group of an empty table
  *
- * @param size the number of buckets of either the lock or transaction table
+ * @param hashTable the table to initialize
+ * @param size the number of bucket groups
+ */
+void initHashTable(HashTableBase* hashTable, int size);
+
+/**
+ * Frees all entries and segments of a table, but not the table itself. Must
+ * not be called from within the enclave on tables in untrusted memory.
+ *
+ * @param hashTable the table to destroy
+ * @param deleteEntry frees an entry together with its value
+ */
+void destroyHashTable(HashTableBase* hashTable, void (*deleteEntry)(Entry*));
+
+/**
+ * Scrambles the key with the hash function selected at build time
+ * (-DHASH_FUNCTION=modulo|fibonacci|mix64). Keys are assigned to bucket groups
+ * by the remainder and to the buckets within a group by the quotient of the
+ * scrambled key, so that a function that spreads clustered or strided keys
+ * spreads them over both.
+ *
+ * @param key TXID or RID
+ */
+inline auto hashKey(int key) -> unsigned int {
+#if defined(FIBONACCI_HASH)
+  // Multiplicative hashing with 2^32 divided by the golden ratio. The upper
+  // half of the product depends on all bits of the key, so it is rotated into
+  // the lower half, which selects the bucket group.
+  unsigned int h = (unsigned int)key * 0x9e3779b9u;
+  return (h >> 16) | (h << 16);
+#elif defined(MIX64_HASH)
+  // Finalizer of SplitMix64, folded to the upper 32 bits
+  unsigned long long h = (unsigned int)key;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+  h ^= h >> 31;
+  return (unsigned int)(h >> 32);
+#else
+  return (unsigned int)key;
+#endif
+}
+
+/**
+ * Maps each key to an index from 0..size-1 within the hashtable, i.e. to its
+ * bucket group
+ *
+ * @param size the number of bucket groups of either the lock or transaction
+ * table
  * @param key TXID or RID to map into the hashtable
  */
 int hash(int size, int key);
 
+/**
+ * Returns the index of the bucket within its group that the key belongs to
+ *
+ * @param size the number of bucket groups
+ * @param group the state of the bucket group of the key
+ * @param key TXID or RID
+ */
+auto bucketOf(int size, BucketGroup* group, int key) -> int;
+
+/**
+ * Returns the segment that holds the bucket with the given index within its
+ * group
+ */
+auto segmentOf(int bucket) -> int;
+
+/**
+ * Returns the number of buckets that a segment l > 0 of a group holds
+ */
+auto segmentSize(int segment) -> long;
+
+/**
+ * Returns the position of a bucket within the segment of its group, for
+ * buckets other than the first one
+ */
+auto segmentOffset(int bucket) -> long;
+
 /**
  * Returns the bucket of the hashtable
  *
@@ -36,7 +147,121 @@ int hash(int size, int key);
  * @returns a pointer to the head entry of the bucket and the number of entries
  * in that bucket
  */
-std::pair<Entry*, int> getBucket(HashTable* table, int key);
+std::pair<Entry*, int> getBucket(HashTableBase* table, int key);
+
+/**
+ * Returns the bucket of the hashtable
+ *
+ * @param table the hashtable struct
+ * @param group the bucket group, i.e. hash() of the key
+ * @param bucket the index of the bucket within its group
+ *
+ * @returns a pointer to the head entry of the bucket and the number of entries
+ * in that bucket
+ */
+std::pair<Entry*, int> getBucket(HashTableBase* table, int group, int bucket);
+
+/**
+ * Checks if a bucket group exceeds kMaxLoadFactor and should be split
+ */
+auto needsSplit(BucketGroup* group) -> bool;
+
+/**
+ * Splits the next bucket of a group into itself and a new bucket. Only the
+ * entries of that single bucket are moved. The segment of the new bucket has
+ * to be allocated already.
+ *
+ * @param hashTable the table containing the group
+ * @param group the bucket group, i.e. hash() of the keys
+ * @param state the state of the group that the split is based on. It is
+ * advanced by the split and then copied into the table, so the enclave can
+ * pass a trusted copy of the state of a table in untrusted memory.
+ */
+void splitBucketGroup(HashTableBase* hashTable, int group, BucketGroup* state);
+
+/**
+ * Retrieves the entry for the given key from a hashtable.
+ *
+ * @param hashTable either the lock or transaction table to execute the
+ * operation on
+ * @param key identifies the entry, i.e. TXID or RID
+ * @returns the entry or nullptr, when the corresponding key could not be
+ * found
+ */
+auto findEntry(HashTableBase* hashTable, int key) -> Entry*;
+
+/**
+ * Retrieves the entry for the given key from a bucket.
+ *
+ * @param bucket the first entry of a bucket of the lock or transaction table
+ * @param key idedentifies the entry, i.e. TXID or RID
+ * @returns the entry or nullptr, when the corresponding key could not be
+ * found
+ */
+auto findEntry(Entry* bucket, int key) -> Entry*;
+
+/**
+ * Retrieves the entries for several keys at once. Instead of walking one
+ * bucket after another, it first computes the positions of all buckets and
+ * prefetches them, then advances all walks by one entry per round, so that
+ * the cache misses of the different keys overlap.
+ *
+ * @param hashTable either the lock or transaction table to execute the
+ * operation on
+ * @param keys the keys to look up, at most kLookupBatchSize
+ * @param n the number of keys
+ * @param entries receives the entry of each key, or nullptr when the key could
+ * not be found
+ */
+void findEntries(HashTableBase* hashTable, const int* keys, int n,
+                 Entry** entries);
+
+/**
+ * Adds an entry to the table, unless its key already exists in the table.
+ * Grows the bucket group of the key, when it exceeds kMaxLoadFactor, unless
+ * the table is untrusted.
+ *
+ * @param hashTable either the lock or transaction table to execute the
+ * operation on
+ * @param entry the entry to add, with its key already set
+ * @returns the entry with the key of the given entry that is in the table
+ * now, i.e. either the given entry or the one that already existed
+ */
+auto insertEntry(HashTableBase* hashTable, Entry* entry) -> Entry*;
+
+/**
+ * Removes the entry for the given key from the table without freeing it, so
+ * that the caller can free it later on
+ *
+ * @param hashTable the table to execute the operation on
+ * @param key TXID or RID
+ * @returns the entry, or nullptr if the key does not exist
+ */
+auto extractEntry(HashTableBase* hashTable, int key) -> Entry*;
+
+/**
+ * Returns the node that starts with the given entry. The enclave reads nodes
+ * of the lock table that the untrusted part allocated, which only works for
+ * values with a standard layout.
+ */
+template <typename Value>
+auto nodeOf(Entry* entry) -> Node<Value>* {
+  static_assert(std::is_standard_layout<Node<Value>>::value,
+                "nodes must have the same layout as C structs");
+  return reinterpret_cast<Node<Value>*>(entry);
+}
+
+/**
+ * Allocates an empty table
+ *
+ * @param size the number of bucket groups
+ */
+template <typename Key, typename Value>
+auto newHashTable(int size) -> HashTable<Key, Value>* {
+  auto hashTable = new HashTable<Key, Value>();
+  initHashTable(hashTable, size);
+  return hashTable;
+}
 
 /**
  * Retrieves the value for the given key from a hashtable.
@@ -44,35 +269,64 @@ std::pair<Entry*, int> getBucket(HashTable* table, int key);
  * @param hashTable either the lock or transaction table to execute the
  * operation on
  * @param key identifies the value, i.e. TXID or RID
- * @returns value for the given key. Needs to be casted to the appropriate
- * pointer type, i.e. Transaction or Lock. Or nullptr, when the corresponding
- * key could not be found.
+ * @returns the value for the given key, which stays valid until the key is
+ * removed. Or nullptr, when the corresponding key could not be found.
  */
-auto get(HashTable* hashTable, int key) -> void*;
+template <typename Key, typename Value>
+auto get(HashTable<Key, Value>* hashTable,
+         typename HashTable<Key, Value>::KeyType key) -> Value* {
+  Entry* entry = findEntry(hashTable, key);
+  return entry == nullptr ? nullptr : &nodeOf<Value>(entry)->value;
+}
 
 /**
- * Retrieves the value for the given key from a bucket.
+ * Retrieves the values for several keys at once, see findEntries(). Faster
+ * than calling get() for each key, when the buckets are not in the cache.
  *
- * @param entry either the bucket of the lock or transaction table to execute
- * the operation on
- * @param key idedentifies the value, i.e. TXID or RID
- * @returns value for the given key. Needs to be casted to the appropriate
- * pointer type, i.e. Transaction or Lock. Or nullptr, when the corresponding
- * key could not be found.
+ * @param hashTable either the lock or transaction table to execute the
+ * operation on
+ * @param keys identify the values, i.e. TXIDs or RIDs
+ * @param n the number of keys
+ * @param values receives the value of each key, or nullptr when the key could
+ * not be found
  */
-auto get(Entry* entry, int key) -> void*;
+template <typename Key, typename Value>
+void getMany(HashTable<Key, Value>* hashTable,
+             const typename HashTable<Key, Value>::KeyType* keys, int n,
+             Value** values) {
+  Entry* entries[kLookupBatchSize];
+  for (int first = 0; first < n; first += kLookupBatchSize) {
+    int batch = n - first < kLookupBatchSize ? n - first : kLookupBatchSize;
+    findEntries(hashTable, keys + first, batch, entries);
+    for (int i = 0; i < batch; i++) {
+      values[first + i] =
+          entries[i] == nullptr ? nullptr : &nodeOf<Value>(entries[i])->value;
+    }
+  }
+}
 
 /**
- *  Sets the value for a given key. Doesn't do anything when the key already
- * exists in the table.
+ * Adds a value-initialized value for the given key. Doesn't do anything when
+ * the key already exists in the table. Grows the bucket group of the key,
+ * when it exceeds kMaxLoadFactor, unless the table is untrusted.
  *
  * @param hashTable either the lock or transaction table to execute the
  * operation on
  * @param key TXID or RID
- * @param value needs to be casted to void pointer from Transaction or Lock
- * pointer
+ * @returns the value for the given key, to be initialized by the caller if it
+ * was just added
  */
-void set(HashTable* hashTable, int key, void* value);
+template <typename Key, typename Value>
+auto insert(HashTable<Key, Value>* hashTable,
+            typename HashTable<Key, Value>::KeyType key) -> Value* {
+  auto node = poolNew<Node<Value>>();
+  node->entry.key = key;
+  Entry* entry = insertEntry(hashTable, &node->entry);
+  if (entry != &node->entry) {
+    poolDelete(node);  // key already exists
+  }
+  return &nodeOf<Value>(entry)->value;
+}
 
 /**
  * Checks if the transaction got already registered or a lock already exists
@@ -84,13 +338,74 @@ void set(HashTable* hashTable, int key, void* value);
  * @return true if the transaction or the lock respectively is in the
  * hashTable
  */
-auto contains(HashTable* hashTable, int key) -> bool;
+template <typename Key, typename Value>
+auto contains(HashTable<Key, Value>* hashTable,
+              typename HashTable<Key, Value>::KeyType key) -> bool {
+  return findEntry(hashTable, key) != nullptr;
+}
 
 /**
- * Deletes the lock or transaction respectively for the given key
+ * Deletes the lock or transaction respectively for the given key without
+ * freeing its node, so that the caller can free it later on
+ *
+ * @param hashTable the table to execute the operation on
+ * @param key TXID or RID
+ * @returns the node, or nullptr if the key does not exist
+ */
+template <typename Key, typename Value>
+auto extract(HashTable<Key, Value>* hashTable,
+             typename HashTable<Key, Value>::KeyType key) -> Node<Value>* {
+  Entry* entry = extractEntry(hashTable, key);
+  return entry == nullptr ? nullptr : nodeOf<Value>(entry);
+}
+
+/**
+ * Deletes the lock or transaction respectively for the given key. The node is
+ * not freed, as deleting untrusted memory from within the enclave causes an
+ * error.
  *
  * @param hashTable either the lock or transaction table to execute the
  * operation on
  * @param key TXID or RID
  */
-void remove(HashTable* hashTable, int key);
\ No newline at end of file
+template <typename Key, typename Value>
+void remove(HashTable<Key, Value>* hashTable,
+            typename HashTable<Key, Value>::KeyType key) {
+  extractEntry(hashTable, key);
+}
+
+/**
+ * Deletes the lock or transaction respectively for the given key and frees
+ * its node. Must only be used on tables in the caller's own memory, i.e. on
+ * the transaction table inside the enclave, as the enclave cannot free
+ * untrusted memory. Pointers to the value become invalid.
+ *
+ * @param hashTable the table to execute the operation on
+ * @param key TXID or RID
+ */
+template <typename Key, typename Value>
+void removeAndDelete(HashTable<Key, Value>* hashTable,
+                     typename HashTable<Key, Value>::KeyType key) {
+  poolDelete(extract(hashTable, key));
+}
+
+/**
+ * Counts the entries of every bucket of the table. Must not run while another
+ * thread modifies the table.
+ *
+ * @param hashTable either the lock or transaction table
+ * @returns the number of buckets and entries and how many buckets hold how
+ * many entries
+ */
+auto bucketStatistics(HashTableBase* hashTable) -> BucketStatistics;
+
+/**
+ * Adds a bucket with the given number of entries to the statistics
+ */
+void countBucket(BucketStatistics* statistics, unsigned long length);
+
+/**
+ * Returns the average number of entries of the non-empty buckets, i.e. the
+ * length of the chain that a lookup of an existing key walks on average
+ */
+auto meanBucketLength(BucketStatistics* statistics) -> double;
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+
+#include "common.h"
+
+/*
+Each worker thread takes its jobs from a bounded ring, into which any number of
+threads push jobs without taking a lock. A producer claims a position by
+advancing the tail with a compare and swap, writes the job into the slot of
+the position and publishes it by setting the sequence number of the slot. The
+worker is the only consumer and takes the published jobs in the order of their
+positions, handing each slot back to the producers of the next round by its
+sequence number. The tail, the consumer state and the flag of a sleeping
+consumer are kept on separate cache lines, so producers and the consumer do
+not invalidate each other's lines more than the slots require.
+
+Unlike a queue guarded by an sgx_thread_mutex_t, pushing a job neither takes a
+lock nor signals a condition variable, which may leave the enclave to wake up
+the worker. An empty ring is polled for a while before the worker goes to
+sleep. The number of polls adapts to the load: it doubles whenever a job
+arrived while polling and halves whenever the worker had to sleep, so a busy
+worker never sleeps while an idle one hardly burns any cycles. Producers only
+wake up a worker that announced that it sleeps.
+*/
+
+// Number of jobs a ring holds, producers wait while it is full
+const int kJobRingSize = 4096;
+
+// Size of a cache line, which separates the parts of a ring
+const int kCacheLineSize = 64;
+
+// Bounds of the number of times an empty ring is polled before sleeping
+const int kMinJobRingSpins = 64;
+const int kMaxJobRingSpins = 1 << 16;
+
+/**
+ * A job and the sequence number of its slot. The slot holds a published job
+ * of position p if its sequence number is p + 1, and is free for position p if
+ * it is p.
+ */
+struct JobSlot {
+  std::atomic<unsigned long> sequence;
+  Job job;
+};
+typedef struct JobSlot JobSlot;
+
+struct JobRing {
+  JobSlot* slots;  // kJobRingSize slots, never changes
+  alignas(kCacheLineSize) std::atomic<unsigned long> tail;  // next position
+                                                             // to claim
+  alignas(kCacheLineSize) unsigned long head;  // next position to take, only
+                                               // used by the consumer
+  int spins;  // number of polls before the consumer sleeps
+  alignas(kCacheLineSize) std::atomic<bool> sleeping;  // the consumer sleeps
+};
+typedef struct JobRing JobRing;
+
+/**
+ * Initializes an empty ring
+ */
+void initJobRing(JobRing* ring);
+
+/**
+ * Frees the slots of a ring
+ */
+void destroyJobRing(JobRing* ring);
+
+/**
+ * Pushes a job into the ring, waiting while it is full
+ *
+ * @param ring the ring of the worker thread
+ * @param job the job to push
+ * @returns true, if the consumer announced that it sleeps, so the caller has
+ * to wake it up
+ */
+auto pushJob(JobRing* ring, const Job& job) -> bool;
+
+/**
+ * Takes the published jobs from the ring in the order they were pushed. Must
+ * only be called by the consumer.
+ *
+ * @param ring the ring of the worker thread
+ * @param jobs buffer for the jobs
+ * @param maxJobs the maximum number of jobs to take
+ * @returns the number of jobs taken
+ */
+auto popJobs(JobRing* ring, Job* jobs, int maxJobs) -> int;
+
+/**
+ * Polls an empty ring until a job is published or the number of polls of the
+ * ring is exhausted, and adapts that number. Must only be called by the
+ * consumer.
+ *
+ * @returns true, if a job was published, false if the consumer should sleep
+ */
+auto spinForJobs(JobRing* ring) -> bool;
+
+/**
+ * Announces that the consumer is going to sleep. A producer that pushes a job
+ * afterwards wakes it up, so the consumer must hold the mutex that its
+ * producers wake it up with from here on until it waits.
+ *
+ * @returns false, if a job was published in the meantime and the consumer
+ * must not sleep
+ */
+auto announceSleep(JobRing* ring) -> bool;
+
+/**
+ * Withdraws the announcement of announceSleep(), once the consumer is awake
+ */
+void cancelSleep(JobRing* ring);
@@ -4,41 +4,144 @@
 #include <mutex>
 #include <set>
 #include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
 using std::memcpy;
 
+// Number of owners that are stored inline in a lock
+const int kInlineOwners = 4;
+
 /**
- * Used to set the size of the owners list of a lock. As of right now, there is
- * no way implemented to dynamically resize untrusted memory from the trusted
- * region. Therefore we allocate as much memory as we could possibly need. So we
- * have to set an upper limit on the number of owners of a lock, i.e. the number
- * of concurrent transactions.
+ * Number of owners of each chunk of untrusted memory that an OwnerArena
+ * obtains at once. It is also the capacity of the largest overflow array.
  */
-const int kTransactionBudget = 2;
+const int kOwnerChunkSize = 16384;
+
+// Number of capacities of overflow arrays: kInlineOwners * 2^i owners, up to
+// kOwnerChunkSize
+const int kOverflowClasses = 13;
+
+// Upper limit on the number of owners of a lock, i.e. the number of
+// concurrent transactions that share it
+const int kMaxOwners = kInlineOwners + kOwnerChunkSize;
+
+// Bit of Lock::word that is set while the lock is held exclusively
+const unsigned int kExclusiveBit = 1u << 31;
+
+// Bits of Lock::word that count the owners of the lock
+const unsigned int kOwnerCountMask = kExclusiveBit - 1;
 
 /**
- * The internal representation of a lock for the lock manager.
+ * The internal representation of a lock for the lock manager. The mode and the
+ * number of owners are packed into a single word, which is only changed with
+ * atomic operations. The first kInlineOwners owners are stored inline, the
+ * others of widely shared locks in an overflow array from an OwnerArena.
  */
 struct Lock {
-  bool exclusive;
-  int* owners;
-  int num_owners;
+  unsigned int word;          // kExclusiveBit | number of owners
+  int owners[kInlineOwners];  // the owners in the order they acquired the lock
+  int* overflow;              // the other owners, or nullptr
 };
 typedef struct Lock Lock;
 
 /**
- * Initializes a lock struct
+ * Hands out the overflow arrays of locks in untrusted memory. As of right now,
+ * there is no way implemented to allocate untrusted memory from the trusted
+ * region directly, so the arena obtains it from the untrusted part in chunks
+ * of kOwnerChunkSize owners, i.e. a single OCALL provides the overflow arrays
+ * for many locks. The arrays have capacities of powers of two and freed arrays
+ * are kept for the next lock that needs one of the same capacity.
+ *
+ * The arena itself lives in the enclave, so the untrusted part can neither
+ * tamper with its free lists nor make a lock point to an overflow array that
+ * the arena did not hand out. Each partition of the lock table has its own
+ * arena, as only the worker thread owning the partition changes its locks.
+ */
+struct OwnerArena {
+  int* (*allocate_chunk)();  // obtains a new chunk, or returns nullptr
+  int* chunk;                // the chunk new overflow arrays are carved from
+  int used;                  // number of owners of the chunk handed out
+  std::vector<int*> free_arrays[kOverflowClasses];  // freed, per capacity
+  std::unordered_map<int*, int> capacities;  // of the arrays handed out
+};
+typedef struct OwnerArena OwnerArena;
+
+/**
+ * Initializes an arena that has not handed out any overflow arrays yet
+ *
+ * @param arena the arena to initialize
+ * @param allocateChunk obtains kOwnerChunkSize owners of untrusted memory
+ */
+void initOwnerArena(OwnerArena* arena, int* (*allocateChunk)());
+
+/**
+ * Returns if the lock is held exclusively
+ */
+inline auto isHeldExclusively(Lock* lock) -> bool {
+  return (__atomic_load_n(&lock->word, __ATOMIC_ACQUIRE) & kExclusiveBit) != 0;
+}
+
+/**
+ * Returns the number of transactions that hold the lock
+ */
+inline auto numOwners(Lock* lock) -> int {
+  return (int)(__atomic_load_n(&lock->word, __ATOMIC_ACQUIRE) &
+               kOwnerCountMask);
+}
+
+/**
+ * Checks if the transaction holds the lock
+ *
+ * @param lock the lock to check
+ * @param transactionId ID of the transaction
+ * @param arena the arena the overflow array of the lock is from, or nullptr
+ * to only check the inline owners
+ */
+auto isOwner(Lock* lock, int transactionId, OwnerArena* arena = nullptr)
+    -> bool;
+
+/**
+ * Initializes a lock struct, e.g. one that was just inserted into the lock
+ * table
+ */
+void initLock(Lock* lock);
+
+/**
+ * Allocates and initializes a lock struct that is not part of a lock table
  */
 Lock* newLock();
 
 /**
- * Attempts to acquire shared access for a transaction.
+ * Releases the resources of a lock, but not the lock struct itself, e.g.
+ * before the node of the lock is freed. Must not be called from within the
+ * enclave on locks in untrusted memory. The overflow array belongs to the
+ * chunk of an OwnerArena, which is freed as a whole.
+ */
+void destroyLock(Lock* lock);
+
+/**
+ * Frees a lock struct that was initialized with newLock(). Must not be called
+ * from within the enclave on locks in untrusted memory.
+ */
+void deleteLock(Lock* lock);
+
+/**
+ * Attempts to acquire shared access for a transaction. The first owners take
+ * the inline slots, further ones are appended to the overflow array, which is
+ * replaced by one of twice the capacity when it is full. Like all other
+ * operations on a lock, it has to be serialized by the caller. The owner is
+ * stored before the count of owners grows, so threads reading the count see
+ * all owners it covers.
  *
  * @param lock the lock the operation is executed on
  * @param transactionId ID of the transaction, that wants to acquire the lock
+ * @param arena provides the overflow array. Without an arena, shared access
+ * fails once all inline slots are taken.
  * @throws std::domain_error, when the lock is exclusive
  */
-auto getSharedAccess(Lock* lock, int transactionId) -> bool;
+auto getSharedAccess(Lock* lock, int transactionId,
+                     OwnerArena* arena = nullptr) -> bool;
 
 /**
  * Attempts to acquire exclusive access for a transaction.
@@ -50,11 +153,15 @@ auto getSharedAccess(Lock* lock, int transactionId) -> bool;
 auto getExclusiveAccess(Lock* lock, int transactionId) -> bool;
 
 /**
- * Releases the lock for the calling transaction.
+ * Releases the lock for the calling transaction. Returns the overflow array to
+ * the arena once the remaining owners fit inline, and replaces it by one of
+ * half the capacity once it is only a quarter full.
  * @param lock the lock the operation is executed on
  * @param transactionId ID of the calling transaction
+ * @param arena the arena the overflow array of the lock is from, or nullptr
+ * if the lock has none
  */
-void release(Lock* lock, int transactionId);
+void release(Lock* lock, int transactionId, OwnerArena* arena = nullptr);
 
 /**
  * Upgrades the lock for the transaction, that currently holds the shared lock
@@ -68,9 +175,9 @@ void release(Lock* lock, int transactionId);
 auto upgrade(Lock* lock, int transactionId) -> bool;
 
 /**
- * Creates a new lock that has the same content as the given lock. This
- * is used to move a lock that is allocated in untrusted memory into protected
- * memory.
+ * Creates a new lock that has the same content as the given lock, without its
+ * overflow array. This is used to move a lock that is allocated in untrusted
+ * memory into protected memory.
  *
  * @param lock the lock to copy
  * @return copy casted as void*
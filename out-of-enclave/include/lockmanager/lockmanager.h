@@ -1,18 +1,23 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "base64-encoding.h"
 #include "common.h"
+#include "completion.h"
 #include "enclave_u.h"
 #include "errors.h"
 #include "files.h"
 #include "hashtable.h"
 #include "lock.h"
+#include "pool.h"
 #include "sgx_eid.h"
 #include "sgx_tcrypto.h"
 #include "sgx_urts.h"
@@ -23,11 +28,30 @@
 #define ENCLAVE_FILENAME "enclave.signed.so"
 #define SEALED_KEY_FILE "sealed_data_blob.txt"
 #define NO_SIGNATURE ""    // for jobs that return no signature (QUIT, UNLOCK)
-#define SIGNATURE_SIZE 89  // length of the base64-encoded signature
+
+// Milliseconds between two rounds of the janitor thread
+const int kJanitorInterval = 10;
+
+// Number of partitions of the lock table inside the enclave for each worker
+// thread. A worker owns several partitions, so that the janitor can have some
+// of them moved to other workers.
+const int kPartitionsPerWorker = 16;
+
+// Milliseconds a lock is granted for by default, before it is released
+const int kDefaultLeaseDuration = 30000;
 
 extern sgx_enclave_id_t global_eid;  // identifies the enclave
 extern sgx_launch_token_t token;
 
+/**
+ * A row lock requested as part of a batch, see LockManager::lockBatch()
+ */
+struct BatchedLock {
+  int transactionId;
+  int rowId;
+  bool isExclusive;
+};
+
 //=========================== OCALLS ============================
 /**
  * Logs an info message from inside the enclave to the terminal
@@ -49,8 +73,22 @@ void print_error(const char *str);
  * @param str characters to be printed
  */
 void print_warn(const char *str);
+
+/**
+ * Allocates a chunk of untrusted memory, from which the enclave takes the
+ * overflow arrays of widely shared locks, see OwnerArena
+ *
+ * @param num_owners the number of owners the chunk holds
+ */
+void *allocate_owner_chunk(size_t num_owners);
 //================================================================
 
+/**
+ * Frees the chunks allocated by allocate_owner_chunk(), once the enclave is
+ * destroyed
+ */
+void free_owner_chunks();
+
 /**
  * Process lock and unlock requests from the server. It manages a lock table,
  * where for each row ID it can store the corresponding lock object, which
@@ -64,14 +102,20 @@ void print_warn(const char *str);
  */
 class LockManager {
  public:
-  HashTable *lockTable;
+  LockTable *lockTable;
 
   /**
    * Initializes the enclave and seals the public and private key for signing.
    *
    * @param numWorkerThreads the number of threads that work on the lock table
+   * @param leaseDuration milliseconds each lock is granted for. The signature
+   * of a lock carries the time its lease expires, and the enclave releases the
+   * lock at that time, unless it was released before, so the locks of crashed
+   * clients do not stay in the lock table. 0 grants locks until they are
+   * released.
    */
-  LockManager(int numWorkerThreads = 1);
+  LockManager(int numWorkerThreads = 1,
+              int leaseDuration = kDefaultLeaseDuration);
 
   /**
    * Destroys the enclave.
@@ -98,7 +142,8 @@ class LockManager {
    * @param requestedMode either shared for concurrent read access or exclusive
    * for sole write access
    * @param waitForResult parameter forwarded to create_job function
-   * @returns the signature for the acquired lock
+   * @returns the signature for the acquired lock, followed by "_" and the
+   * time in milliseconds since the epoch its lease expires, or 0
    * @throws std::domain_error, when transaction did not call
    * RegisterTransaction before or the given lock mode is unknown or when the
    * transaction makes a request for a look, that it already owns, makes a
@@ -108,6 +153,20 @@ class LockManager {
   auto lock(int transactionId, int rowId, bool isExclusive,
             bool waitForResult = true) -> std::pair<std::string, bool>;
 
+  /**
+   * Acquires the row locks of a batch with a single transition into the
+   * enclave, instead of one for each lock(). The enclave puts the requests
+   * into the job queues of their worker threads at once, so they are
+   * processed in parallel, and the function waits until all of them finished.
+   * The requests may belong to different transactions.
+   *
+   * @param requests the row locks to acquire
+   * @returns a pair of the signature and if the lock was acquired for each
+   * request in the order of the requests, see lock()
+   */
+  auto lockBatch(const std::vector<BatchedLock> &requests)
+      -> std::vector<std::pair<std::string, bool>>;
+
   /**
    * Releases a lock for the specified row
    *
@@ -118,6 +177,32 @@ class LockManager {
    */
   void unlock(int transactionId, int rowId, bool waitForResult = false);
 
+  /**
+   * Commits a transaction by releasing all of its locks and removing it from
+   * the transaction table with a single enclave job, instead of one unlock()
+   * for each lock. The locked rows are split by the partitions that own them
+   * and released by their worker threads in parallel, each verifying the
+   * buckets of its rows. Requests of the transaction that did not finish yet
+   * fail.
+   *
+   * @param transactionId identifies the transaction
+   * @param waitForResult if the function should wait for all locks to be
+   * released
+   * @returns false, if the transaction is not registered
+   */
+  auto commit(int transactionId, bool waitForResult = true) -> bool;
+
+  /**
+   * Aborts a transaction, which releases all of its locks and removes it from
+   * the transaction table like commit()
+   *
+   * @param transactionId identifies the transaction
+   * @param waitForResult if the function should wait for all locks to be
+   * released
+   * @returns false, if the transaction is not registered
+   */
+  auto abort(int transactionId, bool waitForResult = true) -> bool;
+
   /**
    * This function is just for testing, to demonstrate that signatures created
    * on lock requests are valid.
@@ -132,6 +217,32 @@ class LockManager {
   auto verify_signature_string(std::string signature, int transactionId,
                                int rowId, int isExclusive) -> bool;
 
+  /**
+   * Returns the hit and miss counters of the pools in untrusted memory, that
+   * the locks and the entries of the lock table are allocated from
+   */
+  auto getPoolStatistics() -> PoolStatistics;
+
+  /**
+   * Returns the hit and miss counters of the pools inside the enclave, that
+   * the transactions and the entries of the transaction table are allocated
+   * from
+   */
+  auto getEnclavePoolStatistics() -> PoolStatistics;
+
+  /**
+   * Returns how the locks are distributed over the buckets of the lock table.
+   * Must only be called while no requests are being processed.
+   */
+  auto getLockTableStatistics() -> BucketStatistics;
+
+  /**
+   * Returns the worker thread that owns each partition of the lock table
+   * inside the enclave, and the jobs that are queued for it and that were
+   * served for it so far
+   */
+  auto getPartitionStatistics() -> std::vector<PartitionStatistics>;
+
  private:
   /**
    * Initializes the enclave (in DEBUG mode).
@@ -175,15 +286,16 @@ class LockManager {
    * Initializes the configuration parameters for the enclave
    *
    * @param numWorkerThreads the number of threads that work on the lock table
+   * @param leaseDuration milliseconds each lock is granted for, or 0
    */
-  void configuration_init(int numWorkerThreads);
+  void configuration_init(int numWorkerThreads, int leaseDuration);
 
   /**
    * Creates a job and sends it to the enclave to get it processed by an enclave
    * worker thread.
    *
-   * @param command SHARED, EXCLUSIVE, REGISTER or QUIT
-   * @param transaction_id additional argument for SHARED, EXCLUSIVE or REGISTER
+   * @param command SHARED, EXCLUSIVE, UNLOCK, COMMIT, ABORT, REGISTER or QUIT
+   * @param transaction_id additional argument for all commands except QUIT
    * @param row_id additional argument for SHARED or EXCLUSIVE
    * @param lock_budget additional argument for REGISTER
    * @param waitForResult if the function should wait for return values to be
@@ -201,7 +313,47 @@ class LockManager {
   pthread_t
       *threads;  // worker threads that execute requests inside the enclave
   std::mutex new_lock_mut;  // controls the insertion of new lock objects into
-                            // the lock table
+                            // the lock table. Every untrusted reader of the
+                            // lock table must hold it, see
+                            // reclaim_retired_entries()
   std::mutex new_transaction_mut;  // controls the insertion of new transaction
                                    // objects into the lock table
+
+  /**
+   * Function that the janitor thread executes. Until the lock manager shuts
+   * down, it frees the lock table entries that the enclave removed every
+   * kJanitorInterval milliseconds and sends the current time to the enclave,
+   * which expires the leases of the locks and moves partitions of the lock
+   * table from busy worker threads to idle ones.
+   *
+   * @param tmp the lock manager
+   */
+  static auto create_janitor_thread(void *tmp) -> void *;
+
+  /**
+   * Collects the entries the enclave retired from the reclamation rings and
+   * frees them together with their locks, once no untrusted reader of the lock
+   * table can still hold a pointer to them. The enclave only hands over entries
+   * that its worker threads no longer reach.
+   */
+  void reclaim_retired_entries();
+
+  /**
+   * Sends a TICK job with the current time to the worker threads, which
+   * release the locks whose lease expired
+   */
+  void advance_leases();
+
+  /**
+   * Sends a BALANCE job with the current time to the enclave, which measures
+   * the load of the worker threads and moves a partition of the lock table
+   * from the busiest worker to the idlest one
+   */
+  void balance_partitions();
+
+  ReclamationRing
+      *reclamation_rings;  // one per enclave thread, see ReclamationRing
+  std::vector<Entry *> retired_entries;  // collected in the current round
+  pthread_t janitor;  // frees the memory of retired lock table entries
+  std::atomic<bool> janitor_running;
 };
\ No newline at end of file
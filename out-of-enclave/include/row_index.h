@@ -0,0 +1,66 @@
+#pragma once
+
+/**
+ * Hash index over the dense array of the rows a transaction holds locks on.
+ * Each slot holds the position of a row in the array plus 1, or 0 if it is
+ * empty. Collisions are resolved by linear probing and removed rows are
+ * backward shifted instead of leaving tombstones. The index is kept at most
+ * half full, so finding, adding and removing a row take O(1) on average,
+ * and it doubles when it grows, so a transaction with n locks rehashes O(n)
+ * rows in total.
+ */
+struct RowIndex {
+  int* slots;     // positions of the rows plus 1, or 0 for an empty slot
+  int num_slots;  // 0 or a power of two
+};
+typedef struct RowIndex RowIndex;
+
+/**
+ * Initializes an empty index, which allocates its slots with the first row
+ */
+void initRowIndex(RowIndex* index);
+
+/**
+ * Frees the slots of an index
+ */
+void destroyRowIndex(RowIndex* index);
+
+/**
+ * Returns the position of a row in the array, or -1 if it is not indexed
+ *
+ * @param index the index of the array
+ * @param rows the array of rows
+ * @param rowId the row to look up
+ */
+auto findRow(RowIndex* index, const int* rows, int rowId) -> int;
+
+/**
+ * Indexes the row that was just appended to the array, growing the index if
+ * it would be more than half full
+ *
+ * @param index the index of the array
+ * @param rows the array of rows
+ * @param numRows the number of rows including the appended one, which is the
+ * last one
+ */
+void indexRow(RowIndex* index, const int* rows, int numRows);
+
+/**
+ * Removes a row from the index before the caller moves the last row of the
+ * array into its position and shrinks the array by one
+ *
+ * @param index the index of the array
+ * @param rows the array of rows
+ * @param position the position of the removed row
+ * @param last the position of the last row
+ */
+void unindexRow(RowIndex* index, const int* rows, int position, int last);
+
+/**
+ * Copies the slots of an index, e.g. together with the array of rows, without
+ * rehashing them
+ *
+ * @param copy the index to initialize as a copy, which must not own slots
+ * @param index the index to copy
+ */
+void copyRowIndex(RowIndex* copy, const RowIndex* index);
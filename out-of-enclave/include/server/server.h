@@ -79,6 +79,30 @@ class LockingServiceImpl final : public LockingService::Service {
   auto Unlock(ServerContext* context, const LockRequest* request,
               LockResponse* response) -> Status override;
 
+  /**
+   * Unpacks the TransactionRequest by a client to release all locks of its
+   * transaction at once and to end it.
+   *
+   * @param context contains metadata about the request
+   * @param request containing transaction ID
+   * @param response only used for the status of the RPC call
+   * @return the status code of the RPC call (OK or a specific error code)
+   */
+  auto Commit(ServerContext* context, const TransactionRequest* request,
+              TransactionResponse* response) -> Status override;
+
+  /**
+   * Unpacks the TransactionRequest by a client to release all locks of its
+   * transaction at once and to abort it.
+   *
+   * @param context contains metadata about the request
+   * @param request containing transaction ID
+   * @param response only used for the status of the RPC call
+   * @return the status code of the RPC call (OK or a specific error code)
+   */
+  auto Abort(ServerContext* context, const TransactionRequest* request,
+             TransactionResponse* response) -> Status override;
+
  private:
   LockManager lockManager_;
 };
\ No newline at end of file
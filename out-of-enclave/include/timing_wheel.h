@@ -0,0 +1,87 @@
+#pragma once
+
+// Number of levels of a timing wheel
+const int kWheelLevels = 4;
+
+// Number of bits of a tick that select the slot within a level
+const int kWheelBits = 6;
+
+// Number of slots of each level
+const int kWheelSlots = 1 << kWheelBits;
+
+/**
+ * A lock granted to a transaction until the tick it expires at. The lease is
+ * linked into the slot of a timing wheel it expires in.
+ */
+struct Lease {
+  struct Lease* next;    // next lease of the same slot
+  struct Lease** pprev;  // pointer to this lease, or nullptr if not linked
+  unsigned long expiry;  // tick at which the lease expires
+  int transaction_id;
+  int row_id;
+};
+typedef struct Lease Lease;
+
+/**
+ * Hierarchical timing wheel, which expires leases without ever scanning the
+ * leases that did not expire yet. Level l has kWheelSlots slots of
+ * kWheelSlots^l ticks each, so the wheel covers kWheelSlots^kWheelLevels ticks
+ * ahead. A lease is linked into the slot of the lowest level that reaches its
+ * expiry. Whenever the current tick enters the next slot of a level, the
+ * leases of that slot move down to the levels below, and the leases in the
+ * current slot of level 0 expire. Each lease moves at most kWheelLevels - 1
+ * times, so adding, cancelling and expiring it takes O(1) amortized time.
+ * Leases further ahead than the wheel covers wait in the highest level and are
+ * linked in again until they are in reach.
+ */
+struct TimingWheel {
+  unsigned long now;  // the current tick
+  long num_leases;    // number of linked leases
+  Lease* slots[kWheelLevels][kWheelSlots];
+};
+typedef struct TimingWheel TimingWheel;
+
+/**
+ * Initializes an empty timing wheel
+ *
+ * @param wheel the wheel to initialize
+ * @param now the current tick
+ */
+void initTimingWheel(TimingWheel* wheel, unsigned long now);
+
+/**
+ * Frees the leases that are still linked into a timing wheel
+ */
+void destroyTimingWheel(TimingWheel* wheel);
+
+/**
+ * Allocates a lease and links it into the wheel. A lease that expires at or
+ * before the current tick expires with the next tick.
+ *
+ * @param wheel the wheel the lease expires in
+ * @param transactionId the transaction the lock is granted to
+ * @param rowId the locked row
+ * @param expiry tick at which the lease expires
+ * @returns the lease, which stays valid until it is cancelled or expired
+ */
+auto addLease(TimingWheel* wheel, int transactionId, int rowId,
+              unsigned long expiry) -> Lease*;
+
+/**
+ * Unlinks a lease from the wheel, if it is still linked, and frees it
+ *
+ * @param wheel the wheel the lease was added to
+ * @param lease the lease, or nullptr
+ */
+void cancelLease(TimingWheel* wheel, Lease* lease);
+
+/**
+ * Advances the wheel to the given tick and unlinks the leases that expired on
+ * the way. The wheel never goes back in time.
+ *
+ * @param wheel the wheel to advance
+ * @param now the current tick
+ * @returns the expired leases, linked by next, which the caller frees with
+ * cancelLease()
+ */
+auto advanceTimingWheel(TimingWheel* wheel, unsigned long now) -> Lease*;
@@ -1,13 +1,17 @@
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 #include "hashtable.h"
 #include "lock.h"
+#include "row_index.h"
+#include "timing_wheel.h"
 
 using std::memcpy;
 
@@ -30,17 +34,44 @@ struct Transaction {
    */
   bool growing_phase;
   int lock_budget;
+  /**
+   * The locked rows are kept densely in no particular order, so that a
+   * released row is replaced by the last one, and are indexed by row ID.
+   * Looking up, adding and removing a row takes constant time on average.
+   */
   int* locked_rows;
-  int locked_rows_size;
-  int num_locked;
+  int locked_rows_size;  // number of rows locked_rows has room for
+  int num_locked;        // number of locked rows
+  RowIndex locked_rows_index;
+  // Lease of each locked row, at the same position, or nullptr if the lock
+  // does not expire. The leases are owned by the timing wheels of the enclave.
+  Lease** leases;
+  // number of threads using the transaction, and whether it was removed from
+  // the transaction table meanwhile. Both are guarded by the mutex of its
+  // partition of the transaction table, see pin_transaction().
+  int pins;
+  bool detached;
 };
 typedef struct Transaction Transaction;
 
 /**
- * Initializes the transaction struct. New transaction objects, that are created
- * for new, not-yet registered transaction beforehand by the untrusted
- * application always have their transaction ID set to -1 to differentiate them
- * from transaction objects refering to already registered transactions.
+ * Initializes the transaction struct, e.g. one that was just inserted into the
+ * transaction table. New transaction objects, that are created for new,
+ * not-yet registered transaction beforehand by the untrusted application
+ * always have their transaction ID set to -1 to differentiate them from
+ * transaction objects refering to already registered transactions.
+ *
+ * @param transaction the transaction struct to initialize
+ * @param transactionId identifies the transaction
+ * @param lockBudget maximum number of locks the transaction is allowed to
+ * acquire
+ */
+void initTransaction(Transaction* transaction, int transactionId,
+                     int lockBudget);
+
+/**
+ * Allocates and initializes a transaction struct that is not part of a
+ * transaction table.
  *
  * @param transactionId identifies the transaction
  * @param lockBudget maximum number of locks the transaction is allowed to
@@ -49,6 +80,19 @@ typedef struct Transaction Transaction;
  */
 Transaction* newTransaction(int transactionId, int lockBudget);
 
+/**
+ * Frees the set of locked rows of a transaction, but not the transaction
+ * struct itself, e.g. before it is removed from the transaction table. The
+ * leases of the rows must have been cancelled already.
+ */
+void destroyTransaction(Transaction* transaction);
+
+/**
+ * Frees a transaction struct that was initialized with newTransaction(),
+ * together with its set of locked rows
+ */
+void deleteTransaction(Transaction* transaction);
+
 /**
  * When the transaction acquires a new lock, the row ID that lock refers to is
  * added to the set of locked rows and it decrements the lock budget by 1.
@@ -59,9 +103,10 @@ Transaction* newTransaction(int transactionId, int lockBudget);
  * @param rowId row ID of the newly acquired lock
  * @param requestedMode
  * @param lock
+ * @param arena provides the overflow array of the lock, see getSharedAccess()
  */
-auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock)
-    -> bool;
+auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock,
+             OwnerArena* arena = nullptr) -> bool;
 
 /**
  * Checks if the transaction currently holds a lock on the given row ID.
@@ -71,8 +116,13 @@ auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock)
  * @param Transaction transaction to execute the operation on
  * @param rowId row ID of the released lock
  * @param lock the lock to release
+ * @param arena the arena the overflow array of the lock is from
+ * @returns the node of the lock, if the lock has no owners anymore and was
+ * removed from the lock table, else nullptr. The node is not freed, see
+ * ReclamationRing.
  */
-void releaseLock(Transaction* transaction, int rowId, HashTable* lockTable);
+auto releaseLock(Transaction* transaction, int rowId, LockTable* lockTable,
+                 OwnerArena* arena = nullptr) -> Node<Lock>*;
 
 /**
  * Checks if the transaction has a lock on the specified row.
@@ -89,13 +139,16 @@ auto hasLock(Transaction* transaction, int rowId) -> bool;
  *
  * @param Transaction transaction to execute the operation on
  * @param lockTable containing all the locks indexed by row ID
+ * @param arena the arena the overflow arrays of the locks are from
  */
-void releaseAllLocks(Transaction* transaction, HashTable* lockTable);
+void releaseAllLocks(Transaction* transaction, LockTable* lockTable,
+                     OwnerArena* arena = nullptr);
 
 /**
  * Creates a new transaction that has the same content as the given transaction.
  * This is used to move a transaction that is allocated in untrusted memory into
- * protected memory.
+ * protected memory. The locked rows and their index are copied as they are,
+ * without rehashing the rows.
  *
  * @param transaction the transaction to copy
  * @return copy casted as void*
@@ -108,3 +161,18 @@ auto copy_transaction(Transaction* transaction) -> void*;
  * @param transaction the transaction created with copy_transaction())
  */
 void free_transaction_copy(Transaction*& transaction);
+
+/**
+ * Shared state of the parts a COMMIT or ABORT request is split into, one for
+ * each partition that owns rows the transaction holds locks on. The
+ * transaction is removed from the transaction table before the parts are
+ * sent, and the last part to finish frees it and completes the original
+ * request.
+ */
+struct ReleaseRequest {
+  Job job;                             // the original request
+  Node<Transaction>* node;             // the removed transaction
+  std::vector<std::vector<int>> rows;  // locked rows of each partition
+  std::atomic<int> pending;  // number of parts that did not finish yet
+};
+typedef struct ReleaseRequest ReleaseRequest;
@@ -93,5 +93,33 @@ auto LockingServiceClient::requestUnlock(unsigned int transactionId,
 
   Status status = stub_->Unlock(&context, request, &response);
 
+  return status.ok();
+}
+
+auto LockingServiceClient::requestCommit(unsigned int transactionId) -> bool {
+  spdlog::info("Requesting to commit (TXID: " + std::to_string(transactionId) +
+               ")");
+  TransactionRequest request;
+  request.set_transaction_id(transactionId);
+
+  TransactionResponse response;
+  ClientContext context;
+
+  Status status = stub_->Commit(&context, request, &response);
+
+  return status.ok();
+}
+
+auto LockingServiceClient::requestAbort(unsigned int transactionId) -> bool {
+  spdlog::info("Requesting to abort (TXID: " + std::to_string(transactionId) +
+               ")");
+  TransactionRequest request;
+  request.set_transaction_id(transactionId);
+
+  TransactionResponse response;
+  ClientContext context;
+
+  Status status = stub_->Abort(&context, request, &response);
+
   return status.ok();
 }
\ No newline at end of file
@@ -4,17 +4,104 @@ Arg arg_enclave;  // configuration parameters for the enclave
 int num = 0;      // global variable used to give every thread a unique ID
 int transaction_count = 0;  // counts the number of active transactions
 sgx_thread_mutex_t global_num_mutex;  // synchronizes access to num
-sgx_thread_mutex_t *queue_mutex;      // synchronizes access to the job queue
+sgx_thread_mutex_t *queue_mutex;      // lets a worker sleep on its job ring
 sgx_thread_cond_t
     *job_cond;  // wakes up worker threads when a new job is available
-std::vector<std::queue<Job>> queue;  // a job queue for each worker threads
+JobRing *job_rings;                  // a job ring for each worker thread
 sgx_ecc_state_handle_t *contexts;    // context for signing for each thread
 
-void enclave_init_values(Arg arg, HashTable *lock_table) {
+// Synchronizes access to each partition of the transaction table
+sgx_thread_mutex_t *transaction_table_mutex;
+
+/**
+ * Tells the CPU that the thread is polling, which saves power and frees the
+ * pipeline for a sibling hyperthread
+ */
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+/**
+ * Marks a request as finished and wakes up the client waiting for it outside
+ * of the enclave, if it parked already
+ */
+static void finish_job(const Job &job) {
+  if (finishCompletion(job.finished)) {
+    wake_completion(job.finished);
+  }
+}
+
+/**
+ * Obtains a chunk of untrusted memory for the overflow arrays of the locks
+ * from the untrusted part
+ *
+ * @returns the chunk of kOwnerChunkSize owners, or nullptr if the untrusted
+ * part did not provide it
+ */
+static auto allocate_owner_chunk_untrusted() -> int * {
+  void *chunk = nullptr;
+  sgx_status_t ret = allocate_owner_chunk(&chunk, kOwnerChunkSize);
+  if (ret != SGX_SUCCESS || chunk == nullptr ||
+      !sgx_is_outside_enclave(chunk, sizeof(int) * kOwnerChunkSize)) {
+    print_error("Could not allocate a chunk for the owners of locks");
+    return nullptr;
+  }
+  return (int *)chunk;
+}
+
+void enclave_init_values(Arg arg, HashTableBase *lock_table,
+                         ReclamationRing *reclamation_rings) {
   // Get configuration parameters
   arg_enclave = arg;
-  lockTable_ = lock_table;
-  transactionTable_ = newHashTable(arg_enclave.transaction_table_size);
+  lockTable_ = static_cast<LockTable *>(lock_table);
+  transactionTable_ =
+      newHashTable<int, Transaction>(arg_enclave.transaction_table_size);
+
+  // The worker threads write into the rings, so they must not overlap with
+  // the enclave
+  if (reclamation_rings != nullptr &&
+      sgx_is_outside_enclave(reclamation_rings, sizeof(ReclamationRing) *
+                                                    arg_enclave.num_threads)) {
+    reclamationRings_ = reclamation_rings;
+  } else {
+    print_error("Reclamation rings are not in untrusted memory");
+    reclamationRings_ = nullptr;
+  }
+
+  ownerArenas_ = new OwnerArena[arg_enclave.num_partitions]();
+  for (int i = 0; i < arg_enclave.num_partitions; i++) {
+    initOwnerArena(&ownerArenas_[i], &allocate_owner_chunk_untrusted);
+  }
+
+  leaseClock_ = arg_enclave.start_time;
+  timingWheels_ = new TimingWheel[arg_enclave.num_partitions];
+  for (int i = 0; i < arg_enclave.num_partitions; i++) {
+    initTimingWheel(&timingWheels_[i],
+                    arg_enclave.start_time / kLeaseResolution);
+  }
+
+  // Each worker thread starts with adjacent partitions, so it serves the same
+  // rows as with a fixed partition per worker
+  partitionOwner_ = new std::atomic<int>[arg_enclave.num_partitions];
+  partitionSenders_ = new std::atomic<int>[arg_enclave.num_partitions]();
+  partitionJobs_ = new std::atomic<int>[arg_enclave.num_partitions]();
+  partitionServed_ =
+      new std::atomic<unsigned long>[arg_enclave.num_partitions]();
+  partitionMigrations_ =
+      new std::atomic<unsigned long>[arg_enclave.num_partitions]();
+  adopting_ = new std::atomic<bool>[arg_enclave.num_partitions]();
+  lastServed_ = new unsigned long[arg_enclave.num_partitions]();
+  for (int i = 0; i < arg_enclave.num_partitions; i++) {
+    partitionOwner_[i] =
+        (int)((long)i * arg_enclave.num_threads / arg_enclave.num_partitions);
+  }
+  migrating_ = false;
+  lastBalance_ = 0;
+  serviceTime_ = new unsigned long[arg_enclave.num_threads]();
+  handoffs_ = new std::vector<Handoff>[arg_enclave.num_threads];
+  adoptedJobs_ = new std::vector<Job>[arg_enclave.num_threads];
 
   // Initialize mutex variables
   sgx_thread_mutex_init(&global_num_mutex, NULL);
@@ -22,17 +109,107 @@ void enclave_init_values(Arg arg, HashTable *lock_table) {
                                              arg_enclave.num_threads);
   job_cond = (sgx_thread_cond_t *)malloc(sizeof(sgx_thread_cond_t) *
                                          arg_enclave.num_threads);
+  transaction_table_mutex = (sgx_thread_mutex_t *)malloc(
+      sizeof(sgx_thread_mutex_t) * arg_enclave.num_threads);
+  for (int i = 0; i < arg_enclave.num_threads; i++) {
+    sgx_thread_mutex_init(&transaction_table_mutex[i], NULL);
+  }
 
-  // Initialize job queues
+  // Initialize job rings and signing contexts
   contexts = (sgx_ecc_state_handle_t *)malloc(arg_enclave.num_threads *
                                               sizeof(sgx_ecc_state_handle_t));
+  job_rings = new JobRing[arg_enclave.num_threads];
   for (int i = 0; i < arg_enclave.num_threads; i++) {
-    queue.push_back(std::queue<Job>());
+    initJobRing(&job_rings[i]);
     sgx_ecc256_open_context(&contexts[i]);
   }
 
-  // Allocate space for one hash per bucket
+  // Allocate space for one hash per group, the hashes of the other buckets are
+  // allocated while the bucket groups grow
   lockTableIntegrityHashes.resize(lockTable_->size);
+  lockTableSplitHashes.resize(lockTable_->size);
+  lockTableGroups.resize(lockTable_->size);
+}
+
+/**
+ * Makes sure that a segment of a group of the lock table exists. The buckets
+ * are allocated in untrusted memory by an OCALL, the integrity hashes of the
+ * segment inside the enclave. Only the worker thread owning the group grows
+ * it, so no other thread allocates the same segment.
+ *
+ * @param group the bucket group, i.e. hash() of the row ID
+ * @param segment the index of the segment within the group
+ * @returns false, if the untrusted part did not provide the memory
+ */
+static auto allocate_locktable_segment(int group, int segment) -> bool {
+  BucketGroup *untrusted = &lockTable_->groups[group];
+  if (untrusted->segments == nullptr) {
+    void *segments = nullptr;
+    sgx_status_t ret =
+        allocate_bucket_segments(&segments, HASHTABLE_MAX_LEVELS - 1);
+    if (ret != SGX_SUCCESS || segments == nullptr ||
+        !sgx_is_outside_enclave(
+            segments, (HASHTABLE_MAX_LEVELS - 1) * sizeof(Bucket *))) {
+      print_error("Could not allocate the segments of a lock table group");
+      return false;
+    }
+    __atomic_store_n(&untrusted->segments, (Bucket **)segments,
+                     __ATOMIC_RELEASE);
+  }
+  if (untrusted->segments[segment - 1] != nullptr) {
+    return true;
+  }
+
+  long numBuckets = segmentSize(segment);
+  void *buckets = nullptr;
+  sgx_status_t ret = allocate_buckets(&buckets, numBuckets);
+  if (ret != SGX_SUCCESS || buckets == nullptr ||
+      !sgx_is_outside_enclave(buckets, numBuckets * sizeof(Bucket))) {
+    print_error("Could not allocate a new segment of the lock table");
+    return false;
+  }
+  lockTableSplitHashes[group].resize(2 * numBuckets - 1);
+  __atomic_store_n(&untrusted->segments[segment - 1], (Bucket *)buckets,
+                   __ATOMIC_RELEASE);
+  return true;
+}
+
+/**
+ * Returns the integrity hash of a bucket of the lock table
+ *
+ * @param group the bucket group, i.e. hash() of the row ID
+ * @param bucket the index of the bucket within its group
+ */
+static auto locktable_integrity_hash(int group, int bucket)
+    -> sgx_sha256_hash_t *& {
+  if (bucket == 0) {
+    return lockTableIntegrityHashes[group];
+  }
+  return lockTableSplitHashes[group][bucket - 1];
+}
+
+/**
+ * Hands an entry that was removed from the lock table over to the janitor
+ * thread of the untrusted part, which frees the entry and its lock. If the
+ * ring of the worker thread is full, the entry is leaked instead of waiting
+ * for the janitor.
+ *
+ * @param threadId the worker thread that removed the entry
+ * @param entry the removed entry
+ */
+static void retire_locktable_entry(int threadId, Entry *entry) {
+  if (reclamationRings_ == nullptr) {
+    return;
+  }
+  ReclamationRing *ring = &reclamationRings_[threadId];
+  unsigned int tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+  unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  if (tail - head >= RECLAMATION_RING_SIZE) {
+    ring->dropped++;
+    return;
+  }
+  ring->entries[tail % RECLAMATION_RING_SIZE] = entry;
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
 }
 
 void enclave_send_job(void *data) {
@@ -42,16 +219,41 @@ void enclave_send_job(void *data) {
 
   switch (command) {
     case QUIT:
+      // A migrating partition is handed over first, as the former owner
+      // pushes into the ring of the new one until then
+      while (migrating_) {
+        cpuRelax();
+      }
+
       // Send exit message to all of the worker threads
       for (int i = 0; i < arg_enclave.num_threads; i++) {
         print_info("Sending QUIT to all threads");
 
-        sgx_thread_mutex_lock(&queue_mutex[i]);
-        queue[i].push(new_job);
-        sgx_thread_cond_signal(&job_cond[i]);
-        sgx_thread_mutex_unlock(&queue_mutex[i]);
+        enqueue_job(i, new_job);
+      }
+      break;
+
+    case TICK: {
+      // The time of the untrusted part must neither go back nor jump ahead,
+      // see leaseClock_
+      unsigned long now = leaseClock_;
+      unsigned long time =
+          std::min(((Job *)data)->time, now + kMaxTickAdvance);
+      if (time <= now || !leaseClock_.compare_exchange_strong(now, time)) {
+        break;
+      }
+
+      // Every worker thread advances the timing wheels of its partitions
+      new_job.time = time;
+      for (int i = 0; i < arg_enclave.num_threads; i++) {
+        enqueue_job(i, new_job);
       }
       break;
+    }
+
+    case BALANCE:
+      balance_partitions(((Job *)data)->time);
+      break;
 
     case SHARED:
     case EXCLUSIVE:
@@ -68,23 +270,31 @@ void enclave_send_job(void *data) {
       }
 
       // If transaction is not registered, abort the request
-      if (!contains(transactionTable_, new_job.transaction_id)) {
+      if (!is_registered(new_job.transaction_id)) {
         print_error("Need to register transaction before lock requests");
         if (new_job.wait_for_result) {
           *new_job.error = true;
-          *new_job.finished = true;
+          finish_job(new_job);
         }
         return;
       }
 
-      // Send the requests to specific worker thread
-      int thread_id =
-          (int)((new_job.row_id % lockTable_->size) /
-                ((float)lockTable_->size / (arg_enclave.num_threads - 1)));
-      sgx_thread_mutex_lock(&queue_mutex[thread_id]);
-      queue[thread_id].push(new_job);
-      sgx_thread_cond_signal(&job_cond[thread_id]);
-      sgx_thread_mutex_unlock(&queue_mutex[thread_id]);
+      // Send the requests to the worker thread that owns the partition of
+      // the row
+      send_to_partition(partition_of(new_job.row_id), new_job);
+      break;
+    }
+    case COMMIT:
+    case ABORT: {
+      // Copy job parameters
+      new_job.transaction_id = ((Job *)data)->transaction_id;
+      new_job.wait_for_result = ((Job *)data)->wait_for_result;
+
+      if (new_job.wait_for_result) {
+        new_job.finished = ((Job *)data)->finished;
+        new_job.error = ((Job *)data)->error;
+      }
+      send_release_parts(new_job);
       break;
     }
     case REGISTER: {
@@ -94,11 +304,10 @@ void enclave_send_job(void *data) {
       new_job.finished = ((Job *)data)->finished;
       new_job.error = ((Job *)data)->error;
 
-      // Send the requests to thread responsible for registering transactions
-      sgx_thread_mutex_lock(&queue_mutex[arg_enclave.tx_thread_id]);
-      queue[arg_enclave.tx_thread_id].push(new_job);
-      sgx_thread_cond_signal(&job_cond[arg_enclave.tx_thread_id]);
-      sgx_thread_mutex_unlock(&queue_mutex[arg_enclave.tx_thread_id]);
+      // Send the requests to the worker thread that owns the partition of the
+      // transaction table
+      int thread_id = transaction_partition_of(new_job.transaction_id);
+      enqueue_job(thread_id, new_job);
       break;
     }
     default:
@@ -107,6 +316,61 @@ void enclave_send_job(void *data) {
   }
 }
 
+void enclave_send_jobs(void *data, size_t num_jobs) {
+  Job *jobs = (Job *)data;
+  for (size_t i = 0; i < num_jobs; i++) {
+    enclave_send_job(&jobs[i]);
+  }
+}
+
+void send_release_parts(Job &job) {
+  // Later requests of the transaction do not find it anymore
+  Node<Transaction> *node = extract_transaction(job.transaction_id);
+  if (node == nullptr) {
+    print_error("Transaction was not registered");
+    if (job.wait_for_result) {
+      *job.error = true;
+      finish_job(job);
+    }
+    return;
+  }
+  Transaction *transaction = &node->value;
+  if (job.command == ABORT) {
+    transaction->aborted = true;
+  }
+  transaction->growing_phase = false;
+
+  ReleaseRequest *request = new ReleaseRequest();
+  request->job = job;
+  request->node = node;
+  request->rows.resize(arg_enclave.num_partitions);
+  for (int i = 0; i < transaction->num_locked; i++) {
+    int lockedRow = transaction->locked_rows[i];
+    request->rows[partition_of(lockedRow)].push_back(lockedRow);
+  }
+
+  std::vector<int> partitions;
+  for (int partition = 0; partition < arg_enclave.num_partitions;
+       partition++) {
+    if (!request->rows[partition].empty()) {
+      partitions.push_back(partition);
+    }
+  }
+  if (partitions.empty()) {
+    partitions.push_back(transaction_partition_of(job.transaction_id));
+  }
+
+  // All parts must be counted before the first one may finish
+  request->pending = partitions.size();
+  for (auto partition : partitions) {
+    Job part = job;
+    part.partition = partition;
+    part.release = request;
+
+    send_to_partition(partition, part);
+  }
+}
+
 void enclave_process_request() {
   sgx_thread_mutex_lock(&global_num_mutex);
 
@@ -118,200 +382,616 @@ void enclave_process_request() {
 
   sgx_thread_mutex_unlock(&global_num_mutex);
 
-  sgx_thread_mutex_lock(&queue_mutex[thread_id]);
+  Job jobs[kJobBatchSize];
 
   while (1) {
     print_info("Worker waiting for jobs");
-    if (queue[thread_id].size() == 0) {
-      sgx_thread_cond_wait(&job_cond[thread_id], &queue_mutex[thread_id]);
-      continue;
-    }
+    int numJobs = dequeue_jobs(thread_id, jobs);
 
-    auto log = ("Worker " + std::to_string(thread_id) + " got a job").c_str();
+    auto log = ("Worker " + std::to_string(thread_id) + " got " +
+                std::to_string(numJobs) + " jobs")
+                   .c_str();
     print_info(log);
-    Job cur_job = queue[thread_id].front();
-    Command command = cur_job.command;
-
-    sgx_thread_mutex_unlock(&queue_mutex[thread_id]);
-
-    switch (command) {
-      case QUIT:
-        sgx_thread_mutex_lock(&queue_mutex[thread_id]);
-        queue[thread_id].pop();
-        sgx_thread_mutex_unlock(&queue_mutex[thread_id]);
+    prefetch_locks(jobs, numJobs);
+    for (int i = 0; i < numJobs; i++) {
+      if (jobs[i].command == QUIT) {
         sgx_thread_mutex_destroy(&queue_mutex[thread_id]);
         sgx_thread_cond_destroy(&job_cond[thread_id]);
         sgx_ecc256_close_context(contexts[thread_id]);
+        destroyJobRing(&job_rings[thread_id]);
+        for (int partition = 0; partition < arg_enclave.num_partitions;
+             partition++) {
+          if (partitionOwner_[partition] == thread_id) {
+            destroyTimingWheel(&timingWheels_[partition]);
+          }
+        }
         print_info("Enclave worker quitting");
         return;
-      case SHARED:
-      case EXCLUSIVE: {
-        if (command == EXCLUSIVE) {
-          auto log =
-              ("(EXCLUSIVE) TXID: " + std::to_string(cur_job.transaction_id) +
-               ", RID: " + std::to_string(cur_job.row_id))
-                  .c_str();
-          print_info(log);
+      }
+      if (jobs[i].command == MIGRATE) {
+        hand_off_partition(thread_id, jobs[i]);
+        continue;
+      }
+      if (jobs[i].command == ADOPT) {
+        adopt_partition(thread_id, jobs[i]);
+        continue;
+      }
+      if (is_adopting(thread_id, jobs[i])) {
+        // The former owner still serves the jobs it got before the handoff
+        adoptedJobs_[thread_id].push_back(jobs[i]);
+        continue;
+      }
+      process_job(jobs[i], thread_id);
+      if (jobs[i].command != REGISTER && jobs[i].command != TICK) {
+        partitionJobs_[jobs[i].partition]--;
+        partitionServed_[jobs[i].partition]++;
+      }
+    }
+    finish_handoffs(thread_id);
+  }
+
+  return;
+}
+
+void enqueue_job(int thread_id, const Job &job) {
+  if (pushJob(&job_rings[thread_id], job)) {
+    sgx_thread_mutex_lock(&queue_mutex[thread_id]);
+    sgx_thread_cond_signal(&job_cond[thread_id]);
+    sgx_thread_mutex_unlock(&queue_mutex[thread_id]);
+  }
+}
+
+auto dequeue_jobs(int thread_id, Job *jobs) -> int {
+  JobRing *ring = &job_rings[thread_id];
+  int numJobs;
+  while ((numJobs = popJobs(ring, jobs, kJobBatchSize)) == 0) {
+    if (spinForJobs(ring)) {
+      continue;
+    }
+    // Jobs sent to the worker just before it handed over a partition may not
+    // be published yet
+    if (!handoffs_[thread_id].empty()) {
+      return 0;
+    }
+    sgx_thread_mutex_lock(&queue_mutex[thread_id]);
+    if (announceSleep(ring)) {
+      sgx_thread_cond_wait(&job_cond[thread_id], &queue_mutex[thread_id]);
+    }
+    cancelSleep(ring);
+    sgx_thread_mutex_unlock(&queue_mutex[thread_id]);
+  }
+  return numJobs;
+}
+
+void send_to_partition(int partition, Job &job) {
+  job.partition = partition;
+  partitionJobs_[partition]++;
+
+  // The owner may hand the partition over meanwhile. It only considers the
+  // partition drained once no thread is sending a job to it anymore, see
+  // finish_handoffs().
+  partitionSenders_[partition]++;
+  enqueue_job(partitionOwner_[partition], job);
+  partitionSenders_[partition]--;
+}
+
+void balance_partitions(unsigned long time) {
+  const int numWorkers = arg_enclave.num_threads;
+  const int numPartitions = arg_enclave.num_partitions;
+  std::vector<unsigned long> queued(numWorkers, 0);
+  std::vector<unsigned long> served(numWorkers, 0);
+  std::vector<int> owned(numWorkers, 0);
+  std::vector<unsigned long> load(numPartitions, 0);
+  for (int partition = 0; partition < numPartitions; partition++) {
+    int owner = partitionOwner_[partition];
+    unsigned long jobs = std::max(partitionJobs_[partition].load(), 0);
+    unsigned long total = partitionServed_[partition];
+    load[partition] = jobs + total - lastServed_[partition];
+    lastServed_[partition] = total;
+    queued[owner] += jobs;
+    served[owner] += load[partition] - jobs;
+    owned[owner]++;
+  }
+  unsigned long elapsed = time > lastBalance_ ? time - lastBalance_ : 0;
+  bool isFirstRound = lastBalance_ == 0;
+  lastBalance_ = time;
+  if (isFirstRound || elapsed == 0 || numWorkers == 1) {
+    return;
+  }
+
+  // A worker that still has queued jobs was busy all the time, so the jobs
+  // it served tell how long it takes for one
+  for (int worker = 0; worker < numWorkers; worker++) {
+    if (served[worker] == 0 || queued[worker] == 0) {
+      continue;
+    }
+    unsigned long serviceTime = elapsed * 1000000 / served[worker];
+    serviceTime_[worker] = serviceTime_[worker] == 0
+                               ? serviceTime
+                               : (serviceTime_[worker] + serviceTime) / 2;
+  }
+
+  int busiest = -1;
+  int idlest = -1;
+  std::vector<unsigned long> backlog(numWorkers);
+  for (int worker = 0; worker < numWorkers; worker++) {
+    backlog[worker] = queued[worker] * std::max(serviceTime_[worker], 1UL);
+    if (owned[worker] > 1 && queued[worker] >= kBalanceThreshold &&
+        (busiest == -1 || backlog[worker] > backlog[busiest])) {
+      busiest = worker;
+    }
+    if (idlest == -1 || backlog[worker] < backlog[idlest]) {
+      idlest = worker;
+    }
+  }
+  if (busiest == -1 || busiest == idlest ||
+      backlog[busiest] <= 2 * backlog[idlest]) {
+    return;
+  }
+
+  // Moving a partition with more than half of the load of the worker would
+  // only move the bottleneck
+  unsigned long workerLoad = queued[busiest] + served[busiest];
+  int partition = -1;
+  for (int i = 0; i < numPartitions; i++) {
+    if (partitionOwner_[i] == busiest && !adopting_[i] && load[i] > 0 &&
+        2 * load[i] <= workerLoad &&
+        (partition == -1 || load[i] > load[partition])) {
+      partition = i;
+    }
+  }
+  bool expected = false;
+  if (partition == -1 || !migrating_.compare_exchange_strong(expected, true)) {
+    return;
+  }
+
+  print_info(("Migrating partition " + std::to_string(partition) +
+              " from worker " + std::to_string(busiest) + " to worker " +
+              std::to_string(idlest))
+                 .c_str());
+  Job job;
+  job.command = MIGRATE;
+  job.partition = partition;
+  job.worker = idlest;
+  enqueue_job(busiest, job);
+}
+
+void hand_off_partition(int threadId, Job &job) {
+  int partition = job.partition;
+  if (partitionOwner_[partition] != threadId || adopting_[partition]) {
+    migrating_ = false;
+    return;
+  }
+
+  // The new owner keeps the jobs it gets for the partition from now on until
+  // this worker served the ones it got before
+  adopting_[partition] = true;
+  partitionOwner_[partition] = job.worker;
+  partitionMigrations_[partition]++;
+  handoffs_[threadId].push_back({partition, job.worker, false, 0});
+}
+
+void finish_handoffs(int threadId) {
+  JobRing *ring = &job_rings[threadId];
+  std::vector<Handoff> &pending = handoffs_[threadId];
+  for (auto handoff = pending.begin(); handoff != pending.end();) {
+    // Threads that start sending a job to the partition from now on see the
+    // new owner, so the jobs of the partition in the ring end before its tail
+    if (!handoff->isDrained && partitionSenders_[handoff->partition] == 0) {
+      handoff->isDrained = true;
+      handoff->lastJob = ring->tail.load();
+    }
+    if (!handoff->isDrained || ring->head < handoff->lastJob) {
+      handoff++;
+      continue;
+    }
+
+    Job adopt;
+    adopt.command = ADOPT;
+    adopt.partition = handoff->partition;
+    enqueue_job(handoff->worker, adopt);
+    handoff = pending.erase(handoff);
+  }
+}
+
+void adopt_partition(int threadId, Job &job) {
+  // A single partition migrates at a time, so all kept jobs belong to it
+  adopting_[job.partition] = false;
+  for (auto &adopted : adoptedJobs_[threadId]) {
+    process_job(adopted, threadId);
+    partitionJobs_[adopted.partition]--;
+    partitionServed_[adopted.partition]++;
+  }
+  adoptedJobs_[threadId].clear();
+  migrating_ = false;
+}
+
+auto is_adopting(int threadId, const Job &job) -> bool {
+  // The former owner still sees the flag while it serves the last jobs of the
+  // partition, but does not own it anymore
+  return job.command != REGISTER && job.command != TICK &&
+         adopting_[job.partition] &&
+         partitionOwner_[job.partition] == threadId;
+}
+
+void prefetch_locks(Job *jobs, int numJobs) {
+  // The former owner of a migrating partition may still change its buckets
+  int rowIds[kJobBatchSize];
+  int numRows = 0;
+  for (int i = 0; i < numJobs; i++) {
+    if ((jobs[i].command == SHARED || jobs[i].command == EXCLUSIVE ||
+         jobs[i].command == UNLOCK) &&
+        !adopting_[jobs[i].partition]) {
+      rowIds[numRows++] = jobs[i].row_id;
+    }
+  }
+  if (numRows > 1) {
+    Lock *locks[kJobBatchSize];
+    getMany(lockTable_, rowIds, numRows, locks);
+  }
+}
+
+void process_job(Job &cur_job, int threadId) {
+  Command command = cur_job.command;
+  switch (command) {
+    case SHARED:
+    case EXCLUSIVE: {
+      if (command == EXCLUSIVE) {
+        auto log =
+            ("(EXCLUSIVE) TXID: " + std::to_string(cur_job.transaction_id) +
+             ", RID: " + std::to_string(cur_job.row_id))
+                .c_str();
+        print_info(log);
+      } else {
+        auto log =
+            ("(SHARED) TXID: " + std::to_string(cur_job.transaction_id) +
+             ", RID: " + std::to_string(cur_job.row_id))
+                .c_str();
+        print_info(log);
+      }
+
+      // Acquire lock and receive signature
+      sgx_ec256_signature_t sig;
+      unsigned long expiry = get_block_timeout();
+      bool ok =
+          acquire_lock((void *)&sig, cur_job.transaction_id, cur_job.row_id,
+                       command == EXCLUSIVE, threadId, expiry);
+      if (cur_job.wait_for_result) {
+        if (!ok) {
+          *cur_job.error = true;
         } else {
-          auto log =
-              ("(SHARED) TXID: " + std::to_string(cur_job.transaction_id) +
-               ", RID: " + std::to_string(cur_job.row_id))
-                  .c_str();
-          print_info(log);
-        }
+          // Write base64 encoded signature, followed by the block timeout it
+          // was signed with, into the return value of the job struct
+          std::string encoded_signature =
+              base64_encode((unsigned char *)sig.x, sizeof(sig.x)) + "-" +
+              base64_encode((unsigned char *)sig.y, sizeof(sig.y)) + "_" +
+              std::to_string(expiry);
 
-        // Acquire lock and receive signature
-        sgx_ec256_signature_t sig;
-        bool ok = acquire_lock((void *)&sig, cur_job.transaction_id,
-                               cur_job.row_id, command == EXCLUSIVE, thread_id);
-        if (cur_job.wait_for_result) {
-          if (!ok) {
-            *cur_job.error = true;
-          } else {
-            // Write base64 encoded signature into the return value of the job
-            // struct
-            std::string encoded_signature =
-                base64_encode((unsigned char *)sig.x, sizeof(sig.x)) + "-" +
-                base64_encode((unsigned char *)sig.y, sizeof(sig.y));
-
-            volatile char *p = cur_job.return_value;
-            size_t signature_size = 89;
-            for (int i = 0; i < signature_size; i++) {
-              *p++ = encoded_signature.c_str()[i];
-            }
+          volatile char *p = cur_job.return_value;
+          size_t signature_size = std::min(encoded_signature.length(),
+                                           (size_t)RETURN_VALUE_SIZE - 1);
+          for (int i = 0; i < signature_size; i++) {
+            *p++ = encoded_signature.c_str()[i];
           }
-          *cur_job.finished = true;
+          *p = '\0';
         }
-        break;
+        finish_job(cur_job);
       }
-      case UNLOCK: {
-        auto log = ("(UNLOCK) TXID: " + std::to_string(cur_job.transaction_id) +
-                    ", RID: " + std::to_string(cur_job.row_id))
-                       .c_str();
-        print_info(log);
-        release_lock(cur_job.transaction_id, cur_job.row_id);
-        if (cur_job.wait_for_result) {
-          *cur_job.finished = true;
-        }
-        break;
+      break;
+    }
+    case UNLOCK: {
+      auto log = ("(UNLOCK) TXID: " + std::to_string(cur_job.transaction_id) +
+                  ", RID: " + std::to_string(cur_job.row_id))
+                     .c_str();
+      print_info(log);
+      release_lock(cur_job.transaction_id, cur_job.row_id, threadId);
+      if (cur_job.wait_for_result) {
+        finish_job(cur_job);
       }
-      case REGISTER: {
-        auto transactionId = cur_job.transaction_id;
-        auto lockBudget = cur_job.lock_budget;
+      break;
+    }
+    case COMMIT:
+    case ABORT: {
+      auto log =
+          (std::string(command == COMMIT ? "(COMMIT)" : "(ABORT)") +
+           " TXID: " + std::to_string(cur_job.transaction_id) +
+           ", PARTITION: " + std::to_string(cur_job.partition))
+              .c_str();
+      print_info(log);
+      release_part(cur_job, threadId);
+      finish_release_part(cur_job);
+      break;
+    }
+    case TICK:
+      expire_leases(cur_job.time, threadId);
+      break;
+    case REGISTER: {
+      auto transactionId = cur_job.transaction_id;
+      auto lockBudget = cur_job.lock_budget;
 
-        auto log = ("Registering transaction " + std::to_string(transactionId))
-                       .c_str();
-        // print_debug(log);
+      auto log = ("Registering transaction " + std::to_string(transactionId))
+                     .c_str();
+      // print_debug(log);
 
-        if (contains(transactionTable_, transactionId)) {
-          print_error("Transaction is already registered");
-          *cur_job.error = true;
-        } else {
-          set(transactionTable_, transactionId,
-              (void *)newTransaction(transactionId, lockBudget));
-        }
-        *cur_job.finished = true;
-        break;
+      if (!register_transaction(transactionId, lockBudget)) {
+        print_error("Transaction is already registered");
+        *cur_job.error = true;
       }
-      default:
-        print_error("Worker received unknown command");
+      finish_job(cur_job);
+      break;
     }
+    default:
+      print_error("Worker received unknown command");
+  }
+}
 
-    sgx_thread_mutex_lock(&queue_mutex[thread_id]);
-    queue[thread_id].pop();
+auto partition_of(unsigned int rowId) -> int {
+  return (int)(hash(lockTable_->size, rowId) /
+               ((float)lockTable_->size / arg_enclave.num_partitions));
+}
+
+auto transaction_partition_of(unsigned int transactionId) -> int {
+  return (int)(hash(transactionTable_->size, transactionId) /
+               ((float)transactionTable_->size / arg_enclave.num_threads));
+}
+
+auto register_transaction(unsigned int transactionId, int lockBudget)
+    -> bool {
+  // The bucket groups of a partition only grow under its mutex, so
+  // registrations in different partitions do not contend
+  int partition = transaction_partition_of(transactionId);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  bool isNew = !contains(transactionTable_, transactionId);
+  if (isNew) {
+    initTransaction(insert(transactionTable_, transactionId), transactionId,
+                    lockBudget);
   }
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  return isNew;
+}
 
-  return;
+auto is_registered(unsigned int transactionId) -> bool {
+  int partition = transaction_partition_of(transactionId);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  bool registered = contains(transactionTable_, transactionId);
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  return registered;
+}
+
+auto pin_transaction(unsigned int transactionId) -> Node<Transaction> * {
+  int partition = transaction_partition_of(transactionId);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  Entry *entry = findEntry(transactionTable_, transactionId);
+  Node<Transaction> *node =
+      entry == nullptr ? nullptr : nodeOf<Transaction>(entry);
+  if (node != nullptr) {
+    node->value.pins++;
+  }
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  return node;
+}
+
+void unpin_transaction(Node<Transaction> *node) {
+  int partition = transaction_partition_of(node->value.transaction_id);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  bool isLast = --node->value.pins == 0 && node->value.detached;
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  if (isLast) {
+    destroyTransaction(&node->value);
+    poolDelete(node);
+  }
+}
+
+void delete_transaction(Node<Transaction> *node) {
+  int partition = transaction_partition_of(node->value.transaction_id);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  bool isPinned = node->value.pins > 0;
+  node->value.detached = true;
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  if (!isPinned) {
+    destroyTransaction(&node->value);
+    poolDelete(node);
+  }
+}
+
+void remove_if_idle(unsigned int transactionId) {
+  int partition = transaction_partition_of(transactionId);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  Node<Transaction> *node = nullptr;
+  Transaction *transaction = get(transactionTable_, transactionId);
+  if (transaction != nullptr && transaction->num_locked == 0) {
+    node = extract(transactionTable_, transactionId);
+  }
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  if (node != nullptr) {
+    delete_transaction(node);
+  }
+}
+
+auto extract_transaction(unsigned int transactionId) -> Node<Transaction> * {
+  int partition = transaction_partition_of(transactionId);
+  sgx_thread_mutex_lock(&transaction_table_mutex[partition]);
+  Node<Transaction> *node = extract(transactionTable_, transactionId);
+  sgx_thread_mutex_unlock(&transaction_table_mutex[partition]);
+  return node;
 }
 
 auto acquire_lock(void *signature, int transactionId, int rowId,
-                  bool isExclusive, int threadId) -> bool {
+                  bool isExclusive, int threadId, unsigned long expiry)
+    -> bool {
   bool ok;
 
   // Get the transaction for the given transaction ID
-  auto transaction = (Transaction *)get(transactionTable_, transactionId);
+  Node<Transaction> *node = pin_transaction(transactionId);
 
-  if (transaction == nullptr) {
+  if (node == nullptr) {
     print_error("Transaction was not registered");
     return false;
   }
+  Transaction *transaction = &node->value;
 
   if (transaction->lock_budget < 1) {
     print_error("Lock budget is exhausted");
+    unpin_transaction(node);
+    return false;
+  }
+
+  // The untrusted part just added the row, so grow its bucket group first
+  int group = hash(lockTable_->size, rowId);
+  if (!split_locktable_buckets(group)) {
+    unpin_transaction(node);
     return false;
   }
 
   // Get the lock object for the given row ID
-  auto lockUntrusted = (Lock *)get(lockTable_, rowId);
+  Lock *lockUntrusted = get(lockTable_, rowId);
 
-  auto [bucket, numEntries] = getBucket(lockTable_, rowId);
+  int bucketIndex = bucketOf(lockTable_->size, &lockTableGroups[group], rowId);
+  auto [bucket, numEntries] = getBucket(lockTable_, group, bucketIndex);
+  sgx_sha256_hash_t *&stored_hash =
+      locktable_integrity_hash(group, bucketIndex);
 
   uint32_t *serialized = locktable_bucket_to_uint32_t(bucket, numEntries);
+  if (serialized == nullptr) {
+    print_error("Integrity verification of lock bucket failed: Invalid lock");
+    unpin_transaction(node);
+    return false;
+  }
   if (numEntries == 1 &&
       serialized[2] == 0) {  // only one empty lock with no owners
     // note: untrusted part adds empty lock because we cannot allocate memory in
     // untrusted part from within the enclave
-    if (lockTableIntegrityHashes[hash(lockTable_->size, rowId)] != nullptr) {
+    if (stored_hash != nullptr) {
       print_error(
           "Integrity verification of lock bucket failed: Bucket should be "
           "empty");
+      unpin_transaction(node);
       return false;
     }
   } else {
-    // skip the uninitialized lock struct at the beginning
-    sgx_sha256_hash_t *stored_hash =
-        lockTableIntegrityHashes[hash(lockTable_->size, rowId)];
-
-    int entriesToHash = numEntries;
-    // Is the last entry an empty lock and should be ignored in the hash?
-    if (serialized[(numEntries - 1) * sizeOfSerializedLockEntry + 2] == 0) {
-      entriesToHash = numEntries - 1;
-    }
+    // skip the uninitialized lock struct at the end
+    int entriesToHash = entries_to_hash(serialized, numEntries);
     if (!verify_against_stored_hash(serialized, entriesToHash, stored_hash)) {
       print_error(
           "Integrity verification of lock bucket failed: Hashes are not equal");
+      unpin_transaction(node);
       return false;
     }
   }
 
-  // Update stored hash
-  add_lock_trusted(transaction, rowId, isExclusive, serialized);
-  update_integrity_hash_locktable(serialized, hash(lockTable_->size, rowId),
-                                  numEntries, lockTableIntegrityHashes);
+  // Update stored hash. A shared owner that asks for exclusive access upgrades
+  // its lock, which only succeeds while it is the only owner.
+  bool isUpgrade = isExclusive && hasLock(transaction, rowId);
+  if (!add_lock_trusted(transaction, rowId, isExclusive, serialized,
+                        numEntries)) {
+    print_error("Lock is held in a conflicting mode");
+    unpin_transaction(node);
+    return false;
+  }
+  update_integrity_hash_locktable(serialized, numEntries, stored_hash);
 
   // Repeat operation in untrusted part
-  addLock(transaction, rowId, isExclusive, lockUntrusted);
+  if (isUpgrade) {
+    upgrade(lockUntrusted, transactionId);
+  } else {
+    addLock(transaction, rowId, isExclusive, lockUntrusted,
+            &ownerArenas_[partition_of(rowId)]);
+  }
+  grant_lease(transaction, rowId, expiry);
 
   // Sign the lock
   std::string string_to_sign =
-      lock_to_string(transactionId, rowId, isExclusive);
+      lock_to_string(transactionId, rowId, isExclusive, expiry);
 
   sgx_ecdsa_sign((uint8_t *)string_to_sign.c_str(),
                  strnlen(string_to_sign.c_str(), MAX_SIGNATURE_LENGTH),
                  &ec256_private_key, (sgx_ec256_signature_t *)signature,
                  contexts[threadId]);
 
+  unpin_transaction(node);
+  return true;
+}
+
+auto split_locktable_buckets(int group) -> bool {
+  BucketGroup *state = &lockTableGroups[group];
+
+  // Only the number of entries is taken from untrusted memory. Tampering with
+  // it can merely cause too few or too many splits, which are verified anyway.
+  state->count = lockTable_->groups[group].count;
+
+  for (int i = 0; i < kSplitsPerOperation && needsSplit(state); i++) {
+    int from = state->split;
+    int to = state->split + (1 << state->level);
+    if (!allocate_locktable_segment(group, segmentOf(to))) {
+      return false;
+    }
+
+    auto [bucket, numEntries] = getBucket(lockTable_, group, from);
+    uint32_t *serialized = locktable_bucket_to_uint32_t(bucket, numEntries);
+    if (serialized == nullptr ||
+        !verify_against_stored_hash(serialized,
+                                    entries_to_hash(serialized, numEntries),
+                                    locktable_integrity_hash(group, from))) {
+      print_error("Integrity verification of lock bucket failed during split");
+      return false;
+    }
+
+    splitBucketGroup(lockTable_, group, state);
+
+    // Both buckets only contain entries of the verified bucket
+    for (int index : {from, to}) {
+      auto [bucket, numEntries] = getBucket(lockTable_, group, index);
+      uint32_t *serialized = locktable_bucket_to_uint32_t(bucket, numEntries);
+      if (serialized == nullptr) {
+        print_error("Lock bucket was altered during split");
+        return false;
+      }
+      update_integrity_hash_locktable(serialized,
+                                      entries_to_hash(serialized, numEntries),
+                                      locktable_integrity_hash(group, index));
+    }
+  }
   return true;
 }
 
-void release_lock(int transactionId, int rowId) {
-  auto transaction = (Transaction *)get(transactionTable_, transactionId);
+void release_lock(int transactionId, int rowId, int threadId) {
+  Node<Transaction> *node = pin_transaction(transactionId);
+  if (node == nullptr) {
+    return;
+  }
+  Transaction *transaction = &node->value;
 
-  if (transaction == nullptr) {
+  if (!release_verified(transaction, rowId)) {
+    unpin_transaction(node);
     return;
   }
+  cancel_lease(transaction, rowId);
 
-  // Get the lock object for the given row ID
-  auto lockUntrusted = (Lock *)get(lockTable_, rowId);
+  // Repeat operation in untrusted memory
+  Node<Lock> *removed = releaseLock(transaction, rowId, lockTable_,
+                                    &ownerArenas_[partition_of(rowId)]);
+  if (removed != nullptr) {
+    retire_locktable_entry(threadId, &removed->entry);
+  }
+  unpin_transaction(node);
+
+  // If the transaction released its last lock,
+  // delete it
+  remove_if_idle(transactionId);
+}
 
-  auto [bucket, numEntries] = getBucket(lockTable_, rowId);
+auto release_verified(Transaction *transaction, int rowId) -> bool {
+  int group = hash(lockTable_->size, rowId);
+  int bucketIndex = bucketOf(lockTable_->size, &lockTableGroups[group], rowId);
+  auto [bucket, numEntries] = getBucket(lockTable_, group, bucketIndex);
   uint32_t *serialized = locktable_bucket_to_uint32_t(bucket, numEntries);
-  sgx_sha256_hash_t *stored_hash =
-      lockTableIntegrityHashes[hash(lockTable_->size, rowId)];
+  sgx_sha256_hash_t *&stored_hash =
+      locktable_integrity_hash(group, bucketIndex);
 
-  if (!verify_against_stored_hash(serialized, numEntries, stored_hash)) {
+  if (serialized == nullptr ||
+      !verify_against_stored_hash(serialized, numEntries, stored_hash)) {
     print_error("Integrity verification of lock bucket failed during UNLOCK");
-    return;
+    return false;
   }
 
   // Update stored hash
@@ -320,15 +1000,122 @@ void release_lock(int transactionId, int rowId) {
   if (entryWasDeleted) {
     numEntries--;
   }
-  update_integrity_hash_locktable(serialized, hash(lockTable_->size, rowId),
-                                  numEntries, lockTableIntegrityHashes);
+  update_integrity_hash_locktable(serialized, numEntries, stored_hash);
+  return true;
+}
 
-  // Repeat operation in untrusted memory
-  releaseLock(transaction, rowId, lockTable_);
+void release_part(Job &job, int threadId) {
+  ReleaseRequest *request = (ReleaseRequest *)job.release;
+  Transaction *transaction = &request->node->value;
+  for (auto lockedRow : request->rows[job.partition]) {
+    // The transaction is freed by the last part, even if a bucket cannot be
+    // verified
+    cancel_lease(transaction, lockedRow);
+    if (!release_verified(transaction, lockedRow)) {
+      continue;
+    }
 
-  // If the transaction released its last lock,
-  // delete it
-  if (transaction->num_locked == 0) {
-    remove(transactionTable_, transactionId);
+    // Repeat operation in untrusted memory
+    Lock *lockUntrusted = get(lockTable_, lockedRow);
+    if (lockUntrusted == nullptr) {
+      continue;
+    }
+    release(lockUntrusted, job.transaction_id, &ownerArenas_[job.partition]);
+    if (numOwners(lockUntrusted) == 0) {
+      retire_locktable_entry(threadId,
+                             &extract(lockTable_, lockedRow)->entry);
+    }
+  }
+}
+
+void finish_release_part(Job &job) {
+  ReleaseRequest *request = (ReleaseRequest *)job.release;
+  if (--request->pending > 0) {
+    return;
+  }
+
+  delete_transaction(request->node);
+  if (request->job.wait_for_result) {
+    finish_job(request->job);
+  }
+  delete request;
+}
+
+void grant_lease(Transaction *transaction, int rowId, unsigned long expiry) {
+  if (expiry == 0) {
+    return;
+  }
+  int position = findRow(&transaction->locked_rows_index,
+                         transaction->locked_rows, rowId);
+  if (position < 0) {
+    return;
+  }
+
+  // The expiry is rounded up to the next tick, so that the lock is never
+  // released before its signature expires
+  TimingWheel *wheel = &timingWheels_[partition_of(rowId)];
+  cancelLease(wheel, transaction->leases[position]);
+  transaction->leases[position] =
+      addLease(wheel, transaction->transaction_id, rowId,
+               (expiry + kLeaseResolution - 1) / kLeaseResolution);
+}
+
+void cancel_lease(Transaction *transaction, int rowId) {
+  int position = findRow(&transaction->locked_rows_index,
+                         transaction->locked_rows, rowId);
+  if (position < 0) {
+    return;
+  }
+  cancelLease(&timingWheels_[partition_of(rowId)],
+              transaction->leases[position]);
+  transaction->leases[position] = nullptr;
+}
+
+void expire_leases(unsigned long time, int threadId) {
+  for (int partition = 0; partition < arg_enclave.num_partitions;
+       partition++) {
+    // The former owner of a migrating partition may still change its locks
+    if (partitionOwner_[partition] != threadId || adopting_[partition]) {
+      continue;
+    }
+    Lease *lease = advanceTimingWheel(&timingWheels_[partition],
+                                      time / kLeaseResolution);
+    while (lease != nullptr) {
+      Lease *next = lease->next;
+
+      // If the transaction is not found or does not hold the lease anymore,
+      // it was removed by COMMIT or ABORT, whose part for this partition
+      // frees the lease
+      Node<Transaction> *node = pin_transaction(lease->transaction_id);
+      if (node != nullptr) {
+        Transaction *transaction = &node->value;
+        int position = findRow(&transaction->locked_rows_index,
+                               transaction->locked_rows, lease->row_id);
+        bool isHeld = position >= 0 && transaction->leases[position] == lease;
+        unpin_transaction(node);
+        if (isHeld) {
+          std::string log = "Lease expired, TXID: " +
+                            std::to_string(lease->transaction_id) +
+                            ", RID: " + std::to_string(lease->row_id);
+          print_warn(log.c_str());
+          release_lock(lease->transaction_id, lease->row_id, threadId);
+        }
+      }
+      lease = next;
+    }
   }
-}
\ No newline at end of file
+}
+
+void get_pool_statistics(PoolStatistics *statistics) {
+  *statistics = poolStatistics();
+}
+
+void get_partition_statistics(PartitionStatistics *statistics,
+                              size_t num_partitions) {
+  size_t size = std::min(num_partitions, (size_t)arg_enclave.num_partitions);
+  for (size_t i = 0; i < size; i++) {
+    statistics[i] = {partitionOwner_[i],
+                     (unsigned long)std::max(partitionJobs_[i].load(), 0),
+                     partitionServed_[i], partitionMigrations_[i]};
+  }
+}
@@ -1,11 +1,50 @@
 #include "integrity_verification.h"
 
-const int maxEntriesPerLocktableBucket = 70;
-int sizeOfSerializedLockEntry =
-    3 +  // lock.key, lock.exclusive, lock.num_owners (compare lock struct)
-    kTransactionBudget;  // owners of the lock can be at most kTransactionBudget
-const int serializedLockBucketSize = 70 * sizeOfSerializedLockEntry;
-uint32_t *serializedLockBucket = new uint32_t[serializedLockBucketSize];
+/**
+ * Number of words in front of the owners of a serialized lock entry: the key,
+ * isHeldExclusively() and numOwners() of the lock. The owners follow, so each
+ * entry is prefixed with its length.
+ */
+const int kSerializedLockHeaderSize = 3;
+
+// Serialized bucket of the worker thread, which grows with the buckets
+thread_local uint32_t *serializedLockBucket = nullptr;
+thread_local int serializedLockBucketSize = 0;  // capacity in words
+
+/**
+ * Returns the number of words of the serialized lock entry
+ */
+static auto serialized_entry_size(uint32_t *entry) -> int {
+  return kSerializedLockHeaderSize + entry[2];
+}
+
+/**
+ * Returns the number of words of the first numEntries entries of a serialized
+ * bucket
+ */
+static auto serialized_size(uint32_t *bucket, int numEntries) -> int {
+  int size = 0;
+  for (int i = 0; i < numEntries; i++) {
+    size += serialized_entry_size(bucket + size);
+  }
+  return size;
+}
+
+/**
+ * Returns the start of the serialized entry of the given row, or -1 if the
+ * bucket has none
+ */
+static auto find_serialized_entry(uint32_t *bucket, int numEntries, int rowId)
+    -> int {
+  int i = 0;  // start index of the serialized lock entry
+  for (int entry = 0; entry < numEntries; entry++) {
+    if (bucket[i] == rowId) {
+      return i;
+    }
+    i += serialized_entry_size(bucket + i);
+  }
+  return -1;
+}
 
 auto hash_locktable_bucket(uint32_t *bucket, int numEntries)
     -> sgx_sha256_hash_t * {
@@ -14,23 +53,30 @@ auto hash_locktable_bucket(uint32_t *bucket, int numEntries)
   }
   sgx_sha256_hash_t *p_hash =
       (sgx_sha256_hash_t *)malloc(sizeof(sgx_sha256_hash_t));
-  // because the bucket contains "numEntries" entries of size
-  // "sizeOfSerializedLockEntry", but is of type uint32_t, which is 4x the size
-  // of uint8_t
-  uint32_t src_len = numEntries * sizeOfSerializedLockEntry * 4;
+  // because the bucket contains "numEntries" entries of variable size, but is
+  // of type uint32_t, which is 4x the size of uint8_t
+  uint32_t src_len = serialized_size(bucket, numEntries) * 4;
   sgx_status_t ret = sgx_sha256_msg((uint8_t *)bucket, src_len, p_hash);
   return p_hash;
 }
 
-void update_integrity_hash_locktable(
-    uint32_t *bucket, int key, int numEntries,
-    std::vector<sgx_sha256_hash_t *> &lockTableIntegrityHashes) {
-  free(lockTableIntegrityHashes[key]);
-  lockTableIntegrityHashes[key] = hash_locktable_bucket(bucket, numEntries);
+void update_integrity_hash_locktable(uint32_t *bucket, int numEntries,
+                                     sgx_sha256_hash_t *&storedHash) {
+  free(storedHash);
+  storedHash = hash_locktable_bucket(bucket, numEntries);
+}
+
+auto entries_to_hash(uint32_t *serialized, int numEntries) -> int {
+  // Is the last entry an empty lock and should be ignored in the hash?
+  if (numEntries > 0 &&
+      serialized[serialized_size(serialized, numEntries - 1) + 2] == 0) {
+    return numEntries - 1;
+  }
+  return numEntries;
 }
 
 void transactiontable_entry_to_uint8_t(Entry *&entry, uint8_t *&result) {
-  Transaction *transaction = (Transaction *)(entry->value);
+  Transaction *transaction = &nodeOf<Transaction>(entry)->value;
   int num_locked = transaction->num_locked;
 
   // Get the entry key and every member of the transaction struct
@@ -42,11 +88,25 @@ void transactiontable_entry_to_uint8_t(Entry *&entry, uint8_t *&result) {
   result[5] = transaction->locked_rows_size;
   result[6] = num_locked;
 
+  // The index of the locked rows is hashed too, because hasLock() trusts it
   if (num_locked > 0) {
     sgx_sha256_hash_t *p_hash =
         (sgx_sha256_hash_t *)malloc(sizeof(sgx_sha256_hash_t));
-    sgx_status_t ret = sgx_sha256_msg((uint8_t *)transaction->locked_rows,
-                                      sizeof(int) * num_locked, p_hash);
+    RowIndex *index = &transaction->locked_rows_index;
+    sgx_sha_state_handle_t state = nullptr;
+    sgx_status_t ret = sgx_sha256_init(&state);
+    if (ret == SGX_SUCCESS) {
+      ret = sgx_sha256_update((uint8_t *)transaction->locked_rows,
+                              sizeof(int) * num_locked, state);
+    }
+    if (ret == SGX_SUCCESS) {
+      ret = sgx_sha256_update((uint8_t *)index->slots,
+                              sizeof(int) * index->num_slots, state);
+    }
+    if (ret == SGX_SUCCESS) {
+      ret = sgx_sha256_get_hash(state, p_hash);
+    }
+    sgx_sha256_close(state);
     if (ret != SGX_SUCCESS) {
       print_error("Error when serializing transaction");
     }
@@ -67,98 +127,122 @@ auto locktable_bucket_to_uint32_t(Entry *&bucket, int numEntries)
   Entry *entry = bucket;
   Lock *lock;
   int num_owners;
+  int size = 0;  // words of the serialized bucket so far
 
   for (int i = 0; i < numEntries; i++) {
-    lock = (Lock *)(entry->value);
-    num_owners = lock->num_owners;
-    serializedLockBucket[i * sizeOfSerializedLockEntry] = entry->key;
-    serializedLockBucket[i * sizeOfSerializedLockEntry + 1] = lock->exclusive;
-    serializedLockBucket[i * sizeOfSerializedLockEntry + 2] = num_owners;
-    for (int j = 0; j < kTransactionBudget; j++) {
-      if (j < num_owners)
-        serializedLockBucket[i * sizeOfSerializedLockEntry + 3 + j] =
-            lock->owners[j];
-      else
-        serializedLockBucket[i * sizeOfSerializedLockEntry + 3 + j] = 0;
+    lock = &nodeOf<Lock>(entry)->value;
+    num_owners = numOwners(lock);
+    int *overflow = lock->overflow;
+    if (num_owners > kMaxOwners ||
+        (num_owners > kInlineOwners &&
+         (overflow == nullptr ||
+          !sgx_is_outside_enclave(
+              overflow, sizeof(int) * (num_owners - kInlineOwners))))) {
+      return nullptr;  // the lock was tampered with
+    }
+
+    // Leave room for one more owner, which add_lock_trusted() may add
+    int required = size + kSerializedLockHeaderSize + num_owners + 1;
+    if (required > serializedLockBucketSize) {
+      int capacity = 2 * required;
+      uint32_t *grown = new uint32_t[capacity];
+      if (serializedLockBucket != nullptr) {
+        memcpy(grown, serializedLockBucket, sizeof(uint32_t) * size);
+        delete[] serializedLockBucket;
+      }
+      serializedLockBucket = grown;
+      serializedLockBucketSize = capacity;
     }
 
+    serializedLockBucket[size] = entry->key;
+    serializedLockBucket[size + 1] = isHeldExclusively(lock);
+    serializedLockBucket[size + 2] = num_owners;
+    for (int j = 0; j < num_owners; j++) {
+      serializedLockBucket[size + kSerializedLockHeaderSize + j] =
+          j < kInlineOwners ? lock->owners[j] : overflow[j - kInlineOwners];
+    }
+    size += kSerializedLockHeaderSize + num_owners;
+
     entry = entry->next;
   }
 
+  if (serializedLockBucket == nullptr) {
+    serializedLockBucket = new uint32_t[kSerializedLockHeaderSize + 1];
+    serializedLockBucketSize = kSerializedLockHeaderSize + 1;
+  }
   return serializedLockBucket;
 }
 
 auto add_lock_trusted(Transaction *transaction, int rowId, bool isExclusive,
-                      uint32_t *bucket) -> bool {
+                      uint32_t *bucket, int numEntries) -> bool {
   if (transaction->aborted) {
     return false;
   }
 
-  bool ret;
-
   // Find the lock inside the serialized bucket
-  int i = 0;  // start index of the serialized lock entry
-  while (bucket[i] != rowId &&
-         i < serializedLockBucketSize - sizeOfSerializedLockEntry) {
-    // RID of the lock is at the beginning of each serialized lock entry
-    i += sizeOfSerializedLockEntry;
+  int i = find_serialized_entry(bucket, numEntries, rowId);
+  if (i < 0) {
+    return false;
   }
+  int numOwners = bucket[i + 2];
+  bool lockExclusive = bucket[i + 1];
 
-  //  Get exclusive access on the lock
+  // Mirror getSharedAccess(), getExclusiveAccess() and upgrade() on the
+  // serialized lock
   if (isExclusive) {
-    int numOwners = bucket[i + 2];
-    if (numOwners == 0) {
-      bucket[i + 1] = true;                         // set lock exclusive
-      bucket[i + 2] = 1;                            // set num_owners
-      bucket[i + 3] = transaction->transaction_id;  // set owner
-      ret = true;
-    } else {
-      ret = false;
-    }
-    //  Get shared access on the lock
+    if (numOwners == 1 && bucket[i + kSerializedLockHeaderSize] ==
+                              transaction->transaction_id) {
+      bucket[i + 1] = true;  // the only owner upgrades its lock
+      return true;
+    }
+    if (numOwners != 0) {
+      return false;
+    }
   } else {
-    bool lockExclusive = bucket[i + 1];
-    if (!lockExclusive) {
-      bucket[i + 2]++;  // increment num_owners
-      int numOwners = bucket[i + 2];
-      bucket[i + 2 + numOwners] = transaction->transaction_id;  // set new owner
-      ret = true;
-    } else {
-      ret = false;
+    if (lockExclusive) {
+      return false;
+    }
+    for (int j = 0; j < numOwners; j++) {
+      if (bucket[i + kSerializedLockHeaderSize + j] ==
+          transaction->transaction_id) {
+        return true;  // already an owner
+      }
+    }
+    if (numOwners >= kMaxOwners) {
+      return false;
     }
   }
 
-  return ret;
+  // Make room for the new owner behind the existing ones. The serialized
+  // bucket always has room for one more word.
+  int end = i + kSerializedLockHeaderSize + numOwners;
+  int size = serialized_size(bucket, numEntries);
+  memmove(bucket + end + 1, bucket + end, sizeof(uint32_t) * (size - end));
+  bucket[end] = transaction->transaction_id;  // set new owner
+  bucket[i + 1] = isExclusive;                // set lock exclusive
+  bucket[i + 2] = numOwners + 1;              // increment num_owners
+  return true;
 }
 
 auto release_lock_trusted(Transaction *transaction, int rowId, uint32_t *bucket,
                           int numEntries) -> bool {
-  bool wasOwner = false;
-  for (int i = 0; i < transaction->num_locked; i++) {
-    if (transaction->locked_rows[i] == rowId) {
-      wasOwner = true;
-      break;
-    }
-  }
-
-  if (wasOwner) {
+  if (hasLock(transaction, rowId)) {
     int transactionId = transaction->transaction_id;
     // Find the lock inside the serialized bucket
-    int i = 0;  // start index of the serialized lock entry
-    while (bucket[i] != rowId &&
-           i < serializedLockBucketSize - sizeOfSerializedLockEntry) {
-      // RID of the lock is at the beginning of each serialized lock entry
-      i += sizeOfSerializedLockEntry;
+    int i = find_serialized_entry(bucket, numEntries, rowId);
+    if (i < 0) {
+      return false;
     }
 
+    int size = serialized_size(bucket, numEntries);
     int numOwners = bucket[i + 2];
     for (int j = 0; j < numOwners; j++) {
-      if (bucket[i + 3 + j] == transactionId) {
+      int owner = i + kSerializedLockHeaderSize + j;
+      if (bucket[owner] == transactionId) {
         // Lock is owned by the given transaction
-        for (int k = j; k < numOwners - 1; k++) {
-          bucket[i + 3 + k] = bucket[i + 3 + k + 1];
-        }
-        bucket[i + 3 + numOwners - 1] = 0;
+        memmove(bucket + owner, bucket + owner + 1,
+                sizeof(uint32_t) * (size - owner - 1));
+        size--;
         bucket[i + 1] = false;  // not exclusive anymore
         bucket[i + 2]--;        // decrement num_owners
         break;
@@ -167,12 +251,8 @@ auto release_lock_trusted(Transaction *transaction, int rowId, uint32_t *bucket,
 
     if (bucket[i + 2] == 0) {  // unowned lock
       // Remove the lock
-      for (int j = i; j < sizeOfSerializedLockEntry * (numEntries - 1); j++) {
-        bucket[i + j] = bucket[i + j + sizeOfSerializedLockEntry];
-      }
-      for (int j = 0; j < sizeOfSerializedLockEntry; j++) {
-        bucket[sizeOfSerializedLockEntry * (numEntries - 1) + j] = 0;
-      }
+      int end = i + kSerializedLockHeaderSize;
+      memmove(bucket + i, bucket + end, sizeof(uint32_t) * (size - end));
       return true;
     }
   }
@@ -7,9 +7,17 @@ std::string encoded_public_key;
 
 auto verify_signature(char *signature, int transactionId, int rowId,
                       int isExclusive) -> int {
-  std::string plain = lock_to_string(transactionId, rowId, isExclusive);
-
   std::string signature_string(signature);
+  size_t separator = signature_string.find("_");
+  unsigned long block_timeout = 0;
+  if (separator != std::string::npos) {
+    block_timeout =
+        strtoul(signature_string.c_str() + separator + 1, nullptr, 10);
+    signature_string.resize(separator);
+  }
+  std::string plain =
+      lock_to_string(transactionId, rowId, isExclusive, block_timeout);
+
   std::string x = signature_string.substr(0, signature_string.find("-"));
   std::string y = signature_string.substr(signature_string.find("-") + 1,
                                           signature_string.length());
@@ -27,10 +35,8 @@ auto verify_signature(char *signature, int transactionId, int rowId,
   return ret;
 }
 
-auto lock_to_string(int transactionId, int rowId, bool isExclusive)
-    -> std::string {
-  unsigned int block_timeout = get_block_timeout();
-
+auto lock_to_string(int transactionId, int rowId, bool isExclusive,
+                    unsigned long blockTimeout) -> std::string {
   std::string mode;
   if (isExclusive) {
     mode = "X";
@@ -39,7 +45,7 @@ auto lock_to_string(int transactionId, int rowId, bool isExclusive)
   }
 
   return std::to_string(transactionId) + "_" + std::to_string(rowId) + "_" +
-         mode + "_" + std::to_string(block_timeout);
+         mode + "_" + std::to_string(blockTimeout);
 }
 
 auto generate_key_pair() -> int {
@@ -70,9 +76,11 @@ auto verify(const char *message, void *signature, size_t sig_len) -> int {
   return res;
 }
 
-auto get_block_timeout() -> int {
-  // TODO: Implement getting the lock timeout
-  return 0;
+auto get_block_timeout() -> unsigned long {
+  if (arg_enclave.lease_duration == 0) {
+    return 0;
+  }
+  return leaseClock_ + arg_enclave.lease_duration;
 };
 
 auto get_sealed_data_size() -> uint32_t {
@@ -1,115 +1,281 @@
 #include "hashtable.h"
 
-HashTable* newHashTable(int size) {
-  HashTable* hashTable = new HashTable();
+void initHashTable(HashTableBase* hashTable, int size) {
   hashTable->size = size;
-  hashTable->table = new Entry*[size];
-  for (int i = 0; i < size; i++) {
-    hashTable->table[i] = nullptr;
+  hashTable->heads = new Bucket[size]();
+  hashTable->groups = new BucketGroup[size]();
+  hashTable->untrusted = false;
+}
+
+/**
+ * Frees the entries of an array of buckets
+ */
+static void destroyBuckets(Bucket* buckets, long numBuckets,
+                           void (*deleteEntry)(Entry*)) {
+  for (long i = 0; i < numBuckets; i++) {
+    Entry* entry = buckets[i].head;
+    while (entry != nullptr) {
+      Entry* next = entry->next;
+      deleteEntry(entry);
+      entry = next;
+    }
   }
-  hashTable->bucketSizes = new unsigned int[size];
-  for (int i = 0; i < size; i++) {
-    hashTable->bucketSizes[i] = 0;
+}
+
+void destroyHashTable(HashTableBase* hashTable, void (*deleteEntry)(Entry*)) {
+  destroyBuckets(hashTable->heads, hashTable->size, deleteEntry);
+  delete[] hashTable->heads;
+  for (int group = 0; group < hashTable->size; group++) {
+    Bucket** segments = hashTable->groups[group].segments;
+    if (segments == nullptr) {
+      continue;
+    }
+    for (int segment = 1; segment < HASHTABLE_MAX_LEVELS; segment++) {
+      if (segments[segment - 1] != nullptr) {
+        destroyBuckets(segments[segment - 1], segmentSize(segment),
+                       deleteEntry);
+        delete[] segments[segment - 1];
+      }
+    }
+    delete[] segments;
   }
-  return hashTable;
-};
+  delete[] hashTable->groups;
+}
 
-Entry* newEntry(int key, void* value) {
-  Entry* entry = new Entry();
-  entry->key = key;
-  entry->value = value;
-  return entry;
+int hash(int size, int key) {
+  return (int)(hashKey(key) % (unsigned int)size);
+}
+
+auto bucketOf(int size, BucketGroup* group, int key) -> int {
+  // All keys of a group share the same remainder of hash(), so the buckets
+  // within the group are chosen by the quotient of the scrambled key instead
+  unsigned int quotient = hashKey(key) / size;
+  unsigned int bucket = quotient & ((1u << group->level) - 1);
+  if (bucket < (unsigned int)group->split) {
+    bucket = quotient & ((2u << group->level) - 1);
+  }
+  return bucket;
 }
 
-std::pair<Entry*, int> getBucket(HashTable* table, int key) {
-  int position = hash(table->size, key);
-  return std::make_pair(table->table[position], table->bucketSizes[position]);
+auto segmentOf(int bucket) -> int {
+  return bucket == 0 ? 0 : 32 - __builtin_clz(bucket);
 }
 
-int hash(int size, int key) { return key % size; }
+auto segmentSize(int segment) -> long { return 1L << (segment - 1); }
 
-auto get(HashTable* hashTable, int key) -> void* {
-  Entry* entry = hashTable->table[hash(hashTable->size, key)];
-  return get(entry, key);
+auto segmentOffset(int bucket) -> long {
+  return bucket - (1 << (segmentOf(bucket) - 1));
 }
 
-auto get(Entry* entry, int key) -> void* {
+/**
+ * Returns the bucket of the given index within the group
+ */
+static auto bucketAt(HashTableBase* hashTable, int group, int bucket)
+    -> Bucket* {
+  if (bucket == 0) {
+    return &hashTable->heads[group];
+  }
+  Bucket** segments =
+      __atomic_load_n(&hashTable->groups[group].segments, __ATOMIC_ACQUIRE);
+  Bucket* buckets =
+      __atomic_load_n(&segments[segmentOf(bucket) - 1], __ATOMIC_ACQUIRE);
+  return &buckets[segmentOffset(bucket)];
+}
+
+static auto bucketAt(HashTableBase* hashTable, int key) -> Bucket* {
+  int group = hash(hashTable->size, key);
+  return bucketAt(hashTable, group,
+                  bucketOf(hashTable->size, &hashTable->groups[group], key));
+}
+
+/**
+ * Allocates a segment of a group, unless it already exists. Only the thread
+ * owning the group grows it, so no other thread allocates the same segment.
+ */
+static void allocateSegment(BucketGroup* state, int segment) {
+  if (state->segments == nullptr) {
+    __atomic_store_n(&state->segments,
+                     new Bucket*[HASHTABLE_MAX_LEVELS - 1](),
+                     __ATOMIC_RELEASE);
+  }
+  if (state->segments[segment - 1] == nullptr) {
+    __atomic_store_n(&state->segments[segment - 1],
+                     new Bucket[segmentSize(segment)](), __ATOMIC_RELEASE);
+  }
+}
+
+std::pair<Entry*, int> getBucket(HashTableBase* table, int key) {
+  Bucket* bucket = bucketAt(table, key);
+  return std::make_pair(bucket->head, bucket->size);
+}
+
+std::pair<Entry*, int> getBucket(HashTableBase* table, int group,
+                                 int bucket) {
+  Bucket* position = bucketAt(table, group, bucket);
+  return std::make_pair(position->head, position->size);
+}
+
+auto needsSplit(BucketGroup* group) -> bool {
+  return group->level + 1 < HASHTABLE_MAX_LEVELS &&
+         group->count > kMaxLoadFactor * ((1 << group->level) + group->split);
+}
+
+void splitBucketGroup(HashTableBase* hashTable, int group,
+                      BucketGroup* state) {
+  Bucket* from = bucketAt(hashTable, group, state->split);
+  Bucket* to = bucketAt(hashTable, group, state->split + (1 << state->level));
+
+  // Move every entry whose quotient has the bit of the new level set, keeping
+  // the order of the entries in both buckets
+  Entry** stay = &from->head;
+  Entry** move = &to->head;
+  Entry* entry = from->head;
+  unsigned int moved = 0;
   while (entry != nullptr) {
-    if (entry->key == key) {
-      return entry->value;
+    unsigned int quotient = hashKey(entry->key) / hashTable->size;
+    if ((quotient >> state->level) & 1) {
+      *move = entry;
+      move = &entry->next;
+      moved++;
+    } else {
+      *stay = entry;
+      stay = &entry->next;
     }
     entry = entry->next;
   }
-  return nullptr;
+  *stay = nullptr;
+  *move = nullptr;
+  from->size -= moved;
+  to->size = moved;
+
+  state->split++;
+  if (state->split == 1 << state->level) {
+    state->level++;
+    state->split = 0;
+  }
+  hashTable->groups[group].level = state->level;
+  hashTable->groups[group].split = state->split;
 }
 
-void set(HashTable* hashTable, int key, void* value) {
-  int position = hash(hashTable->size, key);
-  Entry* entry = hashTable->table[position];
+auto findEntry(HashTableBase* hashTable, int key) -> Entry* {
+  return findEntry(bucketAt(hashTable, key)->head, key);
+}
 
-  Entry* entryToInsert = new Entry();
-  entryToInsert->key = key;
-  entryToInsert->value = value;
-  entryToInsert->next = nullptr;
+auto findEntry(Entry* bucket, int key) -> Entry* {
+  Entry* entry = bucket;
+  while (entry != nullptr && entry->key != key) {
+    entry = entry->next;
+  }
+  return entry;
+}
 
-  if (entry == nullptr) {
-    hashTable->table[position] = entryToInsert;
-    hashTable->bucketSizes[position]++;
-    return;
+void findEntries(HashTableBase* hashTable, const int* keys, int n,
+                 Entry** entries) {
+  int groups[kLookupBatchSize];
+  for (int i = 0; i < n; i++) {
+    groups[i] = hash(hashTable->size, keys[i]);
+    __builtin_prefetch(&hashTable->groups[groups[i]]);
   }
 
-  while (entry->next != nullptr) {
-    if (entry->key == key) {
-      delete entryToInsert;
-      return;  // key already exists
-    }
-    entry = entry->next;
+  Bucket* buckets[kLookupBatchSize];
+  for (int i = 0; i < n; i++) {
+    buckets[i] = bucketAt(
+        hashTable, groups[i],
+        bucketOf(hashTable->size, &hashTable->groups[groups[i]], keys[i]));
+    __builtin_prefetch(buckets[i]);
+  }
+
+  for (int i = 0; i < n; i++) {
+    entries[i] = buckets[i]->head;
+    __builtin_prefetch(entries[i]);
   }
 
-  entry->next = entryToInsert;  // Add new entry at the end of the list
-  hashTable->bucketSizes[position]++;
+  // Advance every walk that has not reached its key or the end of its bucket
+  // by one entry per round, so that a long bucket does not stall the others
+  bool walking = true;
+  while (walking) {
+    walking = false;
+    for (int i = 0; i < n; i++) {
+      if (entries[i] != nullptr && entries[i]->key != keys[i]) {
+        entries[i] = entries[i]->next;
+        __builtin_prefetch(entries[i]);
+        walking = true;
+      }
+    }
+  }
 }
 
-auto contains(HashTable* hashTable, int key) -> bool {
-  Entry* entry = hashTable->table[hash(hashTable->size, key)];
+auto insertEntry(HashTableBase* hashTable, Entry* entry) -> Entry* {
+  Bucket* bucket = bucketAt(hashTable, entry->key);
+  Entry** position = &bucket->head;
 
-  while (entry != nullptr) {
-    if (entry->key == key) {
-      return true;
+  while (*position != nullptr) {
+    if ((*position)->key == entry->key) {
+      return *position;  // key already exists
     }
-    entry = entry->next;
+    position = &(*position)->next;
+  }
+  entry->next = nullptr;
+  *position = entry;  // Add new entry at the end of the list
+  bucket->size++;
+
+  int group = hash(hashTable->size, entry->key);
+  BucketGroup* state = &hashTable->groups[group];
+  state->count++;
+  if (hashTable->untrusted) {
+    return entry;  // the enclave splits the buckets
   }
 
-  return false;
+  // Grow the group step by step, so that no single request has to pay for
+  // rehashing more than a few buckets
+  for (int i = 0; i < kSplitsPerOperation && needsSplit(state); i++) {
+    allocateSegment(state, segmentOf(state->split + (1 << state->level)));
+    splitBucketGroup(hashTable, group, state);
+  }
+  return entry;
 }
 
-void remove(HashTable* hashTable, int key) {
-  int position = hash(hashTable->size, key);
-  Entry* entry = hashTable->table[position];
+auto extractEntry(HashTableBase* hashTable, int key) -> Entry* {
+  Bucket* bucket = bucketAt(hashTable, key);
+  Entry** position = &bucket->head;
 
-  if (entry == nullptr) {
-    return;
+  while (*position != nullptr) {
+    Entry* entry = *position;
+    if (entry->key == key) {
+      *position = entry->next;
+      bucket->size--;
+      hashTable->groups[hash(hashTable->size, key)].count--;
+      return entry;
+    }
+    position = &entry->next;
   }
+  return nullptr;
+}
 
-  if (entry->key == key) {
-    hashTable->table[position] = entry->next;
-    hashTable->bucketSizes[position]--;
-    // delete entry; We don't want to free the memory here, as deleting
-    // untrusted memory from within the enclave causes an error
-    return;
+auto bucketStatistics(HashTableBase* hashTable) -> BucketStatistics {
+  BucketStatistics statistics = {};
+  for (int group = 0; group < hashTable->size; group++) {
+    BucketGroup* state = &hashTable->groups[group];
+    for (int bucket = 0; bucket < (1 << state->level) + state->split;
+         bucket++) {
+      countBucket(&statistics, bucketAt(hashTable, group, bucket)->size);
+    }
   }
+  return statistics;
+}
 
-  Entry* next = entry->next;
-  while (next != nullptr) {
-    if (next->key == key) {
-      // delete it and return
-      entry->next = next->next;
-      hashTable->bucketSizes[position]--;
-      // delete next; We don't want to free the memory here, as deleting
-      // untrusted memory from within the enclave causes causes an error
-      return;
-    }
-    entry = next;
-    next = entry->next;
+void countBucket(BucketStatistics* statistics, unsigned long length) {
+  statistics->buckets++;
+  statistics->entries += length;
+  if (length > statistics->max_length) {
+    statistics->max_length = length;
   }
-}
\ No newline at end of file
+  statistics->histogram[length < BUCKET_HISTOGRAM_SIZE
+                            ? length
+                            : BUCKET_HISTOGRAM_SIZE - 1]++;
+}
+
+auto meanBucketLength(BucketStatistics* statistics) -> double {
+  unsigned long used = statistics->buckets - statistics->histogram[0];
+  return used == 0 ? 0 : (double)statistics->entries / used;
+}
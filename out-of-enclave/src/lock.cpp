@@ -1,68 +1,246 @@
 #include "lock.h"
 
+#include "pool.h"
+
+/**
+ * Returns the index of the free list for overflow arrays of the given
+ * capacity
+ */
+static auto overflowClass(int capacity) -> int {
+  int overflowClass = 0;
+  while ((kInlineOwners << overflowClass) < capacity) {
+    overflowClass++;
+  }
+  return overflowClass;
+}
+
+/**
+ * Hands out an overflow array of the given capacity, which is a power of two
+ * from kInlineOwners to kOwnerChunkSize
+ *
+ * @returns the array, or nullptr if no chunk could be obtained
+ */
+static auto allocateOverflow(OwnerArena* arena, int capacity) -> int* {
+  std::vector<int*>& freeArrays = arena->free_arrays[overflowClass(capacity)];
+  int* overflow;
+  if (!freeArrays.empty()) {
+    overflow = freeArrays.back();
+    freeArrays.pop_back();
+  } else {
+    if (arena->chunk == nullptr || arena->used + capacity > kOwnerChunkSize) {
+      // The rest of the previous chunk is too small and stays unused
+      arena->chunk = arena->allocate_chunk();
+      arena->used = 0;
+      if (arena->chunk == nullptr) {
+        return nullptr;
+      }
+    }
+    overflow = arena->chunk + arena->used;
+    arena->used += capacity;
+  }
+  arena->capacities[overflow] = capacity;
+  return overflow;
+}
+
+/**
+ * Takes an overflow array back, so that it is handed out again
+ */
+static void freeOverflow(OwnerArena* arena, int* overflow) {
+  auto capacity = arena->capacities.find(overflow);
+  arena->free_arrays[overflowClass(capacity->second)].push_back(overflow);
+  arena->capacities.erase(capacity);
+}
+
+/**
+ * Returns the capacity of the overflow array of a lock, or 0 if it has none.
+ * The lock may be in untrusted memory, so its overflow pointer is only
+ * followed if the arena handed the array out.
+ *
+ * @returns -1, if the lock points to an array that is not from the arena
+ */
+static auto overflowCapacity(Lock* lock, OwnerArena* arena) -> int {
+  if (lock->overflow == nullptr) {
+    return 0;
+  }
+  if (arena == nullptr) {
+    return -1;
+  }
+  auto capacity = arena->capacities.find(lock->overflow);
+  return capacity == arena->capacities.end() ? -1 : capacity->second;
+}
+
+/**
+ * Replaces the overflow array of a lock with one of the given capacity, which
+ * must be large enough for all of its owners. Frees the overflow array, if the
+ * capacity is 0.
+ *
+ * @returns false, if no array of the capacity could be obtained
+ */
+static auto resizeOverflow(Lock* lock, OwnerArena* arena, int count,
+                           int capacity) -> bool {
+  int* overflow = nullptr;
+  if (capacity > 0) {
+    overflow = allocateOverflow(arena, capacity);
+    if (overflow == nullptr) {
+      return false;
+    }
+    for (int i = kInlineOwners; i < count; i++) {
+      overflow[i - kInlineOwners] = lock->overflow[i - kInlineOwners];
+    }
+  }
+  if (lock->overflow != nullptr) {
+    freeOverflow(arena, lock->overflow);
+  }
+  lock->overflow = overflow;
+  return true;
+}
+
+void initOwnerArena(OwnerArena* arena, int* (*allocateChunk)()) {
+  arena->allocate_chunk = allocateChunk;
+  arena->chunk = nullptr;
+  arena->used = 0;
+}
+
+auto isOwner(Lock* lock, int transactionId, OwnerArena* arena) -> bool {
+  int count = numOwners(lock);
+  for (int i = 0; i < count && i < kInlineOwners; i++) {
+    if (lock->owners[i] == transactionId) {
+      return true;
+    }
+  }
+  if (count > kInlineOwners &&
+      overflowCapacity(lock, arena) >= count - kInlineOwners) {
+    for (int i = kInlineOwners; i < count; i++) {
+      if (lock->overflow[i - kInlineOwners] == transactionId) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void initLock(Lock* lock) {
+  lock->word = 0;
+  for (int i = 0; i < kInlineOwners; i++) {
+    lock->owners[i] = 0;
+  }
+  lock->overflow = nullptr;
+}
+
 Lock* newLock() {
-  Lock* lock = new Lock();
-  lock->exclusive = false;
-  lock->owners = new int[kTransactionBudget];
-  lock->num_owners = 0;
+  Lock* lock = poolNew<Lock>();
+  initLock(lock);
   return lock;
 }
 
-auto getSharedAccess(Lock* lock, int transactionId) -> bool {
-  if (!lock->exclusive) {
-    lock->owners[lock->num_owners++] = transactionId;
+void destroyLock(Lock* lock) { lock->overflow = nullptr; }
+
+void deleteLock(Lock* lock) {
+  if (lock != nullptr) {
+    destroyLock(lock);
+  }
+  poolDelete(lock);
+}
+
+auto getSharedAccess(Lock* lock, int transactionId, OwnerArena* arena)
+    -> bool {
+  unsigned int word = __atomic_load_n(&lock->word, __ATOMIC_ACQUIRE);
+  if ((word & kExclusiveBit) != 0) {
+    return false;
+  }
+  if (isOwner(lock, transactionId, arena)) {
     return true;
   }
-  return false;
+
+  // The count only covers the slot once it holds the owner
+  int count = word & kOwnerCountMask;
+  if (count < kInlineOwners) {
+    lock->owners[count] = transactionId;
+    __atomic_store_n(&lock->word, word + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  // Append to the overflow array, doubling it when it is full
+  int capacity = overflowCapacity(lock, arena);
+  if (arena == nullptr || count >= kMaxOwners ||
+      capacity < count - kInlineOwners) {
+    return false;
+  }
+  if (count - kInlineOwners == capacity &&
+      !resizeOverflow(lock, arena, count,
+                      capacity == 0 ? kInlineOwners : 2 * capacity)) {
+    return false;
+  }
+  lock->overflow[count - kInlineOwners] = transactionId;
+  __atomic_store_n(&lock->word, word + 1, __ATOMIC_RELEASE);
+  return true;
 };
 
 auto getExclusiveAccess(Lock* lock, int transactionId) -> bool {
-  if (lock->num_owners == 0) {
-    lock->exclusive = true;
-    lock->owners[lock->num_owners++] = transactionId;
+  unsigned int word = 0;
+  if (__atomic_compare_exchange_n(&lock->word, &word, kExclusiveBit | 1, false,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    lock->owners[0] = transactionId;
     return true;
   }
   return false;
 };
 
 auto upgrade(Lock* lock, int transactionId) -> bool {
-  if (lock->num_owners == 1 && lock->owners[0] == transactionId) {
-    lock->exclusive = true;
+  if (numOwners(lock) == 1 && lock->owners[0] == transactionId) {
+    __atomic_store_n(&lock->word, kExclusiveBit | 1, __ATOMIC_RELEASE);
     return true;
   }
   return false;
 };
 
-void release(Lock* lock, int transactionId) {
-  bool wasOwner = false;  // only release when the transactionId was actually
-                          // within the set of owners of that lock
-  for (int i = 0; i < lock->num_owners; i++) {
-    if (lock->owners[i] == transactionId) {
-      for (int j = i; j < lock->num_owners - 1; j++) {
-        lock->owners[j] = lock->owners[j + 1];
-      }
-      lock->exclusive = false;
-      lock->num_owners--;
-      break;
-    }
+void release(Lock* lock, int transactionId, OwnerArena* arena) {
+  int count = numOwners(lock);
+  int capacity = overflowCapacity(lock, arena);
+  if (capacity < count - kInlineOwners) {
+    return;  // the owners beyond the inline slots cannot be reached
   }
-}
 
-auto copy_lock(Lock* lock) -> void* {
-  Lock* copy = new Lock();
-  copy->exclusive = lock->exclusive;
-  int num_owners = lock->num_owners;
-  copy->num_owners = num_owners;
+  // Keep the order of the remaining owners, as it is part of the serialized
+  // bucket that the integrity of the lock table is verified with
+  int i = 0;
+  while (i < count && (i < kInlineOwners ? lock->owners[i]
+                                         : lock->overflow[i - kInlineOwners]) !=
+                          transactionId) {
+    i++;
+  }
+  if (i == count) {
+    return;
+  }
+  for (; i < count - 1; i++) {
+    int next = i + 1 < kInlineOwners ? lock->owners[i + 1]
+                                     : lock->overflow[i + 1 - kInlineOwners];
+    if (i < kInlineOwners) {
+      lock->owners[i] = next;
+    } else {
+      lock->overflow[i - kInlineOwners] = next;
+    }
+  }
+  if (count - 1 < kInlineOwners) {
+    lock->owners[count - 1] = 0;
+  }
+  count--;
+  __atomic_store_n(&lock->word, (unsigned int)count, __ATOMIC_RELEASE);
 
-  copy->owners = new int[kTransactionBudget];
-  for (int i = 0; i < num_owners; i++) {
-    copy->owners[i] = lock->owners[i];
+  // Shrink the overflow array once it is only a quarter full
+  if (count <= kInlineOwners && capacity > 0) {
+    resizeOverflow(lock, arena, count, 0);
+  } else if (capacity > kInlineOwners &&
+             4 * (count - kInlineOwners) <= capacity) {
+    resizeOverflow(lock, arena, count, capacity / 2);
   }
+}
 
+auto copy_lock(Lock* lock) -> void* {
+  Lock* copy = poolNew<Lock>();
+  *copy = *lock;
+  copy->overflow = nullptr;
   return (void*)copy;
 }
 
-void free_lock_copy(Lock*& lock) {
-  delete[] lock->owners;
-  delete lock;
-}
\ No newline at end of file
+void free_lock_copy(Lock*& lock) { deleteLock(lock); }
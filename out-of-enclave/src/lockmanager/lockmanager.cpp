@@ -34,16 +34,98 @@ auto LockManager::create_worker_thread(void *tmp) -> void * {
   return 0;
 }
 
-void LockManager::configuration_init(int numWorkerThreads) {
-  arg.num_threads =
-      numWorkerThreads + 1;  // one single thread for transaction table
-  arg.tx_thread_id = arg.num_threads - 1;
-  arg.lock_table_size = 10000;
-  arg.transaction_table_size = 2;
+/**
+ * Frees an entry of the lock table together with its lock
+ */
+static void delete_locktable_entry(Entry *entry) {
+  Node<Lock> *node = nodeOf<Lock>(entry);
+  destroyLock(&node->value);
+  poolDelete(node);
 }
 
-LockManager::LockManager(int numWorkerThreads) {
-  configuration_init(numWorkerThreads);
+auto LockManager::create_janitor_thread(void *tmp) -> void * {
+  LockManager *lockManager = (LockManager *)tmp;
+  while (lockManager->janitor_running) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(kJanitorInterval));
+    lockManager->reclaim_retired_entries();
+    lockManager->advance_leases();
+    lockManager->balance_partitions();
+  }
+  return 0;
+}
+
+void LockManager::reclaim_retired_entries() {
+  // A worker thread unlinks an entry from the lock table before it publishes
+  // it in its ring
+  for (int i = 0; i < arg.num_threads; i++) {
+    ReclamationRing *ring = &reclamation_rings[i];
+    unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    unsigned int tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      retired_entries.push_back(ring->entries[head % RECLAMATION_RING_SIZE]);
+    }
+    __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+  }
+  if (retired_entries.empty()) {
+    return;
+  }
+
+  // Wait for a quiescent state: every untrusted reader of the lock table walks
+  // its buckets while holding new_lock_mut, so once the janitor got hold of
+  // it, the readers that may have reached a collected entry have finished and
+  // all later ones start after the entry was unlinked
+  new_lock_mut.lock();
+  new_lock_mut.unlock();
+
+  for (Entry *entry : retired_entries) {
+    delete_locktable_entry(entry);
+  }
+  retired_entries.clear();
+}
+
+/**
+ * Returns the current time in milliseconds since the epoch
+ */
+static auto current_time() -> unsigned long {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+void LockManager::advance_leases() {
+  if (arg.lease_duration == 0) {
+    return;
+  }
+  Job job;
+  job.command = TICK;
+  job.time = current_time();
+  job.wait_for_result = false;
+  enclave_send_job(global_eid, &job);
+}
+
+void LockManager::balance_partitions() {
+  Job job;
+  job.command = BALANCE;
+  job.time = current_time();
+  job.wait_for_result = false;
+  enclave_send_job(global_eid, &job);
+}
+
+void LockManager::configuration_init(int numWorkerThreads,
+                                     int leaseDuration) {
+  // The worker threads share the transaction table, see
+  // transaction_partition_of()
+  arg.num_threads = numWorkerThreads;
+  arg.num_partitions = numWorkerThreads * kPartitionsPerWorker;
+  arg.lock_table_size = 10000;  // bucket groups, each of them grows on its own
+  arg.transaction_table_size = 64;  // grows with the registered transactions,
+                                    // its groups are split among the workers
+  arg.lease_duration = leaseDuration;
+  arg.start_time = current_time();
+}
+
+LockManager::LockManager(int numWorkerThreads, int leaseDuration) {
+  configuration_init(numWorkerThreads, leaseDuration);
 
   // Load and initialize the signed enclave
   sgx_status_t ret = load_and_initialize_enclave(&global_eid);
@@ -52,8 +134,15 @@ LockManager::LockManager(int numWorkerThreads) {
     // TODO: implement error handling
   }
 
-  lockTable = newHashTable(arg.lock_table_size);
-  enclave_init_values(global_eid, arg, lockTable);
+  lockTable = newHashTable<int, Lock>(arg.lock_table_size);
+  lockTable->untrusted = true;  // the enclave grows the lock table
+  reclamation_rings = new ReclamationRing[arg.num_threads]();
+  enclave_init_values(global_eid, arg, lockTable, reclamation_rings);
+
+  // The enclave cannot free untrusted memory, so the janitor thread frees the
+  // entries and locks that it removes from the lock table
+  janitor_running = true;
+  pthread_create(&janitor, NULL, &LockManager::create_janitor_thread, this);
 
   // Create worker threads inside the enclave to serve lock requests and
   // registrations of transactions
@@ -76,6 +165,12 @@ LockManager::LockManager(int numWorkerThreads) {
 LockManager::~LockManager() {
   // TODO: Destructor never called (esp. on CTRL+C shutdown)!
 
+  // The janitor must not send TICK or BALANCE jobs to the enclave anymore,
+  // the entries it did not free yet are freed below
+  spdlog::info("Stopping janitor");
+  janitor_running = false;
+  pthread_join(janitor, NULL);
+
   // Send QUIT to worker threads
   create_enclave_job(QUIT, 0, 0, 0, false);
 
@@ -90,8 +185,20 @@ LockManager::~LockManager() {
   spdlog::info("Destroying enclave");
   sgx_destroy_enclave(global_eid);
 
-  delete[] lockTable->table;
+  reclaim_retired_entries();
+  unsigned long dropped = 0;
+  for (int i = 0; i < arg.num_threads; i++) {
+    dropped += reclamation_rings[i].dropped;
+  }
+  if (dropped > 0) {
+    spdlog::warn(std::to_string(dropped) +
+                 " lock table entries leaked because the janitor fell behind");
+  }
+  delete[] reclamation_rings;
+
+  destroyHashTable(lockTable, &delete_locktable_entry);
   delete lockTable;
+  free_owner_chunks();
 }
 
 auto LockManager::registerTransaction(int transactionId, int lockBudget)
@@ -103,7 +210,7 @@ auto LockManager::lock(int transactionId, int rowId, bool isExclusive,
                        bool waitForResult) -> std::pair<std::string, bool> {
   new_lock_mut.lock();
   if (!contains(lockTable, rowId)) {
-    set(lockTable, rowId, (void *)newLock());
+    initLock(insert(lockTable, rowId));
   }
   new_lock_mut.unlock();
 
@@ -114,10 +221,63 @@ auto LockManager::lock(int transactionId, int rowId, bool isExclusive,
   return create_enclave_job(SHARED, transactionId, rowId, 0, waitForResult);
 };
 
+auto LockManager::lockBatch(const std::vector<BatchedLock> &requests)
+    -> std::vector<std::pair<std::string, bool>> {
+  size_t numJobs = requests.size();
+
+  new_lock_mut.lock();
+  for (const auto &request : requests) {
+    if (!contains(lockTable, request.rowId)) {
+      initLock(insert(lockTable, request.rowId));
+    }
+  }
+  new_lock_mut.unlock();
+
+  // The results of the requests live on the stack and the heap of this thread
+  // in the untrusted part of the application, see create_enclave_job()
+  std::vector<Job> jobs(numJobs);
+  std::vector<Completion> finished(numJobs);
+  std::unique_ptr<bool[]> errors(new bool[numJobs]());
+  std::vector<char> returnValues(numJobs * RETURN_VALUE_SIZE);
+  for (size_t i = 0; i < numJobs; i++) {
+    Job &job = jobs[i];
+    job.command = requests[i].isExclusive ? EXCLUSIVE : SHARED;
+    job.transaction_id = requests[i].transactionId;
+    job.row_id = requests[i].rowId;
+    job.wait_for_result = true;
+    job.return_value = &returnValues[i * RETURN_VALUE_SIZE];
+    initCompletion(&finished[i]);
+    job.finished = &finished[i];
+    job.error = &errors[i];
+  }
+  enclave_send_jobs(global_eid, jobs.data(), numJobs);
+
+  std::vector<std::pair<std::string, bool>> results;
+  results.reserve(numJobs);
+  for (size_t i = 0; i < numJobs; i++) {
+    waitForCompletion(&finished[i]);
+    if (errors[i]) {
+      results.emplace_back(NO_SIGNATURE, false);
+      continue;
+    }
+    results.emplace_back(std::string(&returnValues[i * RETURN_VALUE_SIZE]),
+                         true);
+  }
+  return results;
+}
+
 void LockManager::unlock(int transactionId, int rowId, bool waitForResult) {
   create_enclave_job(UNLOCK, transactionId, rowId, 0, waitForResult);
 };
 
+auto LockManager::commit(int transactionId, bool waitForResult) -> bool {
+  return create_enclave_job(COMMIT, transactionId, 0, 0, waitForResult).second;
+};
+
+auto LockManager::abort(int transactionId, bool waitForResult) -> bool {
+  return create_enclave_job(ABORT, transactionId, 0, 0, waitForResult).second;
+};
+
 auto LockManager::initialize_enclave() -> bool {
   sgx_status_t ret = SGX_ERROR_UNEXPECTED;
   ret = sgx_create_enclave(ENCLAVE_FILENAME, SGX_DEBUG_FLAG, NULL, NULL,
@@ -222,19 +382,20 @@ auto LockManager::create_enclave_job(Command command, int transaction_id,
   job.row_id = row_id;
   job.lock_budget = lock_budget;
 
-  // Need to track, when job is finished or error has occurred
+  // Need to track, when job is finished or error has occurred. Both live on
+  // the stack of this thread in the untrusted part of the application, so the
+  // enclave can modify them via their pointers while this thread waits.
+  Completion finished;
+  bool error = false;
   if (waitForResult) {
-    // Allocate dynamic memory in the untrusted part of the application, so the
-    // enclave can modify it via its pointer
-    job.finished = new bool;
-    job.error = new bool;
-    *job.finished = false;
-    *job.error = false;
+    initCompletion(&finished);
+    job.finished = &finished;
+    job.error = &error;
   }
 
   if (command == SHARED || command == EXCLUSIVE) {
     // These requests return a signature
-    job.return_value = new char[SIGNATURE_SIZE];
+    job.return_value = new char[RETURN_VALUE_SIZE];
   }
 
   job.wait_for_result = waitForResult;
@@ -243,21 +404,18 @@ auto LockManager::create_enclave_job(Command command, int transaction_id,
   if (waitForResult) {
     // Need to wait until job is finished because we need to be registered for
     // subsequent requests or because we need to wait for the return value
-    while (!*job.finished) {
-      continue;
-    }
-    delete job.finished;
+    waitForCompletion(&finished);
 
     // Check if an error occured
-    if (*job.error) {
+    if (error) {
       return std::make_pair(NO_SIGNATURE, false);
     }
-    delete job.error;
 
     // Get the signature return value
     if (command == SHARED || command == EXCLUSIVE) {
       std::string signature;
-      for (int i = 0; i < SIGNATURE_SIZE; i++) {
+      for (int i = 0; i < RETURN_VALUE_SIZE && job.return_value[i] != '\0';
+           i++) {
         signature += job.return_value[i];
       }
       delete[] job.return_value;
@@ -282,4 +440,32 @@ auto LockManager::verify_signature_string(std::string signature,
     print_info("Signature successfully verified");
     return true;
   }
-}
\ No newline at end of file
+}
+auto LockManager::getPoolStatistics() -> PoolStatistics {
+  return poolStatistics();
+}
+
+auto LockManager::getEnclavePoolStatistics() -> PoolStatistics {
+  PoolStatistics statistics = {};
+  sgx_status_t ret = get_pool_statistics(global_eid, &statistics);
+  if (ret != SGX_SUCCESS) {
+    print_error("Failed to get the pool statistics of the enclave");
+  }
+  return statistics;
+}
+
+auto LockManager::getLockTableStatistics() -> BucketStatistics {
+  std::lock_guard<std::mutex> guard(new_lock_mut);
+  return bucketStatistics(lockTable);
+}
+
+auto LockManager::getPartitionStatistics()
+    -> std::vector<PartitionStatistics> {
+  std::vector<PartitionStatistics> statistics(arg.num_partitions);
+  sgx_status_t ret = get_partition_statistics(global_eid, statistics.data(),
+                                              statistics.size());
+  if (ret != SGX_SUCCESS) {
+    print_error("Failed to get the partition statistics");
+  }
+  return statistics;
+}
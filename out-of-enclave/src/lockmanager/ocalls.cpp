@@ -1,5 +1,9 @@
 #include "lockmanager.h"
 
+// Chunks for the owners of locks that were handed to the enclave
+std::vector<int *> owner_chunks;
+std::mutex owner_chunks_mutex;  // synchronizes access to owner_chunks
+
 void print_info(const char *str) {
   spdlog::info("Enclave: " + std::string{str});
 }
@@ -10,4 +14,30 @@ void print_error(const char *str) {
 
 void print_warn(const char *str) {
   spdlog::warn("Enclave: " + std::string{str});
-}
\ No newline at end of file
+}
+
+void wake_completion(void *completion) {
+  wakeCompletion((Completion *)completion);
+}
+
+void *allocate_buckets(size_t num_buckets) {
+  return (void *)new Bucket[num_buckets]();
+}
+
+void *allocate_bucket_segments(size_t num_segments) {
+  return (void *)new Bucket *[num_segments]();
+}
+void *allocate_owner_chunk(size_t num_owners) {
+  int *chunk = new int[num_owners]();
+  std::lock_guard<std::mutex> guard(owner_chunks_mutex);
+  owner_chunks.push_back(chunk);
+  return (void *)chunk;
+}
+
+void free_owner_chunks() {
+  std::lock_guard<std::mutex> guard(owner_chunks_mutex);
+  for (int *chunk : owner_chunks) {
+    delete[] chunk;
+  }
+  owner_chunks.clear();
+}
@@ -0,0 +1,205 @@
+#include "pool.h"
+
+#include <stdlib.h>
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+/**
+ * Free blocks of one size class that are shared by all threads
+ */
+struct SizeClass {
+  bool locked;           // spin lock, as the free list is only held briefly
+  FreeBlock* freeList;   // blocks that were returned by threads
+  char* slab;            // the slab new blocks are carved from
+  size_t slabRemaining;  // bytes of the slab that were not carved yet
+};
+
+/**
+ * Free blocks of one size class that only the owning thread accesses
+ */
+struct ThreadCache {
+  FreeBlock* freeList;
+  int count;            // number of blocks in the free list
+  unsigned long hits;   // allocations not yet added to the statistics
+};
+
+/**
+ * The free lists of a thread, which are flushed when the thread exits
+ */
+struct ThreadCaches {
+  ThreadCache classes[kPoolSizeClasses];
+
+  ~ThreadCaches();
+};
+
+static SizeClass sizeClasses[kPoolSizeClasses];
+static thread_local ThreadCaches threadCaches;
+static PoolStatistics statistics;
+
+/**
+ * Returns the size class of an object, or kPoolSizeClasses when it is too
+ * large for the pools
+ */
+static auto sizeClassOf(size_t size) -> int {
+  int sizeClass = 0;
+  size_t blockSize = kPoolMinBlockSize;
+  while (blockSize < size && sizeClass < kPoolSizeClasses) {
+    blockSize <<= 1;
+    sizeClass++;
+  }
+  return sizeClass;
+}
+
+static void lock(SizeClass* sizeClass) {
+  while (__atomic_test_and_set(&sizeClass->locked, __ATOMIC_ACQUIRE)) {
+    continue;
+  }
+}
+
+static void unlock(SizeClass* sizeClass) {
+  __atomic_clear(&sizeClass->locked, __ATOMIC_RELEASE);
+}
+
+/**
+ * Moves a batch of blocks from the shared free list into the free list of the
+ * calling thread, carving new blocks from the slab if necessary
+ */
+static void refill(int index) {
+  SizeClass* sizeClass = &sizeClasses[index];
+  ThreadCache* cache = &threadCaches.classes[index];
+  size_t blockSize = kPoolMinBlockSize << index;
+
+  lock(sizeClass);
+  while (cache->count < kPoolBatchSize) {
+    FreeBlock* block = sizeClass->freeList;
+    if (block != nullptr) {
+      sizeClass->freeList = block->next;
+    } else {
+      if (sizeClass->slabRemaining < blockSize) {
+        sizeClass->slab = (char*)malloc(kPoolSlabSize);
+        if (sizeClass->slab == nullptr) {
+          sizeClass->slabRemaining = 0;
+          break;
+        }
+        sizeClass->slabRemaining = kPoolSlabSize;
+        __atomic_fetch_add(&statistics.slabs, 1, __ATOMIC_RELAXED);
+      }
+      block = (FreeBlock*)sizeClass->slab;
+      sizeClass->slab += blockSize;
+      sizeClass->slabRemaining -= blockSize;
+    }
+    block->next = cache->freeList;
+    cache->freeList = block;
+    cache->count++;
+  }
+  unlock(sizeClass);
+
+  __atomic_fetch_add(&statistics.misses, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&statistics.hits, cache->hits, __ATOMIC_RELAXED);
+  cache->hits = 0;
+}
+
+/**
+ * Moves a batch of blocks from the free list of the calling thread back into
+ * the shared free list, so that other threads can reuse them
+ */
+static void drain(int index) {
+  SizeClass* sizeClass = &sizeClasses[index];
+  ThreadCache* cache = &threadCaches.classes[index];
+
+  FreeBlock* first = cache->freeList;
+  FreeBlock* last = first;
+  for (int i = 1; i < kPoolBatchSize; i++) {
+    last = last->next;
+  }
+  cache->freeList = last->next;
+  cache->count -= kPoolBatchSize;
+
+  lock(sizeClass);
+  last->next = sizeClass->freeList;
+  sizeClass->freeList = first;
+  unlock(sizeClass);
+
+  __atomic_fetch_add(&statistics.hits, cache->hits, __ATOMIC_RELAXED);
+  cache->hits = 0;
+}
+
+/**
+ * Moves all blocks of the exiting thread into the shared free lists, as no
+ * other thread could reuse them otherwise
+ */
+ThreadCaches::~ThreadCaches() {
+  for (int index = 0; index < kPoolSizeClasses; index++) {
+    SizeClass* sizeClass = &sizeClasses[index];
+    ThreadCache* cache = &classes[index];
+
+    if (cache->freeList != nullptr) {
+      FreeBlock* last = cache->freeList;
+      while (last->next != nullptr) {
+        last = last->next;
+      }
+      lock(sizeClass);
+      last->next = sizeClass->freeList;
+      sizeClass->freeList = cache->freeList;
+      unlock(sizeClass);
+      cache->freeList = nullptr;
+      cache->count = 0;
+    }
+
+    __atomic_fetch_add(&statistics.hits, cache->hits, __ATOMIC_RELAXED);
+    cache->hits = 0;
+  }
+}
+
+auto poolAllocate(size_t size) -> void* {
+  int index = sizeClassOf(size);
+  if (index == kPoolSizeClasses || kPoolBypass) {
+    __atomic_fetch_add(&statistics.misses, 1, __ATOMIC_RELAXED);
+    return malloc(size);
+  }
+
+  ThreadCache* cache = &threadCaches.classes[index];
+  if (cache->freeList == nullptr) {
+    refill(index);
+    if (cache->freeList == nullptr) {
+      return nullptr;  // out of memory
+    }
+  } else {
+    cache->hits++;
+  }
+
+  FreeBlock* block = cache->freeList;
+  cache->freeList = block->next;
+  cache->count--;
+  return (void*)block;
+}
+
+void poolFree(void* block, size_t size) {
+  if (block == nullptr) {
+    return;
+  }
+
+  int index = sizeClassOf(size);
+  if (index == kPoolSizeClasses || kPoolBypass) {
+    free(block);
+    return;
+  }
+
+  ThreadCache* cache = &threadCaches.classes[index];
+  ((FreeBlock*)block)->next = cache->freeList;
+  cache->freeList = (FreeBlock*)block;
+  cache->count++;
+  if (cache->count > 2 * kPoolBatchSize) {
+    drain(index);
+  }
+}
+
+auto poolStatistics() -> PoolStatistics {
+  PoolStatistics result;
+  result.hits = __atomic_load_n(&statistics.hits, __ATOMIC_RELAXED);
+  result.misses = __atomic_load_n(&statistics.misses, __ATOMIC_RELAXED);
+  result.slabs = __atomic_load_n(&statistics.slabs, __ATOMIC_RELAXED);
+  return result;
+}
@@ -59,4 +59,22 @@ auto LockingServiceImpl::Unlock(ServerContext* context,
 
   lockManager_.unlock(transaction_id, row_id, wait_for_signature);
   return Status::OK;
+}
+
+auto LockingServiceImpl::Commit(ServerContext* context,
+                                const TransactionRequest* request,
+                                TransactionResponse* response) -> Status {
+  if (lockManager_.commit(request->transaction_id())) {
+    return Status::OK;
+  }
+  return Status::CANCELLED;
+}
+
+auto LockingServiceImpl::Abort(ServerContext* context,
+                               const TransactionRequest* request,
+                               TransactionResponse* response) -> Status {
+  if (lockManager_.abort(request->transaction_id())) {
+    return Status::OK;
+  }
+  return Status::CANCELLED;
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "timing_wheel.h"
+
+#include <algorithm>
+
+#include "pool.h"
+
+/**
+ * Links a lease into the slot of the lowest level that reaches its expiry
+ *
+ * @param earliest the earliest tick the lease may be expired at
+ */
+static void linkLease(TimingWheel* wheel, Lease* lease,
+                      unsigned long earliest) {
+  unsigned long expiry = std::max(lease->expiry, earliest);
+  unsigned long delta = expiry - wheel->now;
+
+  int level = 0;
+  while (level < kWheelLevels - 1 &&
+         (delta >> (kWheelBits * (level + 1))) != 0) {
+    level++;
+  }
+  // Leases further ahead than the wheel covers wait in the slot of the
+  // highest level that is furthest ahead
+  if ((delta >> (kWheelBits * kWheelLevels)) != 0) {
+    expiry = wheel->now + (1ul << (kWheelBits * kWheelLevels)) - 1;
+  }
+
+  int slot = (expiry >> (kWheelBits * level)) & (kWheelSlots - 1);
+  Lease** head = &wheel->slots[level][slot];
+  lease->next = *head;
+  if (*head != nullptr) {
+    (*head)->pprev = &lease->next;
+  }
+  *head = lease;
+  lease->pprev = head;
+  wheel->num_leases++;
+}
+
+/**
+ * Removes all leases from a slot
+ *
+ * @returns the leases of the slot, linked by next
+ */
+static auto takeSlot(TimingWheel* wheel, int level, int slot) -> Lease* {
+  Lease* leases = wheel->slots[level][slot];
+  wheel->slots[level][slot] = nullptr;
+  for (Lease* lease = leases; lease != nullptr; lease = lease->next) {
+    lease->pprev = nullptr;
+    wheel->num_leases--;
+  }
+  return leases;
+}
+
+void initTimingWheel(TimingWheel* wheel, unsigned long now) {
+  wheel->now = now;
+  wheel->num_leases = 0;
+  for (int level = 0; level < kWheelLevels; level++) {
+    for (int slot = 0; slot < kWheelSlots; slot++) {
+      wheel->slots[level][slot] = nullptr;
+    }
+  }
+}
+
+void destroyTimingWheel(TimingWheel* wheel) {
+  for (int level = 0; level < kWheelLevels; level++) {
+    for (int slot = 0; slot < kWheelSlots; slot++) {
+      Lease* lease = takeSlot(wheel, level, slot);
+      while (lease != nullptr) {
+        Lease* next = lease->next;
+        poolDelete(lease);
+        lease = next;
+      }
+    }
+  }
+}
+
+auto addLease(TimingWheel* wheel, int transactionId, int rowId,
+              unsigned long expiry) -> Lease* {
+  Lease* lease = poolNew<Lease>();
+  lease->transaction_id = transactionId;
+  lease->row_id = rowId;
+  lease->expiry = expiry;
+  linkLease(wheel, lease, wheel->now + 1);
+  return lease;
+}
+
+void cancelLease(TimingWheel* wheel, Lease* lease) {
+  if (lease == nullptr) {
+    return;
+  }
+  if (lease->pprev != nullptr) {
+    *lease->pprev = lease->next;
+    if (lease->next != nullptr) {
+      lease->next->pprev = lease->pprev;
+    }
+    wheel->num_leases--;
+  }
+  poolDelete(lease);
+}
+
+auto advanceTimingWheel(TimingWheel* wheel, unsigned long now) -> Lease* {
+  Lease* expired = nullptr;
+  while (wheel->now < now) {
+    // Nothing can expire on the way
+    if (wheel->num_leases == 0) {
+      wheel->now = now;
+      break;
+    }
+    wheel->now++;
+
+    // Move the leases of the slots the tick entered down, starting with the
+    // highest level, as its leases may move into a slot that is entered on a
+    // lower level with the same tick
+    for (int level = kWheelLevels - 1; level > 0; level--) {
+      if ((wheel->now & ((1ul << (kWheelBits * level)) - 1)) != 0) {
+        continue;
+      }
+      int slot = (wheel->now >> (kWheelBits * level)) & (kWheelSlots - 1);
+      Lease* lease = takeSlot(wheel, level, slot);
+      while (lease != nullptr) {
+        Lease* next = lease->next;
+        linkLease(wheel, lease, wheel->now);
+        lease = next;
+      }
+    }
+
+    Lease* lease = takeSlot(wheel, 0, wheel->now & (kWheelSlots - 1));
+    while (lease != nullptr) {
+      Lease* next = lease->next;
+      lease->next = expired;
+      expired = lease;
+      lease = next;
+    }
+  }
+  return expired;
+}
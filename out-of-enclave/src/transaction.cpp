@@ -1,7 +1,11 @@
 #include "transaction.h"
 
-Transaction* newTransaction(int transactionId, int lockBudget) {
-  Transaction* transaction = new Transaction();
+#include <algorithm>
+
+#include "pool.h"
+
+void initTransaction(Transaction* transaction, int transactionId,
+                     int lockBudget) {
   transaction->transaction_id = transactionId;
   transaction->aborted = false;
   transaction->growing_phase = true;
@@ -9,11 +13,37 @@ Transaction* newTransaction(int transactionId, int lockBudget) {
   transaction->locked_rows = new int[lockBudget];
   transaction->locked_rows_size = lockBudget;
   transaction->num_locked = 0;
+  initRowIndex(&transaction->locked_rows_index);
+  transaction->leases = new Lease*[lockBudget]();
+  transaction->pins = 0;
+  transaction->detached = false;
+}
+
+Transaction* newTransaction(int transactionId, int lockBudget) {
+  Transaction* transaction = poolNew<Transaction>();
+  initTransaction(transaction, transactionId, lockBudget);
   return transaction;
 }
 
-auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock)
-    -> bool {
+void destroyTransaction(Transaction* transaction) {
+  delete[] transaction->locked_rows;
+  transaction->locked_rows = nullptr;
+  transaction->locked_rows_size = 0;
+  transaction->num_locked = 0;
+  destroyRowIndex(&transaction->locked_rows_index);
+  delete[] transaction->leases;
+  transaction->leases = nullptr;
+}
+
+void deleteTransaction(Transaction* transaction) {
+  if (transaction != nullptr) {
+    destroyTransaction(transaction);
+  }
+  poolDelete(transaction);
+}
+
+auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock,
+             OwnerArena* arena) -> bool {
   if (transaction->aborted) {
     return false;
   }
@@ -22,99 +52,116 @@ auto addLock(Transaction* transaction, int rowId, bool isExclusive, Lock* lock)
   if (isExclusive) {
     ret = getExclusiveAccess(lock, transaction->transaction_id);
   } else {
-    ret = getSharedAccess(lock, transaction->transaction_id);
+    ret = getSharedAccess(lock, transaction->transaction_id, arena);
   }
 
   if (ret) {
-    if (transaction->num_locked == 0) {
-      transaction->locked_rows = new int[1];
-      transaction->locked_rows[0] = rowId;
-    } else {
-      transaction->locked_rows =
-          (int*)realloc(transaction->locked_rows,
-                        sizeof(int) * (transaction->num_locked + 1));
-      transaction->locked_rows[transaction->num_locked] = rowId;
+    // The rows usually fit into the lock budget the transaction registered
+    // with, otherwise the array doubles
+    if (transaction->num_locked == transaction->locked_rows_size) {
+      int capacity = std::max(2 * transaction->locked_rows_size, 4);
+      int* temp = new int[capacity];
+      if (transaction->num_locked > 0) {
+        memcpy(temp, transaction->locked_rows,
+               sizeof(int) * transaction->num_locked);
+      }
+      delete[] transaction->locked_rows;
+      transaction->locked_rows = temp;
+
+      Lease** leases = new Lease*[capacity]();
+      if (transaction->num_locked > 0) {
+        memcpy(leases, transaction->leases,
+               sizeof(Lease*) * transaction->num_locked);
+      }
+      delete[] transaction->leases;
+      transaction->leases = leases;
+      transaction->locked_rows_size = capacity;
     }
 
+    transaction->locked_rows[transaction->num_locked] = rowId;
+    transaction->leases[transaction->num_locked] = nullptr;
     transaction->num_locked++;
+    indexRow(&transaction->locked_rows_index, transaction->locked_rows,
+             transaction->num_locked);
     transaction->lock_budget--;
   }
 
   return ret;
 };
 
-void releaseLock(Transaction* transaction, int rowId, HashTable* lockTable) {
-  bool wasOwner = false;
-  for (int i = 0; i < transaction->num_locked; i++) {
-    if (transaction->locked_rows[i] == rowId) {
-      for (int j = i; j < transaction->num_locked - 1; j++) {
-        transaction->locked_rows[j] = transaction->locked_rows[j + 1];
-      }
-      wasOwner = true;
-      break;
-    }
-  }
-
-  if (wasOwner) {
+auto releaseLock(Transaction* transaction, int rowId, LockTable* lockTable,
+                 OwnerArena* arena) -> Node<Lock>* {
+  int position = findRow(&transaction->locked_rows_index,
+                         transaction->locked_rows, rowId);
+  if (position >= 0) {
+    // The order of the locked rows does not matter, so the last one fills the
+    // gap
+    int last = transaction->num_locked - 1;
+    unindexRow(&transaction->locked_rows_index, transaction->locked_rows,
+               position, last);
+    transaction->locked_rows[position] = transaction->locked_rows[last];
+    transaction->leases[position] = transaction->leases[last];
     transaction->num_locked--;
     transaction->growing_phase = false;
-    auto lock = (Lock*)get(lockTable, rowId);
+    Lock* lock = get(lockTable, rowId);
     if (lock != nullptr) {
-      release(lock, transaction->transaction_id);
-      if (lock->num_owners == 0) {
-        remove(lockTable, rowId);
-        // delete lock; -> issues with deleting locks in untrusted memory
+      release(lock, transaction->transaction_id, arena);
+      if (numOwners(lock) == 0) {
+        // The lock table may be in untrusted memory, which the enclave cannot
+        // free, so the caller decides what happens to the node and its lock
+        return extract(lockTable, rowId);
       }
     }
   }
+  return nullptr;
 };
 
 auto hasLock(Transaction* transaction, int rowId) -> bool {
-  for (int i = 0; i < transaction->num_locked; i++) {
-    if (transaction->locked_rows[i] == rowId) {
-      return true;
-    }
-  }
-  return false;
+  return findRow(&transaction->locked_rows_index, transaction->locked_rows,
+                 rowId) >= 0;
 };
 
-void releaseAllLocks(Transaction* transaction, HashTable* lockTable) {
+void releaseAllLocks(Transaction* transaction, LockTable* lockTable,
+                     OwnerArena* arena) {
   for (int i = 0; i < transaction->num_locked; i++) {
     int locked_row = transaction->locked_rows[i];
-    auto lock = (Lock*)get(lockTable, locked_row);
-    release(lock, transaction->transaction_id);
-    if (lock->num_owners == 0) {
+    Lock* lock = get(lockTable, locked_row);
+    release(lock, transaction->transaction_id, arena);
+    if (numOwners(lock) == 0) {
       remove(lockTable, locked_row);
     }
   }
   transaction->num_locked = 0;
+  destroyRowIndex(&transaction->locked_rows_index);
   transaction->aborted = true;
 };
 
 auto copy_transaction(Transaction* transaction) -> void* {
-  Transaction* copy = new Transaction();
+  Transaction* copy = poolNew<Transaction>();
   copy->transaction_id = transaction->transaction_id;
   copy->aborted = transaction->aborted;
   copy->growing_phase = transaction->growing_phase;
   copy->lock_budget = transaction->lock_budget;
   copy->locked_rows_size = transaction->locked_rows_size;
 
-  int num_locked = transaction->num_locked;
-  copy->num_locked = num_locked;
+  copy->num_locked = transaction->num_locked;
 
-  if (copy->num_locked > 0) {
-    copy->locked_rows = new int[copy->num_locked];
+  if (copy->locked_rows_size > 0) {
+    copy->locked_rows = new int[copy->locked_rows_size];
+    memcpy(copy->locked_rows, transaction->locked_rows,
+           sizeof(int) * copy->num_locked);
+    copy->leases = new Lease*[copy->locked_rows_size];
+    memcpy(copy->leases, transaction->leases,
+           sizeof(Lease*) * copy->num_locked);
   } else {
     copy->locked_rows = nullptr;
+    copy->leases = nullptr;
   }
-  for (int i = 0; i < num_locked; i++) {
-    copy->locked_rows[i] = transaction->locked_rows[i];
-  }
+  copyRowIndex(&copy->locked_rows_index, &transaction->locked_rows_index);
 
   return (void*)copy;
 }
 
 void free_transaction_copy(Transaction*& transaction) {
-  delete[] transaction->locked_rows;
-  delete transaction;
+  deleteTransaction(transaction);
 }
\ No newline at end of file
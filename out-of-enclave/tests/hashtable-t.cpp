@@ -10,38 +10,62 @@
  */
 
 TEST(HashTableTest, getWhenListEmpty) {
-  HashTable* hashTable = newHashTable(10);
-  void* value = get(hashTable, 102);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
+  Lock* value = get(hashTable, 102);
   EXPECT_EQ(value, nullptr);
 };
 
 TEST(HashTableTest, getListNotEmptyKeyExists) {
-  HashTable* hashTable = newHashTable(10);
-  Lock* lock = newLock();
-  lock->exclusive = true;
-  lock->num_owners = 4;
-
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 32, (void*)lock);
-  set(hashTable, 42, (void*)newLock());
-
-  Lock* value = (Lock*)get(hashTable, 32);
-  EXPECT_EQ(value->exclusive, lock->exclusive);
-  EXPECT_EQ(value->num_owners, lock->num_owners);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
+  initLock(insert(hashTable, 12));
+  initLock(insert(hashTable, 22));
+  Lock* lock = insert(hashTable, 32);
+  initLock(lock);
+  lock->word = kExclusiveBit | 4;
+  initLock(insert(hashTable, 42));
+
+  Lock* value = get(hashTable, 32);
+  EXPECT_EQ(value, lock);
+  EXPECT_EQ(isHeldExclusively(value), isHeldExclusively(lock));
+  EXPECT_EQ(numOwners(value), numOwners(lock));
 };
 
 TEST(HashTableTest, getElementNotFound) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  initLock(insert(hashTable, 12));
+  initLock(insert(hashTable, 22));
+  initLock(insert(hashTable, 42));
 
-  Lock* value = (Lock*)get(hashTable, 32);
+  Lock* value = get(hashTable, 32);
   EXPECT_EQ(value, nullptr);
 };
 
+// Looks up more keys than one batch, hits and misses mixed, in long buckets
+TEST(HashTableTest, getManyFindsHitsAndMisses) {
+  HashTable<int, int>* hashTable = newHashTable<int, int>(10);
+  for (int key = 0; key < 1000; key += 2) {
+    *insert(hashTable, key) = key;
+  }
+
+  const int numKeys = 3 * kLookupBatchSize + 1;
+  int keys[numKeys];
+  for (int i = 0; i < numKeys; i++) {
+    keys[i] = i * 37 % 1200;
+  }
+  int* values[numKeys];
+  getMany(hashTable, keys, numKeys, values);
+
+  for (int i = 0; i < numKeys; i++) {
+    if (keys[i] % 2 == 0 && keys[i] < 1000) {
+      ASSERT_NE(values[i], nullptr);
+      EXPECT_EQ(*values[i], keys[i]);
+    } else {
+      EXPECT_EQ(values[i], nullptr);
+    }
+  }
+};
+
 /*
  ********************************
  * SET
@@ -49,23 +73,19 @@ TEST(HashTableTest, getElementNotFound) {
  */
 
 TEST(HashTableTest, setWhenKeyAlreadyExists) {
-  HashTable* hashTable = newHashTable(10);
-  Lock* lock = newLock();
-  lock->exclusive = true;
-  lock->num_owners = 4;
-
-  Lock* anotherLock = new Lock();
-  anotherLock->exclusive = false;
-  anotherLock->num_owners = 6;
-
-  set(hashTable, 32, (void*)lock);
-  // Because lock for that key already exists, it should ignore this set
-  // function call!
-  set(hashTable, 32, (void*)anotherLock);
-
-  Lock* value = (Lock*)get(hashTable, 32);
-  EXPECT_EQ(value->exclusive, lock->exclusive);
-  EXPECT_EQ(value->num_owners, lock->num_owners);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
+  Lock* lock = insert(hashTable, 32);
+  initLock(lock);
+  lock->word = kExclusiveBit | 4;
+
+  // Because lock for that key already exists, it should return the existing
+  // lock unchanged!
+  Lock* anotherLock = insert(hashTable, 32);
+  EXPECT_EQ(anotherLock, lock);
+
+  Lock* value = get(hashTable, 32);
+  EXPECT_EQ(isHeldExclusively(value), true);
+  EXPECT_EQ(numOwners(value), 4);
 };
 
 /*
@@ -75,26 +95,26 @@ TEST(HashTableTest, setWhenKeyAlreadyExists) {
  */
 
 TEST(HashTableTest, containsListEmpty) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
   EXPECT_FALSE(contains(hashTable, 32));
 };
 
 TEST(HashTableTest, containsTrue) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  initLock(insert(hashTable, 12));
+  initLock(insert(hashTable, 22));
+  initLock(insert(hashTable, 42));
 
   EXPECT_TRUE(contains(hashTable, 22));
 };
 
 TEST(HashTableTest, containsFalse) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  initLock(insert(hashTable, 12));
+  initLock(insert(hashTable, 22));
+  initLock(insert(hashTable, 42));
 
   EXPECT_FALSE(contains(hashTable, 32));
 };
@@ -106,18 +126,18 @@ TEST(HashTableTest, containsFalse) {
  */
 
 TEST(HashTableTest, removeEmptyList) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
   // Nothing happens
   remove(hashTable, 10);
 };
 
 TEST(HashTableTest, removeEndOfList) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 32, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  initLock(insert(hashTable, 12));
+  initLock(insert(hashTable, 22));
+  initLock(insert(hashTable, 32));
+  initLock(insert(hashTable, 42));
 
   EXPECT_TRUE(contains(hashTable, 12));
   EXPECT_TRUE(contains(hashTable, 22));
@@ -133,20 +153,20 @@ TEST(HashTableTest, removeEndOfList) {
 };
 
 TEST(HashTableTest, removeListJustHasOneElement) {
-  HashTable* hashTable = newHashTable(10);
-  set(hashTable, 12, (void*)newLock());
+  LockTable* hashTable = newHashTable<int, Lock>(10);
+  initLock(insert(hashTable, 12));
   EXPECT_TRUE(contains(hashTable, 12));
   remove(hashTable, 12);
   EXPECT_FALSE(contains(hashTable, 12));
 }
 
 TEST(HashTableTest, removeBeginningOfList) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 32, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  initLock(insert(hashTable, 12));
+  initLock(insert(hashTable, 22));
+  initLock(insert(hashTable, 32));
+  initLock(insert(hashTable, 42));
 
   EXPECT_TRUE(contains(hashTable, 12));
   EXPECT_TRUE(contains(hashTable, 22));
@@ -162,12 +182,12 @@ TEST(HashTableTest, removeBeginningOfList) {
 };
 
 TEST(HashTableTest, removeMiddleOfList) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 32, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  initLock(insert(hashTable, 12));
+  initLock(insert(hashTable, 22));
+  initLock(insert(hashTable, 32));
+  initLock(insert(hashTable, 42));
 
   EXPECT_TRUE(contains(hashTable, 12));
   EXPECT_TRUE(contains(hashTable, 22));
@@ -183,11 +203,11 @@ TEST(HashTableTest, removeMiddleOfList) {
 };
 
 TEST(HashTableTest, removeElementNotFound) {
-  HashTable* hashTable = newHashTable(10);
+  LockTable* hashTable = newHashTable<int, Lock>(10);
 
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 42, (void*)newLock());
+  initLock(insert(hashTable, 12));
+  initLock(insert(hashTable, 22));
+  initLock(insert(hashTable, 42));
 
   EXPECT_TRUE(contains(hashTable, 12));
   EXPECT_TRUE(contains(hashTable, 22));
@@ -209,24 +229,21 @@ TEST(HashTableTest, removeElementNotFound) {
  */
 
 TEST(HashTableTest, changeValue) {
-  HashTable* hashTable = newHashTable(10);
-  Lock* lock = newLock();  // create a lock
-  lock->exclusive = true;
-  lock->num_owners = 4;
-
-  set(hashTable, 12, (void*)newLock());
-  set(hashTable, 22, (void*)newLock());
-  set(hashTable, 32, (void*)lock);  // insert it into the table
-  set(hashTable, 42, (void*)newLock());
+  LockTable* hashTable = newHashTable<int, Lock>(10);
+  initLock(insert(hashTable, 12));
+  initLock(insert(hashTable, 22));
+  Lock* lock = insert(hashTable, 32);  // insert a lock into the table
+  initLock(lock);
+  lock->word = kExclusiveBit | 4;
+  initLock(insert(hashTable, 42));
 
   // Change some values on the lock pointer
-  lock->num_owners = 6;
-  lock->exclusive = false;
+  lock->word = 6;
 
   // Check that the values also changed within the table
-  Lock* value = (Lock*)get(hashTable, 32);
-  EXPECT_EQ(value->num_owners, 6);
-  EXPECT_EQ(value->exclusive, false);
+  Lock* value = get(hashTable, 32);
+  EXPECT_EQ(numOwners(value), 6);
+  EXPECT_EQ(isHeldExclusively(value), false);
 };
 
 /*
@@ -235,18 +252,21 @@ TEST(HashTableTest, changeValue) {
  ********************************
  */
 
+// The layout below assumes the default modulo hash function
+#if !defined(FIBONACCI_HASH) && !defined(MIX64_HASH)
 TEST(HashTableTest, computesBucketSizesCorrectly) {
-  HashTable* hashTable = newHashTable(4);
-  set(hashTable, 4, (void*)newLock());
-  set(hashTable, 1, (void*)newLock());
-  set(hashTable, 5, (void*)newLock());
-  set(hashTable, 9, (void*)newLock());
-  set(hashTable, 3, (void*)newLock());
+  LockTable* hashTable = newHashTable<int, Lock>(4);
+  initLock(insert(hashTable, 4));
+  initLock(insert(hashTable, 1));
+  initLock(insert(hashTable, 5));
+  initLock(insert(hashTable, 9));
+  initLock(insert(hashTable, 3));
 
   /**
-   * Visualization of the hash table after those five operations:
+   * Visualization of the hash table after those five operations, where
+   * group 1 exceeded kMaxLoadFactor and got split into two buckets:
    * [0] -> 4
-   * [1] -> 1, 5, 9
+   * [1] -> 1, 9 | 5
    * [2] ->
    * [3] -> 3
    */
@@ -255,8 +275,116 @@ TEST(HashTableTest, computesBucketSizesCorrectly) {
 
   // Verify bucket sizes
   // First bucket contains 1 element, a.s.o
-  EXPECT_EQ(hashTable->bucketSizes[0], 1);
-  EXPECT_EQ(hashTable->bucketSizes[1], 2);
-  EXPECT_EQ(hashTable->bucketSizes[2], 0);
-  EXPECT_EQ(hashTable->bucketSizes[3], 1);
+  EXPECT_EQ(getBucket(hashTable, 4).second, 1);
+  EXPECT_EQ(getBucket(hashTable, 1).second, 2);
+  EXPECT_EQ(getBucket(hashTable, 5).second, 0);
+  EXPECT_EQ(getBucket(hashTable, 2).second, 0);
+  EXPECT_EQ(getBucket(hashTable, 3).second, 1);
+}
+#endif
+
+// The bucket statistics account for every entry of the table
+TEST(HashTableTest, countsEntriesPerBucket) {
+  LockTable* hashTable = newHashTable<int, Lock>(10);
+  for (int key = 0; key < 1000; key++) {
+    initLock(insert(hashTable, key));
+  }
+
+  BucketStatistics statistics = bucketStatistics(hashTable);
+  EXPECT_EQ(statistics.entries, 1000);
+  unsigned long buckets = 0;
+  unsigned long entries = 0;
+  for (int length = 0; length < BUCKET_HISTOGRAM_SIZE; length++) {
+    buckets += statistics.histogram[length];
+    entries += length * statistics.histogram[length];
+  }
+  EXPECT_EQ(buckets, statistics.buckets);
+  EXPECT_EQ(entries, statistics.entries);
+  EXPECT_GE(statistics.max_length, meanBucketLength(&statistics));
+
+  for (int key = 0; key < 1000; key += 2) {
+    remove(hashTable, key);
+  }
+  EXPECT_EQ(bucketStatistics(hashTable).entries, 500);
+}
+
+TEST(HashTableTest, hashStaysWithinTable) {
+  const int size = 10;
+  for (int key = 0; key < 100000; key += 7) {
+    EXPECT_GE(hash(size, key), 0);
+    EXPECT_LT(hash(size, key), size);
+  }
+  EXPECT_LT(hash(size, 2147483647), size);
+}
+
+TEST(HashTableTest, growsOnlyTheFullBucketGroup) {
+  HashTable<int, int>* hashTable = newHashTable<int, int>(10);
+  const int numKeys = 1000;
+
+  // All keys belong to bucket group 3
+  int* keys = new int[numKeys];
+  for (int i = 0, key = 0; i < numKeys; key++) {
+    if (hash(10, key) == 3) {
+      keys[i++] = key;
+    }
+  }
+  for (int i = 0; i < numKeys; i++) {
+    *insert(hashTable, keys[i]) = i;
+  }
+
+  BucketGroup* group = &hashTable->groups[3];
+  EXPECT_EQ(group->count, numKeys);
+  EXPECT_FALSE(needsSplit(group));
+  for (int i = 0; i < 10; i++) {
+    if (i != 3) {
+      EXPECT_EQ(hashTable->groups[i].level, 0);
+      EXPECT_EQ(hashTable->groups[i].split, 0);
+      EXPECT_EQ(hashTable->groups[i].segments, nullptr);
+    }
+  }
+  for (int i = 0; i < numKeys; i++) {
+    EXPECT_EQ(*get(hashTable, keys[i]), i);
+  }
+
+  delete[] keys;
+}
+
+TEST(HashTableTest, untrustedTableIsOnlySplitExplicitly) {
+  LockTable* hashTable = newHashTable<int, Lock>(4);
+  hashTable->untrusted = true;
+
+  // All keys belong to bucket group 1
+  const int numKeys = 9;
+  int keys[numKeys];
+  for (int i = 0, key = 0; i < numKeys; key++) {
+    if (hash(4, key) == 1) {
+      keys[i++] = key;
+    }
+  }
+  for (int key : keys) {
+    initLock(insert(hashTable, key));
+  }
+  EXPECT_EQ(getBucket(hashTable, keys[0]).second, numKeys);
+  EXPECT_TRUE(needsSplit(&hashTable->groups[1]));
+
+  // Split the group the way the enclave does, based on a trusted copy of its
+  // state
+  BucketGroup state = hashTable->groups[1];
+  while (needsSplit(&state)) {
+    int segment = segmentOf(state.split + (1 << state.level));
+    Bucket**& segments = hashTable->groups[1].segments;
+    if (segments == nullptr) {
+      segments = new Bucket*[HASHTABLE_MAX_LEVELS - 1]();
+    }
+    if (segments[segment - 1] == nullptr) {
+      segments[segment - 1] = new Bucket[segmentSize(segment)]();
+    }
+    splitBucketGroup(hashTable, 1, &state);
+  }
+  EXPECT_EQ(hashTable->groups[1].level, state.level);
+  EXPECT_EQ(hashTable->groups[1].split, state.split);
+  EXPECT_FALSE(needsSplit(&hashTable->groups[1]));
+  for (int key : keys) {
+    EXPECT_TRUE(contains(hashTable, key));
+  }
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <mutex>
 #include <thread>
 
 #include "lock.h"
@@ -7,6 +8,12 @@
 const unsigned int kTransactionIdA = 1;
 const unsigned int kTransactionIdB = 2;
 
+/**
+ * Allocates a chunk for an OwnerArena like the untrusted part does for the
+ * enclave
+ */
+int* allocateChunk() { return new int[kOwnerChunkSize](); }
+
 // Shared access works
 TEST(LockTest, sharedAccess) {
   Lock* lock = newLock();
@@ -15,17 +22,17 @@ TEST(LockTest, sharedAccess) {
   getSharedAccess(lock, 3);
   getSharedAccess(lock, 4);
 
-  EXPECT_FALSE(lock->exclusive);
-  EXPECT_EQ(lock->num_owners, 4);
+  EXPECT_FALSE(isHeldExclusively(lock));
+  EXPECT_EQ(numOwners(lock), 4);
 };
 
 // Exclusive access works
 TEST(LockTest, exclusiveAccess) {
   Lock* lock = newLock();
   getExclusiveAccess(lock, kTransactionIdA);
-  EXPECT_TRUE(lock->exclusive);
-  EXPECT_EQ(lock->num_owners, 1);
-  EXPECT_EQ(lock->owners[0], kTransactionIdA);
+  EXPECT_TRUE(isHeldExclusively(lock));
+  EXPECT_EQ(numOwners(lock), 1);
+  EXPECT_TRUE(isOwner(lock, kTransactionIdA));
 }
 
 // Cannot acquire shared access on an exclusive lock
@@ -54,9 +61,9 @@ TEST(LockTest, upgrade) {
   Lock* lock = newLock();
   EXPECT_TRUE(getSharedAccess(lock, kTransactionIdA));
   EXPECT_TRUE(upgrade(lock, kTransactionIdA));
-  EXPECT_TRUE(lock->exclusive);
-  EXPECT_EQ(lock->num_owners, 1);
-  EXPECT_EQ(lock->owners[0], kTransactionIdA);
+  EXPECT_TRUE(isHeldExclusively(lock));
+  EXPECT_EQ(numOwners(lock), 1);
+  EXPECT_TRUE(isOwner(lock, kTransactionIdA));
 }
 
 TEST(LockTest, releaseUnownedLock) {
@@ -65,7 +72,125 @@ TEST(LockTest, releaseUnownedLock) {
   // B tries to release the lock of A
   release(lock, kTransactionIdB);
   // This has no effectg, A still owns the lock
-  EXPECT_TRUE(lock->exclusive);
-  EXPECT_EQ(lock->num_owners, 1);
-  EXPECT_EQ(lock->owners[0], kTransactionIdA);
-}
\ No newline at end of file
+  EXPECT_TRUE(isHeldExclusively(lock));
+  EXPECT_EQ(numOwners(lock), 1);
+  EXPECT_TRUE(isOwner(lock, kTransactionIdA));
+}
+
+// A lock fits into half a cache line
+TEST(LockTest, isCompact) { EXPECT_LE(sizeof(Lock), 32); }
+
+// Without an arena, shared access fails once all inline slots are taken
+TEST(LockTest, sharedAccessIsLimited) {
+  Lock* lock = newLock();
+  for (int i = 1; i <= kInlineOwners; i++) {
+    EXPECT_TRUE(getSharedAccess(lock, i));
+  }
+  EXPECT_FALSE(getSharedAccess(lock, kInlineOwners + 1));
+  EXPECT_EQ(numOwners(lock), kInlineOwners);
+
+  // The slot of a released owner can be taken again
+  release(lock, 1);
+  EXPECT_TRUE(getSharedAccess(lock, kInlineOwners + 1));
+  EXPECT_FALSE(isOwner(lock, 1));
+  EXPECT_TRUE(isOwner(lock, kInlineOwners + 1));
+  deleteLock(lock);
+}
+
+// Owners beyond the inline slots are stored in an overflow array of the arena
+TEST(LockTest, manySharedOwners) {
+  OwnerArena arena;
+  initOwnerArena(&arena, &allocateChunk);
+  Lock* lock = newLock();
+  const int numTransactions = 10 * kInlineOwners;
+  for (int i = 0; i < numTransactions; i++) {
+    EXPECT_TRUE(getSharedAccess(lock, i, &arena));
+  }
+  EXPECT_EQ(numOwners(lock), numTransactions);
+  EXPECT_NE(lock->overflow, nullptr);
+  EXPECT_FALSE(getExclusiveAccess(lock, numTransactions));
+
+  for (int i = 0; i < numTransactions; i += 2) {
+    release(lock, i, &arena);
+  }
+  EXPECT_EQ(numOwners(lock), numTransactions / 2);
+  for (int i = 0; i < numTransactions; i++) {
+    EXPECT_EQ(isOwner(lock, i, &arena), i % 2 == 1);
+  }
+
+  // The remaining owners keep their order
+  EXPECT_EQ(lock->owners[0], 1);
+  EXPECT_EQ(lock->overflow[0], 2 * kInlineOwners + 1);
+
+  for (int i = 1; i < numTransactions; i += 2) {
+    release(lock, i, &arena);
+  }
+  EXPECT_EQ(numOwners(lock), 0);
+  EXPECT_EQ(lock->overflow, nullptr);
+  EXPECT_TRUE(arena.capacities.empty());
+  EXPECT_TRUE(getExclusiveAccess(lock, numTransactions));
+  deleteLock(lock);
+}
+
+// Freed overflow arrays are handed out again
+TEST(LockTest, overflowArraysAreReused) {
+  OwnerArena arena;
+  initOwnerArena(&arena, &allocateChunk);
+  Lock* lock = newLock();
+  for (int i = 0; i <= kInlineOwners; i++) {
+    EXPECT_TRUE(getSharedAccess(lock, i, &arena));
+  }
+  int* overflow = lock->overflow;
+  release(lock, kInlineOwners, &arena);
+  EXPECT_EQ(lock->overflow, nullptr);
+
+  Lock* another = newLock();
+  for (int i = 0; i <= kInlineOwners; i++) {
+    EXPECT_TRUE(getSharedAccess(another, i, &arena));
+  }
+  EXPECT_EQ(another->overflow, overflow);
+  EXPECT_EQ(arena.used, kInlineOwners);
+  deleteLock(lock);
+  deleteLock(another);
+}
+
+// An overflow array that the arena did not hand out is never written to
+TEST(LockTest, foreignOverflowIsRejected) {
+  OwnerArena arena;
+  initOwnerArena(&arena, &allocateChunk);
+  Lock* lock = newLock();
+  for (int i = 0; i < kInlineOwners; i++) {
+    EXPECT_TRUE(getSharedAccess(lock, i, &arena));
+  }
+  int foreign[kInlineOwners] = {0};
+  lock->overflow = foreign;
+  EXPECT_FALSE(getSharedAccess(lock, kInlineOwners, &arena));
+  EXPECT_EQ(numOwners(lock), kInlineOwners);
+  EXPECT_EQ(foreign[0], 0);
+  deleteLock(lock);
+}
+
+// Threads that serialize their shared acquisitions, like the workers of the
+// lock manager, see the owners added by each other
+TEST(LockTest, concurrentSharedAccess) {
+  for (int repetition = 0; repetition < 100; repetition++) {
+    Lock* lock = newLock();
+    std::mutex mutex;
+    std::thread threads[kInlineOwners];
+    for (int i = 0; i < kInlineOwners; i++) {
+      threads[i] = std::thread([lock, &mutex, i] {
+        std::lock_guard<std::mutex> guard(mutex);
+        getSharedAccess(lock, i);
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    EXPECT_EQ(numOwners(lock), kInlineOwners);
+    for (int i = 0; i < kInlineOwners; i++) {
+      EXPECT_TRUE(isOwner(lock, i));
+    }
+    deleteLock(lock);
+  }
+}
@@ -68,6 +68,33 @@ TEST_F(LockManagerTest, multipleTransactionsSharedLock) {
   }
 };
 
+// More transactions can share a row than fit inline into its lock
+TEST_F(LockManagerTest, manyTransactionsShareALock) {
+  LockManager lock_manager = LockManager();
+  const int numTransactions = 10 * kInlineOwners;
+  for (int transaction_id = 1; transaction_id <= numTransactions;
+       transaction_id++) {
+    EXPECT_TRUE(lock_manager.registerTransaction(transaction_id, kLockBudget));
+    EXPECT_TRUE(lock_manager.lock(transaction_id, kRowId, false).second);
+  }
+  EXPECT_EQ(numOwners(get(lock_manager.lockTable, kRowId)), numTransactions);
+
+  for (int transaction_id = 1; transaction_id <= numTransactions;
+       transaction_id += 2) {
+    lock_manager.unlock(transaction_id, kRowId, true);
+  }
+  EXPECT_EQ(numOwners(get(lock_manager.lockTable, kRowId)),
+            numTransactions / 2);
+
+  // The bucket of the shared lock still passes the integrity verification
+  int size = lock_manager.lockTable->size;
+  int anotherLockId = kRowId + 1;
+  while (hash(size, anotherLockId) != hash(size, kRowId)) {
+    anotherLockId++;  // make sure that lock will be in the same bucket
+  }
+  EXPECT_TRUE(lock_manager.lock(2, anotherLockId, false).second);
+}
+
 // Cannot get the same lock twice
 // TODO: Doesn't check if transaction already owns lock yet
 TEST_F(LockManagerTest, DISABLED_sameLockTwice) {
@@ -98,6 +125,21 @@ TEST_F(LockManagerTest, upgradeLock) {
   EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, true).second);
 };
 
+// A shared lock can only be upgraded once the other owners released it
+TEST_F(LockManagerTest, upgradeRequiresSoleOwnership) {
+  LockManager lock_manager = LockManager();
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB, kLockBudget));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, false).second);
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kRowId, false).second);
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdA, kRowId, true).second);
+
+  lock_manager.unlock(kTransactionIdB, kRowId, true);
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, true).second);
+  EXPECT_TRUE(isHeldExclusively(get(lock_manager.lockTable, kRowId)));
+  EXPECT_EQ(numOwners(get(lock_manager.lockTable, kRowId)), 1);
+};
+
 // Can unlock and acquire again
 TEST_F(LockManagerTest, unlock) {
   LockManager lock_manager = LockManager();
@@ -182,13 +224,15 @@ TEST_F(LockManagerTest,
   EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, false).second);
 
   // Alter lock table in untrusted memory
-  auto lock = (Lock*)get(lock_manager.lockTable, kRowId);
-  lock->exclusive = true;
+  Lock* lock = get(lock_manager.lockTable, kRowId);
+  lock->word |= kExclusiveBit;
 
   // Next lock request fails because change is detected
-  int anotherLockId =
-      kRowId + lock_manager.lockTable
-                   ->size;  // make sure that lock will be in the same bucket
+  int size = lock_manager.lockTable->size;
+  int anotherLockId = kRowId + 1;
+  while (hash(size, anotherLockId) != hash(size, kRowId)) {
+    anotherLockId++;  // make sure that lock will be in the same bucket
+  }
   EXPECT_FALSE(lock_manager.lock(kTransactionIdA, anotherLockId, false).second);
 }
 
@@ -199,13 +243,15 @@ TEST_F(LockManagerTest,
   EXPECT_TRUE(lock_manager.lock(kTransactionIdA, kRowId, false).second);
 
   // Alter lock table in untrusted memory
-  auto lock = (Lock*)get(lock_manager.lockTable, kRowId);
-  lock->num_owners = 6;
+  Lock* lock = get(lock_manager.lockTable, kRowId);
+  lock->word = 6;
 
   // Next lock request fails because change is detected
-  int anotherLockId =
-      kRowId + lock_manager.lockTable
-                   ->size;  // make sure that lock will be in the same bucket
+  int size = lock_manager.lockTable->size;
+  int anotherLockId = kRowId + 1;
+  while (hash(size, anotherLockId) != hash(size, kRowId)) {
+    anotherLockId++;  // make sure that lock will be in the same bucket
+  }
   EXPECT_FALSE(lock_manager.lock(kTransactionIdA, anotherLockId, false).second);
 }
 
@@ -247,6 +293,127 @@ TEST_F(LockManagerTest, DISABLED_transactionGetsDeletedAfterReleasingLastLock) {
   EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
 }
 
+// Committing releases the locks of a transaction on all workers at once and
+// keeps the buckets of the lock table verifiable
+TEST_F(LockManagerTest, commitReleasesAllLocks) {
+  LockManager lock_manager = LockManager(4);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB, kLockBudget));
+  for (unsigned int rowId = kRowId; rowId < kRowId + 10; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, rowId, true).second);
+  }
+
+  EXPECT_TRUE(lock_manager.commit(kTransactionIdA));
+  EXPECT_FALSE(lock_manager.commit(kTransactionIdA));
+  for (unsigned int rowId = kRowId; rowId < kRowId + 10; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdB, rowId, true).second);
+  }
+  EXPECT_TRUE(lock_manager.abort(kTransactionIdB));
+}
+
+// A batch of lock requests is sent to the enclave at once and answered in the
+// order of the requests
+TEST_F(LockManagerTest, lockBatch) {
+  LockManager lock_manager = LockManager(4);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+  std::vector<BatchedLock> batch;
+  for (unsigned int rowId = kRowId; rowId < kRowId + 10; rowId++) {
+    batch.push_back({(int)kTransactionIdA, (int)rowId, true});
+  }
+  // The other transaction is not registered
+  batch.push_back({(int)kTransactionIdB, (int)kRowId + 20, false});
+
+  auto results = lock_manager.lockBatch(batch);
+  ASSERT_EQ(results.size(), batch.size());
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(results[i].second);
+    EXPECT_TRUE(lock_manager.verify_signature_string(
+        results[i].first, kTransactionIdA, kRowId + i, true));
+  }
+  EXPECT_FALSE(results[10].second);
+}
+
+// A lock is released once its lease expired, e.g. because its client crashed
+TEST_F(LockManagerTest, expiredLockIsReleased) {
+  const int kLeaseDuration = 50;
+  LockManager lock_manager = LockManager(1, kLeaseDuration);
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdB, kLockBudget));
+  std::string signature =
+      lock_manager.lock(kTransactionIdA, kRowId, true).first;
+  EXPECT_TRUE(lock_manager.verify_signature_string(signature, kTransactionIdA,
+                                                   kRowId, true));
+  EXPECT_FALSE(lock_manager.lock(kTransactionIdB, kRowId, true).second);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(10 * kLeaseDuration));
+  EXPECT_TRUE(lock_manager.lock(kTransactionIdB, kRowId, true).second);
+}
+
+// Each worker thread owns the same number of partitions of the lock table at
+// first, and the partitions count the jobs served for their rows
+TEST_F(LockManagerTest, partitionStatistics) {
+  LockManager lock_manager = LockManager(4);
+  auto before = lock_manager.getPartitionStatistics();
+  ASSERT_EQ(before.size(), (size_t)(4 * kPartitionsPerWorker));
+  for (int i = 0; i < (int)before.size(); i++) {
+    EXPECT_EQ(before[i].owner, i / kPartitionsPerWorker);
+    EXPECT_EQ(before[i].served, 0UL);
+  }
+
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kLockBudget));
+  for (unsigned int rowId = kRowId; rowId < kRowId + 10; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, rowId, false).second);
+  }
+  // The workers count a job after serving it, and serve the parts of the
+  // commit after the lock requests
+  EXPECT_TRUE(lock_manager.commit(kTransactionIdA));
+  unsigned long served = 0;
+  for (const auto &partition : lock_manager.getPartitionStatistics()) {
+    EXPECT_GE(partition.owner, 0);
+    EXPECT_LT(partition.owner, 4);
+    served += partition.served;
+  }
+  EXPECT_GE(served, 10UL);
+}
+
+// A worker with a backlog hands partitions over to an idle worker, which still
+// detects conflicts on the rows of the partitions it took over
+TEST_F(LockManagerTest, busyWorkerMigratesPartitions) {
+  LockManager lock_manager = LockManager(4);
+  const unsigned int kHotRows = 2500;       // rows of the first worker
+  const unsigned int kProbeDistance = 100;  // less than a partition
+  const unsigned int kMaxRounds = 100;
+  auto migrations = [&lock_manager]() {
+    unsigned long total = 0;
+    for (const auto &partition : lock_manager.getPartitionStatistics()) {
+      total += partition.migrations;
+    }
+    return total;
+  };
+  for (unsigned int round = 0; round < kMaxRounds && migrations() == 0;
+       round++) {
+    unsigned int transactionId = kTransactionIdC + 1 + round;
+    EXPECT_TRUE(lock_manager.registerTransaction(transactionId, kHotRows));
+    for (unsigned int rowId = 0; rowId < kHotRows; rowId++) {
+      lock_manager.lock(transactionId, rowId, false, false);
+    }
+    EXPECT_TRUE(lock_manager.commit(transactionId));
+  }
+  EXPECT_GT(migrations(), 0UL);
+
+  EXPECT_TRUE(lock_manager.registerTransaction(kTransactionIdA, kHotRows));
+  for (unsigned int rowId = 0; rowId < kHotRows; rowId++) {
+    EXPECT_TRUE(lock_manager.lock(kTransactionIdA, rowId, true).second);
+  }
+  // Each partition of the first worker is probed, including the migrated ones
+  for (unsigned int rowId = 0; rowId < kHotRows; rowId += kProbeDistance) {
+    unsigned int transactionId = kTransactionIdC + kMaxRounds + 1 + rowId;
+    EXPECT_TRUE(lock_manager.registerTransaction(transactionId, kLockBudget));
+    EXPECT_FALSE(lock_manager.lock(transactionId, rowId, false).second);
+  }
+  EXPECT_TRUE(lock_manager.commit(kTransactionIdA));
+}
+
 TEST_F(LockManagerTest, notWaitingForSignature) {
   LockManager lock_manager = LockManager();
   int lockBudget = 100;
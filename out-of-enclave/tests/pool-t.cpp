@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "hashtable.h"
+#include "lock.h"
+#include "pool.h"
+#include "transaction.h"
+
+#ifndef POOL_BYPASS
+// Freed blocks are reused for the next allocation of the same size class
+TEST(PoolTest, reusesFreedBlocks) {
+  Lock* lock = newLock();
+  deleteLock(lock);
+  EXPECT_EQ(newLock(), lock);
+};
+#endif
+
+// Objects of the same size class get distinct blocks
+TEST(PoolTest, allocatesDistinctBlocks) {
+  const int numObjects = 10 * kPoolBatchSize;
+  std::set<void*> blocks;
+  for (int i = 0; i < numObjects; i++) {
+    blocks.insert(poolAllocate(sizeof(Node<Lock>)));
+  }
+  EXPECT_EQ(blocks.size(), numObjects);
+  for (void* block : blocks) {
+    poolFree(block, sizeof(Node<Lock>));
+  }
+};
+
+// Objects larger than the largest size class are allocated on the heap
+TEST(PoolTest, largeObjects) {
+  const size_t size = kPoolMinBlockSize << kPoolSizeClasses;
+  char* block = (char*)poolAllocate(size);
+  block[size - 1] = 1;
+  poolFree(block, size);
+};
+
+// Objects are initialized, even when their block is reused
+TEST(PoolTest, initializesObjects) {
+  Lock* lock = newLock();
+  Transaction* transaction = newTransaction(1, 10);
+  addLock(transaction, 1, false, lock);
+  deleteTransaction(transaction);
+
+  transaction = newTransaction(2, 10);
+  EXPECT_EQ(transaction->transaction_id, 2);
+  EXPECT_EQ(transaction->num_locked, 0);
+  EXPECT_EQ(transaction->lock_budget, 10);
+  deleteTransaction(transaction);
+  deleteLock(lock);
+};
+
+#ifndef POOL_BYPASS
+// Only refilling a free list counts as a miss
+TEST(PoolTest, countsHitsAndMisses) {
+  PoolStatistics before = poolStatistics();
+  std::vector<void*> blocks;
+  for (int i = 0; i < 4 * kPoolBatchSize; i++) {
+    blocks.push_back(poolAllocate(kPoolMinBlockSize));
+  }
+  PoolStatistics after = poolStatistics();
+
+  // The first refill may also publish hits of previous tests
+  EXPECT_EQ(after.misses - before.misses, 4);
+  EXPECT_GE(after.hits - before.hits, 2 * (kPoolBatchSize - 1));
+  EXPECT_GE(after.slabs, 1);
+
+  for (void* block : blocks) {
+    poolFree(block, kPoolMinBlockSize);
+  }
+};
+
+// Blocks cached by a thread are handed to other threads once it exits
+TEST(PoolTest, flushesCachesOfExitingThreads) {
+  const size_t size = kPoolMinBlockSize << (kPoolSizeClasses - 1);
+  std::set<void*> cached;
+  std::thread exiting([&]() {
+    std::vector<void*> blocks;
+    for (int i = 0; i < kPoolBatchSize; i++) {
+      blocks.push_back(poolAllocate(size));
+    }
+    for (void* block : blocks) {
+      poolFree(block, size);
+      cached.insert(block);
+    }
+  });
+  exiting.join();
+
+  // This thread caches at most two batches itself before it refills its free
+  // list from the shared one, which starts with the blocks of the exited thread
+  std::vector<void*> blocks;
+  int reused = 0;
+  for (int i = 0; i < 3 * kPoolBatchSize; i++) {
+    blocks.push_back(poolAllocate(size));
+    reused += cached.count(blocks.back());
+  }
+  EXPECT_EQ(reused, kPoolBatchSize);
+
+  for (void* block : blocks) {
+    poolFree(block, size);
+  }
+};
+#endif
+
+// Blocks freed by one thread can be allocated by another one
+TEST(PoolTest, freeingOnOtherThreads) {
+  const int numLocks = 20 * kPoolBatchSize;
+  std::vector<Lock*> locks(numLocks);
+  std::thread allocating([&]() {
+    for (int i = 0; i < numLocks; i++) {
+      locks[i] = newLock();
+    }
+  });
+  allocating.join();
+
+  std::thread freeing([&]() {
+    for (Lock* lock : locks) {
+      deleteLock(lock);
+    }
+  });
+  freeing.join();
+
+  std::set<Lock*> reused;
+  for (int i = 0; i < numLocks; i++) {
+    reused.insert(newLock());
+  }
+  EXPECT_EQ(reused.size(), numLocks);
+};
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "timing_wheel.h"
+
+class TimingWheelTest : public ::testing::Test {
+ protected:
+  void SetUp() override { initTimingWheel(&wheel_, kStart_); };
+
+  void TearDown() override { destroyTimingWheel(&wheel_); }
+
+  // Advances the wheel and frees the expired leases
+  auto advance(unsigned long now) -> std::vector<int> {
+    std::vector<int> rows;
+    Lease* lease = advanceTimingWheel(&wheel_, now);
+    while (lease != nullptr) {
+      Lease* next = lease->next;
+      rows.push_back(lease->row_id);
+      cancelLease(&wheel_, lease);
+      lease = next;
+    }
+    return rows;
+  }
+
+  const unsigned long kStart_ = 1000;
+  TimingWheel wheel_;
+};
+
+// A lease expires at the tick it was added for, not before
+TEST_F(TimingWheelTest, expiresAtExpiry) {
+  addLease(&wheel_, 1, 7, kStart_ + 5);
+  EXPECT_TRUE(advance(kStart_ + 4).empty());
+  EXPECT_EQ(advance(kStart_ + 5), std::vector<int>{7});
+  EXPECT_EQ(wheel_.num_leases, 0);
+};
+
+// Leases beyond the first level move down and still expire on time
+TEST_F(TimingWheelTest, cascadesLeases) {
+  const std::vector<unsigned long> delays = {
+      kWheelSlots - 1, kWheelSlots, kWheelSlots + 1,
+      kWheelSlots * kWheelSlots, kWheelSlots * kWheelSlots * 3 + 17};
+  for (int i = 0; i < (int)delays.size(); i++) {
+    addLease(&wheel_, 1, i, kStart_ + delays[i]);
+  }
+  for (int i = 0; i < (int)delays.size(); i++) {
+    EXPECT_TRUE(advance(kStart_ + delays[i] - 1).empty());
+    EXPECT_EQ(advance(kStart_ + delays[i]), std::vector<int>{i});
+  }
+};
+
+// Leases further ahead than the wheel covers expire on time as well
+TEST_F(TimingWheelTest, expiresLeasesBeyondWheel) {
+  unsigned long expiry = kStart_ + (1ul << (kWheelBits * kWheelLevels)) + 5;
+  addLease(&wheel_, 1, 7, expiry);
+  EXPECT_TRUE(advance(expiry - 1).empty());
+  EXPECT_EQ(advance(expiry), std::vector<int>{7});
+};
+
+// A cancelled lease does not expire
+TEST_F(TimingWheelTest, cancelledLeaseDoesNotExpire) {
+  Lease* lease = addLease(&wheel_, 1, 7, kStart_ + 100);
+  addLease(&wheel_, 2, 8, kStart_ + 100);
+  cancelLease(&wheel_, lease);
+  EXPECT_EQ(advance(kStart_ + 100), std::vector<int>{8});
+};
+
+// A lease that expired already expires with the next tick
+TEST_F(TimingWheelTest, expiredLeaseExpiresWithNextTick) {
+  addLease(&wheel_, 1, 7, kStart_ - 10);
+  EXPECT_EQ(advance(kStart_ + 1), std::vector<int>{7});
+};
+
+// The wheel does not go back in time
+TEST_F(TimingWheelTest, doesNotGoBack) {
+  addLease(&wheel_, 1, 7, kStart_ + 10);
+  advance(kStart_ + 5);
+  EXPECT_TRUE(advance(kStart_).empty());
+  EXPECT_EQ(wheel_.now, kStart_ + 5);
+  EXPECT_EQ(advance(kStart_ + 10), std::vector<int>{7});
+};
@@ -14,12 +14,12 @@ class TransactionTest : public ::testing::Test {
     lock_ = newLock();
     transactionA_ = newTransaction(kTransactionIdA_, kLockBudget_);
     transactionB_ = newTransaction(kTransactionIdB_, kLockBudget_);
-    lockTable_ = newHashTable(100);
+    lockTable_ = newHashTable<int, Lock>(100);
   };
 
   void TearDown() override {
-    delete transactionA_;
-    delete transactionB_;
+    deleteTransaction(transactionA_);
+    deleteTransaction(transactionB_);
   }
 
   const unsigned int kTransactionIdA_ = 0;
@@ -29,13 +29,12 @@ class TransactionTest : public ::testing::Test {
   Lock* lock_;
   Transaction* transactionA_;
   Transaction* transactionB_;
-  HashTable* lockTable_;
+  LockTable* lockTable_;
 
  public:
   void acquireLock(Transaction* transaction, unsigned int rowId) {
-    auto lock = newLock();
-    getSharedAccess(lock, transaction->transaction_id);
-    set(lockTable_, rowId, (void*)lock);
+    Lock* lock = insert(lockTable_, rowId);
+    initLock(lock);
     addLock(transaction, rowId, false, lock);
   };
 };
@@ -65,8 +64,9 @@ TEST_F(TransactionTest, noSharedOnExclusive) {
 
 // Enters shrinking phase after releasing a lock
 TEST_F(TransactionTest, entersShrinkingPhase) {
-  EXPECT_TRUE(addLock(transactionA_, rowId_, false, lock_));
-  set(lockTable_, rowId_, (void*)lock_);
+  Lock* lock = insert(lockTable_, rowId_);
+  initLock(lock);
+  EXPECT_TRUE(addLock(transactionA_, rowId_, false, lock));
 
   auto locked_rows = transactionA_->locked_rows;
   EXPECT_EQ(transactionA_->num_locked, 1);
@@ -81,11 +81,12 @@ TEST_F(TransactionTest, entersShrinkingPhase) {
 
 // Lock budget decreases when acquiring locks
 TEST_F(TransactionTest, lockBudgetDecreases) {
-  auto another_lock = newLock();
-  addLock(transactionA_, rowId_, false, lock_);
-  set(lockTable_, rowId_, (void*)lock_);
+  Lock* lock = insert(lockTable_, rowId_);
+  initLock(lock);
+  addLock(transactionA_, rowId_, false, lock);
+  Lock* another_lock = insert(lockTable_, rowId_ + 1);
+  initLock(another_lock);
   addLock(transactionA_, rowId_ + 1, true, another_lock);
-  set(lockTable_, rowId_ + 1, (void*)another_lock);
   EXPECT_EQ(transactionA_->lock_budget, kLockBudget_ - 2);
 
   releaseLock(transactionA_, rowId_, lockTable_);
@@ -98,6 +99,61 @@ TEST_F(TransactionTest, hasLock) {
   EXPECT_TRUE(hasLock(transactionA_, rowId_));
 };
 
+// The set of locked rows stays consistent when it grows past the lock budget
+// and rows are released in a different order than they were locked
+TEST_F(TransactionTest, releasesRowsInAnyOrder) {
+  const int kNumRows = 1000;
+  for (int rowId = 0; rowId < kNumRows; rowId++) {
+    acquireLock(transactionA_, rowId);
+  }
+  EXPECT_EQ(transactionA_->num_locked, kNumRows);
+
+  // Release every third row, starting from the highest one
+  for (int rowId = kNumRows - 1; rowId >= 0; rowId -= 3) {
+    releaseLock(transactionA_, rowId, lockTable_);
+  }
+
+  for (int rowId = 0; rowId < kNumRows; rowId++) {
+    EXPECT_EQ(hasLock(transactionA_, rowId), (kNumRows - 1 - rowId) % 3 != 0);
+  }
+  EXPECT_FALSE(hasLock(transactionA_, kNumRows));
+  EXPECT_EQ(transactionA_->num_locked, kNumRows - (kNumRows + 2) / 3);
+
+  // A copy holds the same locks without rehashing them
+  Transaction* copy = (Transaction*)copy_transaction(transactionA_);
+  for (int rowId = 0; rowId < kNumRows; rowId++) {
+    EXPECT_EQ(hasLock(copy, rowId), hasLock(transactionA_, rowId));
+  }
+  free_transaction_copy(copy);
+};
+
+// The lease of a row stays at the position of the row, when the array of
+// locked rows grows and other rows are released
+TEST_F(TransactionTest, leasesMoveWithTheirRows) {
+  const int kNumRows = 100;
+  TimingWheel wheel;
+  initTimingWheel(&wheel, 0);
+  for (int rowId = 0; rowId < kNumRows; rowId++) {
+    acquireLock(transactionA_, rowId);
+    transactionA_->leases[transactionA_->num_locked - 1] =
+        addLease(&wheel, kTransactionIdA_, rowId, 1000);
+  }
+
+  for (int rowId = 0; rowId < kNumRows; rowId += 2) {
+    int position = findRow(&transactionA_->locked_rows_index,
+                           transactionA_->locked_rows, rowId);
+    cancelLease(&wheel, transactionA_->leases[position]);
+    transactionA_->leases[position] = nullptr;
+    releaseLock(transactionA_, rowId, lockTable_);
+  }
+
+  for (int i = 0; i < transactionA_->num_locked; i++) {
+    EXPECT_EQ(transactionA_->leases[i]->row_id, transactionA_->locked_rows[i]);
+  }
+  EXPECT_EQ(wheel.num_leases, kNumRows / 2);
+  destroyTimingWheel(&wheel);
+};
+
 // Transaction releases all locks under concurrent lock requests
 TEST_F(TransactionTest, releasesAllLocks) {
   // Start multiple threads that add Locks for that transaction